@@ -0,0 +1,882 @@
+#include "AlertEngine.h"
+#include "NamePool.h"
+#include "ProcessManager.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwchar>
+#include <cwctype>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+const char* AlertEngine::syntax()
+{
+    return
+        "Alert rules, one per line:\n"
+        "  process NAME METRIC > VALUE [for 30s] [clear VALUE] [-> ACTION]   each matching process\n"
+        "  group NAME METRIC > VALUE ...                                    summed over a name\n"
+        "  instances NAME > COUNT ...                                       processes of a name\n"
+        "  appear NAME [-> ACTION]  /  exit NAME [-> ACTION]                a process started / exited\n"
+        "  NAME ignores case and .exe and may use * and ? (group and instance rules then watch\n"
+        "  each matching name on its own). < works instead of > for the threshold rules.\n"
+        "  METRIC: memory, cpu, threads, handles, read, write, io (bytes per second).\n"
+        "  Values take B, KB, MB, GB or TB (optionally /s); cpu is in percent of one core.\n"
+        "  for: how long the condition must hold (ms, s, m or h); clear: where it stops\n"
+        "  (default: the threshold itself).\n"
+        "  ACTION: log (default), kill, or run COMMAND with {pid}, {name} and {value} filled in\n"
+        "  (COMMAND is split into arguments on spaces first, so a value never adds arguments).\n";
+}
+
+static std::wstring lowered(std::wstring text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), ::towlower);
+    return text;
+}
+
+static std::wstring trimmed(const std::wstring& text)
+{
+    size_t first = 0;
+    size_t last = text.size();
+    while (first < last && std::iswspace(text[first]))
+        ++first;
+    while (last > first && std::iswspace(text[last - 1]))
+        --last;
+    return text.substr(first, last - first);
+}
+
+// Number with an optional suffix; false if there is no number
+static bool parseNumber(const std::wstring& text, double& number, std::wstring& suffix)
+{
+    wchar_t* end = nullptr;
+    number = std::wcstod(text.c_str(), &end);
+    if (end == text.c_str() || !(number >= 0.0) || std::isinf(number))
+        return false;
+    suffix = lowered(end);
+    return true;
+}
+
+// A threshold in the metric's own unit: bytes (or bytes per second), percent, or a count
+static bool parseThreshold(const std::wstring& text, AlertKind kind, AlertMetric metric, double& value, std::string& error)
+{
+    std::wstring suffix;
+    if (!parseNumber(text, value, suffix))
+    {
+        error = "expected a number instead of '" + toNarrow(text) + "'";
+        return false;
+    }
+    if (kind == AlertKind::Instances || metric == AlertMetric::Threads || metric == AlertMetric::Handles)
+    {
+        if (!suffix.empty())
+        {
+            error = "expected a count instead of '" + toNarrow(text) + "'";
+            return false;
+        }
+        return true;
+    }
+    if (metric == AlertMetric::Cpu)
+    {
+        if (!suffix.empty() && suffix != L"%")
+        {
+            error = "expected a CPU percentage instead of '" + toNarrow(text) + "'";
+            return false;
+        }
+        return true;
+    }
+
+    std::wstring size = lowered(text);
+    if (size.size() >= 2 && size.compare(size.size() - 2, 2, L"/s") == 0)
+        size.resize(size.size() - 2);
+    if (!parseMemorySize(size, value))
+    {
+        error = "unknown unit '" + toNarrow(suffix) + "'";
+        return false;
+    }
+    return true;
+}
+
+static bool parseRule(const std::wstring& text, AlertRule& rule, std::string& error)
+{
+    rule = AlertRule();
+    rule.text = trimmed(text);
+
+    // The action is everything after "->", the command of run taken as written
+    std::wstring condition = rule.text;
+    size_t arrow = condition.find(L"->");
+    if (arrow != std::wstring::npos)
+    {
+        std::wstring action = trimmed(condition.substr(arrow + 2));
+        condition.resize(arrow);
+        std::wstring verb = lowered(action.substr(0, action.find_first_of(L" \t")));
+        if (verb == L"log")
+            rule.action = AlertAction::Log;
+        else if (verb == L"kill")
+            rule.action = AlertAction::Kill;
+        else if (verb == L"run")
+        {
+            rule.action = AlertAction::Run;
+            rule.command = trimmed(action.substr(3));
+            if (rule.command.empty())
+            {
+                error = "run needs a command";
+                return false;
+            }
+        }
+        else
+        {
+            error = "unknown action '" + toNarrow(verb) + "' (log, kill or run)";
+            return false;
+        }
+        if (verb != L"run" && verb.size() != action.size())
+        {
+            error = "unexpected text after '" + toNarrow(verb) + "'";
+            return false;
+        }
+    }
+
+    std::vector<std::wstring> words;
+    std::wistringstream stream(condition);
+    for (std::wstring word; stream >> word;)
+        words.push_back(word);
+    if (words.empty())
+    {
+        error = "empty rule";
+        return false;
+    }
+
+    std::wstring kind = lowered(words[0]);
+    if (kind == L"process")
+        rule.kind = AlertKind::Process;
+    else if (kind == L"group")
+        rule.kind = AlertKind::Group;
+    else if (kind == L"instances")
+        rule.kind = AlertKind::Instances;
+    else if (kind == L"appear")
+        rule.kind = AlertKind::Appear;
+    else if (kind == L"exit")
+        rule.kind = AlertKind::Exit;
+    else
+    {
+        error = "unknown rule '" + toNarrow(words[0]) + "' (process, group, instances, appear or exit)";
+        return false;
+    }
+
+    if (words.size() < 2)
+    {
+        error = "expected a process name after '" + toNarrow(kind) + "'";
+        return false;
+    }
+    rule.name = lowered(words[1]);
+    if (rule.name.find_first_of(L"*?") == std::wstring::npos)
+        rule.name = cleanProcessName(rule.name);    // "Notepad.exe" finds notepad too
+
+    if (rule.kind == AlertKind::Appear || rule.kind == AlertKind::Exit)
+    {
+        if (words.size() > 2)
+        {
+            error = "unexpected '" + toNarrow(words[2]) + "'";
+            return false;
+        }
+        if (rule.kind == AlertKind::Exit && rule.action == AlertAction::Kill)
+        {
+            error = "an exit rule has nothing to kill";
+            return false;
+        }
+        return true;
+    }
+
+    size_t next = 2;
+    if (rule.kind != AlertKind::Instances)
+    {
+        static const struct { const wchar_t* word; AlertMetric metric; } metrics[] = {
+            { L"memory", AlertMetric::Memory }, { L"mem", AlertMetric::Memory }, { L"cpu", AlertMetric::Cpu },
+            { L"threads", AlertMetric::Threads }, { L"handles", AlertMetric::Handles }, { L"fds", AlertMetric::Handles },
+            { L"read", AlertMetric::ReadRate }, { L"write", AlertMetric::WriteRate }, { L"io", AlertMetric::IoRate },
+        };
+        if (words.size() <= next)
+        {
+            error = "expected a metric after the name";
+            return false;
+        }
+        std::wstring metric = lowered(words[next++]);
+        auto found = std::find_if(std::begin(metrics), std::end(metrics), [&](const auto& entry) { return metric == entry.word; });
+        if (found == std::end(metrics))
+        {
+            error = "unknown metric '" + toNarrow(metric) + "'";
+            return false;
+        }
+        rule.metric = found->metric;
+    }
+
+    if (words.size() <= next || (words[next] != L">" && words[next] != L"<"))
+    {
+        error = "expected > or < before the threshold";
+        return false;
+    }
+    rule.above = words[next++] == L">";
+    if (words.size() <= next)
+    {
+        error = "expected a threshold";
+        return false;
+    }
+    if (!parseThreshold(words[next++], rule.kind, rule.metric, rule.threshold, error))
+        return false;
+    rule.clearLevel = rule.threshold;
+
+    while (next < words.size())
+    {
+        std::wstring option = lowered(words[next++]);
+        if (next >= words.size() || (option != L"for" && option != L"clear"))
+        {
+            error = "unexpected '" + toNarrow(option) + "' (for DURATION or clear VALUE)";
+            return false;
+        }
+        if (option == L"for")
+        {
+            if (!parseDuration(words[next], rule.duration))
+            {
+                error = "expected a duration such as 30s instead of '" + toNarrow(words[next]) + "'";
+                return false;
+            }
+            ++next;
+        }
+        else
+        {
+            if (!parseThreshold(words[next++], rule.kind, rule.metric, rule.clearLevel, error))
+                return false;
+            if (rule.above ? rule.clearLevel > rule.threshold : rule.clearLevel < rule.threshold)
+            {
+                error = "the clear level must be on the other side of the threshold";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+AlertEngine::AlertEngine()
+    : epoch(std::chrono::steady_clock::now())
+{
+}
+
+AlertEngine::~AlertEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    if (jobThread.joinable())
+        jobThread.join();
+}
+
+bool AlertEngine::addRule(const std::wstring& text, std::string& error)
+{
+    AlertRule rule;
+    if (!parseRule(text, rule, error))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ruleList.push_back(std::move(rule));
+    needsReset = true;
+    return true;
+}
+
+bool AlertEngine::loadRules(const std::string& path, std::string& error)
+{
+    std::ifstream file;
+    if (path != "-")
+    {
+        file.open(path);
+        if (!file)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+    }
+    std::istream& in = path == "-" ? std::cin : file;
+
+    std::vector<AlertRule> parsed;
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number)
+    {
+        std::wstring text = trimmed(toWide(line));
+        if (text.empty() || text[0] == L'#')
+            continue;
+        AlertRule rule;
+        if (!parseRule(text, rule, error))
+        {
+            error = path + ":" + std::to_string(number) + ": " + error;
+            return false;
+        }
+        parsed.push_back(std::move(rule));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (AlertRule& rule : parsed)
+        ruleList.push_back(std::move(rule));
+    needsReset = true;
+    return true;
+}
+
+bool AlertEngine::removeRule(size_t index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index >= ruleList.size())
+        return false;
+    ruleList.erase(ruleList.begin() + static_cast<std::ptrdiff_t>(index));
+    reset();    // The states are keyed by rule index, which just moved
+    needsReset = true;
+    return true;
+}
+
+std::vector<AlertRule> AlertEngine::rules() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ruleList;
+}
+
+std::vector<ActiveAlert> AlertEngine::active(std::chrono::steady_clock::time_point now) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<ActiveAlert> result;
+    for (const auto& entry : states)
+    {
+        if (!entry.second.active)
+            continue;
+        uint32_t rule = static_cast<uint32_t>(entry.first >> 32);
+        uint32_t subject = static_cast<uint32_t>(entry.first);
+        bool perProcess = ruleList[rule].kind == AlertKind::Process;
+        result.push_back({ rule, perProcess ? subject : 0, processNames().display(entry.second.nameId), entry.second.value,
+            std::chrono::duration<double>(now - entry.second.since).count() });
+    }
+    std::sort(result.begin(), result.end(), [](const ActiveAlert& a, const ActiveAlert& b)
+        {
+            return a.rule != b.rule ? a.rule < b.rule : a.pid != b.pid ? a.pid < b.pid : a.name < b.name;
+        });
+    return result;
+}
+
+std::vector<std::wstring> AlertEngine::recentLog(size_t count) const
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    size_t first = logLines.size() > count ? logLines.size() - count : 0;
+    return std::vector<std::wstring>(logLines.begin() + static_cast<std::ptrdiff_t>(first), logLines.end());
+}
+
+void AlertEngine::setLogSink(std::function<void(const std::wstring& line)> sink)
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    logSink = std::move(sink);
+}
+
+void AlertEngine::setActionsEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    actionsEnabled = enabled;
+}
+
+void AlertEngine::setTerminationOptions(const TerminationOptions& options)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    terminationOptions = options;
+}
+
+unsigned long long AlertEngine::firedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return fired;
+}
+
+void AlertEngine::update(const ProcessManager& manager, std::chrono::steady_clock::time_point at)
+{
+    // Commands started by run actions are collected here, not only when the next one starts
+    launcher.reapChildren();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    updating = &manager;
+    updateFrom(manager, at);
+    updating = nullptr;
+}
+
+void AlertEngine::updateFrom(const ProcessManager& manager, std::chrono::steady_clock::time_point at)
+{
+    if (needsReset)
+    {
+        reset();
+        evaluateAll(manager, at);
+        needsReset = false;
+        return;
+    }
+    if (ruleList.empty())
+        return;
+
+    const ProcessDelta& delta = manager.getLastDelta();
+
+    // Removals first: a recycled PID shows up as removed and added in the same delta
+    for (const ProcessInfo& proc : delta.removed)
+        forgetProcess(proc, at);
+
+    for (DWORD pid : delta.added)
+    {
+        const ProcessInfo* proc = manager.findProcess(pid);
+        if (!proc)
+            continue;
+        evaluateProcess(*proc, at);
+        for (uint32_t rule : rulesFor(proc->nameId))
+        {
+            if (ruleList[rule].kind == AlertKind::Appear)
+                fire(rule, pid, proc->nameId, 0.0);
+        }
+    }
+
+    for (DWORD pid : delta.changed)
+    {
+        const ProcessInfo* proc = manager.findProcess(pid);
+        if (proc)
+            evaluateProcess(*proc, at);
+    }
+
+    for (uint32_t foldedId : dirtyNames)
+        evaluateAggregate(foldedId, at);
+    dirtyNames.clear();
+
+    checkPending(at);
+}
+
+void AlertEngine::reset()
+{
+    states.clear();
+    pending.clear();
+    contributions.clear();
+    aggregates.clear();
+    dirtyNames.clear();
+
+    rulesByName.clear();
+    wildcardRules.clear();
+    for (uint32_t rule = 0; rule < ruleList.size(); ++rule)
+    {
+        if (ruleList[rule].name.find_first_of(L"*?") != std::wstring::npos)
+            wildcardRules.push_back(rule);
+        else
+            rulesByName[ruleList[rule].name].push_back(rule);
+    }
+    ruleSets.assign(1, std::vector<uint32_t>());
+    aggregateSets.assign(1, 0);
+    ruleSetOfName.clear();
+}
+
+const std::vector<uint32_t>& AlertEngine::rulesFor(uint32_t nameId)
+{
+    if (nameId >= ruleSetOfName.size())
+        ruleSetOfName.resize(std::max<size_t>(nameId + 1, processNames().size()), Unresolved);
+
+    uint32_t set = ruleSetOfName[nameId];
+    if (set == Unresolved)
+    {
+        // First time this name is seen since the rules changed: match it against all of them
+        const std::wstring& name = processNames().lower(nameId);
+        std::vector<uint32_t> matched;
+        auto exact = rulesByName.find(name);
+        if (exact != rulesByName.end())
+            matched = exact->second;
+        for (uint32_t rule : wildcardRules)
+        {
+            if (globMatch(ruleList[rule].name, name))
+                matched.push_back(rule);
+        }
+
+        set = 0;
+        if (!matched.empty())
+        {
+            std::sort(matched.begin(), matched.end());
+            bool aggregate = std::any_of(matched.begin(), matched.end(), [this](uint32_t rule)
+                {
+                    return ruleList[rule].kind == AlertKind::Group || ruleList[rule].kind == AlertKind::Instances;
+                });
+            set = static_cast<uint32_t>(ruleSets.size());
+            ruleSets.push_back(std::move(matched));
+            aggregateSets.push_back(aggregate ? 1 : 0);
+        }
+        ruleSetOfName[nameId] = set;
+    }
+    return ruleSets[set];
+}
+
+bool AlertEngine::hasAggregateRules(uint32_t nameId)
+{
+    rulesFor(nameId);
+    return aggregateSets[ruleSetOfName[nameId]] != 0;
+}
+
+void AlertEngine::evaluateAll(const ProcessManager& manager, std::chrono::steady_clock::time_point now)
+{
+    if (ruleList.empty())
+        return;
+
+    for (const ProcessInfo& proc : manager.getProcessList())
+        evaluateProcess(proc, now);
+
+    // Names given in full are watched even with no process running, so "instances sshd < 1"
+    // fires when there is none to begin with
+    for (const AlertRule& rule : ruleList)
+    {
+        if ((rule.kind == AlertKind::Group || rule.kind == AlertKind::Instances)
+            && rule.name.find_first_of(L"*?") == std::wstring::npos)
+        {
+            uint32_t foldedId = processNames().foldedId(processNames().intern(rule.name));
+            Aggregate& aggregate = aggregates[foldedId];
+            if (!aggregate.dirty)
+            {
+                aggregate.dirty = true;
+                dirtyNames.push_back(foldedId);
+            }
+        }
+    }
+
+    for (uint32_t foldedId : dirtyNames)
+        evaluateAggregate(foldedId, now);
+    dirtyNames.clear();
+}
+
+void AlertEngine::evaluateProcess(const ProcessInfo& proc, std::chrono::steady_clock::time_point now)
+{
+    const std::vector<uint32_t>& set = rulesFor(proc.nameId);
+    if (set.empty())
+        return;
+
+    // Counters of processes that cannot be read are zeros, not measurements
+    if (proc.isAccessible)
+    {
+        for (uint32_t rule : set)
+        {
+            if (ruleList[rule].kind == AlertKind::Process)
+                evaluate(rule, proc.pid, proc.nameId, metricOf(proc, ruleList[rule].metric), now);
+        }
+    }
+
+    if (!aggregateSets[ruleSetOfName[proc.nameId]])
+        return;
+
+    uint32_t foldedId = processNames().foldedId(proc.nameId);
+    Aggregate& aggregate = aggregates[foldedId];
+    auto inserted = contributions.emplace(proc.pid, Contribution());
+    Contribution& contribution = inserted.first->second;
+    if (inserted.second)
+    {
+        contribution.foldedId = foldedId;
+        ++aggregate.count;
+    }
+    else
+    {
+        for (size_t metric = 0; metric < MetricCount; ++metric)
+            aggregate.sums[metric] -= contribution.values[metric];
+    }
+    for (size_t metric = 0; metric < MetricCount; ++metric)
+    {
+        contribution.values[metric] = proc.isAccessible ? metricOf(proc, static_cast<AlertMetric>(metric)) : 0.0;
+        aggregate.sums[metric] += contribution.values[metric];
+    }
+    if (!aggregate.dirty)
+    {
+        aggregate.dirty = true;
+        dirtyNames.push_back(foldedId);
+    }
+}
+
+void AlertEngine::evaluateAggregate(uint32_t foldedId, std::chrono::steady_clock::time_point now)
+{
+    Aggregate& aggregate = aggregates[foldedId];
+    aggregate.dirty = false;
+    for (uint32_t rule : rulesFor(foldedId))
+    {
+        if (ruleList[rule].kind == AlertKind::Group)
+            evaluate(rule, foldedId, foldedId, aggregate.sums[static_cast<size_t>(ruleList[rule].metric)], now);
+        else if (ruleList[rule].kind == AlertKind::Instances)
+            evaluate(rule, foldedId, foldedId, static_cast<double>(aggregate.count), now);
+    }
+}
+
+void AlertEngine::forgetProcess(const ProcessInfo& proc, std::chrono::steady_clock::time_point)
+{
+    const std::vector<uint32_t>& set = rulesFor(proc.nameId);
+    if (set.empty())
+        return;
+
+    for (uint32_t rule : set)
+    {
+        if (ruleList[rule].kind == AlertKind::Process)
+        {
+            uint64_t key = keyOf(rule, proc.pid);
+            if (states.erase(key) != 0)
+                pending.erase(key);
+        }
+        else if (ruleList[rule].kind == AlertKind::Exit)
+        {
+            fire(rule, proc.pid, proc.nameId, 0.0);
+        }
+    }
+
+    auto found = contributions.find(proc.pid);
+    if (found == contributions.end())
+        return;
+    Aggregate& aggregate = aggregates[found->second.foldedId];
+    --aggregate.count;
+    for (size_t metric = 0; metric < MetricCount; ++metric)
+        aggregate.sums[metric] -= found->second.values[metric];
+    if (aggregate.count == 0)
+        std::fill(std::begin(aggregate.sums), std::end(aggregate.sums), 0.0);    // No rounding left over
+    if (!aggregate.dirty)
+    {
+        aggregate.dirty = true;
+        dirtyNames.push_back(found->second.foldedId);
+    }
+    contributions.erase(found);
+}
+
+void AlertEngine::evaluate(uint32_t rule, uint32_t subject, uint32_t nameId, double value, std::chrono::steady_clock::time_point now)
+{
+    const AlertRule& definition = ruleList[rule];
+    bool over = definition.above ? value > definition.threshold : value < definition.threshold;
+    uint64_t key = keyOf(rule, subject);
+
+    auto found = states.find(key);
+    if (found == states.end())
+    {
+        if (!over)
+            return;    // The common case: nothing to remember
+        ConditionState state;
+        state.since = now;
+        found = states.emplace(key, state).first;
+    }
+
+    ConditionState& state = found->second;
+    state.value = value;
+    state.nameId = nameId;
+    if (state.active)
+    {
+        // Hysteresis: an active alert only clears past the clear level
+        if (definition.above ? value <= definition.clearLevel : value >= definition.clearLevel)
+        {
+            log(L"cleared [" + std::to_wstring(rule + 1) + L"] " + describe(definition, subject, nameId) + L": "
+                + formatValue(definition, value));
+            states.erase(found);
+        }
+        return;
+    }
+    if (!over)
+    {
+        pending.erase(key);
+        states.erase(found);
+        return;
+    }
+    if (now - state.since >= definition.duration)
+    {
+        state.active = true;
+        pending.erase(key);
+        fire(rule, subject, nameId, value);
+    }
+    else
+    {
+        pending.insert(key);
+    }
+}
+
+void AlertEngine::checkPending(std::chrono::steady_clock::time_point now)
+{
+    if (pending.empty())
+        return;
+
+    std::vector<uint64_t> due;
+    for (uint64_t key : pending)
+    {
+        const ConditionState& state = states[key];
+        if (now - state.since >= ruleList[static_cast<uint32_t>(key >> 32)].duration)
+            due.push_back(key);
+    }
+    std::sort(due.begin(), due.end());    // Fire in rule order
+    for (uint64_t key : due)
+    {
+        ConditionState& state = states[key];
+        state.active = true;
+        pending.erase(key);
+        fire(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), state.nameId, state.value);
+    }
+}
+
+void AlertEngine::fire(uint32_t rule, uint32_t subject, uint32_t nameId, double value)
+{
+    const AlertRule& definition = ruleList[rule];
+    ++fired;
+
+    std::wstring what = describe(definition, subject, nameId);
+    std::wstring line = L"alert [" + std::to_wstring(rule + 1) + L"] " + what;
+    if (definition.kind == AlertKind::Appear)
+        line += L" started";
+    else if (definition.kind == AlertKind::Exit)
+        line += L" exited";
+    else
+        line += L": " + formatValue(definition, value) + (definition.above ? L" > " : L" < ")
+            + formatValue(definition, definition.threshold);
+    log(line);
+
+    if (definition.action == AlertAction::Log)
+        return;
+
+    Job job;
+    job.action = definition.action;
+    job.label = what;
+    job.options = terminationOptions;
+    if (definition.action == AlertAction::Run)
+    {
+        // Split first, then fill in the placeholders inside each argument: a name with spaces
+        // stays one argument
+        const std::pair<const wchar_t*, std::wstring> fields[] = {
+            { L"{pid}", definition.kind == AlertKind::Group || definition.kind == AlertKind::Instances ? std::wstring() : std::to_wstring(subject) },
+            { L"{name}", processNames().display(nameId) },
+            { L"{value}", std::to_wstring(static_cast<long long>(std::llround(value))) },
+        };
+        std::wistringstream words(definition.command);
+        for (std::wstring arg; words >> arg;)
+        {
+            for (const auto& field : fields)
+            {
+                for (size_t at = arg.find(field.first); at != std::wstring::npos; at = arg.find(field.first, at + field.second.size()))
+                    arg.replace(at, std::wcslen(field.first), field.second);
+            }
+            job.command += (job.command.empty() ? L"" : L" ") + arg;
+            job.args.push_back(std::move(arg));
+        }
+    }
+    else if (definition.kind == AlertKind::Group || definition.kind == AlertKind::Instances)
+    {
+        for (const auto& entry : contributions)
+        {
+            if (entry.second.foldedId == subject)
+                job.pids.push_back(entry.first);
+        }
+        std::sort(job.pids.begin(), job.pids.end());
+    }
+    else
+    {
+        job.pids.push_back(subject);
+    }
+
+    // The kill runs later on the action thread; by then a PID may belong to someone else
+    for (DWORD pid : job.pids)
+    {
+        const ProcessInfo* proc = updating ? updating->findProcess(pid) : nullptr;
+        job.startTimes.push_back(proc ? proc->startTime : 0);
+    }
+
+    if (!actionsEnabled)
+    {
+        log(job.action == AlertAction::Run ? L"  (actions off) would run: " + job.command
+            : L"  (actions off) would kill " + std::to_wstring(job.pids.size()) + L" process(es) of " + what);
+        return;
+    }
+    queue(std::move(job));
+}
+
+void AlertEngine::log(const std::wstring& line)
+{
+    wchar_t stamp[16] = L"";
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    std::wcsftime(stamp, 16, L"%H:%M:%S ", &local);
+
+    std::lock_guard<std::mutex> lock(logMutex);
+    logLines.push_back(stamp + line);
+    if (logLines.size() > LogLines)
+        logLines.pop_front();
+    if (logSink)
+        logSink(logLines.back());
+}
+
+void AlertEngine::queue(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back(std::move(job));
+        if (!jobThread.joinable())
+            jobThread = std::thread(&AlertEngine::runJobs, this);
+    }
+    jobReady.notify_one();
+}
+
+// Actions can take seconds (a kill waits out the grace period), so they never hold up a tick
+void AlertEngine::runJobs()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        if (job.action == AlertAction::Run)
+        {
+            log(launcher.launch(job.args) ? L"  started: " + job.command : L"  could not start: " + job.command);
+            continue;
+        }
+
+        std::vector<TerminationResult> results = ProcessManager::endProcesses(job.pids, job.startTimes, job.options);
+        size_t ended = static_cast<size_t>(std::count_if(results.begin(), results.end(), [](const TerminationResult& result)
+            {
+                return result.outcome == TerminationOutcome::Exited || result.outcome == TerminationOutcome::Killed
+                    || result.outcome == TerminationOutcome::AlreadyGone;
+            }));
+        log(L"  ended " + std::to_wstring(ended) + L" of " + std::to_wstring(results.size()) + L" process(es) of " + job.label);
+    }
+}
+
+double AlertEngine::metricOf(const ProcessInfo& proc, AlertMetric metric)
+{
+    switch (metric)
+    {
+    case AlertMetric::Memory:    return static_cast<double>(proc.memoryUsage);
+    case AlertMetric::Cpu:       return proc.cpuUsage;
+    case AlertMetric::Threads:   return proc.threadCount;
+    case AlertMetric::Handles:   return proc.handleCount;
+    case AlertMetric::ReadRate:  return proc.readRate;
+    case AlertMetric::WriteRate: return proc.writeRate;
+    case AlertMetric::IoRate:    return proc.readRate + proc.writeRate;
+    }
+    return 0.0;
+}
+
+std::wstring AlertEngine::describe(const AlertRule& rule, uint32_t subject, uint32_t nameId)
+{
+    const std::wstring& name = processNames().display(nameId);
+    switch (rule.kind)
+    {
+    case AlertKind::Group:
+        return name + L" (all)";
+    case AlertKind::Instances:
+        return name + L" instances";
+    default:
+        return name + L" (PID " + std::to_wstring(subject) + L")";
+    }
+}
+
+std::wstring AlertEngine::formatValue(const AlertRule& rule, double value)
+{
+    if (rule.kind == AlertKind::Instances || rule.metric == AlertMetric::Threads || rule.metric == AlertMetric::Handles)
+        return std::to_wstring(static_cast<long long>(std::llround(value)));
+    if (rule.metric == AlertMetric::Cpu)
+        return formatCpu(std::llround(value * 100.0));
+    std::wstring bytes = formatMemory(static_cast<size_t>(value));
+    return rule.metric == AlertMetric::Memory ? bytes : bytes + L"/s";
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ProcessInfo.h"
+#include "ProcessLauncher.h"
+#include "ProcessTerminator.h"
+
+class ProcessManager;
+
+// What a rule watches
+enum class AlertKind
+{
+    Process,     // A value of each matching process
+    Group,       // The same value summed over all processes of a name
+    Instances,   // How many processes of a name are running
+    Appear,      // A matching process started
+    Exit         // A matching process exited
+};
+
+// Values the threshold rules compare
+enum class AlertMetric
+{
+    Memory,      // Working set in bytes
+    Cpu,         // Percent of one core
+    Threads,
+    Handles,     // Open file descriptors / handles
+    ReadRate,    // Bytes read per second
+    WriteRate,   // Bytes written per second
+    IoRate       // Both together
+};
+
+// What a rule does when it fires
+enum class AlertAction
+{
+    Log,         // Only the log line every firing gets anyway
+    Run,         // Starts a command through ProcessLauncher
+    Kill         // Terminates the process (or every process of the group) through ProcessManager
+};
+
+struct AlertRule
+{
+    AlertKind kind = AlertKind::Process;
+    std::wstring name;                       // Lowercase, without ".exe"; may hold * and ? wildcards
+    AlertMetric metric = AlertMetric::Memory;
+    bool above = true;                       // Fires on value > threshold, else on value < threshold
+    double threshold = 0.0;
+    double clearLevel = 0.0;                 // Where an active alert clears (the threshold unless given)
+    std::chrono::milliseconds duration{ 0 }; // How long the condition must hold before it fires
+    AlertAction action = AlertAction::Log;
+    std::wstring command;                    // For Run; {pid}, {name} and {value} are filled in
+    std::wstring text;                       // The rule as written
+};
+
+// An alert that has fired and not cleared yet
+struct ActiveAlert
+{
+    size_t rule;
+    DWORD pid;              // 0 for group and instance rules
+    std::wstring name;
+    double value;           // Latest value seen
+    double heldFor;         // Seconds the condition has held
+};
+
+// Threshold, instance-count and appear/exit rules evaluated on every sampler tick.
+//
+// A tick only looks at the processes in the refresh's delta: rules are found through the
+// process's interned name ID, which is resolved once against the rules (exact names,
+// wildcards) and cached, so hundreds of rules cost nothing for the processes none of them
+// name and no rule ever scans the whole list. Per-name sums for group and instance rules are
+// kept up to date from the same delta. Conditions that need a duration are remembered and
+// rechecked each tick, so they fire even if the process does not change again.
+class AlertEngine
+{
+public:
+    AlertEngine();
+    ~AlertEngine();
+
+    AlertEngine(const AlertEngine&) = delete;
+    AlertEngine& operator=(const AlertEngine&) = delete;
+
+    // One line describing the rule syntax per form
+    static const char* syntax();
+
+    // Parses one rule and adds it; false with a message in error if it does not parse
+    bool addRule(const std::wstring& text, std::string& error);
+
+    // Reads one rule per line; blank lines and # comments are skipped. Nothing is added
+    // unless every line parses ("-" = standard input).
+    bool loadRules(const std::string& path, std::string& error);
+
+    // Removes the rule at index (as listed by rules()); false if there is none
+    bool removeRule(size_t index);
+
+    std::vector<AlertRule> rules() const;
+
+    // Alerts that have fired and not cleared, by rule
+    std::vector<ActiveAlert> active(std::chrono::steady_clock::time_point now) const;
+
+    // The most recent log lines, oldest first
+    std::vector<std::wstring> recentLog(size_t count) const;
+
+    // Also hands every log line to sink (null = only the in-memory log). It is called with
+    // the log lock held, from the sampler's thread or the action thread.
+    void setLogSink(std::function<void(const std::wstring& line)> sink);
+
+    // Run and kill actions are only logged while disabled (e.g. for a dry run)
+    void setActionsEnabled(bool enabled);
+
+    // How long kill actions give processes before forcing them
+    void setTerminationOptions(const TerminationOptions& options);
+
+    // Evaluates the rules against the manager's last refresh (its delta). at is when it ran.
+    // After a rule change, and on the first call, every process is evaluated once instead;
+    // appear rules do not fire for processes that were already there.
+    void update(const ProcessManager& manager, std::chrono::steady_clock::time_point at);
+
+    // Rule firings so far
+    unsigned long long firedCount() const;
+
+private:
+    // Log lines kept in memory
+    static constexpr size_t LogLines = 200;
+
+    // Sentinel for a name whose rules have not been looked up yet
+    static constexpr uint32_t Unresolved = 0xFFFFFFFFu;
+
+    static constexpr size_t MetricCount = 7;
+
+    // Where a condition stands for one (rule, subject) pair; only kept while it holds or is active
+    struct ConditionState
+    {
+        std::chrono::steady_clock::time_point since;    // When the condition started to hold
+        double value = 0.0;
+        uint32_t nameId = 0;
+        bool active = false;
+    };
+
+    // What one process adds to its name's sums (only kept for names with group or instance rules)
+    struct Contribution
+    {
+        uint32_t foldedId;
+        double values[MetricCount];
+    };
+
+    // Sums over the processes of one name
+    struct Aggregate
+    {
+        uint32_t count = 0;
+        double sums[MetricCount] = {};
+        bool dirty = false;
+    };
+
+    // A run or kill waiting for the action thread
+    struct Job
+    {
+        AlertAction action;
+        std::vector<std::wstring> args;            // For Run: the command's arguments, placeholders filled in
+        std::wstring command;                      // The same joined, for the log
+        std::vector<DWORD> pids;
+        std::vector<unsigned long long> startTimes;    // Of pids when the rule fired, to skip recycled PIDs
+        std::wstring label;
+        TerminationOptions options;
+    };
+
+    // Body of update, with the lock held
+    void updateFrom(const ProcessManager& manager, std::chrono::steady_clock::time_point at);
+
+    // Drops all evaluation state and matches the rules again (rules changed)
+    void reset();
+
+    // Rule indices for a name ID, looked up on first use
+    const std::vector<uint32_t>& rulesFor(uint32_t nameId);
+
+    // Whether a name has any group or instance rules
+    bool hasAggregateRules(uint32_t nameId);
+
+    // Evaluates every process once (first call and after rule changes)
+    void evaluateAll(const ProcessManager& manager, std::chrono::steady_clock::time_point now);
+
+    // Process rules of one process and its share of the name sums
+    void evaluateProcess(const ProcessInfo& proc, std::chrono::steady_clock::time_point now);
+
+    // Group and instance rules of a name, from its sums
+    void evaluateAggregate(uint32_t foldedId, std::chrono::steady_clock::time_point now);
+
+    // Forgets an exited process: its states, its share of the sums, and runs its exit rules
+    void forgetProcess(const ProcessInfo& proc, std::chrono::steady_clock::time_point now);
+
+    // Moves one (rule, subject) condition along: pending, fired, cleared or gone. The subject
+    // is a PID for process rules and a folded name ID for the others.
+    void evaluate(uint32_t rule, uint32_t subject, uint32_t nameId, double value, std::chrono::steady_clock::time_point now);
+
+    // Fires pending conditions whose duration ran out without a new value
+    void checkPending(std::chrono::steady_clock::time_point now);
+
+    // Logs a firing and queues its action
+    void fire(uint32_t rule, uint32_t subject, uint32_t nameId, double value);
+
+    // Writes one timestamped line to the log
+    void log(const std::wstring& line);
+
+    // Hands a job to the action thread (started on first use)
+    void queue(Job job);
+
+    // Body of the action thread
+    void runJobs();
+
+    // Value of a metric for one process
+    static double metricOf(const ProcessInfo& proc, AlertMetric metric);
+
+    // Describes a subject: the process's name and PID, or the group's name
+    static std::wstring describe(const AlertRule& rule, uint32_t subject, uint32_t nameId);
+
+    // A value as the rule's metric is written (bytes, percent, counts)
+    static std::wstring formatValue(const AlertRule& rule, double value);
+
+    // Key of a (rule, subject) pair
+    static uint64_t keyOf(uint32_t rule, uint32_t subject) { return (static_cast<uint64_t>(rule) << 32) | subject; }
+
+    mutable std::mutex mutex;
+    std::vector<AlertRule> ruleList;
+    bool needsReset = true;
+
+    // Rule dispatch: exact lowercase names, wildcard rules, and the cached result per name ID
+    // (an index into ruleSets; set 0 is empty)
+    std::unordered_map<std::wstring, std::vector<uint32_t>> rulesByName;
+    std::vector<uint32_t> wildcardRules;
+    std::vector<std::vector<uint32_t>> ruleSets;
+    std::vector<uint32_t> ruleSetOfName;
+    std::vector<uint8_t> aggregateSets;       // Per rule set: 1 if it has group or instance rules
+
+    // Condition states by (rule, subject) and the ones waiting for their duration
+    std::unordered_map<uint64_t, ConditionState> states;
+    std::unordered_set<uint64_t> pending;
+
+    // Per-name sums for group and instance rules, the processes in them, and the names
+    // that changed this tick
+    std::unordered_map<DWORD, Contribution> contributions;
+    std::unordered_map<uint32_t, Aggregate> aggregates;
+    std::vector<uint32_t> dirtyNames;
+
+    // The manager of the update in progress (fire looks up start times in it); null outside update
+    const ProcessManager* updating = nullptr;
+
+    std::chrono::steady_clock::time_point epoch;
+    unsigned long long fired = 0;
+    bool actionsEnabled = true;
+    TerminationOptions terminationOptions;
+
+    // Log, guarded by its own lock so the action thread can add to it during an update
+    mutable std::mutex logMutex;
+    std::deque<std::wstring> logLines;
+    std::function<void(const std::wstring&)> logSink;
+
+    // Action thread and its queue
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::deque<Job> jobs;
+    std::thread jobThread;
+    bool stopping = false;
+    ProcessLauncher launcher;       // Launches on the action thread; update reaps what it started
+};
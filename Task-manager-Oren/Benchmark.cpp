@@ -0,0 +1,1929 @@
+#include "Benchmark.h"
+#include "AlertEngine.h"
+#include "Format.h"
+#include "LiveView.h"
+#include "MetricsExporter.h"
+#include "MetricsHistory.h"
+#include "ProcessLauncher.h"
+#include "ProcessManager.h"
+#include "ProcessFilter.h"
+#include "ProcessSampler.h"
+#include "ProcessSearchIndex.h"
+#include "ProcessTerminator.h"
+#include "ProcessTree.h"
+#include "ResourceGuard.h"
+#include "SnapshotRecorder.h"
+#include "SnapshotReplay.h"
+#include "SnapshotWriter.h"
+#include "SyntheticSnapshotSource.h"
+#include "UserNames.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include "LinuxSnapshotSource.h"
+#include <csignal>
+#include <cstdlib>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Refreshes the manager a number of times and returns the average time per refresh in milliseconds
+static double timeRefresh(ProcessManager& pm, int iterations)
+{
+    pm.refreshProcessList(); // Warm up: grows the list to its final size
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        pm.refreshProcessList();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// Prints one result row: PID count, ms per refresh and ms per 1k processes
+static void printBenchmarkRow(const wchar_t* label, size_t processes, double msPerRefresh)
+{
+    double perThousand = processes ? msPerRefresh * 1000.0 / static_cast<double>(processes) : 0.0;
+    std::wcout << std::left << std::setw(16) << label
+        << std::setw(12) << processes
+        << std::fixed << std::setprecision(3)
+        << std::setw(16) << msPerRefresh
+        << perThousand << L"\n";
+}
+
+#ifndef _WIN32
+// Writes a small file into a synthetic /proc tree
+static void writeFakeFile(const std::string& path, const char* text)
+{
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file)
+    {
+        std::fputs(text, file);
+        std::fclose(file);
+    }
+}
+
+// Creates <root>/<pid>/stat for pids 1..count, laid out like the kernel's
+static void buildFakeProcTree(const std::string& root, size_t count)
+{
+    for (size_t pid = 1; pid <= count; ++pid)
+    {
+        std::string dir = root + "/" + std::to_string(pid);
+        mkdir(dir.c_str(), 0755);
+
+        char stat[512];
+        std::snprintf(stat, sizeof(stat),
+            "%zu (worker%zu) S 1 %zu %zu 0 -1 4194560 120 0 0 0 15 4 0 0 20 0 1 0 %zu 10485760 %zu "
+            "18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n",
+            pid, pid % 97, pid, pid, 1000 + pid, 1000 + pid % 5000);
+        writeFakeFile(dir + "/stat", stat);
+    }
+}
+
+// Removes everything buildFakeProcTree created
+static void removeFakeProcTree(const std::string& root, size_t count)
+{
+    for (size_t pid = 1; pid <= count; ++pid)
+    {
+        std::string dir = root + "/" + std::to_string(pid);
+        unlink((dir + "/stat").c_str());
+        rmdir(dir.c_str());
+    }
+    rmdir(root.c_str());
+}
+
+// Runs a 10 Hz sampler over the tree for a few seconds while a reader keeps grabbing
+// snapshots and checks that each one is complete (pids 1..expected, nothing torn)
+static void benchmarkSampler(const std::string& root, size_t expected)
+{
+    ProcessSampler sampler(std::make_unique<LinuxSnapshotSource>(root), std::chrono::milliseconds(100));
+    std::atomic<bool> done{ false };
+    size_t reads = 0;
+    size_t torn = 0;
+
+    sampler.start();
+    std::thread reader([&]()
+        {
+            unsigned long long expectedSum = static_cast<unsigned long long>(expected) * (expected + 1) / 2;
+            while (!done.load())
+            {
+                SnapshotHandle snapshot = sampler.acquire();
+                if (snapshot)
+                {
+                    unsigned long long sum = 0;
+                    for (const auto& proc : snapshot->processes)
+                        sum += proc.pid;
+                    ++reads;
+                    if (sum != expectedSum)
+                        ++torn;
+                }
+                std::this_thread::yield();
+            }
+        });
+
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    done.store(true);
+    reader.join();
+
+    unsigned long long ticks = 0;
+    {
+        SnapshotHandle last = sampler.acquire();
+        if (last)
+            ticks = last->sequence;
+    }
+    sampler.stop();
+
+    std::wcout << L"sampler @ 10 Hz on " << expected << L" PIDs: " << ticks << L" snapshots in 3 s, "
+        << reads << L" reads, " << torn << L" torn\n";
+}
+#endif
+
+void runRefreshBenchmark()
+{
+    std::wcout << std::left << std::setw(16) << L"Source"
+        << std::setw(12) << L"Processes"
+        << std::setw(16) << L"ms/refresh"
+        << L"ms per 1k\n";
+    std::wcout << std::wstring(56, L'-') << L"\n";
+
+    ProcessManager native;
+    double nativeMs = timeRefresh(native, 20);
+    printBenchmarkRow(L"native", native.getProcessList().size(), nativeMs);
+
+#ifndef _WIN32
+    const size_t sizes[] = { 500, 1000, 5000, 10000, 20000, 50000 };
+    for (size_t size : sizes)
+    {
+        char rootTemplate[] = "/tmp/taskmgr-proc-XXXXXX";
+        if (!mkdtemp(rootTemplate))
+        {
+            std::wcout << L"Could not create a temporary directory.\n";
+            return;
+        }
+        std::string root = rootTemplate;
+        buildFakeProcTree(root, size);
+
+        ProcessManager synthetic(std::make_unique<LinuxSnapshotSource>(root));
+        double ms = timeRefresh(synthetic, size >= 20000 ? 3 : 10);
+        printBenchmarkRow(L"synthetic /proc", synthetic.getProcessList().size(), ms);
+
+        if (size == 20000)
+        {
+            benchmarkSampler(root, size);
+        }
+
+        removeFakeProcTree(root, size);
+    }
+#endif
+}
+
+void runCollectionScalingBenchmark()
+{
+    const unsigned threadCounts[] = { 1, 2, 4, 8 };
+
+    std::wcout << std::left << std::setw(16) << L"Source"
+        << std::setw(12) << L"Threads"
+        << std::setw(12) << L"Processes"
+        << L"ms/refresh\n";
+    std::wcout << std::wstring(52, L'-') << L"\n";
+
+    for (unsigned threads : threadCounts)
+    {
+        // 5 microseconds per process is about what open+read+close of a /proc file costs
+        ProcessManager synthetic(std::make_unique<SyntheticSnapshotSource>(50000, 5000));
+        synthetic.setCollectionThreads(threads);
+        double ms = timeRefresh(synthetic, 5);
+        std::wcout << std::left << std::setw(16) << L"synthetic"
+            << std::setw(12) << threads
+            << std::setw(12) << synthetic.getProcessList().size()
+            << std::fixed << std::setprecision(3) << ms << L"\n";
+    }
+
+    for (unsigned threads : threadCounts)
+    {
+        ProcessManager native;
+        native.setCollectionThreads(threads);
+        double ms = timeRefresh(native, 20);
+        std::wcout << std::left << std::setw(16) << L"native"
+            << std::setw(12) << threads
+            << std::setw(12) << native.getProcessList().size()
+            << std::fixed << std::setprecision(3) << ms << L"\n";
+    }
+}
+
+// Runs work iterations times and returns the average milliseconds per run
+template <typename Work>
+static double timeAverage(int iterations, Work work)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        work();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// Heap bytes held by a wide string beyond the object itself
+static size_t stringHeapBytes(const std::wstring& text)
+{
+    std::wstring empty;
+    return text.capacity() > empty.capacity() ? (text.capacity() + 1) * sizeof(wchar_t) : 0;
+}
+
+void runProcessTableBenchmark()
+{
+    const size_t rows = 20000;
+    const int iterations = 10;
+
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(rows, 0));
+    pm.refreshProcessList();
+    const std::vector<ProcessInfo>& list = pm.getProcessList();
+
+    // The row-of-structs approach: sort copies of the structs and group into a map of strings
+    double legacySortName = timeAverage(iterations, [&]()
+        {
+            std::vector<ProcessInfo> copy = list;
+            std::sort(copy.begin(), copy.end(), [&pm](const ProcessInfo& a, const ProcessInfo& b)
+                {
+                    if (a.isAccessible != b.isAccessible) return a.isAccessible;
+                    std::wstring aClean = pm.cleanName(a.name);
+                    std::wstring bClean = pm.cleanName(b.name);
+                    std::transform(aClean.begin(), aClean.end(), aClean.begin(), towlower);
+                    std::transform(bClean.begin(), bClean.end(), bClean.begin(), towlower);
+                    return aClean < bClean;
+                });
+        });
+    double legacySortMemory = timeAverage(iterations, [&]()
+        {
+            std::vector<ProcessInfo> copy = list;
+            std::sort(copy.begin(), copy.end(), [](const ProcessInfo& a, const ProcessInfo& b)
+                {
+                    if (a.isAccessible != b.isAccessible) return a.isAccessible;
+                    return a.memoryUsage > b.memoryUsage;
+                });
+        });
+    double legacyGroup = timeAverage(iterations, [&]()
+        {
+            std::map<std::wstring, ProcessGroup> grouped;
+            for (const auto& p : list)
+            {
+                std::wstring name = pm.cleanName(p.name);
+                grouped[name].count++;
+                grouped[name].totalMemory += p.memoryUsage;
+            }
+        });
+
+    size_t legacyBytes = list.size() * sizeof(ProcessInfo);
+    for (const auto& p : list)
+        legacyBytes += stringHeapBytes(p.name);
+
+    // The columnar approach: permutations of row indices and dense name IDs
+    const NamePool& names = processNames();
+    ProcessTable table;
+    ProcessSorter sorter;
+    GroupingEngine groups;
+    const SortOrder byName = { { SortKey::Accessible, false }, { SortKey::Name, false } };
+    const SortOrder byMemory = { { SortKey::Accessible, false }, { SortKey::Memory, true } };
+
+    // Each run starts from a fresh snapshot, so nothing is served from the cache
+    double tableAssign = timeAverage(iterations, [&]() { table.assign(list); });
+    double tableSortName = timeAverage(iterations, [&]() { sorter.invalidate(); sorter.order(table, names, byName); });
+    double tableSortMemory = timeAverage(iterations, [&]() { sorter.invalidate(); sorter.order(table, names, byMemory); });
+    double cachedSort = timeAverage(iterations, [&]() { sorter.order(table, names, byMemory); });
+    double tableGroup = timeAverage(iterations, [&]() { groups.group(table, names, GroupBy::Name, { Metric::Memory }); });
+
+    size_t tableBytes = rows * (sizeof(DWORD) + sizeof(unsigned long long) + sizeof(uint8_t) + sizeof(uint32_t));
+
+    std::wcout << rows << L" rows, " << groups.groupCount() << L" distinct names\n";
+    std::wcout << std::left << std::setw(22) << L"Operation"
+        << std::setw(18) << L"vector<Info> ms"
+        << L"ProcessTable ms\n";
+    std::wcout << std::wstring(56, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(22) << L"sort by name" << std::setw(18) << legacySortName << tableSortName << L"\n"
+        << std::setw(22) << L"sort by memory" << std::setw(18) << legacySortMemory << tableSortMemory << L"\n"
+        << std::setw(22) << L"group by name" << std::setw(18) << legacyGroup << tableGroup << L"\n"
+        << std::setw(22) << L"repeat sort (cached)" << std::setw(18) << legacySortMemory << cachedSort << L"\n"
+        << std::setw(22) << L"build columns" << std::setw(18) << 0.0 << tableAssign << L"\n"
+        << std::setw(22) << L"bytes held" << std::setw(18) << legacyBytes << tableBytes << L"\n";
+}
+
+void runGroupingBenchmark()
+{
+    const size_t rows = 20000;
+    const int iterations = 20;
+
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(rows, 0));
+    pm.refreshProcessList();
+    const std::vector<ProcessInfo>& list = pm.getProcessList();
+    const ProcessTable& table = pm.getProcessTable();
+    const NamePool& names = processNames();
+
+    // What the grouped views used to do: a std::map keyed by a fresh copy of each cleaned name
+    double mapByName = timeAverage(iterations, [&]()
+        {
+            std::map<std::wstring, ProcessGroup> grouped;
+            for (const auto& p : list)
+            {
+                if (!p.isAccessible) continue;
+                std::wstring name = pm.cleanName(p.name);
+                grouped[name].count++;
+                grouped[name].totalMemory += p.memoryUsage;
+            }
+        });
+    double mapByParent = timeAverage(iterations, [&]()
+        {
+            std::map<DWORD, ProcessGroup> grouped;
+            for (const auto& p : list)
+            {
+                if (!p.isAccessible) continue;
+                grouped[p.parentPid].count++;
+                grouped[p.parentPid].totalMemory += p.memoryUsage;
+            }
+        });
+
+    GroupingEngine engine;
+    double engineByName = timeAverage(iterations, [&]() { engine.group(table, names, GroupBy::Name, { Metric::Memory }); });
+    uint32_t nameGroups = engine.groupCount();
+    double engineAllStats = timeAverage(iterations, [&]()
+        {
+            engine.group(table, names, GroupBy::Name, { Metric::Memory, Metric::MemoryChange, Metric::PreviouslySeen });
+        });
+    double engineByParent = timeAverage(iterations, [&]() { engine.group(table, names, GroupBy::ParentPid, { Metric::Memory }); });
+    uint32_t parentGroups = engine.groupCount();
+
+    std::wcout << rows << L" rows, " << nameGroups << L" names, " << parentGroups << L" parents\n";
+    std::wcout << std::left << std::setw(30) << L"Grouping"
+        << std::setw(14) << L"std::map ms"
+        << L"engine ms\n";
+    std::wcout << std::wstring(56, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(30) << L"by name, memory sum" << std::setw(14) << mapByName << engineByName << L"\n"
+        << std::setw(30) << L"by name, 3 metrics min/max" << std::setw(14) << L"-" << engineAllStats << L"\n"
+        << std::setw(30) << L"by parent PID, memory sum" << std::setw(14) << mapByParent << engineByParent << L"\n";
+}
+
+void runHistoryBenchmark()
+{
+    const size_t rows = 20000;
+    const uint32_t seconds = 3600;
+    const size_t churnPerSecond = 5;    // Processes replaced every second
+
+    // Start from a synthetic snapshot and drive the table by hand, one simulated second per tick
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(rows, 0));
+    pm.refreshProcessList();
+    ProcessTable table = pm.getProcessTable();
+    std::vector<unsigned long long> baseMemory = table.memory;
+    ProcessDelta delta;
+    DWORD nextPid = static_cast<DWORD>(rows + 1);
+
+    MetricsHistory history;
+    auto epoch = std::chrono::steady_clock::now();
+    double recordMs = 0;
+
+    for (uint32_t second = 0; second < seconds; ++second)
+    {
+        delta.removed.clear();
+        for (uint32_t row = 0; row < rows; ++row)
+        {
+            table.flags[row] = second == 0 ? (ProcessTable::Accessible | ProcessTable::IsNew) : ProcessTable::Accessible;
+
+            // 1 in 10 leaks a page a second, 1 in 5 wobbles, the rest stay put
+            unsigned long long memory = baseMemory[row];
+            if (row % 10 == 0)
+                memory += second * 4096ULL;
+            else if (row % 5 == 0)
+                memory += ((second + row) % 7) * 4096ULL;
+            table.memory[row] = memory;
+        }
+
+        // A few processes exit and new ones take their rows
+        for (size_t i = 0; i < churnPerSecond && second > 0; ++i)
+        {
+            uint32_t row = static_cast<uint32_t>((second * 7919 + i * 104729) % rows);
+            if (row % 10 == 0)
+                continue; // Keep the leakers for the query below
+
+            ProcessInfo exited = {};
+            exited.pid = table.pid[row];
+            exited.nameId = table.nameId[row];
+            delta.removed.push_back(exited);
+            table.pid[row] = nextPid++;
+            table.flags[row] |= ProcessTable::IsNew;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        history.record(table, delta, epoch + std::chrono::seconds(second));
+        recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::vector<HistoryGrowth> growers;
+    double queryProcesses = timeAverage(10, [&]() { growers = history.topGrowers(10, std::chrono::minutes(10), false); });
+    double queryGroups = timeAverage(10, [&]() { history.topGrowers(10, std::chrono::minutes(10), true); });
+    double seriesQuery = timeAverage(10, [&]() { history.processSeries(table.pid[0], std::chrono::hours(1)); });
+
+    std::wcout << rows << L" PIDs, " << seconds << L" ticks, " << churnPerSecond << L" exits per tick\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::left << std::setw(34) << L"record per tick ms" << recordMs / seconds << L"\n"
+        << std::setw(34) << L"top 10 processes, 10 min, ms" << queryProcesses << L"\n"
+        << std::setw(34) << L"top 10 groups, 10 min, ms" << queryGroups << L"\n"
+        << std::setw(34) << L"one process, 1 hour, ms" << seriesQuery << L"\n"
+        << std::setw(34) << L"series tracked" << history.seriesCount() << L"\n"
+        << std::setw(34) << L"points dropped (over budget)" << history.droppedPoints() << L"\n"
+        << std::setw(34) << L"memory held" << formatMemory(history.memoryUsage()).c_str()
+        << L" (budget " << formatMemory(MetricsHistory::DefaultBudget).c_str() << L" of blocks)\n";
+    if (!growers.empty())
+    {
+        std::wcout << std::setw(34) << L"top grower over 10 min" << L"PID " << growers[0].pid << L", "
+            << formatMemory(static_cast<size_t>(growers[0].growth)).c_str() << L"\n";
+    }
+}
+
+void runLiveViewBenchmark()
+{
+    const uint32_t groupCount = 2000;
+    const uint32_t rows = groupCount * 2;
+    const int frames = 100;
+    const int sizes[][2] = { { 80, 50 }, { 120, 40 }, { 200, 60 }, { 300, 100 } };
+
+    // Two processes per name; about one row in ten changes between frames
+    NamePool& names = processNames();
+    ProcessTable table;
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        table.pid.push_back(row + 1);
+        table.parentPid.push_back(1);
+        table.memory.push_back((1000 + row) * 4096ULL);
+        table.memoryDelta.push_back(0);
+        table.cpu.push_back(0);
+        table.flags.push_back(ProcessTable::Accessible);
+        table.nameId.push_back(names.intern(L"group" + std::to_wstring(row % groupCount)));
+    }
+    ProcessDelta delta;
+    std::vector<LeakSuspect> suspects;
+
+    auto advance = [&](int frame)
+        {
+            for (uint32_t row = static_cast<uint32_t>(frame) % 10; row < rows; row += 10)
+            {
+                long long change = ((row + frame) % 3 == 0) ? -4096 : 8192;
+                table.memory[row] += change;
+                table.memoryDelta[row] = change;
+                table.cpu[row] = static_cast<uint32_t>((row * 7 + frame * 13) % 2500);
+            }
+        };
+
+    // What the live view used to do: format every group through iostreams each tick
+    GroupingEngine legacyGroups;
+    size_t legacyBytes = 0;
+    int legacyFrame = 0;
+    double legacyMs = timeAverage(frames, [&]()
+        {
+            advance(legacyFrame++);
+            legacyGroups.group(table, names, GroupBy::Name, { Metric::Memory, Metric::MemoryChange, Metric::PreviouslySeen, Metric::Cpu });
+            std::vector<uint32_t> order;
+            legacyGroups.orderByName(names, order);
+
+            std::wostringstream out;
+            for (uint32_t group : order)
+            {
+                long long change = legacyGroups.stats(group, 1).sum;
+                out << std::left << std::setw(16) << names.display(static_cast<uint32_t>(legacyGroups.key(group)))
+                    << std::setw(12) << legacyGroups.count(group)
+                    << std::setw(15) << formatMemory(static_cast<size_t>(legacyGroups.stats(group, 0).sum))
+                    << std::setw(15) << (change >= 0 ? L"+" + formatMemory(static_cast<size_t>(change)) : L"-" + formatMemory(static_cast<size_t>(-change)))
+                    << formatCpu(legacyGroups.stats(group, 3).sum) << L"\n";
+            }
+            legacyBytes = out.str().size();
+        });
+
+    std::wcout << groupCount << L" groups, " << rows << L" processes, " << frames << L" frames per size\n";
+    std::wcout << std::left << std::setw(16) << L"Output"
+        << std::setw(14) << L"ms/frame"
+        << std::setw(16) << L"bytes/frame"
+        << L"CPU at 20 fps\n";
+    std::wcout << std::wstring(60, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(16) << L"iostream" << std::setw(14) << legacyMs << std::setw(16) << legacyBytes
+        << std::setprecision(1) << legacyMs * 2.0 << L"%\n";
+
+    for (const auto& size : sizes)
+    {
+        TerminalRenderer screen(size[0], size[1]);
+        LiveView view;
+        view.render(screen, table, delta, suspects, 0); // First frame is a full redraw
+
+        size_t bytes = 0;
+        int frame = 0;
+        double ms = timeAverage(frames, [&]()
+            {
+                advance(frame++);
+                view.render(screen, table, delta, suspects, static_cast<unsigned long long>(frame));
+                bytes += screen.lastFrame().size();
+            });
+
+        std::wstring label = std::to_wstring(size[0]) + L"x" + std::to_wstring(size[1]) + L" diff";
+        std::wcout << std::setprecision(3)
+            << std::setw(16) << label << std::setw(14) << ms << std::setw(16) << bytes / frames
+            << std::setprecision(1) << ms * 2.0 << L"%\n";
+    }
+}
+
+// formatMemory as it was before Format.h: a string stream per value
+static std::wstring legacyFormatMemory(size_t bytes)
+{
+    const double KB = 1024.0;
+    const double MB = KB * 1024.0;
+    const double GB = MB * 1024.0;
+
+    std::wstringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    if (bytes >= GB)
+        ss << (bytes / GB) << L" GB";
+    else
+        ss << (bytes / MB) << L" MB";
+    return ss.str();
+}
+
+void runFormattingBenchmark()
+{
+    const uint32_t rows = 100000;
+    const int passes = 10;
+    const int nameWidth = 30;
+
+    NamePool& names = processNames();
+    ProcessTable table;
+    for (uint32_t row = 0; row < rows; ++row)
+    {
+        table.pid.push_back(row + 100);
+        table.memory.push_back((row % 7 == 0 ? 3ULL << 30 : 0) + row * 12345ULL);
+        table.cpu.push_back(row % 10000);
+        table.nameId.push_back(names.intern(L"process" + std::to_wstring(row % 500)));
+    }
+
+    // Both printers write the same columns into the same stream, which is emptied each pass
+    std::wostringstream sink;
+
+    size_t legacyChars = 0;
+    double legacyMs = timeAverage(passes, [&]()
+        {
+            sink.str(L"");
+            for (uint32_t row = 0; row < rows; ++row)
+            {
+                sink << std::left << std::setw(10) << table.pid[row]
+                    << std::setw(nameWidth) << names.display(table.nameId[row]).c_str()
+                    << std::setw(15) << legacyFormatMemory(table.memory[row]).c_str()
+                    << formatCpu(table.cpu[row]) << L"\n";
+            }
+            legacyChars = static_cast<size_t>(sink.tellp());
+        });
+
+    TextRow line;
+    size_t rowChars = 0;
+    double rowMs = timeAverage(passes, [&]()
+        {
+            sink.str(L"");
+            for (uint32_t row = 0; row < rows; ++row)
+            {
+                line.number(table.pid[row], 10)
+                    .text(names.display(table.nameId[row]), nameWidth)
+                    .memory(table.memory[row], 15, MemoryUnit::Auto)
+                    .cpu(table.cpu[row])
+                    .print(sink);
+            }
+            rowChars = static_cast<size_t>(sink.tellp());
+        });
+
+    std::wcout << rows << L" rows (PID, name, memory, CPU), " << passes << L" passes\n";
+    std::wcout << std::left << std::setw(26) << L"Printer"
+        << std::setw(14) << L"ms/pass"
+        << std::setw(16) << L"rows/second"
+        << L"chars\n";
+    std::wcout << std::wstring(64, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(26) << L"wstringstream + setw" << std::setw(14) << legacyMs
+        << std::setprecision(0) << std::setw(16) << rows * 1000.0 / legacyMs << legacyChars << L"\n"
+        << std::setprecision(3)
+        << std::setw(26) << L"TextRow + to_chars" << std::setw(14) << rowMs
+        << std::setprecision(0) << std::setw(16) << rows * 1000.0 / rowMs << rowChars << L"\n";
+    std::wcout << std::setprecision(1) << L"Speedup: " << legacyMs / rowMs << L"x\n";
+}
+
+void runExportBenchmark()
+{
+    const size_t processes = 20000;
+    const int ticks = 60;
+    const struct { const wchar_t* label; ExportFormat format; } formats[] = {
+        { L"ndjson", ExportFormat::Ndjson },
+        { L"csv", ExportFormat::Csv },
+        { L"binary", ExportFormat::Binary },
+    };
+
+#ifdef _WIN32
+    std::FILE* sink = std::fopen("NUL", "wb");
+#else
+    std::FILE* sink = std::fopen("/dev/null", "wb");
+#endif
+    if (!sink)
+    {
+        std::wcout << L"Could not open the null device.\n";
+        return;
+    }
+
+    // Refresh cost alone, with no per-process read cost, for comparison
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(processes, 0));
+    double refreshMs = timeRefresh(pm, 10);
+
+    std::wcout << processes << L" processes sorted by memory, " << ticks << L" snapshots per format\n";
+    std::wcout << L"Refresh of the synthetic source: " << std::fixed << std::setprecision(3) << refreshMs << L" ms\n";
+    std::wcout << std::left << std::setw(12) << L"Format"
+        << std::setw(18) << L"ms/snapshot"
+        << std::setw(16) << L"bytes/snapshot"
+        << L"Buffer after 1 / " << ticks << L" ticks\n";
+    std::wcout << std::wstring(76, L'-') << L"\n";
+
+    const NamePool& names = processNames();
+    const SortOrder byMemory = { { SortKey::Accessible, false }, { SortKey::Memory, true } };
+    for (const auto& entry : formats)
+    {
+        ProcessSorter sorter;
+        SnapshotWriter writer(entry.format);
+        size_t bytes = 0;
+        size_t firstCapacity = 0;
+        unsigned long long tick = 0;
+
+        // Each snapshot: new counters, then sort, serialize and write as runHeadless does;
+        // only the part after the refresh is timed
+        double totalMs = 0.0;
+        for (int i = 0; i < ticks; ++i)
+        {
+            pm.refreshProcessList();
+            auto start = std::chrono::steady_clock::now();
+            sorter.invalidate();
+            const std::vector<uint32_t>& rows = sorter.order(pm.getProcessTable(), names, byMemory);
+            writer.writeProcesses(pm.getProcessTable(), names, rows, rows.size(), ++tick, 0);
+            bytes = writer.data().size();
+            writer.flush(sink);
+            if (tick == 1)
+                firstCapacity = writer.data().capacity();
+            auto end = std::chrono::steady_clock::now();
+            totalMs += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+
+        std::wcout << std::setw(12) << entry.label
+            << std::setw(18) << totalMs / ticks
+            << std::setw(16) << bytes
+            << firstCapacity << L" / " << writer.data().capacity() << L"\n";
+    }
+
+    std::fclose(sink);
+}
+
+void runRecordingBenchmark()
+{
+    const size_t processCount = 5000;
+    const int ticks = 3600;
+    const int seeks = 200;
+
+#ifdef _WIN32
+    const std::string path = "recording-benchmark.tmrec";
+#else
+    const std::string path = "/tmp/taskmgr-recording-benchmark.tmrec";
+#endif
+
+    // An hour at 1 Hz of a busy host: each tick about one process in ten changes memory,
+    // one in five uses CPU, and one exits while another starts
+    NamePool& names = processNames();
+    std::vector<ProcessInfo> processes(processCount);
+    DWORD nextPid = 1000;
+    for (size_t i = 0; i < processCount; ++i)
+    {
+        ProcessInfo& proc = processes[i];
+        proc.pid = nextPid;
+        nextPid += 1 + static_cast<DWORD>(i % 3);
+        proc.parentPid = 1 + static_cast<DWORD>(i / 50);
+        proc.name = L"service" + std::to_wstring(i % 300) + L".exe";
+        proc.nameId = names.intern(proc.name);
+        proc.memoryUsage = (2000 + i % 7000) * 4096ULL;
+        proc.isAccessible = i % 40 != 0;
+        proc.startTime = 100000 + i;
+        proc.memoryDelta = 0;
+        proc.isNew = false;
+        proc.cpuTime = i * 1000000ULL;
+        proc.cpuUsage = 0.0;
+    }
+
+    SnapshotRecorder recorder;
+    if (!recorder.open(path))
+    {
+        std::wcout << L"Could not create the recording file.\n";
+        return;
+    }
+
+    const long long startMs = 1700000000000LL;
+    unsigned long long seed = 12345;
+    auto random = [&seed]() { seed = seed * 6364136223846793005ULL + 1442695040888963407ULL; return seed >> 33; };
+
+    double recordMs = 0.0;
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        for (size_t n = 0; n < processCount / 10; ++n)
+        {
+            ProcessInfo& proc = processes[random() % processCount];
+            proc.memoryUsage += (random() % 2 ? 1 : -1) * static_cast<long long>(4096 * (1 + random() % 64));
+        }
+        for (size_t n = 0; n < processCount / 5; ++n)
+            processes[random() % processCount].cpuTime += 10000000ULL * (1 + random() % 20);
+
+        ProcessInfo& replaced = processes[random() % processCount];
+        replaced.pid = nextPid++;
+        replaced.startTime = 200000 + static_cast<unsigned long long>(tick);
+
+        auto begin = std::chrono::steady_clock::now();
+        recorder.append(processes, startMs + tick * 1000LL);
+        recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+    recorder.close();
+    unsigned long long fileBytes = recorder.bytesWritten();
+
+    SnapshotReplay replay;
+    std::string error;
+    double openMs = timeAverage(1, [&]() { replay.open(path, error); });
+    if (replay.frameCount() != static_cast<unsigned long long>(ticks))
+    {
+        std::wcout << L"Replay failed: " << error.c_str() << L"\n";
+        std::remove(path.c_str());
+        return;
+    }
+
+    // The last frame must come back exactly as recorded
+    replay.seek(startMs + (ticks - 1) * 1000LL);
+    bool identical = replay.processes().size() == processes.size();
+    std::vector<ProcessInfo> expected = processes;
+    std::sort(expected.begin(), expected.end(), [](const ProcessInfo& a, const ProcessInfo& b) { return a.pid < b.pid; });
+    for (size_t i = 0; identical && i < expected.size(); ++i)
+    {
+        const ProcessInfo& got = replay.processes()[i];
+        identical = got.pid == expected[i].pid && got.name == expected[i].name && got.cpuTime == expected[i].cpuTime
+            && got.isAccessible == expected[i].isAccessible
+            && (!got.isAccessible || got.memoryUsage == expected[i].memoryUsage);
+    }
+
+    double sequentialMs = timeAverage(1, [&]()
+        {
+            replay.seek(startMs);
+            while (replay.next())
+            {
+            }
+        });
+    double seekMs = timeAverage(seeks, [&]() { replay.seek(startMs + static_cast<long long>(random() % ticks) * 1000LL); });
+    replay.close();
+    std::remove(path.c_str());
+
+    std::wcout << processCount << L" processes, " << ticks << L" ticks at 1 Hz, keyframe every "
+        << SnapshotRecorder::DefaultKeyframeInterval << L" ticks\n";
+    std::wcout << std::fixed << std::setprecision(2)
+        << L"File size:          " << fileBytes / (1024.0 * 1024.0) << L" MB ("
+        << std::setprecision(0) << static_cast<double>(fileBytes) / ticks << L" bytes/tick)\n"
+        << std::setprecision(3)
+        << L"Record:             " << recordMs / ticks << L" ms/tick\n"
+        << L"Open (index):       " << openMs << L" ms\n"
+        << L"Sequential replay:  " << sequentialMs / ticks << L" ms/frame\n"
+        << L"Random seek:        " << seekMs << L" ms\n"
+        << L"Last frame matches: " << (identical ? L"yes" : L"NO") << L"\n";
+}
+
+#ifndef _WIN32
+// Scrapes /metrics over one keep-alive connection until done; returns false on a protocol error
+static bool scrapeLoop(uint16_t port, const std::atomic<bool>& done, size_t& scrapes, size_t& bytes, double& totalMs)
+{
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (s < 0 || connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        if (s >= 0)
+            close(s);
+        return false;
+    }
+
+    static const char request[] = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::vector<char> buffer(1 << 16);
+    bool ok = true;
+    while (ok && !done.load())
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (send(s, request, sizeof(request) - 1, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(request) - 1))
+            break;
+
+        // Header first, then exactly Content-Length body bytes
+        size_t have = 0, headerEnd = 0, contentLength = 0;
+        while (ok)
+        {
+            ssize_t got = recv(s, buffer.data() + have, buffer.size() - have, 0);
+            if (got <= 0)
+            {
+                ok = false;
+                break;
+            }
+            have += static_cast<size_t>(got);
+            std::string_view text(buffer.data(), have);
+            size_t end = text.find("\r\n\r\n");
+            if (end != std::string_view::npos)
+            {
+                headerEnd = end + 4;
+                size_t field = text.find("Content-Length: ");
+                ok = field != std::string_view::npos && field < end && text.compare(9, 3, "200") == 0;
+                if (ok)
+                    contentLength = std::strtoull(buffer.data() + field + 16, nullptr, 10);
+                break;
+            }
+        }
+        size_t left = ok ? contentLength - std::min(contentLength, have - headerEnd) : 0;
+        while (ok && left > 0)
+        {
+            ssize_t got = recv(s, buffer.data(), std::min(left, buffer.size()), 0);
+            if (got <= 0)
+                ok = false;
+            else
+                left -= static_cast<size_t>(got);
+        }
+        if (ok)
+        {
+            ++scrapes;
+            bytes += contentLength;
+            totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    close(s);
+    return ok;
+}
+#endif
+
+void runMetricsExporterBenchmark()
+{
+    const size_t processes = 20000;
+    const NamePool& names = processNames();
+
+    // Page build cost: what one scrape would cost if it formatted the snapshot itself
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(processes, 0));
+    pm.refreshProcessList();
+    MetricsFormatter formatter(MetricsExporter::DefaultTopGroups);
+    std::string page;
+    double buildMs = timeAverage(50, [&]() { formatter.build(pm.getProcessTable(), names, 1, 0, page); });
+    formatter.build(pm.getProcessTable(), names, 1, 0, page);
+
+    std::wcout << processes << L" processes, top " << MetricsExporter::DefaultTopGroups << L" names plus (other)\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << L"Page build:  " << buildMs << L" ms, " << page.size() << L" bytes\n";
+
+#ifdef _WIN32
+    std::wcout << L"The concurrent scrape test needs POSIX sockets and is skipped on Windows.\n";
+#else
+    ProcessSampler sampler(std::make_unique<SyntheticSnapshotSource>(processes, 0), std::chrono::milliseconds(1000));
+    sampler.start();
+    MetricsExporter exporter(sampler);
+    std::string error;
+    if (!exporter.start("127.0.0.1", 0, error))
+    {
+        std::wcout << L"Could not start the endpoint: " << error.c_str() << L"\n";
+        sampler.stop();
+        return;
+    }
+    while (exporter.pagesBuilt() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    std::wcout << std::left << std::setw(10) << L"Clients" << std::setw(14) << L"scrapes/s"
+        << std::setw(14) << L"ms/scrape" << std::setw(14) << L"MB/s" << L"Pages built\n";
+    std::wcout << std::wstring(64, L'-') << L"\n";
+
+    const std::chrono::seconds duration(3);
+    for (size_t clients : { 1, 4, 16, 64 })
+    {
+        std::atomic<bool> done{ false };
+        std::vector<size_t> scrapes(clients), bytes(clients);
+        std::vector<double> totalMs(clients);
+        std::atomic<size_t> failures{ 0 };
+        unsigned long long pagesBefore = exporter.pagesBuilt();
+
+        std::vector<std::thread> threads;
+        for (size_t c = 0; c < clients; ++c)
+        {
+            threads.emplace_back([&, c]()
+                {
+                    if (!scrapeLoop(exporter.port(), done, scrapes[c], bytes[c], totalMs[c]))
+                        ++failures;
+                });
+        }
+        std::this_thread::sleep_for(duration);
+        done.store(true);
+        for (std::thread& thread : threads)
+            thread.join();
+
+        size_t scrapeCount = 0, byteCount = 0;
+        double ms = 0.0;
+        for (size_t c = 0; c < clients; ++c)
+        {
+            scrapeCount += scrapes[c];
+            byteCount += bytes[c];
+            ms += totalMs[c];
+        }
+        double seconds = static_cast<double>(duration.count());
+        std::wcout << std::setw(10) << clients
+            << std::setw(14) << std::setprecision(0) << scrapeCount / seconds
+            << std::setw(14) << std::setprecision(3) << (scrapeCount ? ms / scrapeCount : 0.0)
+            << std::setw(14) << std::setprecision(1) << byteCount / seconds / (1024.0 * 1024.0)
+            << exporter.pagesBuilt() - pagesBefore;
+        if (failures)
+            std::wcout << L"  (" << failures.load() << L" clients failed)";
+        std::wcout << L"\n";
+    }
+
+    exporter.stop();
+    sampler.stop();
+    std::wcout << L"The page is built once per sampler tick however many clients scrape it.\n";
+#endif
+}
+
+// Substring search as Menu::searchProcessesByName did it: clean and lowercase every name per query
+static size_t legacySubstringSearch(const ProcessManager& pm, const std::vector<ProcessInfo>& list, const std::wstring& term)
+{
+    size_t matches = 0;
+    for (const auto& proc : list)
+    {
+        std::wstring lowerName = pm.cleanName(proc.name);
+        std::wstring lowerSearch = term;
+        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::towlower);
+        std::transform(lowerSearch.begin(), lowerSearch.end(), lowerSearch.begin(), ::towlower);
+        if (lowerName.find(lowerSearch) != std::wstring::npos)
+            ++matches;
+    }
+    return matches;
+}
+
+void runSearchBenchmark()
+{
+    const size_t processCount = 50000;
+    const size_t churn = 500;    // Processes replaced per refresh
+    const int iterations = 200;
+
+    // A mix of a few very common names and a long tail, like a busy build or container host
+    static const wchar_t* const stems[] = {
+        L"Chrome", L"svchost", L"python3.11", L"node", L"java", L"kworker/u16:", L"systemd-journald",
+        L"postgres", L"nginx", L"Code Helper (Renderer)", L"RuntimeBroker", L"dotnet", L"containerd-shim",
+        L"bash", L"sshd", L"php-fpm", L"clang++", L"ld.lld", L"cc1plus", L"git-remote-https",
+    };
+    const size_t stemCount = sizeof(stems) / sizeof(stems[0]);
+    NamePool& names = processNames();
+    auto makeProcess = [&](size_t i, DWORD pid)
+        {
+            ProcessInfo proc;
+            proc.pid = pid;
+            proc.parentPid = 1;
+            // Half of the processes share the 20 stems, the rest spread over 5k numbered variants
+            size_t variant = i % 2 == 0 ? 0 : 1 + (i / 2 / stemCount) % 250;
+            proc.name = std::wstring(stems[i / 2 % stemCount]) + (variant ? std::to_wstring(variant) : L"") + L".exe";
+            proc.nameId = names.intern(proc.name);
+            proc.memoryUsage = (1000 + i % 5000) * 4096ULL;
+            proc.isAccessible = true;
+            proc.isNew = false;
+            return proc;
+        };
+
+    std::vector<ProcessInfo> processes;
+    for (size_t i = 0; i < processCount; ++i)
+        processes.push_back(makeProcess(i, static_cast<DWORD>(1000 + i * 4)));
+
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(1, 0));
+    ProcessTable table;
+    table.assign(processes);
+
+    ProcessSearchIndex index;
+    double rebuildMs = timeAverage(20, [&]() { index.rebuild(table, names); });
+
+    // Churn: the first `churn` processes exit and as many new ones start, each tick
+    std::vector<ProcessDelta> deltas(iterations);
+    std::vector<ProcessTable> tables(iterations);
+    size_t nextIndex = processCount;
+    std::vector<ProcessInfo> current = processes;
+    for (int tick = 0; tick < iterations; ++tick)
+    {
+        for (ProcessInfo& proc : current)
+            proc.isNew = false;
+        for (size_t i = 0; i < churn; ++i)
+        {
+            size_t slot = (static_cast<size_t>(tick) * churn + i * 97) % processCount;
+            deltas[tick].removed.push_back(current[slot]);
+            current[slot] = makeProcess(nextIndex, static_cast<DWORD>(1000 + nextIndex * 4));
+            current[slot].isNew = true;
+            deltas[tick].added.push_back(current[slot].pid);
+            ++nextIndex;
+        }
+        tables[tick].assign(current);
+    }
+    index.rebuild(table, names);
+    auto applyStart = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < iterations; ++tick)
+        index.apply(tables[tick], deltas[tick], names);
+    double applyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - applyStart).count() / iterations;
+    bool churnConsistent = index.processCount() == processCount;
+
+    // Queries run against the original table
+    index.rebuild(table, names);
+    std::wcout << processCount << L" processes, " << index.processCount() << L" indexed, "
+        << names.size() << L" names in the pool\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << L"Index rebuild:                      " << rebuildMs << L" ms\n"
+        << L"Index update (" << churn << L" exits + " << churn << L" starts): " << applyMs << L" ms"
+        << (churnConsistent ? L"" : L"  (COUNT MISMATCH)") << L"\n\n";
+
+    std::wcout << std::left << std::setw(12) << L"Mode" << std::setw(24) << L"Pattern"
+        << std::setw(10) << L"Matches" << std::setw(14) << L"Index us" << L"Scan us\n";
+    std::wcout << std::wstring(72, L'-') << L"\n";
+
+    const struct { const wchar_t* label; SearchMode mode; const wchar_t* pattern; } queries[] = {
+        { L"exact", SearchMode::Exact, L"postgres" },
+        { L"prefix", SearchMode::Prefix, L"sys" },
+        { L"substring", SearchMode::Substring, L"helper" },
+        { L"substring", SearchMode::Substring, L"er17" },
+        { L"substring", SearchMode::Substring, L"d" },
+        { L"glob", SearchMode::Glob, L"python3.1?2*" },
+        { L"glob", SearchMode::Glob, L"*remote*" },
+        { L"regex", SearchMode::Regex, L"^(node|java)\\d+$" },
+    };
+    std::vector<DWORD> pids;
+    std::string error;
+    for (const auto& query : queries)
+    {
+        double indexUs = 1000.0 * timeAverage(iterations, [&]() { index.find(query.mode, query.pattern, pids, error); });
+        std::wcout << std::setw(12) << query.label << std::setw(24) << query.pattern
+            << std::setw(10) << pids.size() << std::setw(14) << std::setprecision(1) << indexUs;
+
+        // The old menu path only did substrings
+        if (query.mode == SearchMode::Substring)
+        {
+            size_t scanMatches = 0;
+            double scanUs = 1000.0 * timeAverage(5, [&]() { scanMatches = legacySubstringSearch(pm, processes, query.pattern); });
+            std::wcout << scanUs;
+            if (scanMatches != pids.size())
+                std::wcout << L"  (scan found " << scanMatches << L")";
+        }
+        else
+        {
+            std::wcout << L"-";
+        }
+        std::wcout << L"\n";
+    }
+}
+
+void runFilterBenchmark()
+{
+    const size_t processCount = 50000;
+    const int iterations = 200;
+
+    // Five owners with fixed names, so user tests do not depend on the host's accounts
+    static const wchar_t* const owners[] = { L"root", L"build", L"web", L"db", L"ci" };
+    const uint32_t firstOwner = 4200000000u;
+    for (uint32_t i = 0; i < 5; ++i)
+        rememberUserName(firstOwner + i, owners[i]);
+
+    static const wchar_t* const stems[] = { L"java", L"python3", L"node", L"postgres", L"nginx", L"bash", L"javac", L"sshd" };
+    NamePool& names = processNames();
+    std::vector<ProcessInfo> processes(processCount);
+    for (size_t i = 0; i < processCount; ++i)
+    {
+        ProcessInfo& proc = processes[i];
+        proc.pid = static_cast<DWORD>(100 + i * 3);
+        proc.parentPid = i % 10 == 0 ? 1 : static_cast<DWORD>(100 + (i / 10) * 30);
+        proc.name = std::wstring(stems[i % 8]) + std::to_wstring(i % 400) + L".exe";
+        proc.nameId = names.intern(proc.name);
+        proc.memoryUsage = ((i * 2654435761u) % 8192) * 1048576ULL;    // 0 to 8 GB
+        proc.isAccessible = i % 50 != 0;
+        proc.isNew = false;
+        proc.memoryDelta = 0;
+        proc.cpuUsage = static_cast<double>((i * 40503u) % 10000) / 100.0;
+        proc.userId = firstOwner + static_cast<uint32_t>((i / 7) % 5);
+        proc.state = i % 25 == 0 ? 'R' : i % 301 == 0 ? 'Z' : 'S';
+    }
+    ProcessTable table;
+    table.assign(processes);
+
+    // Each filter next to the predicate a reader would write for it: one call per process,
+    // names cleaned and lowercased on the spot
+    auto lowerName = [](const ProcessInfo& proc)
+        {
+            std::wstring name = cleanProcessName(proc.name);
+            std::transform(name.begin(), name.end(), name.begin(), ::towlower);
+            return name;
+        };
+    const struct
+    {
+        const wchar_t* expression;
+        std::function<bool(const ProcessInfo&)> predicate;
+    } cases[] = {
+        { L"memory>2GB", [](const ProcessInfo& p) { return p.isAccessible && p.memoryUsage > (2ULL << 30); } },
+        { L"name=java*", [&](const ProcessInfo& p) { return globMatch(L"java*", lowerName(p)); } },
+        { L"name=java* and memory>2GB and user=build", [&](const ProcessInfo& p)
+            {
+                return globMatch(L"java*", lowerName(p)) && p.isAccessible && p.memoryUsage > (2ULL << 30)
+                    && userName(p.userId) == L"build";
+            } },
+        { L"cpu>50 or state=running", [](const ProcessInfo& p) { return (p.isAccessible && p.cpuUsage > 50.0) || p.state == 'R'; } },
+        { L"not user=root and (pid<20000 or parent=1) and state!=zombie", [](const ProcessInfo& p)
+            {
+                return userName(p.userId) != L"root" && (p.pid < 20000 || p.parentPid == 1) && p.state != 'Z';
+            } },
+    };
+
+    std::wcout << processCount << L" processes, " << iterations << L" evaluations per filter\n";
+    std::wcout << std::left << std::setw(62) << L"Filter" << std::setw(10) << L"Matches"
+        << std::setw(14) << L"Columns us" << L"Per-row us\n";
+    std::wcout << std::wstring(100, L'-') << L"\n";
+
+    std::vector<uint8_t> mask;
+    for (const auto& entry : cases)
+    {
+        ProcessFilter filter;
+        std::string error;
+        if (!filter.compile(entry.expression, error))
+        {
+            std::wcout << entry.expression << L": " << error.c_str() << L"\n";
+            continue;
+        }
+
+        double columnUs = 1000.0 * timeAverage(iterations, [&]() { filter.evaluate(table, names, mask); });
+        size_t matches = static_cast<size_t>(std::count(mask.begin(), mask.end(), 1));
+
+        size_t rowMatches = 0;
+        double rowUs = 1000.0 * timeAverage(5, [&]()
+            {
+                rowMatches = 0;
+                for (const ProcessInfo& proc : processes)
+                    rowMatches += entry.predicate(proc) ? 1 : 0;
+            });
+
+        std::wcout << std::setw(62) << entry.expression << std::setw(10) << matches
+            << std::fixed << std::setprecision(1) << std::setw(14) << columnUs << rowUs;
+        if (rowMatches != matches)
+            std::wcout << L"  (predicate found " << rowMatches << L")";
+        std::wcout << L"\n";
+    }
+}
+
+// Subtree memory the straightforward way: every process walks up its parent chain and adds
+// itself to each ancestor, looking parents up by PID
+static unsigned long long ancestorWalkTotals(const ProcessTable& table, std::vector<unsigned long long>& totals)
+{
+    std::unordered_map<DWORD, uint32_t> rowOfPid;
+    for (uint32_t row = 0; row < table.size(); ++row)
+        rowOfPid.emplace(table.pid[row], row);
+
+    totals.assign(table.size(), 0);
+    for (uint32_t row = 0; row < table.size(); ++row)
+    {
+        unsigned long long bytes = table.accessible(row) ? table.memory[row] : 0;
+        uint32_t at = row;
+        for (size_t steps = 0; steps <= table.size(); ++steps)
+        {
+            totals[at] += bytes;
+            auto it = rowOfPid.find(table.parentPid[at]);
+            if (it == rowOfPid.end() || it->second == at)
+                break;
+            at = it->second;
+        }
+    }
+    return totals.empty() ? 0 : totals[0];
+}
+
+void runProcessTreeBenchmark()
+{
+    const size_t processCount = 50000;
+    const int iterations = 50;
+
+    // Three shapes: a typical host (a few levels, modest fan-out), a build daemon that owns
+    // most of the machine as direct children, and one long chain
+    struct Shape
+    {
+        const wchar_t* label;
+        std::function<DWORD(size_t)> parentOf;    // Parent PID of process i (PIDs are 100 + i)
+        bool compare;                             // The ancestor walk is quadratic on a chain
+    };
+    const Shape shapes[] = {
+        { L"Host (fan-out 10)", [](size_t i) { return i == 0 ? DWORD(1) : static_cast<DWORD>(100 + (i - 1) / 10); }, true },
+        { L"Build daemon (40k children)", [](size_t i)
+            { return i == 0 ? DWORD(1) : i < 40000 ? DWORD(100) : static_cast<DWORD>(100 + (i - 40000) % 200); }, true },
+        { L"Chain (depth 50k)", [](size_t i) { return i == 0 ? DWORD(1) : static_cast<DWORD>(100 + i - 1); }, false },
+    };
+
+    NamePool& names = processNames();
+    uint32_t nameId = names.intern(L"worker.exe");
+
+    std::wcout << processCount << L" processes, " << iterations << L" builds per shape\n";
+    std::wcout << std::left << std::setw(30) << L"Shape" << std::setw(12) << L"Build ms"
+        << std::setw(14) << L"Subtree us" << std::setw(16) << L"Ancestor ms" << L"Roots\n";
+    std::wcout << std::wstring(84, L'-') << L"\n";
+
+    ProcessTree tree;
+    std::vector<uint32_t> rows;
+    std::vector<unsigned long long> totals;
+    for (const Shape& shape : shapes)
+    {
+        std::vector<ProcessInfo> processes(processCount);
+        for (size_t i = 0; i < processCount; ++i)
+        {
+            ProcessInfo& proc = processes[i];
+            proc.pid = static_cast<DWORD>(100 + i);
+            proc.parentPid = shape.parentOf(i);
+            proc.nameId = nameId;
+            proc.memoryUsage = ((i * 2654435761u) % 512) * 1048576ULL;
+            proc.isAccessible = i % 50 != 0;
+            proc.cpuUsage = static_cast<double>(i % 100) / 100.0;
+        }
+        // Collection order is not tree order
+        std::reverse(processes.begin(), processes.end());
+        ProcessTable table;
+        table.assign(processes);
+
+        double buildMs = timeAverage(iterations, [&]() { tree.build(table); });
+
+        // Collecting the subtree of the largest child of the first root (what a kill does)
+        uint32_t target = tree.roots()[0];
+        if (tree.childCount(target) > 0)
+            target = tree.children(target)[0];
+        double subtreeUs = 1000.0 * timeAverage(iterations, [&]() { tree.subtree(target, rows); });
+
+        std::wcout << std::setw(30) << shape.label << std::fixed << std::setprecision(2) << std::setw(12) << buildMs
+            << std::setw(14) << subtreeUs;
+        if (shape.compare)
+        {
+            double walkMs = timeAverage(3, [&]() { ancestorWalkTotals(table, totals); });
+            uint32_t root = tree.roots()[0];
+            std::wcout << std::setw(16) << walkMs;
+            if (totals[root] != tree.subtreeMemory(root))
+                std::wcout << L"(mismatch) ";
+        }
+        else
+        {
+            std::wcout << std::setw(16) << L"(skipped)";
+        }
+        std::wcout << tree.roots().size() << L"\n";
+    }
+}
+
+#ifndef _WIN32
+// Forks count children that sleep until signalled; with ignoreTerm they ignore SIGTERM.
+// The disposition is set before forking so no child can be caught before it is in place.
+static std::vector<DWORD> spawnSleepers(size_t count, bool ignoreTerm)
+{
+    struct sigaction previous;
+    struct sigaction ignore = {};
+    ignore.sa_handler = SIG_IGN;
+    if (ignoreTerm)
+        sigaction(SIGTERM, &ignore, &previous);
+
+    std::vector<DWORD> pids;
+    for (size_t i = 0; i < count; ++i)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            for (;;)
+                pause();
+        }
+        if (pid > 0)
+            pids.push_back(static_cast<DWORD>(pid));
+    }
+
+    if (ignoreTerm)
+        sigaction(SIGTERM, &previous, nullptr);
+    return pids;
+}
+
+static void reapAll(const std::vector<DWORD>& pids)
+{
+    for (DWORD pid : pids)
+    {
+        kill(static_cast<pid_t>(pid), SIGKILL);
+        waitpid(static_cast<pid_t>(pid), nullptr, 0);
+    }
+}
+#endif
+
+void runTerminationBenchmark()
+{
+#ifdef _WIN32
+    std::wcout << L"This benchmark forks its own test processes and only runs on Linux.\n";
+#else
+    const size_t processCount = 1000;
+    ProcessManager pm;
+
+    std::wcout << processCount << L" child processes per run\n";
+    std::wcout << std::left << std::setw(52) << L"Method" << std::setw(12) << L"Gone ms" << L"Outcome\n";
+    std::wcout << std::wstring(90, L'-') << L"\n";
+
+    // What the menu used to do: one SIGKILL after another, with nothing to say when they are gone
+    {
+        std::vector<DWORD> pids = spawnSleepers(processCount, false);
+        auto start = std::chrono::steady_clock::now();
+        size_t killed = 0;
+        for (DWORD pid : pids)
+            killed += pm.terminateProcessByPID(pid) ? 1 : 0;
+        double signalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        for (DWORD pid : pids)
+            waitpid(static_cast<pid_t>(pid), nullptr, 0);
+        double goneMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::wcout << std::setw(52) << L"Serial SIGKILL, then waitpid each" << std::fixed << std::setprecision(1)
+            << std::setw(12) << goneMs << killed << L" signalled in " << signalMs << L" ms\n";
+    }
+
+    const struct
+    {
+        const wchar_t* label;
+        long long graceMs;
+        bool ignoreTerm;
+    } cases[] = {
+        { L"Terminator, no grace (SIGKILL)", 0, false },
+        { L"Terminator, SIGTERM honoured", 2000, false },
+        { L"Terminator, SIGTERM ignored, 250 ms grace", 250, true },
+    };
+    for (const auto& entry : cases)
+    {
+        std::vector<DWORD> pids = spawnSleepers(processCount, entry.ignoreTerm);
+        TerminationOptions options;
+        options.grace = std::chrono::milliseconds(entry.graceMs);
+        ProcessTerminator terminator(options);
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<TerminationResult> results = terminator.terminate(pids);
+        double goneMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        reapAll(pids);
+
+        size_t counts[6] = {};
+        for (const TerminationResult& result : results)
+            ++counts[static_cast<size_t>(result.outcome)];
+        std::wcout << std::setw(52) << entry.label << std::fixed << std::setprecision(1) << std::setw(12) << goneMs
+            << counts[static_cast<size_t>(TerminationOutcome::Exited)] << L" exited, "
+            << counts[static_cast<size_t>(TerminationOutcome::Killed)] << L" killed, "
+            << counts[static_cast<size_t>(TerminationOutcome::Survived)] + counts[static_cast<size_t>(TerminationOutcome::Denied)]
+            << L" left\n";
+    }
+#endif
+}
+
+#ifndef _WIN32
+// CPU time this process has used so far, seconds
+static double ownCpuSeconds()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+        + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+#endif
+
+void runLaunchBenchmark()
+{
+#ifdef _WIN32
+    const size_t launches = 1000;
+    const wchar_t* command = L"cmd.exe /c exit 0";
+#else
+    const size_t launches = 10000;
+    const wchar_t* command = L"true";
+#endif
+    std::vector<std::wstring> commands(launches, command);
+
+    std::wcout << launches << L" launches of \"" << command << L"\"\n";
+    std::wcout << std::left << std::setw(36) << L"Method" << std::setw(12) << L"Total ms" << std::setw(14) << L"Launches/s"
+        << std::setw(16) << L"Own CPU us each" << L"Exit codes\n";
+    std::wcout << std::wstring(90, L'-') << L"\n";
+
+    auto printRow = [&](const wchar_t* label, double totalMs, double ownCpu, size_t collected)
+        {
+            std::wcout << std::setw(36) << label << std::fixed << std::setprecision(1) << std::setw(12) << totalMs
+                << std::setw(14) << launches / (totalMs / 1000.0) << std::setw(16) << ownCpu * 1e6 / launches
+                << collected << L"\n";
+        };
+
+#ifndef _WIN32
+    // The single launch path: one spawn per call, exits never looked at (only reaped)
+    {
+        ProcessLauncher launcher;
+        double cpuBefore = ownCpuSeconds();
+        auto start = std::chrono::steady_clock::now();
+        for (const std::wstring& line : commands)
+            launcher.launch(line);
+        while (wait(nullptr) > 0)
+        {
+        }
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printRow(L"launch() one by one", totalMs, ownCpuSeconds() - cpuBefore, 0);
+    }
+#endif
+
+    for (unsigned concurrency : { 1u, 8u, 64u })
+    {
+        ProcessLauncher launcher;
+        BatchOptions options;
+        options.concurrency = concurrency;
+#ifndef _WIN32
+        double cpuBefore = ownCpuSeconds();
+#endif
+        auto start = std::chrono::steady_clock::now();
+        std::vector<LaunchResult> results = launcher.runBatch(commands, options);
+        double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t collected = static_cast<size_t>(std::count_if(results.begin(), results.end(),
+            [](const LaunchResult& result) { return result.exited && result.exitCode == 0; }));
+
+        std::wstring label = L"Batch, " + std::to_wstring(concurrency) + L" at a time";
+#ifndef _WIN32
+        printRow(label.c_str(), totalMs, ownCpuSeconds() - cpuBefore, collected);
+#else
+        printRow(label.c_str(), totalMs, 0.0, collected);
+#endif
+    }
+}
+
+void runMemoryDetailBenchmark()
+{
+    struct Tier
+    {
+        const wchar_t* label;
+        MemoryDetailPolicy policy;
+        int iterations;
+    };
+    const Tier tiers[] = {
+        { L"counters only", { 0, 0 }, 20 },
+        { L"+ top 20", { 20, 0 }, 20 },
+        { L"+ all", { 0, 1 }, 5 },
+        { L"top 20, all / 30", { 20, 30 }, 60 },
+    };
+
+    std::wcout << std::left << std::setw(12) << L"Source" << std::setw(20) << L"Tier"
+        << std::setw(12) << L"Processes" << std::setw(14) << L"ms/tick" << L"us/breakdown\n";
+    std::wcout << std::wstring(72, L'-') << L"\n";
+
+    auto runTiers = [&tiers](const wchar_t* source, const std::function<std::unique_ptr<ProcessManager>()>& create)
+        {
+            double basicMs = 0.0;
+            for (const Tier& tier : tiers)
+            {
+                std::unique_ptr<ProcessManager> pm = create();
+                pm->refreshProcessList();    // Warm up outside the policy: the list is at full size
+                pm->setMemoryDetailPolicy(tier.policy);
+                double ms = timeRefresh(*pm, tier.iterations);
+                size_t processes = pm->getProcessList().size();
+                if (tier.policy.topCount == 0 && tier.policy.every == 0)
+                    basicMs = ms;
+
+                // What one breakdown costs, from the extra time over the counters-only tier
+                double perTick = tier.policy.every == 1 ? static_cast<double>(processes)
+                    : static_cast<double>(std::min(tier.policy.topCount, processes))
+                        + (tier.policy.every > 1 ? static_cast<double>(processes) / tier.policy.every : 0.0);
+                std::wcout << std::left << std::setw(12) << source << std::setw(20) << tier.label
+                    << std::setw(12) << processes << std::fixed << std::setprecision(3) << std::setw(14) << ms;
+                if (perTick > 0)
+                    std::wcout << std::setprecision(1) << 1000.0 * (ms - basicMs) / perTick;
+                else
+                    std::wcout << L"-";
+                std::wcout << L"\n";
+            }
+        };
+
+    // 5 us per counter read as in the refresh benchmarks, 40 us per smaps_rollup-sized read
+    runTiers(L"synthetic", []() { return std::make_unique<ProcessManager>(std::make_unique<SyntheticSnapshotSource>(10000, 5000, 40000)); });
+    runTiers(L"native", []() { return std::make_unique<ProcessManager>(); });
+}
+
+void runTopNBenchmark()
+{
+    const size_t processCount = 50000;
+    const size_t topCount = 20;
+    const int iterations = 20;
+    const SortOrder byMemory = { { SortKey::Accessible, false }, { SortKey::Memory, true } };
+
+    // Times work only, after prepare has set up each round (a fresh snapshot, churn, ...)
+    auto timeRounds = [iterations](const std::function<void()>& prepare, const std::function<void()>& work)
+        {
+            std::chrono::steady_clock::duration total{};
+            for (int i = 0; i < iterations; ++i)
+            {
+                prepare();
+                auto start = std::chrono::steady_clock::now();
+                work();
+                total += std::chrono::steady_clock::now() - start;
+            }
+            return std::chrono::duration<double, std::milli>(total).count() / iterations;
+        };
+
+    // The views print to std::wcout; send that into a buffer emptied every round
+    std::wostringstream sink;
+    std::wstreambuf* console = std::wcout.rdbuf(sink.rdbuf());
+
+    ProcessManager pm(std::make_unique<SyntheticSnapshotSource>(processCount, 0));
+    pm.refreshProcessList();
+    auto freshSnapshot = [&]() { pm.refreshProcessList(); sink.str(L""); };
+    double fullView = timeRounds(freshSnapshot, [&]() { pm.sortByMemory(); pm.printProcessList(); });
+    double pageView = timeRounds(freshSnapshot, [&]() { pm.printProcessPage(byMemory, 0, topCount); });
+    double fullGroups = timeRounds(freshSnapshot, [&]() { pm.printGroupedProcessesByMemory(); });
+    double pageGroups = timeRounds(freshSnapshot, [&]() { pm.printGroupedProcessesByMemory(0, topCount); });
+
+    std::wcout.rdbuf(console);
+
+    // The selection alone, on a table where a few percent of the processes change size
+    // between snapshots; the cutoff carried from the previous snapshot then still holds
+    const std::vector<ProcessInfo>& list = pm.getProcessList();
+    ProcessTable table;
+    table.assign(list);
+    const NamePool& names = processNames();
+    unsigned long long round = 0;
+    auto churn = [&]()
+        {
+            ++round;
+            for (size_t row = round % 30; row < table.size(); row += 30)
+                table.memory[row] = ((row * 2654435761u + round * 40503u) % 4096) * 65536ULL;
+        };
+
+    ProcessSorter sorter;
+    double fullSort = timeRounds([&]() { churn(); sorter.invalidate(); }, [&]() { sorter.order(table, names, byMemory); });
+    double coldTop = timeRounds([&]() { churn(); sorter = ProcessSorter(); }, [&]() { sorter.top(table, names, byMemory, topCount); });
+    sorter = ProcessSorter();
+    sorter.top(table, names, byMemory, topCount);
+    double warmTop = timeRounds([&]() { churn(); sorter.invalidate(); }, [&]() { sorter.top(table, names, byMemory, topCount); });
+
+    // Same answer as the start of the full order?
+    sorter.invalidate();
+    std::vector<uint32_t> expected(sorter.order(table, names, byMemory).begin(), sorter.order(table, names, byMemory).begin() + topCount);
+    sorter.invalidate();
+    const std::vector<uint32_t>& selected = sorter.top(table, names, byMemory, topCount);
+    bool same = std::equal(expected.begin(), expected.end(), selected.begin());
+
+    std::wcout << processCount << L" processes, top " << topCount << L", " << iterations << L" rounds\n";
+    std::wcout << std::left << std::setw(46) << L"Operation" << L"ms\n";
+    std::wcout << std::wstring(56, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(46) << L"sortByMemory + printProcessList" << fullView << L"\n"
+        << std::setw(46) << L"printProcessPage (first 20)" << pageView << L"\n"
+        << std::setw(46) << L"grouped by memory, every group" << fullGroups << L"\n"
+        << std::setw(46) << L"grouped by memory, first 20 groups" << pageGroups << L"\n"
+        << std::setw(46) << L"radix sort of every row" << fullSort << L"\n"
+        << std::setw(46) << L"top 20, no cutoff (nth_element over all)" << coldTop << L"\n"
+        << std::setw(46) << L"top 20, previous snapshot's cutoff" << warmTop << L"\n";
+    std::wcout << L"Top rows match the full order: " << (same ? L"yes" : L"NO") << L"\n";
+}
+
+// A host of long-running services: each walk a few processes change size or use CPU and
+// a few are replaced by new ones, as between two sampler ticks
+class ChurningSource : public ProcessSnapshotSource
+{
+public:
+    ChurningSource(size_t processCount, size_t nameCount)
+    {
+        for (size_t i = 0; i < nameCount; ++i)
+            names.push_back("service" + std::to_string(i));
+        processes.resize(processCount);
+        for (size_t i = 0; i < processCount; ++i)
+            replace(processes[i], i % nameCount);
+    }
+
+    bool beginWalk(size_t& count) override
+    {
+        if (walks++ > 0)
+        {
+            size_t total = processes.size();
+            for (size_t n = 0; n < total / 50; ++n)
+                processes[random() % total].memory = (1000 + random() % 60000) * 4096ULL;
+            for (size_t n = 0; n < total / 20; ++n)
+                processes[random() % total].cpuTime += 1000000ULL * (1 + random() % 900);
+            for (size_t n = 0; n < total / 1000; ++n)
+                replace(processes[random() % total], random() % names.size());
+        }
+        count = processes.size();
+        return true;
+    }
+
+    bool sampleAt(size_t index, ProcessSample& sample, SampleScratch&) override
+    {
+        const Entry& entry = processes[index];
+        sample = ProcessSample();
+        sample.pid = entry.pid;
+        sample.parentPid = 1;
+        sample.startTime = entry.startTime;
+        sample.memoryUsage = entry.memory;
+        sample.cpuTime = entry.cpuTime;
+        sample.isAccessible = true;
+        sample.userId = 1000;
+        sample.state = 'S';
+        sample.threadCount = 4;
+        sample.handleCount = 16;
+        sample.utf8Name = names[entry.name].data();
+        sample.nameLength = names[entry.name].size();
+        return true;
+    }
+
+private:
+    struct Entry
+    {
+        DWORD pid;
+        unsigned long long startTime;
+        unsigned long long memory;
+        unsigned long long cpuTime;
+        size_t name;
+    };
+
+    unsigned long long random()
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        return seed >> 33;
+    }
+
+    void replace(Entry& entry, size_t name)
+    {
+        entry.pid = nextPid++;
+        entry.startTime = nextPid;
+        entry.memory = (1000 + random() % 60000) * 4096ULL;
+        entry.cpuTime = 0;
+        entry.name = name;
+    }
+
+    std::vector<std::string> names;
+    std::vector<Entry> processes;
+    DWORD nextPid = 1000;
+    unsigned long long seed = 42;
+    unsigned long long walks = 0;
+};
+
+// What a rule engine without the name index does each tick: every rule looks at every
+// process (only the comparison, no durations or state). Returns the conditions that hold.
+static size_t scanEveryRule(const std::vector<ProcessInfo>& processes, const std::vector<AlertRule>& rules)
+{
+    const NamePool& names = processNames();
+    size_t holding = 0;
+    for (const AlertRule& rule : rules)
+    {
+        bool wildcard = rule.name.find_first_of(L"*?") != std::wstring::npos;
+        double sum = 0.0;
+        size_t count = 0;
+        for (const ProcessInfo& proc : processes)
+        {
+            const std::wstring& name = names.lower(proc.nameId);
+            if (wildcard ? !globMatch(rule.name, name) : name != rule.name)
+                continue;
+            double value = rule.metric == AlertMetric::Cpu ? proc.cpuUsage : static_cast<double>(proc.memoryUsage);
+            ++count;
+            sum += value;
+            if (rule.kind == AlertKind::Process && (rule.above ? value > rule.threshold : value < rule.threshold))
+                ++holding;
+        }
+        double total = rule.kind == AlertKind::Instances ? static_cast<double>(count) : sum;
+        if ((rule.kind == AlertKind::Group || rule.kind == AlertKind::Instances)
+            && (rule.above ? total > rule.threshold : total < rule.threshold))
+            ++holding;
+    }
+    return holding;
+}
+
+void runAlertBenchmark()
+{
+    const size_t processCount = 20000;
+    const size_t nameCount = 300;
+    const size_t ruleCount = 500;
+    const int ticks = 30;
+
+    // Rules spread over the names: per-process memory and CPU limits with durations,
+    // group memory caps with hysteresis, instance counts, and appear/exit watches
+    AlertEngine engine;
+    std::string error;
+    for (size_t i = 0; i < ruleCount; ++i)
+    {
+        std::wstring name = L"service" + std::to_wstring((i * 7) % nameCount);
+        std::wstring rule;
+        switch (i % 5)
+        {
+        case 0: rule = L"process " + name + L" memory > 200MB for 5s"; break;
+        case 1: rule = L"process " + name + L" cpu > 50 for 3s clear 20"; break;
+        case 2: rule = L"group " + name + L" memory > 16GB clear 15GB"; break;
+        case 3: rule = L"instances " + name + L" > 70 for 2s"; break;
+        default: rule = (i % 10 == 4 ? L"appear " : L"exit ") + name; break;
+        }
+        engine.addRule(rule, error);
+    }
+    engine.addRule(L"process service1* memory > 236MB", error);
+    std::vector<AlertRule> rules = engine.rules();
+
+    ProcessManager pm(std::make_unique<ChurningSource>(processCount, nameCount));
+    pm.refreshProcessList();
+
+    // Ticks a second apart on the engine's clock, however long the refreshes take
+    auto clock = std::chrono::steady_clock::now();
+    auto start = std::chrono::steady_clock::now();
+    engine.update(pm, clock);
+    double primeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double incrementalMs = 0.0;
+    double scanMs = 0.0;
+    size_t deltaSize = 0;
+    size_t holding = 0;
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        pm.refreshProcessList();
+        const ProcessDelta& delta = pm.getLastDelta();
+        deltaSize += delta.added.size() + delta.removed.size() + delta.changed.size();
+        clock += std::chrono::seconds(1);
+
+        start = std::chrono::steady_clock::now();
+        engine.update(pm, clock);
+        incrementalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        holding += scanEveryRule(pm.getProcessList(), rules);
+        scanMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::wcout << processCount << L" processes, " << nameCount << L" names, " << rules.size() << L" rules, "
+        << ticks << L" ticks (" << deltaSize / ticks << L" processes in each delta)\n";
+    std::wcout << std::left << std::setw(44) << L"Operation" << L"ms\n";
+    std::wcout << std::wstring(54, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(44) << L"first update (every process)" << primeMs << L"\n"
+        << std::setw(44) << L"update from the delta, per tick" << incrementalMs / ticks << L"\n"
+        << std::setw(44) << L"every rule scans every process, per tick" << scanMs / ticks << L"\n";
+    std::wcout << L"Alerts fired: " << engine.firedCount() << L", active now: " << engine.active(clock).size()
+        << L" (the scan saw " << holding / ticks << L" conditions holding per tick)\n";
+}
+
+#ifndef _WIN32
+// Forks a process named tm-guard-hog that touches bytes of memory, says so on ready and
+// waits to be killed. It is named first: the sampler takes a process's name from its first
+// sight of it. Only system calls after the fork: the sampler's threads are running.
+static pid_t spawnHog(size_t bytes, int ready)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        prctl(PR_SET_NAME, "tm-guard-hog", 0, 0, 0);
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED)
+            std::memset(memory, 1, bytes);
+        char byte = 1;
+        if (write(ready, &byte, 1) != 1)
+            _exit(1);
+        for (;;)
+            pause();
+    }
+    return pid;
+}
+#endif
+
+void runGuardBenchmark()
+{
+    const size_t processCount = 20000;
+    const size_t nameCount = 300;
+    const int ticks = 50;
+
+    // Dry run over a churning host: memory caps on a third of the names (most of them over)
+    // and a CPU cap through a wildcard, so every tick has groups to act on
+    ResourceGuard guard;
+    guard.setActionsEnabled(false);
+    guard.setActionLimit(1000000);
+    std::string error;
+    for (size_t i = 0; i < nameCount; i += 3)
+        guard.addPolicy(L"service" + std::to_wstring(i) + L" memory 6GB for 1s cooldown 2s", error);
+    guard.addPolicy(L"service2* cpu 400", error);
+
+    ProcessManager pm(std::make_unique<ChurningSource>(processCount, nameCount));
+    pm.refreshProcessList();
+
+    // Ticks 100 ms apart on the guard's clock (10 Hz sampling)
+    auto clock = std::chrono::steady_clock::now();
+    double refreshMs = 0.0;
+    double updateMs = 0.0;
+    for (int tick = 0; tick < ticks; ++tick)
+    {
+        auto start = std::chrono::steady_clock::now();
+        pm.refreshProcessList();
+        refreshMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        clock += std::chrono::milliseconds(100);
+
+        start = std::chrono::steady_clock::now();
+        guard.update(pm, clock);
+        updateMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::vector<GuardStatus> status = guard.status();
+    size_t over = static_cast<size_t>(std::count_if(status.begin(), status.end(), [](const GuardStatus& group) { return group.over; }));
+    std::wcout << processCount << L" processes, " << nameCount << L" names, " << guard.policies().size() << L" policies, "
+        << ticks << L" ticks 100 ms apart (dry run)\n";
+    std::wcout << std::left << std::setw(44) << L"Operation" << L"ms\n";
+    std::wcout << std::wstring(54, L'-') << L"\n";
+    std::wcout << std::fixed << std::setprecision(3)
+        << std::setw(44) << L"refresh, per tick" << refreshMs / ticks << L"\n"
+        << std::setw(44) << L"guard update, per tick" << updateMs / ticks << L"\n";
+    std::wcout << L"Groups guarded: " << status.size() << L", over their caps: " << over
+        << L", actions that would have been taken: " << guard.actionCount() << L"\n";
+
+#ifdef _WIN32
+    std::wcout << L"The reaction time part forks its own test processes and only runs on Linux.\n";
+#else
+    // Reaction time on this host: from a hog being over its cap to it being gone, with the
+    // sampler at 10 Hz and the kill honouring the default grace (the hog dies on SIGTERM)
+    const int rounds = 10;
+    const size_t hogBytes = 64ULL * 1024 * 1024;
+    ProcessSampler sampler(std::chrono::milliseconds(100));
+    sampler.guard().addPolicy(L"tm-guard-hog memory 32MB for 0 cooldown 0 -> kill", error);
+    sampler.start();
+
+    std::vector<double> reactions;
+    size_t missed = 0;
+    size_t early = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        // A pipe per hog, so the read sees end-of-file if it is killed before it is ready
+        // (caught while still growing past the cap)
+        int ready[2];
+        if (pipe(ready) != 0)
+            break;
+        pid_t pid = spawnHog(hogBytes, ready[1]);
+        close(ready[1]);
+        char byte = 0;
+        bool started = pid > 0 && read(ready[0], &byte, 1) == 1;
+        close(ready[0]);
+        if (pid < 0)
+            break;
+        if (!started)
+        {
+            waitpid(pid, nullptr, 0);
+            ++early;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::seconds(5);
+        bool gone = false;
+        while (!gone && std::chrono::steady_clock::now() < deadline)
+        {
+            gone = waitpid(pid, nullptr, WNOHANG) == pid;
+            if (!gone)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (gone)
+        {
+            reactions.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        else
+        {
+            ++missed;
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    sampler.stop();
+
+    std::wcout << L"\nReaction time, " << hogBytes / (1024 * 1024) << L" MB hog against a 32 MB cap, sampling every 100 ms:\n";
+    if (reactions.empty())
+    {
+        std::wcout << L"No hog was killed once fully grown (" << early << L" while still growing, " << missed
+            << L" left after 5 s); is the sampler able to read their memory?\n";
+        return;
+    }
+    std::sort(reactions.begin(), reactions.end());
+    double total = 0.0;
+    for (double ms : reactions)
+        total += ms;
+    std::wcout << std::setw(44) << L"fastest, ms" << reactions.front() << L"\n"
+        << std::setw(44) << L"average, ms" << total / static_cast<double>(reactions.size()) << L"\n"
+        << std::setw(44) << L"slowest, ms" << reactions.back() << L"\n";
+    std::wcout << reactions.size() << L" of " << rounds << L" hogs killed once fully grown";
+    if (early > 0)
+        std::wcout << L", " << early << L" while still growing";
+    if (missed > 0)
+        std::wcout << L", " << missed << L" not within 5 s";
+    std::wcout << L"\n";
+#endif
+}
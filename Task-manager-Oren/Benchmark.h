@@ -0,0 +1,73 @@
+#pragma once
+
+// Times ProcessManager::refreshProcessList against the native snapshot source.
+// On Linux it also builds synthetic /proc trees from 500 to 50k PIDs to show how the walk scales.
+void runRefreshBenchmark();
+
+// Times a refresh with 1 to 8 collection threads, on a synthetic 50k-PID source and on the real system
+void runCollectionScalingBenchmark();
+
+// Compares sorting and grouping 20k rows as vector<ProcessInfo> against ProcessTable and ProcessSorter
+void runProcessTableBenchmark();
+
+// Compares the hash-based GroupingEngine with the std::map aggregation it replaced
+void runGroupingBenchmark();
+
+// Feeds MetricsHistory an hour of 1 Hz snapshots of 20k PIDs and reports memory and timings
+void runHistoryBenchmark();
+
+// Renders the live view for 2k name groups at several terminal sizes and compares it
+// with reprinting the whole table through iostreams
+void runLiveViewBenchmark();
+
+// Prints 100k process rows through the old wstringstream/setw path and through TextRow
+void runFormattingBenchmark();
+
+// Sorts and serializes a 20k-process snapshot in each headless output format, 60 times over
+void runExportBenchmark();
+
+// Records an hour of 1 Hz snapshots of 5k churning processes, then replays and seeks in it
+void runRecordingBenchmark();
+
+// Builds the metrics page for 20k processes, then has concurrent clients scrape the
+// endpoint over keep-alive connections while the sampler ticks once a second
+void runMetricsExporterBenchmark();
+
+// Searches a 50k-process table by name with the per-process lowercase scan the menu used
+// and with ProcessSearchIndex, and times keeping the index up to date under churn
+void runSearchBenchmark();
+
+// Evaluates filter expressions on a 50k-process table column by column and, for
+// comparison, as a hand-written predicate called once per process
+void runFilterBenchmark();
+
+// Builds the process tree with subtree totals for 50k processes in three shapes (typical
+// host, one parent with 40k children, a 50k-deep chain) and compares the totals with
+// walking up from every process
+void runProcessTreeBenchmark();
+
+// Ends 1000 child processes with the old serial kill loop and with ProcessTerminator:
+// forced only, honouring SIGTERM, and ignoring it until the grace period runs out (Linux)
+void runTerminationBenchmark();
+
+// Spawns and collects 10k short-lived processes (1k on Windows) one by one through launch()
+// and as batches of 1, 8 and 64 at a time, with the launcher's own CPU time per launch
+void runLaunchBenchmark();
+
+// Per-tick cost of each memory collection tier, on 10k synthetic processes and on this host:
+// counters only, plus the breakdown of the 20 largest, plus everyone's breakdown every tick,
+// and the default mix (top 20 every tick, everyone every 30th)
+void runMemoryDetailBenchmark();
+
+// "Top 20 by memory" on a 50k-process snapshot: sortByMemory + printProcessList against
+// printProcessPage, then the pieces (full radix sort, ProcessSorter::top with and without
+// the previous cutoff under churn, grouped views with and without a limit)
+void runTopNBenchmark();
+
+// 500 alert rules on 20k processes with churn: AlertEngine's update from each tick's delta
+// against every rule scanning every process
+void runAlertBenchmark();
+
+// The resource guard's per-tick cost with 100 policies on 20k churning processes (dry run),
+// then on Linux how long a forked 64 MB process over a 32 MB cap lives with 10 Hz sampling
+void runGuardBenchmark();
@@ -0,0 +1,600 @@
+#include "CommandLine.h"
+#include "AlertEngine.h"
+#include "MetricsExporter.h"
+#include "ProcessFilter.h"
+#include "ProcessLauncher.h"
+#include "ProcessManager.h"
+#include "SnapshotRecorder.h"
+#include "UserNames.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+const char* commandLineUsage()
+{
+    return
+        "Usage: Task-manager-Oren [options]\n"
+        "Without options the interactive menu starts.\n"
+        "\n"
+        "  --list                  One record per process (default)\n"
+        "  --group-by name|parent|user\n"
+        "                          One record per process name, parent PID or user instead\n"
+        "  --sort memory|cpu|name|pid\n"
+        "                          Record order (memory and cpu largest first; default memory)\n"
+        "  --top N                 Only the first N records of each snapshot\n"
+        "  --interval SECONDS      Time between snapshots (default 1, fractions allowed)\n"
+        "  --count N               Number of snapshots, 0 = until stopped\n"
+        "                          (default 1, or 0 when --interval is given)\n"
+        "  --format ndjson|csv|binary\n"
+        "                          Output format (default ndjson)\n"
+        "  --filter EXPRESSION     Only processes matching the expression, e.g.\n"
+        "                          --filter \"name=java* and memory>2GB and user=build\"\n"
+        "  --record FILE           Save the snapshots as a recording (see menu option 13)\n"
+        "                          instead of writing them to stdout (all processes, so\n"
+        "                          not with --filter)\n"
+        "  --serve [ADDRESS:]PORT  Serve Prometheus / OpenMetrics metrics at /metrics instead\n"
+        "                          (address defaults to 127.0.0.1; --top caps the number of\n"
+        "                          process names, default 20; --interval sets the sampling)\n"
+        "  --batch FILE            Run the commands in FILE (one per line, - = stdin) instead,\n"
+        "                          and report exit codes and resource usage\n"
+        "  --jobs N                Most batch commands running at once (default 16)\n"
+        "  --rules FILE            Check the alert rules in FILE (see menu option 21) on every\n"
+        "                          snapshot and log what fires to stderr; works with the\n"
+        "                          snapshot output and with --serve\n"
+        "  --guard FILE            Enforce the memory and CPU caps on process groups in FILE\n"
+        "                          (see menu option 22) instead, logging every decision to\n"
+        "                          stderr; checked every --interval (0.1 reacts within a\n"
+        "                          second) and combines with --rules\n"
+        "  --dry-run               Only log what --guard and --rules would do\n"
+        "  --cgroup-root DIR       Where --guard makes its cgroups (Linux; default\n"
+        "                          /sys/fs/cgroup/task-manager)\n"
+        "  --help                  Show this text\n"
+        "\n"
+        "CPU usage is measured between two snapshots, so it is 0 in the first one.\n";
+}
+
+// Parses a whole argument as an unsigned integer
+static bool parseUnsigned(const char* text, unsigned long long& value)
+{
+    const char* end = text + std::strlen(text);
+    std::from_chars_result result = std::from_chars(text, end, value);
+    return result.ec == std::errc() && result.ptr == end && result.ptr != text;
+}
+
+bool parseCommandLine(int argc, char* argv[], CommandLineOptions& options, std::string& error)
+{
+    options.headless = argc > 1;
+    bool listGiven = false, countGiven = false, intervalGiven = false, jobsGiven = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        bool needsValue = option == "--group-by" || option == "--sort" || option == "--top"
+            || option == "--interval" || option == "--count" || option == "--format" || option == "--record"
+            || option == "--serve" || option == "--filter" || option == "--batch" || option == "--jobs"
+            || option == "--rules" || option == "--guard" || option == "--cgroup-root";
+        if (needsValue && i + 1 >= argc)
+        {
+            error = option + " needs a value";
+            return false;
+        }
+        const char* value = needsValue ? argv[++i] : nullptr;
+
+        if (option == "--help" || option == "-h")
+        {
+            options.help = true;
+        }
+        else if (option == "--list")
+        {
+            listGiven = true;
+        }
+        else if (option == "--group-by")
+        {
+            options.grouped = true;
+            if (std::strcmp(value, "name") == 0)
+                options.groupBy = GroupBy::Name;
+            else if (std::strcmp(value, "parent") == 0)
+                options.groupBy = GroupBy::ParentPid;
+            else if (std::strcmp(value, "user") == 0)
+                options.groupBy = GroupBy::User;
+            else
+            {
+                error = std::string("unknown grouping '") + value + "'";
+                return false;
+            }
+        }
+        else if (option == "--sort")
+        {
+            if (std::strcmp(value, "memory") == 0)
+                options.sort = SortKey::Memory;
+            else if (std::strcmp(value, "cpu") == 0)
+                options.sort = SortKey::Cpu;
+            else if (std::strcmp(value, "name") == 0)
+                options.sort = SortKey::Name;
+            else if (std::strcmp(value, "pid") == 0)
+                options.sort = SortKey::Pid;
+            else
+            {
+                error = std::string("unknown sort key '") + value + "'";
+                return false;
+            }
+        }
+        else if (option == "--top")
+        {
+            unsigned long long top = 0;
+            if (!parseUnsigned(value, top) || top == 0)
+            {
+                error = "--top needs a positive number";
+                return false;
+            }
+            options.top = static_cast<size_t>(top);
+        }
+        else if (option == "--count")
+        {
+            if (!parseUnsigned(value, options.count))
+            {
+                error = "--count needs a number";
+                return false;
+            }
+            countGiven = true;
+        }
+        else if (option == "--interval")
+        {
+            char* end = nullptr;
+            double seconds = std::strtod(value, &end);
+            if (end == value || *end != '\0' || !(seconds >= 0.01 && seconds <= 86400.0))
+            {
+                error = "--interval needs a number of seconds between 0.01 and 86400";
+                return false;
+            }
+            options.interval = std::chrono::milliseconds(static_cast<long long>(seconds * 1000.0 + 0.5));
+            intervalGiven = true;
+        }
+        else if (option == "--format")
+        {
+            if (std::strcmp(value, "ndjson") == 0 || std::strcmp(value, "json") == 0)
+                options.format = ExportFormat::Ndjson;
+            else if (std::strcmp(value, "csv") == 0)
+                options.format = ExportFormat::Csv;
+            else if (std::strcmp(value, "binary") == 0)
+                options.format = ExportFormat::Binary;
+            else
+            {
+                error = std::string("unknown format '") + value + "'";
+                return false;
+            }
+        }
+        else if (option == "--record")
+        {
+            options.recordPath = value;
+        }
+        else if (option == "--filter")
+        {
+            // Checked here so a typo fails before anything is written
+            options.filter = toWide(value);
+            ProcessFilter filter;
+            std::string filterError;
+            if (!filter.compile(options.filter, filterError))
+            {
+                error = "--filter: " + filterError;
+                return false;
+            }
+        }
+        else if (option == "--rules")
+        {
+            options.rulesPath = value;
+        }
+        else if (option == "--guard")
+        {
+            options.guardPath = value;
+        }
+        else if (option == "--cgroup-root")
+        {
+            options.cgroupRoot = value;
+        }
+        else if (option == "--dry-run")
+        {
+            options.dryRun = true;
+        }
+        else if (option == "--serve")
+        {
+            std::string endpoint = value;
+            size_t colon = endpoint.rfind(':');
+            if (colon != std::string::npos)
+                options.serveAddress = endpoint.substr(0, colon);
+            unsigned long long port = 0;
+            if (!parseUnsigned(endpoint.c_str() + (colon == std::string::npos ? 0 : colon + 1), port)
+                || port > 65535 || options.serveAddress.empty())
+            {
+                error = "--serve needs [ADDRESS:]PORT";
+                return false;
+            }
+            options.servePort = static_cast<uint16_t>(port);
+            options.serve = true;
+        }
+        else if (option == "--batch")
+        {
+            options.batchPath = value;
+        }
+        else if (option == "--jobs")
+        {
+            unsigned long long jobs = 0;
+            if (!parseUnsigned(value, jobs) || jobs == 0 || jobs > 4096)
+            {
+                error = "--jobs needs a number from 1 to 4096";
+                return false;
+            }
+            options.jobs = static_cast<unsigned>(jobs);
+            jobsGiven = true;
+        }
+        else
+        {
+            error = "unknown option '" + option + "'";
+            return false;
+        }
+    }
+
+    if (listGiven && options.grouped)
+    {
+        error = "--list and --group-by cannot be combined";
+        return false;
+    }
+
+    if (options.serve && (options.grouped || listGiven || countGiven || !options.recordPath.empty() || !options.filter.empty()))
+    {
+        error = "--serve only combines with --top, --interval and --rules";
+        return false;
+    }
+
+    // Recordings keep every process; replay has no filter to apply later
+    if (!options.recordPath.empty() && !options.filter.empty())
+    {
+        error = "--record cannot be combined with --filter";
+        return false;
+    }
+
+    if (!options.guardPath.empty() && (options.serve || !options.batchPath.empty() || options.grouped || listGiven
+        || countGiven || options.top || !options.recordPath.empty() || !options.filter.empty()))
+    {
+        error = "--guard only combines with --interval, --rules, --dry-run and --cgroup-root";
+        return false;
+    }
+    if (!options.cgroupRoot.empty() && options.guardPath.empty())
+    {
+        error = "--cgroup-root only applies to --guard";
+        return false;
+    }
+    if (options.dryRun && options.guardPath.empty() && options.rulesPath.empty())
+    {
+        error = "--dry-run only applies to --guard and --rules";
+        return false;
+    }
+
+    if (jobsGiven && options.batchPath.empty())
+    {
+        error = "--jobs only applies to --batch";
+        return false;
+    }
+    if (!options.batchPath.empty() && argc != (jobsGiven ? 5 : 3))
+    {
+        error = "--batch only combines with --jobs";
+        return false;
+    }
+
+    // An interval alone means "keep streaming"
+    if (intervalGiven && !countGiven)
+        options.count = 0;
+
+    return true;
+}
+
+// Group order for the requested sort key: sums largest first, names alphabetically,
+// parent groups by PID, user groups by user ID
+static void orderGroups(const GroupingEngine& groups, const CommandLineOptions& options,
+    const std::vector<uint32_t>& nameIds, const NamePool& names, std::vector<uint32_t>& order)
+{
+    // With --top only that many groups need ordering
+    size_t limit = options.top ? options.top : GroupingEngine::NoLimit;
+    switch (options.sort)
+    {
+    case SortKey::Cpu:
+        groups.orderBySum(1, order, limit);
+        break;
+    case SortKey::Name:
+    case SortKey::Pid:
+        if (options.groupBy == GroupBy::Name && options.sort == SortKey::Name)
+        {
+            groups.orderByName(names, order, limit);
+            break;
+        }
+        order.resize(groups.groupCount());
+        for (uint32_t group = 0; group < order.size(); ++group)
+            order[group] = group;
+        if (options.sort == SortKey::Name && options.groupBy == GroupBy::User)
+        {
+            // Each account name is looked up once rather than on every comparison
+            std::vector<std::wstring> labels(groups.groupCount());
+            for (uint32_t group = 0; group < labels.size(); ++group)
+                labels[group] = userName(static_cast<uint32_t>(groups.key(group)));
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                {
+                    return labels[a] < labels[b];
+                });
+        }
+        else if (options.sort == SortKey::Name)
+        {
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                {
+                    return names.lower(nameIds[a]) < names.lower(nameIds[b]);
+                });
+        }
+        else
+        {
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                {
+                    return groups.key(a) < groups.key(b);
+                });
+        }
+        break;
+    default:
+        groups.orderBySum(0, order, limit);
+        break;
+    }
+}
+
+// Loads --rules, if given, with the log going to stderr; false (with a message) if it cannot
+static bool loadAlertRules(const CommandLineOptions& options, AlertEngine& alerts)
+{
+    if (options.rulesPath.empty())
+        return true;
+    std::string error;
+    if (!alerts.loadRules(options.rulesPath, error))
+    {
+        std::fprintf(stderr, "Cannot load the alert rules: %s.\n", error.c_str());
+        return false;
+    }
+    alerts.setLogSink([](const std::wstring& line)
+        {
+            std::fprintf(stderr, "%s\n", toNarrow(line).c_str());
+        });
+    alerts.setActionsEnabled(!options.dryRun);
+    return true;
+}
+
+int runHeadless(const CommandLineOptions& options)
+{
+#ifdef _WIN32
+    // No newline translation: the binary format must pass through untouched, and the
+    // text formats use plain \n like everywhere else
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    const NamePool& names = processNames();
+    ProcessManager pm;
+    SnapshotWriter writer(options.format);
+
+    SortOrder fields = { { SortKey::Accessible, false } };
+    switch (options.sort)
+    {
+    case SortKey::Cpu:
+        fields.push_back({ SortKey::Cpu, true });
+        fields.push_back({ SortKey::Memory, true });
+        break;
+    case SortKey::Name:
+        fields.push_back({ SortKey::Name, false });
+        fields.push_back({ SortKey::Pid, false });
+        break;
+    case SortKey::Pid:
+        fields = { { SortKey::Pid, false } };
+        break;
+    default:
+        fields.push_back({ SortKey::Memory, true });
+        break;
+    }
+
+    // Everything below is reused from tick to tick, so memory stays flat while streaming
+    ProcessSorter sorter;
+    GroupingEngine groups;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> nameIds;
+    ProcessFilter filter;
+    std::vector<uint32_t> selected;
+    std::vector<uint8_t> mask;
+    std::string filterError;
+    filter.compile(options.filter, filterError);    // Already checked by parseCommandLine
+
+    AlertEngine alerts;
+    if (!loadAlertRules(options, alerts))
+        return 1;
+
+    SnapshotRecorder recorder;
+    if (!options.recordPath.empty() && !recorder.open(options.recordPath))
+    {
+        std::fprintf(stderr, "Cannot create %s.\n", options.recordPath.c_str());
+        return 1;
+    }
+
+    auto nextTick = std::chrono::steady_clock::now();
+    for (unsigned long long tick = 1; options.count == 0 || tick <= options.count; ++tick)
+    {
+        if (!pm.refreshProcessList())
+        {
+            std::fprintf(stderr, "Failed to refresh process list.\n");
+            return 1;
+        }
+        long long unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        alerts.update(pm, std::chrono::steady_clock::now());
+
+        const ProcessTable& table = pm.getProcessTable();
+        if (recorder.isOpen())
+        {
+            // Everything is recorded; sorting, grouping and --top apply when it is replayed
+            if (!recorder.append(pm.getProcessList(), unixMs))
+            {
+                std::fprintf(stderr, "Writing %s failed.\n", options.recordPath.c_str());
+                return 1;
+            }
+        }
+        else if (!options.grouped)
+        {
+            // With --top and no filter only the first rows need ordering
+            sorter.invalidate();
+            const std::vector<uint32_t>* rows;
+            if (options.top && filter.matchesAll())
+            {
+                rows = &sorter.top(table, names, fields, options.top);
+            }
+            else
+            {
+                rows = &sorter.order(table, names, fields);
+                if (!filter.matchesAll())
+                {
+                    filter.select(table, names, *rows, selected);
+                    rows = &selected;
+                }
+            }
+            size_t count = options.top ? options.top : rows->size();
+            writer.writeProcesses(table, names, *rows, count, tick, unixMs);
+        }
+        else
+        {
+            // Every process counts as an instance; unreadable ones just add no memory
+            if (!filter.matchesAll())
+                filter.evaluate(table, names, mask);
+            groups.group(table, names, options.groupBy, { Metric::Memory, Metric::Cpu }, true, nullptr,
+                filter.matchesAll() ? nullptr : &mask);
+
+            nameIds.resize(groups.groupCount());
+            for (uint32_t group = 0; group < groups.groupCount(); ++group)
+            {
+                if (options.groupBy == GroupBy::Name)
+                {
+                    nameIds[group] = static_cast<uint32_t>(groups.key(group));
+                }
+                else if (options.groupBy == GroupBy::User)
+                {
+                    nameIds[group] = 0;    // Labelled by the account name instead
+                }
+                else
+                {
+                    const ProcessInfo* parent = pm.findProcess(static_cast<DWORD>(groups.key(group)));
+                    nameIds[group] = parent ? parent->nameId : 0;
+                }
+            }
+
+            orderGroups(groups, options, nameIds, names, order);
+            size_t count = options.top ? options.top : order.size();
+            writer.writeGroups(groups, options.groupBy, order, nameIds, names, count, tick, unixMs);
+        }
+
+        if (!recorder.isOpen() && !writer.flush(stdout))
+            return 1;    // Reader went away (e.g. the pipe was closed)
+
+        if (options.count != 0 && tick == options.count)
+            break;
+
+        // Ticks stay on a fixed schedule; a slow refresh skips ahead instead of bunching up
+        nextTick += options.interval;
+        auto now = std::chrono::steady_clock::now();
+        if (nextTick < now)
+            nextTick = now;
+        std::this_thread::sleep_until(nextTick);
+    }
+
+    if (recorder.isOpen() && !recorder.close())
+    {
+        std::fprintf(stderr, "Writing %s failed.\n", options.recordPath.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int runMetricsServer(const CommandLineOptions& options)
+{
+    ProcessSampler sampler(options.interval);
+    sampler.setCollectionThreads(std::thread::hardware_concurrency());
+    if (!loadAlertRules(options, sampler.alerts()))
+        return 1;
+    sampler.start();
+
+    MetricsExporter exporter(sampler, options.top ? options.top : MetricsExporter::DefaultTopGroups);
+    std::string error;
+    if (!exporter.start(options.serveAddress, options.servePort, error))
+    {
+        std::fprintf(stderr, "Cannot serve metrics: %s.\n", error.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "Serving metrics at http://%s:%u/metrics\n",
+        options.serveAddress.c_str(), static_cast<unsigned>(exporter.port()));
+
+    // Runs until the process is killed; the threads do all the work
+    for (;;)
+        std::this_thread::sleep_for(std::chrono::hours(1));
+}
+
+int runBatchCommands(const CommandLineOptions& options)
+{
+    std::vector<std::wstring> commands;
+    if (!ProcessLauncher::readBatchFile(options.batchPath, commands))
+    {
+        std::fprintf(stderr, "Cannot read %s.\n", options.batchPath.c_str());
+        return 1;
+    }
+
+    // The commands write to our stdout and stderr; the report goes to stderr after them
+    BatchOptions batchOptions;
+    batchOptions.concurrency = options.jobs;
+    ProcessLauncher launcher;
+    std::vector<LaunchResult> results = launcher.runBatch(commands, batchOptions);
+    std::fputs(toNarrow(ProcessLauncher::describeBatch(results)).c_str(), stderr);
+
+    bool allSucceeded = std::all_of(results.begin(), results.end(),
+        [](const LaunchResult& result) { return result.exited && result.exitCode == 0 && result.signal == 0; });
+    return allSucceeded ? 0 : 1;
+}
+
+int runGuard(const CommandLineOptions& options)
+{
+    ProcessSampler sampler(options.interval);
+    sampler.setCollectionThreads(std::thread::hardware_concurrency());
+    if (!loadAlertRules(options, sampler.alerts()))
+        return 1;
+
+    ResourceGuard& guard = sampler.guard();
+    std::string error;
+    if (!guard.loadPolicies(options.guardPath, error))
+    {
+        std::fprintf(stderr, "Cannot load the guard policies: %s.\n", error.c_str());
+        return 1;
+    }
+    if (guard.policies().empty())
+    {
+        std::fprintf(stderr, "%s has no guard policies.\n", options.guardPath.c_str());
+        return 1;
+    }
+    guard.setLogSink([](const std::wstring& line)
+        {
+            std::fprintf(stderr, "%s\n", toNarrow(line).c_str());
+        });
+    guard.setActionsEnabled(!options.dryRun);
+    if (!options.cgroupRoot.empty())
+        guard.setCgroupRoot(options.cgroupRoot);
+
+    std::fprintf(stderr, "Guarding %zu policies every %lld ms%s\n", guard.policies().size(),
+        static_cast<long long>(options.interval.count()), options.dryRun ? " (dry run)" : "");
+    sampler.start();
+
+    // Runs until the process is killed; the sampler thread does all the work
+    for (;;)
+        std::this_thread::sleep_for(std::chrono::hours(1));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "GroupingEngine.h"
+#include "ProcessSorter.h"
+#include "SnapshotWriter.h"
+
+// Settings of the non-interactive mode, filled from the program arguments
+struct CommandLineOptions
+{
+    bool headless = false;                       // Any argument was given
+    bool help = false;
+    bool grouped = false;                        // --group-by given (otherwise --list)
+    GroupBy groupBy = GroupBy::Name;
+    SortKey sort = SortKey::Memory;              // Memory and Cpu sort largest first
+    size_t top = 0;                              // 0 = every row
+    std::chrono::milliseconds interval{ 1000 };
+    unsigned long long count = 1;                // Snapshots to emit, 0 = until stopped
+    ExportFormat format = ExportFormat::Ndjson;
+    std::string recordPath;                      // --record: write a recording instead of stdout
+    std::wstring filter;                         // --filter: only processes matching this expression
+    bool serve = false;                          // --serve: run the metrics endpoint instead
+    std::string serveAddress = "127.0.0.1";
+    uint16_t servePort = 0;
+    std::string batchPath;                       // --batch: run the commands in this file ("-" = stdin) instead
+    unsigned jobs = 16;                          // --jobs: most batch commands running at once
+    std::string rulesPath;                       // --rules: alert rules checked on every snapshot
+    std::string guardPath;                       // --guard: enforce the policies in this file instead
+    std::string cgroupRoot;                      // --cgroup-root: where --guard makes its cgroups (empty = default)
+    bool dryRun = false;                         // --dry-run: --guard and --rules only log what they would do
+};
+
+// Parses argv into options. Returns false with a message in error on a bad argument.
+bool parseCommandLine(int argc, char* argv[], CommandLineOptions& options, std::string& error);
+
+// Usage text for --help and argument errors
+const char* commandLineUsage();
+
+// Streams snapshots to stdout as described by options; returns the process exit code
+int runHeadless(const CommandLineOptions& options);
+
+// Samples every interval and serves the metrics page until the process is stopped
+int runMetricsServer(const CommandLineOptions& options);
+
+// Runs the commands of --batch and reports how they went; the exit code is 1 if any failed
+int runBatchCommands(const CommandLineOptions& options);
+
+// Samples every interval and enforces the --guard policies until the process is stopped
+int runGuard(const CommandLineOptions& options);
@@ -0,0 +1,211 @@
+#include "Format.h"
+
+#include <atomic>
+#include <charconv>
+
+// Divisor and suffix of each unit, indexed by MemoryUnit (Auto resolves to MB or GB)
+struct UnitInfo
+{
+    unsigned long long divisor;
+    const wchar_t* suffix;
+    size_t suffixLength;
+    bool decimals;
+};
+
+static constexpr UnitInfo UnitTable[] = {
+    { 1ULL << 20, L" MB", 3, true },    // Auto
+    { 1ULL << 10, L" KB", 3, true },
+    { 1ULL << 20, L" MB", 3, true },
+    { 1ULL << 30, L" GB", 3, true },
+    { 1ULL, L" B", 2, false },
+};
+
+static_assert(sizeof(UnitTable) / sizeof(UnitTable[0]) == static_cast<size_t>(MemoryUnit::Bytes) + 1,
+    "UnitTable needs one entry per MemoryUnit");
+
+static std::atomic<MemoryUnit> currentUnit{ MemoryUnit::Auto };
+
+MemoryUnit displayMemoryUnit()
+{
+    return currentUnit.load(std::memory_order_relaxed);
+}
+
+void setDisplayMemoryUnit(MemoryUnit unit)
+{
+    currentUnit.store(unit, std::memory_order_relaxed);
+}
+
+// Copies ASCII into a wide buffer, as much as fits
+static size_t widen(wchar_t* out, size_t capacity, const char* text, size_t length)
+{
+    size_t count = length < capacity ? length : capacity;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = static_cast<wchar_t>(text[i]);
+    return count;
+}
+
+static size_t append(wchar_t* out, size_t capacity, size_t used, const wchar_t* text, size_t length)
+{
+    size_t count = used + length <= capacity ? length : capacity - used;
+    for (size_t i = 0; i < count; ++i)
+        out[used + i] = text[i];
+    return used + count;
+}
+
+// whole.fraction with exactly two decimals
+static size_t formatFixed2(wchar_t* out, size_t capacity, unsigned long long whole, unsigned hundredths)
+{
+    char text[32];
+    char* end = std::to_chars(text, text + sizeof(text) - 3, whole).ptr;
+    *end++ = '.';
+    *end++ = static_cast<char>('0' + hundredths / 10);
+    *end++ = static_cast<char>('0' + hundredths % 10);
+    return widen(out, capacity, text, static_cast<size_t>(end - text));
+}
+
+size_t formatUnsigned(wchar_t* out, size_t capacity, unsigned long long value)
+{
+    char text[24];
+    char* end = std::to_chars(text, text + sizeof(text), value).ptr;
+    return widen(out, capacity, text, static_cast<size_t>(end - text));
+}
+
+size_t formatSigned(wchar_t* out, size_t capacity, long long value)
+{
+    char text[24];
+    char* end = std::to_chars(text, text + sizeof(text), value).ptr;
+    return widen(out, capacity, text, static_cast<size_t>(end - text));
+}
+
+size_t formatMemory(wchar_t* out, size_t capacity, unsigned long long bytes, MemoryUnit unit)
+{
+    if (unit == MemoryUnit::Auto && bytes >= (1ULL << 30))
+        unit = MemoryUnit::GB;
+    const UnitInfo& info = UnitTable[static_cast<size_t>(unit)];
+
+    size_t length;
+    if (info.decimals)
+    {
+        // Round to hundredths in integers; the remainder times 100 cannot overflow
+        unsigned long long whole = bytes / info.divisor;
+        unsigned long long hundredths = ((bytes % info.divisor) * 100 + info.divisor / 2) / info.divisor;
+        if (hundredths == 100)
+        {
+            ++whole;
+            hundredths = 0;
+        }
+        length = formatFixed2(out, capacity, whole, static_cast<unsigned>(hundredths));
+    }
+    else
+    {
+        length = formatUnsigned(out, capacity, bytes);
+    }
+    return append(out, capacity, length, info.suffix, info.suffixLength);
+}
+
+size_t formatMemoryChange(wchar_t* out, size_t capacity, long long change, MemoryUnit unit)
+{
+    if (capacity == 0)
+        return 0;
+
+    if (change == 0)
+    {
+        const UnitInfo& info = UnitTable[static_cast<size_t>(unit)];
+        size_t length = widen(out, capacity, "0", 1);
+        return append(out, capacity, length, info.suffix, info.suffixLength);
+    }
+
+    out[0] = change > 0 ? L'+' : L'-';
+    unsigned long long magnitude = change > 0
+        ? static_cast<unsigned long long>(change)
+        : 0ULL - static_cast<unsigned long long>(change);
+    return 1 + formatMemory(out + 1, capacity - 1, magnitude, unit);
+}
+
+size_t formatCpu(wchar_t* out, size_t capacity, long long hundredthsOfPercent)
+{
+    size_t length = 0;
+    unsigned long long magnitude = static_cast<unsigned long long>(hundredthsOfPercent);
+    if (hundredthsOfPercent < 0)
+    {
+        length = append(out, capacity, 0, L"-", 1);
+        magnitude = 0ULL - magnitude;
+    }
+    length += formatFixed2(out + length, capacity - length, magnitude / 100, static_cast<unsigned>(magnitude % 100));
+    return append(out, capacity, length, L"%", 1);
+}
+
+TextRow& TextRow::clear()
+{
+    length = 0;
+    return *this;
+}
+
+TextRow& TextRow::field(const wchar_t* value, size_t valueLength, int width, Align align)
+{
+    size_t padding = width > 0 && static_cast<size_t>(width) > valueLength ? static_cast<size_t>(width) - valueLength : 0;
+    if (align == Align::Right)
+        repeat(L' ', static_cast<int>(padding));
+    length = append(buffer, Capacity, length, value, valueLength);
+    if (align == Align::Left)
+        repeat(L' ', static_cast<int>(padding));
+    return *this;
+}
+
+TextRow& TextRow::text(const wchar_t* value, size_t valueLength, int width, Align align)
+{
+    return field(value, valueLength, width, align);
+}
+
+TextRow& TextRow::text(const std::wstring& value, int width, Align align)
+{
+    return field(value.data(), value.size(), width, align);
+}
+
+TextRow& TextRow::number(unsigned long long value, int width, Align align)
+{
+    wchar_t digits[24];
+    return field(digits, formatUnsigned(digits, 24, value), width, align);
+}
+
+TextRow& TextRow::memory(unsigned long long bytes, int width, MemoryUnit unit)
+{
+    wchar_t text[40];
+    return field(text, formatMemory(text, 40, bytes, unit), width, Align::Left);
+}
+
+TextRow& TextRow::memoryChange(long long change, int width, MemoryUnit unit)
+{
+    wchar_t text[40];
+    return field(text, formatMemoryChange(text, 40, change, unit), width, Align::Left);
+}
+
+TextRow& TextRow::cpu(long long hundredthsOfPercent, int width)
+{
+    wchar_t text[32];
+    return field(text, formatCpu(text, 32, hundredthsOfPercent), width, Align::Left);
+}
+
+TextRow& TextRow::repeat(wchar_t ch, int count)
+{
+    for (int i = 0; i < count && length < Capacity; ++i)
+        buffer[length++] = ch;
+    return *this;
+}
+
+const wchar_t* TextRow::data() const
+{
+    return buffer;
+}
+
+size_t TextRow::size() const
+{
+    return length;
+}
+
+void TextRow::print(std::wostream& out)
+{
+    repeat(L'\n', 1);
+    out.write(buffer, static_cast<std::streamsize>(length));
+    length = 0;
+}
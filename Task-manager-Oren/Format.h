@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Units memory values can be shown in
+enum class MemoryUnit
+{
+    Auto,     // MB, or GB from 1 GB up
+    KB,
+    MB,
+    GB,
+    Bytes     // Raw byte count
+};
+
+// Unit used by the tables unless a printer asks for a specific one
+MemoryUnit displayMemoryUnit();
+void setDisplayMemoryUnit(MemoryUnit unit);
+
+// Number formatting into caller buffers. Each function writes at most capacity characters
+// (no terminator) and returns how many it wrote; nothing touches the heap.
+
+// "1.50 MB", "2.00 GB", "12 B" ...
+size_t formatMemory(wchar_t* out, size_t capacity, unsigned long long bytes, MemoryUnit unit = displayMemoryUnit());
+
+// Signed change: "+1.50 MB", "-12.00 KB", zero as "0 MB"
+size_t formatMemoryChange(wchar_t* out, size_t capacity, long long change, MemoryUnit unit = displayMemoryUnit());
+
+// CPU usage from hundredths of a percent: 1234 -> "12.34%"
+size_t formatCpu(wchar_t* out, size_t capacity, long long hundredthsOfPercent);
+
+// Plain integers
+size_t formatUnsigned(wchar_t* out, size_t capacity, unsigned long long value);
+size_t formatSigned(wchar_t* out, size_t capacity, long long value);
+
+// Builds one line of a table in a fixed buffer: each field is padded to its width like
+// std::setw (longer text is not cut). Written out with a single stream write.
+class TextRow
+{
+public:
+    enum class Align { Left, Right };
+
+    // Empties the line
+    TextRow& clear();
+
+    TextRow& text(const wchar_t* value, size_t length, int width = 0, Align align = Align::Left);
+    template <size_t N>
+    TextRow& text(const wchar_t (&literal)[N], int width = 0, Align align = Align::Left)
+    {
+        return field(literal, N - 1, width, align);
+    }
+    TextRow& text(const std::wstring& value, int width = 0, Align align = Align::Left);
+    TextRow& number(unsigned long long value, int width = 0, Align align = Align::Left);
+    TextRow& memory(unsigned long long bytes, int width = 0, MemoryUnit unit = displayMemoryUnit());
+    TextRow& memoryChange(long long change, int width = 0, MemoryUnit unit = displayMemoryUnit());
+    TextRow& cpu(long long hundredthsOfPercent, int width = 0);
+
+    // count copies of ch
+    TextRow& repeat(wchar_t ch, int count);
+
+    const wchar_t* data() const;
+    size_t size() const;
+
+    // Writes the line plus a newline and empties it
+    void print(std::wostream& out);
+
+private:
+    static constexpr size_t Capacity = 1024;
+
+    // Appends text padded to width
+    TextRow& field(const wchar_t* value, size_t length, int width, Align align);
+
+    wchar_t buffer[Capacity];
+    size_t length = 0;
+};
@@ -0,0 +1,228 @@
+#include "GroupingEngine.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Value of one metric for one row
+static long long metricValue(const ProcessTable& table, uint32_t row, Metric metric)
+{
+    bool isNew = (table.flags[row] & ProcessTable::IsNew) != 0;
+    switch (metric)
+    {
+    case Metric::Memory:
+        return static_cast<long long>(table.memory[row]);
+    case Metric::MemoryChange:
+        return isNew ? static_cast<long long>(table.memory[row]) : table.memoryDelta[row];
+    case Metric::PreviouslySeen:
+        return isNew ? 0 : 1;
+    case Metric::Cpu:
+        return table.cpu[row];
+    case Metric::Proportional:
+        return static_cast<long long>(table.proportional[row]);
+    case Metric::Unique:
+        return static_cast<long long>(table.unique[row]);
+    case Metric::Swap:
+        return static_cast<long long>(table.swap[row]);
+    case Metric::HasDetail:
+        return (table.flags[row] & ProcessTable::HasDetail) ? 1 : 0;
+    case Metric::Threads:
+        return table.threads[row];
+    case Metric::Handles:
+        return table.handles[row];
+    case Metric::ReadRate:
+        return static_cast<long long>(table.readRate[row]);
+    case Metric::WriteRate:
+        return static_cast<long long>(table.writeRate[row]);
+    case Metric::IoOps:
+        return static_cast<long long>(table.ioOpsRate[row]);
+    case Metric::ContextSwitches:
+        return static_cast<long long>(table.switchRate[row]);
+    }
+    return 0;
+}
+
+size_t GroupingEngine::slotOf(uint64_t key) const
+{
+    // Fibonacci hashing spreads sequential IDs and PIDs over the whole table
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) & slotMask;
+}
+
+void GroupingEngine::grow()
+{
+    size_t capacity = slotGroup.empty() ? 64 : slotGroup.size() * 2;
+    slotGroup.assign(capacity, NotFound);
+    slotMask = capacity - 1;
+
+    for (uint32_t group = 0; group < groupKeys.size(); ++group)
+    {
+        size_t slot = slotOf(groupKeys[group]);
+        while (slotGroup[slot] != NotFound)
+            slot = (slot + 1) & slotMask;
+        slotGroup[slot] = group;
+    }
+}
+
+uint32_t GroupingEngine::findOrAdd(uint64_t key)
+{
+    size_t slot = slotOf(key);
+    while (slotGroup[slot] != NotFound)
+    {
+        uint32_t group = slotGroup[slot];
+        if (groupKeys[group] == key)
+            return group;
+        slot = (slot + 1) & slotMask;
+    }
+
+    uint32_t group = static_cast<uint32_t>(groupKeys.size());
+    slotGroup[slot] = group;
+    groupKeys.push_back(key);
+    groupCounts.push_back(0);
+    groupStats.resize(groupStats.size() + metricCount);
+
+    // Keep the load factor at or below one half so probe runs stay short
+    if (groupKeys.size() * 2 > slotGroup.size())
+        grow();
+    return group;
+}
+
+void GroupingEngine::group(const ProcessTable& table, const NamePool& names, GroupBy by,
+    const std::vector<Metric>& metrics, bool includeInaccessible,
+    const std::function<uint64_t(uint32_t row)>& customKey, const std::vector<uint8_t>* rowMask)
+{
+    groupKeys.clear();
+    groupCounts.clear();
+    groupStats.clear();
+    metricCount = metrics.size();
+    if (slotGroup.empty())
+        grow();
+    else
+        std::fill(slotGroup.begin(), slotGroup.end(), NotFound);
+
+    for (uint32_t row = 0; row < table.size(); ++row)
+    {
+        if (!includeInaccessible && !table.accessible(row))
+            continue;
+        if (rowMask && !(*rowMask)[row])
+            continue;
+
+        uint64_t rowKey = 0;
+        switch (by)
+        {
+        case GroupBy::Name:
+            rowKey = table.nameId[row];
+            break;
+        case GroupBy::FoldedName:
+            rowKey = names.foldedId(table.nameId[row]);
+            break;
+        case GroupBy::ParentPid:
+            rowKey = table.parentPid[row];
+            break;
+        case GroupBy::User:
+            rowKey = table.user[row];
+            break;
+        case GroupBy::Custom:
+            rowKey = customKey ? customKey(row) : 0;
+            break;
+        }
+
+        uint32_t group = findOrAdd(rowKey);
+        bool first = groupCounts[group]++ == 0;
+
+        MetricStats* stats = &groupStats[group * metricCount];
+        for (size_t m = 0; m < metricCount; ++m)
+        {
+            long long value = metricValue(table, row, metrics[m]);
+            stats[m].sum += value;
+            if (first || value < stats[m].min)
+                stats[m].min = value;
+            if (first || value > stats[m].max)
+                stats[m].max = value;
+        }
+    }
+}
+
+uint32_t GroupingEngine::groupCount() const
+{
+    return static_cast<uint32_t>(groupKeys.size());
+}
+
+uint64_t GroupingEngine::key(uint32_t group) const
+{
+    return groupKeys[group];
+}
+
+uint32_t GroupingEngine::count(uint32_t group) const
+{
+    return groupCounts[group];
+}
+
+const MetricStats& GroupingEngine::stats(uint32_t group, size_t metricIndex) const
+{
+    return groupStats[group * metricCount + metricIndex];
+}
+
+uint32_t GroupingEngine::find(uint64_t key) const
+{
+    if (slotGroup.empty())
+        return NotFound;
+
+    size_t slot = slotOf(key);
+    while (slotGroup[slot] != NotFound)
+    {
+        uint32_t group = slotGroup[slot];
+        if (groupKeys[group] == key)
+            return group;
+        slot = (slot + 1) & slotMask;
+    }
+    return NotFound;
+}
+
+// Sorts all of order, or just enough of it for its first limit entries, and drops the rest
+template <typename Before>
+static void orderFirst(std::vector<uint32_t>& order, size_t limit, Before before)
+{
+    if (limit < order.size())
+    {
+        std::partial_sort(order.begin(), order.begin() + limit, order.end(), before);
+        order.resize(limit);
+    }
+    else
+    {
+        std::sort(order.begin(), order.end(), before);
+    }
+}
+
+void GroupingEngine::orderBySum(size_t metricIndex, std::vector<uint32_t>& order, size_t limit) const
+{
+    order.resize(groupCount());
+    std::iota(order.begin(), order.end(), 0u);
+    orderFirst(order, limit, [this, metricIndex](uint32_t a, uint32_t b)
+        {
+            long long sumA = stats(a, metricIndex).sum;
+            long long sumB = stats(b, metricIndex).sum;
+            return sumA != sumB ? sumA > sumB : a < b;
+        });
+}
+
+void GroupingEngine::orderBySums(size_t firstMetric, size_t secondMetric, std::vector<uint32_t>& order, size_t limit) const
+{
+    order.resize(groupCount());
+    std::iota(order.begin(), order.end(), 0u);
+    orderFirst(order, limit, [this, firstMetric, secondMetric](uint32_t a, uint32_t b)
+        {
+            long long sumA = stats(a, firstMetric).sum + stats(a, secondMetric).sum;
+            long long sumB = stats(b, firstMetric).sum + stats(b, secondMetric).sum;
+            return sumA != sumB ? sumA > sumB : a < b;
+        });
+}
+
+void GroupingEngine::orderByName(const NamePool& names, std::vector<uint32_t>& order, size_t limit) const
+{
+    order.resize(groupCount());
+    std::iota(order.begin(), order.end(), 0u);
+    orderFirst(order, limit, [this, &names](uint32_t a, uint32_t b)
+        {
+            int compared = names.lower(static_cast<uint32_t>(groupKeys[a])).compare(names.lower(static_cast<uint32_t>(groupKeys[b])));
+            return compared != 0 ? compared < 0 : a < b;
+        });
+}
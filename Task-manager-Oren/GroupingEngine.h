@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "NamePool.h"
+#include "ProcessTable.h"
+
+// What rows are grouped by
+enum class GroupBy
+{
+    Name,          // Exact (case-sensitive) name
+    FoldedName,    // Name ignoring case
+    ParentPid,
+    User,          // Owner's user ID (ProcessTable::user)
+    Custom         // Key computed by a caller-supplied function
+};
+
+// Per-row values the engine can aggregate
+enum class Metric
+{
+    Memory,          // Working set in bytes
+    MemoryChange,    // Memory gained since the previous refresh (all of it for new processes)
+    PreviouslySeen,  // 1 if the process was already there at the previous refresh, else 0
+    Cpu,             // CPU usage in hundredths of a percent of one core
+    Proportional,    // Proportional set size in bytes (0 without a memory breakdown)
+    Unique,          // Memory no other process shares, in bytes (same)
+    Swap,            // Swapped-out bytes (same)
+    HasDetail,       // 1 if the process has a memory breakdown, else 0
+    Threads,
+    Handles,         // Open file descriptors / handles
+    ReadRate,        // Bytes read per second
+    WriteRate,       // Bytes written per second
+    IoOps,           // Read and write calls per second
+    ContextSwitches  // Context switches per second
+};
+
+// Count, sum, min and max of one metric over a group
+struct MetricStats
+{
+    long long sum = 0;
+    long long min = 0;
+    long long max = 0;
+
+    // Average over the group's instance count
+    double mean(uint32_t count) const { return count ? static_cast<double>(sum) / count : 0.0; }
+};
+
+// Aggregates the rows of a ProcessTable in a single pass. Groups are found through an
+// open-addressing hash table keyed by a 64-bit key (name ID, parent PID, user ID, ...), and
+// all per-group numbers live in flat arrays that are reused from one call to the next.
+class GroupingEngine
+{
+public:
+    // Sentinel returned by find when a key has no group
+    static constexpr uint32_t NotFound = 0xFFFFFFFFu;
+
+    // Groups the rows of table and accumulates the given metrics. Inaccessible rows are
+    // skipped unless includeInaccessible is set. customKey is only used with GroupBy::Custom.
+    // If rowMask is given, rows whose byte in it is zero are skipped too (see ProcessFilter).
+    void group(const ProcessTable& table, const NamePool& names, GroupBy by,
+        const std::vector<Metric>& metrics, bool includeInaccessible = false,
+        const std::function<uint64_t(uint32_t row)>& customKey = nullptr,
+        const std::vector<uint8_t>* rowMask = nullptr);
+
+    // Number of groups from the last call
+    uint32_t groupCount() const;
+
+    // Key of a group: the name ID for the name groupings, the PID for ParentPid, the user ID for User
+    uint64_t key(uint32_t group) const;
+
+    // Number of rows in a group
+    uint32_t count(uint32_t group) const;
+
+    // Stats of the metricIndex-th metric passed to group()
+    const MetricStats& stats(uint32_t group, size_t metricIndex) const;
+
+    // Group holding key, or NotFound
+    uint32_t find(uint64_t key) const;
+
+    // Group numbers ordered by a metric's sum, largest first. With a limit only the first
+    // limit groups are produced (partial_sort); ties go to the lower group number either
+    // way, so a limited order is always the start of the full one.
+    void orderBySum(size_t metricIndex, std::vector<uint32_t>& order, size_t limit = NoLimit) const;
+
+    // Same, by the sum of two metrics together (e.g. bytes read plus bytes written)
+    void orderBySums(size_t firstMetric, size_t secondMetric, std::vector<uint32_t>& order, size_t limit = NoLimit) const;
+
+    // Group numbers ordered by lowercase name (name groupings only), limited the same way
+    void orderByName(const NamePool& names, std::vector<uint32_t>& order, size_t limit = NoLimit) const;
+
+    // No limit for the orders above
+    static constexpr size_t NoLimit = ~size_t(0);
+
+private:
+    // Returns the group for key, creating it (and growing the hash table) if needed
+    uint32_t findOrAdd(uint64_t key);
+
+    // Rebuilds the slot array with twice the capacity
+    void grow();
+
+    // Slot position for a key
+    size_t slotOf(uint64_t key) const;
+
+    // Open-addressing table: slotGroup[i] is a group number or NotFound
+    std::vector<uint32_t> slotGroup;
+    size_t slotMask = 0;
+
+    // Per-group data, indexed by group number
+    std::vector<uint64_t> groupKeys;
+    std::vector<uint32_t> groupCounts;
+    std::vector<MetricStats> groupStats;   // groupCount() * metricCount entries
+    size_t metricCount = 0;
+};
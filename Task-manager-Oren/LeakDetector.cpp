@@ -0,0 +1,162 @@
+#include "LeakDetector.h"
+#include "ProcessManager.h"
+
+#include <algorithm>
+
+LeakDetector::LeakDetector(const LeakThresholds& thresholds) : thresholds(thresholds) {}
+
+void LeakDetector::setThresholds(const LeakThresholds& newThresholds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    thresholds = newThresholds;
+}
+
+LeakThresholds LeakDetector::getThresholds() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return thresholds;
+}
+
+double LeakDetector::secondsSince(std::chrono::steady_clock::time_point at) const
+{
+    return std::chrono::duration<double>(at - epoch).count();
+}
+
+void LeakDetector::startRun(Trend& trend, double now, unsigned long long value)
+{
+    trend.runStart = now;
+    trend.lastTime = 0;
+    trend.runStartValue = value;
+    trend.lastValue = value;
+    trend.weight = trend.sumT = trend.sumTT = trend.sumY = trend.sumTY = 0;
+}
+
+// The integrals of a constant over [from, to), so a value that held for ten seconds weighs
+// as much as ten one-second samples would
+void LeakDetector::addStep(Trend& trend, double from, double to, double value)
+{
+    double t2 = (to * to - from * from) / 2.0;
+    trend.weight += to - from;
+    trend.sumT += t2;
+    trend.sumTT += (to * to * to - from * from * from) / 3.0;
+    trend.sumY += value * (to - from);
+    trend.sumTY += value * t2;
+}
+
+double LeakDetector::slopeOf(const Trend& trend)
+{
+    double denominator = trend.weight * trend.sumTT - trend.sumT * trend.sumT;
+    if (trend.weight <= 0 || denominator <= 0)
+        return 0.0;
+    return (trend.weight * trend.sumTY - trend.sumT * trend.sumY) / denominator;
+}
+
+bool LeakDetector::isLeaking(const Trend& trend, double now, double slope) const
+{
+    return now - trend.runStart >= static_cast<double>(thresholds.minDuration.count())
+        && slope >= thresholds.minSlope
+        && trend.lastValue > trend.runStartValue;
+}
+
+void LeakDetector::update(const ProcessManager& manager, std::chrono::steady_clock::time_point at)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!started)
+    {
+        epoch = at;
+        started = true;
+    }
+    double now = secondsSince(at);
+    const ProcessDelta& delta = manager.getLastDelta();
+
+    // Removals first: a recycled PID shows up as removed and added in the same delta
+    for (const ProcessInfo& proc : delta.removed)
+    {
+        trends.erase(proc.pid);
+        flagged.erase(proc.pid);
+    }
+
+    for (DWORD pid : delta.added)
+    {
+        const ProcessInfo* proc = manager.findProcess(pid);
+        if (!proc || !proc->isAccessible)
+            continue;
+
+        Trend& trend = trends[pid];
+        trend.nameId = proc->nameId;
+        startRun(trend, now, proc->memoryUsage);
+    }
+
+    for (DWORD pid : delta.changed)
+    {
+        const ProcessInfo* proc = manager.findProcess(pid);
+        if (!proc || !proc->isAccessible)
+        {
+            trends.erase(pid);
+            flagged.erase(pid);
+            continue;
+        }
+
+        auto found = trends.find(pid);
+        if (found == trends.end())
+        {
+            // Became readable only now
+            Trend& trend = trends[pid];
+            trend.nameId = proc->nameId;
+            startRun(trend, now, proc->memoryUsage);
+            continue;
+        }
+
+        Trend& trend = found->second;
+        unsigned long long value = proc->memoryUsage;
+        if (value + thresholds.allowedDip < trend.lastValue)
+        {
+            // Memory went down: whatever this is, it is not a leak in progress
+            startRun(trend, now, value);
+            flagged.erase(pid);
+            continue;
+        }
+
+        // Close the step that just ended and open one at the new value
+        double relative = now - trend.runStart;
+        addStep(trend, trend.lastTime, relative, static_cast<double>(trend.lastValue));
+        trend.lastTime = relative;
+        trend.lastValue = value;
+
+        if (isLeaking(trend, now, slopeOf(trend)))
+            flagged.insert(pid);
+        else
+            flagged.erase(pid);
+    }
+}
+
+std::vector<LeakSuspect> LeakDetector::suspects(std::chrono::steady_clock::time_point at) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::vector<LeakSuspect> result;
+    if (!started)
+        return result;
+
+    double now = secondsSince(at);
+    for (DWORD pid : flagged)
+    {
+        const Trend& stored = trends.at(pid);
+
+        // Include the step still open, so a process that stopped growing fades out
+        Trend trend = stored;
+        double relative = std::max(now - trend.runStart, trend.lastTime);
+        addStep(trend, trend.lastTime, relative, static_cast<double>(trend.lastValue));
+
+        double slope = slopeOf(trend);
+        if (!isLeaking(trend, now, slope))
+            continue;
+
+        result.push_back({ pid, trend.nameId, slope, now - trend.runStart,
+            static_cast<long long>(trend.lastValue) - static_cast<long long>(trend.runStartValue), trend.lastValue });
+    }
+
+    std::sort(result.begin(), result.end(), [](const LeakSuspect& a, const LeakSuspect& b) { return a.slope > b.slope; });
+    return result;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ProcessInfo.h"
+
+class ProcessManager;
+
+// When a process counts as leaking
+struct LeakThresholds
+{
+    double minSlope = 4096.0;                          // Bytes per second (one page a second ~ 14 MB/hour)
+    std::chrono::seconds minDuration{ 120 };           // How long the growth must have lasted
+    unsigned long long allowedDip = 0;                 // A drop larger than this ends the growth run
+};
+
+// A process that looks like it is leaking
+struct LeakSuspect
+{
+    DWORD pid;
+    uint32_t nameId;                 // Interned name (see NamePool)
+    double slope;                    // Fitted growth in bytes per second
+    double growingFor;               // Seconds since the current growth run started
+    long long growth;                // Bytes gained since the run started
+    unsigned long long current;      // Latest working set in bytes
+};
+
+// Flags processes whose working set keeps going up.
+//
+// Each process carries a least-squares line fitted to its memory since its current growth
+// run began (a run ends as soon as the memory drops). The memory is a step function that
+// only moves when a refresh reports a change, so each step is folded into the running sums
+// in closed form when the next change arrives: a tick costs O(processes in the delta),
+// and processes that did not change are never visited.
+class LeakDetector
+{
+public:
+    explicit LeakDetector(const LeakThresholds& thresholds = LeakThresholds());
+
+    // Replaces the thresholds; runs in progress are judged by the new ones from now on
+    void setThresholds(const LeakThresholds& thresholds);
+    LeakThresholds getThresholds() const;
+
+    // Folds the manager's last refresh (its delta) into the trends. at is when it ran.
+    void update(const ProcessManager& manager, std::chrono::steady_clock::time_point at);
+
+    // Processes currently over the thresholds, steepest first
+    std::vector<LeakSuspect> suspects(std::chrono::steady_clock::time_point now) const;
+
+private:
+    // Running sums of the fit over the current run. Times are seconds since runStart,
+    // so the sums stay small enough for doubles.
+    struct Trend
+    {
+        uint32_t nameId = 0;
+        double runStart = 0;             // Seconds since the detector's epoch
+        double lastTime = 0;             // Start of the current step, relative to runStart
+        unsigned long long runStartValue = 0;
+        unsigned long long lastValue = 0;
+        double weight = 0;               // Integrals over the run of 1, t, t^2, y and t*y
+        double sumT = 0;
+        double sumTT = 0;
+        double sumY = 0;
+        double sumTY = 0;
+    };
+
+    // Starts a fresh run at time now with the given value
+    static void startRun(Trend& trend, double now, unsigned long long value);
+
+    // Adds the step [from, to) at the given value to the sums
+    static void addStep(Trend& trend, double from, double to, double value);
+
+    // Fitted slope (bytes per second), 0 while the run is too short to fit
+    static double slopeOf(const Trend& trend);
+
+    // Is the trend over the thresholds at time now (seconds since epoch)?
+    bool isLeaking(const Trend& trend, double now, double slope) const;
+
+    // Seconds since the first update
+    double secondsSince(std::chrono::steady_clock::time_point at) const;
+
+    mutable std::mutex mutex;
+    LeakThresholds thresholds;
+    std::unordered_map<DWORD, Trend> trends;
+    std::unordered_set<DWORD> flagged;       // PIDs over the thresholds at their last change
+    bool started = false;
+    std::chrono::steady_clock::time_point epoch;
+};
@@ -0,0 +1,311 @@
+#ifndef _WIN32
+
+#include "LinuxSnapshotSource.h"
+#include "UserNames.h"
+
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Layout of the records returned by getdents64 (glibc does not export it)
+struct LinuxDirent64
+{
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// Parses a decimal number and moves p past it; leading spaces are skipped
+static unsigned long long parseUnsigned(const char*& p, const char* end)
+{
+    while (p < end && *p == ' ')
+        ++p;
+
+    unsigned long long value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        value = value * 10 + static_cast<unsigned long long>(*p - '0');
+        ++p;
+    }
+    return value;
+}
+
+// Returns the length of name if it is a PID directory (all digits), 0 otherwise
+static size_t pidNameLength(const char* name)
+{
+    size_t length = 0;
+    while (name[length] != '\0')
+    {
+        if (name[length] < '0' || name[length] > '9')
+            return 0;
+        ++length;
+    }
+    return length;
+}
+
+// Skips count space-separated fields
+static void skipFields(const char*& p, const char* end, int count)
+{
+    for (int i = 0; i < count && p < end; ++i)
+    {
+        while (p < end && *p == ' ')
+            ++p;
+        while (p < end && *p != ' ')
+            ++p;
+    }
+}
+
+// Writes value in decimal at out and returns the number of characters written
+static size_t formatUnsigned(unsigned long value, char* out)
+{
+    char digits[20];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    for (size_t i = 0; i < count; ++i)
+        out[i] = digits[count - 1 - i];
+    return count;
+}
+
+// Value of the "key: <n>" line of a /proc file, 0 if it is missing
+static unsigned long long numberField(const char* text, const char* end, const char* key)
+{
+    const char* line = std::strstr(text, key);
+    if (!line || line >= end)
+        return 0;
+    const char* p = line + std::strlen(key);
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    return parseUnsigned(p, end);
+}
+
+// Value in bytes of the "key:   <n> kB" line of a /proc file, 0 if it is missing
+static unsigned long long kilobyteField(const char* text, const char* end, const char* key)
+{
+    return numberField(text, end, key) * 1024;
+}
+
+LinuxSnapshotSource::LinuxSnapshotSource(const std::string& procRoot)
+    : procRoot(procRoot), pageSize(sysconf(_SC_PAGESIZE)),
+      nanosPerTick(1000000000ULL / static_cast<unsigned long long>(sysconf(_SC_CLK_TCK)))
+{
+    // Since Linux 6.2 the size of a /proc/<pid>/fd directory is its number of entries.
+    // We hold at least stdin/stdout/stderr, so a size of 0 means an older kernel.
+    struct stat info;
+    fdCountFromSize = stat((procRoot + "/self/fd").c_str(), &info) == 0 && info.st_size > 0;
+}
+
+LinuxSnapshotSource::~LinuxSnapshotSource()
+{
+    if (procFd >= 0)
+        close(procFd);
+}
+
+long LinuxSnapshotSource::readProcFile(DWORD pid, const char* file, SampleScratch& scratch, long limit) const
+{
+    // Build "<pid>/<file>" by hand instead of going through a string
+    size_t length = formatUnsigned(pid, scratch.pathBuffer);
+    size_t fileLength = std::strlen(file);
+    if (length + 1 + fileLength + 1 > sizeof(scratch.pathBuffer))
+        return -1;
+    scratch.pathBuffer[length] = '/';
+    std::memcpy(scratch.pathBuffer + length + 1, file, fileLength + 1);
+
+    int fd = openat(procFd, scratch.pathBuffer, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    if (limit < 0)
+        limit = static_cast<long>(sizeof(scratch.fileBuffer) - 1);
+    ssize_t bytes = read(fd, scratch.fileBuffer, static_cast<size_t>(limit));
+    close(fd);
+    if (bytes < 0)
+        return -1;
+
+    scratch.fileBuffer[bytes] = '\0';
+    return static_cast<long>(bytes);
+}
+
+bool LinuxSnapshotSource::beginWalk(size_t& count)
+{
+    pids.clear();
+
+    if (procFd >= 0)
+        close(procFd);
+    procFd = open(procRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd < 0)
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        long bytes = syscall(SYS_getdents64, procFd, direntBuffer, sizeof(direntBuffer));
+        if (bytes <= 0)
+            break;
+
+        for (long offset = 0; offset < bytes;)
+        {
+            const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(direntBuffer + offset);
+            offset += entry->d_reclen;
+
+            if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN)
+                continue;
+
+            size_t pidLength = pidNameLength(entry->d_name);
+            if (pidLength == 0)
+                continue;
+
+            const char* p = entry->d_name;
+            pids.push_back(static_cast<DWORD>(parseUnsigned(p, entry->d_name + pidLength)));
+        }
+    }
+
+    count = pids.size();
+    return true;
+}
+
+bool LinuxSnapshotSource::sampleAt(size_t index, ProcessSample& sample, SampleScratch& scratch)
+{
+    // The process can exit between getdents64 and the read below; just skip it then
+    long statBytes = readProcFile(pids[index], "stat", scratch);
+    if (statBytes <= 0)
+        return false;
+
+    // stat is "pid (comm) state ppid ...". comm may itself contain spaces or ')',
+    // so the name ends at the last ')' in the line.
+    const char* buffer = scratch.fileBuffer;
+    const char* end = buffer + statBytes;
+    const char* nameStart = static_cast<const char*>(std::memchr(buffer, '(', static_cast<size_t>(statBytes)));
+    const char* nameEnd = end;
+    while (nameEnd > buffer && *(nameEnd - 1) != ')')
+        --nameEnd;
+    if (!nameStart || nameEnd <= nameStart + 1)
+        return false;
+    --nameEnd; // Now points at the ')'
+
+    sample.pid = pids[index];
+    sample.wideName = nullptr;
+    sample.utf8Name = nameStart + 1;
+    sample.nameLength = static_cast<size_t>(nameEnd - nameStart - 1);
+
+    // After the name: field 3 is state, 4 ppid, 9 flags, 10/12 minflt/majflt, 14/15
+    // utime/stime (clock ticks), 20 num_threads, 22 starttime, 24 rss (in pages)
+    const char* cursor = nameEnd + 1;
+    while (cursor < end && *cursor == ' ')
+        ++cursor;
+    sample.state = cursor < end ? *cursor : '?';
+    skipFields(cursor, end, 1);
+    sample.parentPid = static_cast<DWORD>(parseUnsigned(cursor, end));
+    skipFields(cursor, end, 4);
+    bool kernelThread = (parseUnsigned(cursor, end) & KernelThreadFlag) != 0;
+    unsigned long long minorFaults = parseUnsigned(cursor, end);
+    skipFields(cursor, end, 1);
+    sample.majorFaults = parseUnsigned(cursor, end);
+    sample.pageFaults = minorFaults + sample.majorFaults;
+    skipFields(cursor, end, 1);
+    unsigned long long cpuTicks = parseUnsigned(cursor, end);
+    cpuTicks += parseUnsigned(cursor, end);
+    sample.cpuTime = cpuTicks * nanosPerTick;
+    skipFields(cursor, end, 4);
+    sample.threadCount = static_cast<uint32_t>(parseUnsigned(cursor, end));
+    skipFields(cursor, end, 1);
+    sample.startTime = parseUnsigned(cursor, end);
+    skipFields(cursor, end, 1);
+    sample.memoryUsage = parseUnsigned(cursor, end) * static_cast<unsigned long long>(pageSize);
+    sample.isAccessible = true;
+
+    // The name points into fileBuffer, which the reads below reuse, so move it to the end
+    // of the buffer first (comm is at most 64 bytes; stat is far shorter than the buffer)
+    char* savedName = scratch.fileBuffer + sizeof(scratch.fileBuffer) - sample.nameLength;
+    std::memmove(savedName, sample.utf8Name, sample.nameLength);
+    sample.utf8Name = savedName;
+    long limit = static_cast<long>(sizeof(scratch.fileBuffer) - sample.nameLength - 1);
+
+    // I/O needs ptrace access to the process, so it stays 0 for other users' processes
+    // when we are not root. read_bytes/write_bytes are what reached the storage layer.
+    // Kernel threads have neither I/O accounting nor descriptors, so they skip those reads.
+    long bytes = kernelThread ? -1 : readProcFile(pids[index], "io", scratch, limit);
+    const char* text = scratch.fileBuffer;
+    sample.readBytes = bytes > 0 ? numberField(text, text + bytes, "\nread_bytes:") : 0;
+    sample.writeBytes = bytes > 0 ? numberField(text, text + bytes, "\nwrite_bytes:") : 0;
+    sample.readOps = bytes > 0 ? numberField(text, text + bytes, "\nsyscr:") : 0;
+    sample.writeOps = bytes > 0 ? numberField(text, text + bytes, "\nsyscw:") : 0;
+
+    bytes = readProcFile(pids[index], "status", scratch, limit);
+    sample.contextSwitches = bytes > 0
+        ? numberField(text, text + bytes, "\nvoluntary_ctxt_switches:") + numberField(text, text + bytes, "\nnonvoluntary_ctxt_switches:")
+        : 0;
+    sample.peakMemory = bytes > 0 ? kilobyteField(text, text + bytes, "\nVmHWM:") : 0;
+
+    sample.handleCount = kernelThread ? 0 : countDescriptors(pids[index], scratch, limit);
+
+    // The owner is the owner of the /proc/<pid> directory; pathBuffer still starts with "<pid>/"
+    struct stat info;
+    *std::strchr(scratch.pathBuffer, '/') = '\0';
+    sample.userId = fstatat(procFd, scratch.pathBuffer, &info, 0) == 0 ? static_cast<uint32_t>(info.st_uid) : NoUser;
+    return true;
+}
+
+uint32_t LinuxSnapshotSource::countDescriptors(DWORD pid, SampleScratch& scratch, long limit) const
+{
+    size_t length = formatUnsigned(pid, scratch.pathBuffer);
+    std::memcpy(scratch.pathBuffer + length, "/fd", 4);
+
+    if (fdCountFromSize)
+    {
+        struct stat info;
+        return fstatat(procFd, scratch.pathBuffer, &info, 0) == 0 ? static_cast<uint32_t>(info.st_size) : 0;
+    }
+
+    // Older kernels: count the entries, using the file buffer for getdents64
+    int fd = openat(procFd, scratch.pathBuffer, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return 0;
+    uint32_t count = 0;
+    while (true)
+    {
+        long bytes = syscall(SYS_getdents64, fd, scratch.fileBuffer, static_cast<size_t>(limit) & ~size_t(7));
+        if (bytes <= 0)
+            break;
+        for (long offset = 0; offset < bytes;)
+        {
+            const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(scratch.fileBuffer + offset);
+            offset += entry->d_reclen;
+            if (entry->d_name[0] != '.')
+                ++count;
+        }
+    }
+    close(fd);
+    return count;
+}
+
+bool LinuxSnapshotSource::readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch& scratch)
+{
+    if (procFd < 0)
+        return false;
+
+    // The first line is the address range header, so every key follows a newline
+    long bytes = readProcFile(pid, "smaps_rollup", scratch);
+    if (bytes <= 0)
+        return false;
+    const char* text = scratch.fileBuffer;
+    const char* end = text + bytes;
+    detail.proportional = kilobyteField(text, end, "\nPss:");
+    detail.unique = kilobyteField(text, end, "\nPrivate_Clean:") + kilobyteField(text, end, "\nPrivate_Dirty:");
+    detail.shared = kilobyteField(text, end, "\nShared_Clean:") + kilobyteField(text, end, "\nShared_Dirty:");
+    detail.swap = kilobyteField(text, end, "\nSwap:");
+    detail.peak = 0;    // VmHWM already comes with every walk
+    return true;
+}
+
+#endif
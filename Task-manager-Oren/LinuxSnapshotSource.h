@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ProcessSnapshotSource.h"
+
+// Walks /proc with getdents64 and reads each process's stat, io and status files into one
+// fixed buffer: name, CPU and start times, page faults, threads and resident size from
+// stat, storage I/O from io, context switches and peak from status, plus the size of its
+// fd directory. Nothing is allocated per process.
+class LinuxSnapshotSource : public ProcessSnapshotSource
+{
+public:
+    // procRoot can point at a synthetic tree (used by the benchmark)
+    explicit LinuxSnapshotSource(const std::string& procRoot = "/proc");
+    ~LinuxSnapshotSource() override;
+
+    bool beginWalk(size_t& count) override;
+    bool sampleAt(size_t index, ProcessSample& sample, SampleScratch& scratch) override;
+
+    // From /proc/<pid>/smaps_rollup (one walk of the page tables in the kernel, so far
+    // dearer than the files a walk reads)
+    bool readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch& scratch) override;
+
+private:
+    // PF_KTHREAD in the flags field of stat
+    static constexpr unsigned long long KernelThreadFlag = 0x00200000;
+
+    // Reads "<pid>/<file>" relative to the proc directory into scratch.fileBuffer, at most
+    // limit bytes (-1 = the whole buffer). Returns the number of bytes read, or -1 on failure.
+    long readProcFile(DWORD pid, const char* file, SampleScratch& scratch, long limit = -1) const;
+
+    // Open descriptors of a process, 0 if its fd directory cannot be read
+    uint32_t countDescriptors(DWORD pid, SampleScratch& scratch, long limit) const;
+
+    std::string procRoot;
+    long pageSize;
+    unsigned long long nanosPerTick;   // Length of a clock tick (utime/stime unit)
+    int procFd = -1;             // Open for the duration of a walk, used with openat
+    bool fdCountFromSize;        // The kernel reports the descriptor count as the fd directory size
+
+    // PIDs found by the current walk, reused between refreshes
+    std::vector<DWORD> pids;
+
+    // Reused on every refresh so the directory walk never touches the heap
+    alignas(8) char direntBuffer[32 * 1024];
+};
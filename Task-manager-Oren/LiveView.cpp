@@ -0,0 +1,176 @@
+#include "LiveView.h"
+#include "Format.h"
+
+#include <algorithm>
+
+typedef TerminalRenderer::Align Align;
+
+void LiveView::render(TerminalRenderer& screen, const ProcessTable& table, const ProcessDelta& delta,
+    const std::vector<LeakSuspect>& suspects, unsigned long long sequence)
+{
+    const NamePool& names = processNames();
+
+    // One pass over the snapshot: instances, memory, memory gained since the last tick
+    // (new processes count fully towards the delta) and CPU usage
+    const std::vector<uint8_t>* rowMask = nullptr;
+    matchedPids.swap(previousMatchedPids);
+    matchedPids.clear();
+    if (!filter.matchesAll())
+    {
+        filter.evaluate(table, names, filterMask);
+        rowMask = &filterMask;
+        for (uint32_t row = 0; row < table.size(); ++row)
+        {
+            if (filterMask[row])
+                matchedPids.push_back(table.pid[row]);
+        }
+        std::sort(matchedPids.begin(), matchedPids.end());
+    }
+    groups.group(table, names, GroupBy::Name, { Metric::Memory, Metric::MemoryChange, Metric::PreviouslySeen, Metric::Cpu },
+        false, nullptr, rowMask);
+
+    uint32_t groupCount = groups.groupCount();
+    memoryDelta.resize(groupCount);
+    hasHistory.resize(groupCount);
+    for (uint32_t group = 0; group < groupCount; ++group)
+    {
+        memoryDelta[group] = groups.stats(group, 1).sum;
+        hasHistory[group] = groups.stats(group, 2).sum > 0;
+    }
+
+    // Instances that exited take their memory with them, if the filter counted them last time
+    for (const ProcessInfo& proc : delta.removed)
+    {
+        if (!proc.isAccessible) continue;
+        if (rowMask && !std::binary_search(previousMatchedPids.begin(), previousMatchedPids.end(), proc.pid))
+            continue;
+
+        uint32_t group = groups.find(proc.nameId);
+        if (group != GroupingEngine::NotFound)
+        {
+            memoryDelta[group] -= static_cast<long long>(proc.memoryUsage);
+            hasHistory[group] = 1;
+        }
+    }
+
+    groups.orderByName(names, order);
+
+    // Columns: the name takes whatever the numbers leave over
+    const int countWidth = 12, memoryWidth = 15, deltaWidth = 15, cpuWidth = 10;
+    int width = screen.columns();
+    size_t longestName = 12;
+    for (uint32_t group : order)
+        longestName = std::max(longestName, names.display(static_cast<uint32_t>(groups.key(group))).length());
+    int nameWidth = std::max(12, std::min(static_cast<int>(longestName) + 4, width - countWidth - memoryWidth - deltaWidth - cpuWidth));
+    int countColumn = nameWidth;
+    int memoryColumn = countColumn + countWidth;
+    int deltaColumn = memoryColumn + memoryWidth;
+    int cpuColumn = deltaColumn + deltaWidth;
+
+    int suspectRows = suspects.empty() ? 0 : std::min(static_cast<int>(suspects.size()), MaxSuspectRows) + 2;
+    int statusRow = screen.rows() - 1;
+    int firstGroupRow = trackedPids.empty() ? 3 : 4;
+    int lastGroupRow = statusRow - suspectRows;    // Exclusive
+
+    screen.beginFrame();
+
+    cell.clear().text(L"Live monitor - ").number(table.size()).text(L" processes");
+    if (rowMask)
+    {
+        cell.text(L" (").number(static_cast<size_t>(std::count(filterMask.begin(), filterMask.end(), 1)))
+            .text(L" match ").text(filter.text()).text(L")");
+    }
+    cell.text(L" in ").number(groupCount).text(L" groups, tick ").number(sequence);
+    screen.text(0, 0, cell.data(), cell.size(), width);
+
+    screen.text(1, 0, L"Process Name", nameWidth);
+    screen.text(1, countColumn, L"Instances", countWidth);
+    screen.text(1, memoryColumn, L"Memory", memoryWidth);
+    screen.text(1, deltaColumn, L"Delta", deltaWidth);
+    screen.text(1, cpuColumn, L"CPU", cpuWidth);
+    screen.fill(2, 0, cpuColumn + cpuWidth, L'-');
+
+    // The tracked group: the same columns, summed over the rows whose PID is in the list
+    if (!trackedPids.empty())
+    {
+        size_t members = 0;
+        unsigned long long memory = 0;
+        long long cpu = 0;
+        for (uint32_t row = 0; row < table.size(); ++row)
+        {
+            if (!std::binary_search(trackedPids.begin(), trackedPids.end(), table.pid[row]))
+                continue;
+            ++members;
+            memory += table.accessible(row) ? table.memory[row] : 0;
+            cpu += table.cpu[row];
+        }
+        screen.text(3, 0, trackedLabel, nameWidth - 1);
+        size_t length = formatUnsigned(field, FieldSize, members);
+        screen.text(3, countColumn, field, length, countWidth);
+        length = formatMemory(field, FieldSize, memory);
+        screen.text(3, memoryColumn, field, length, memoryWidth);
+        screen.text(3, deltaColumn, L"N/A", 3, deltaWidth);
+        length = formatCpu(field, FieldSize, cpu);
+        screen.text(3, cpuColumn, field, length, cpuWidth);
+    }
+
+    int row = firstGroupRow;
+    size_t shown = 0;
+    for (; shown < order.size() && row < lastGroupRow; ++shown, ++row)
+    {
+        uint32_t group = order[shown];
+        screen.text(row, 0, names.display(static_cast<uint32_t>(groups.key(group))), nameWidth - 1);
+        size_t length = formatUnsigned(field, FieldSize, groups.count(group));
+        screen.text(row, countColumn, field, length, countWidth);
+        length = formatMemory(field, FieldSize, static_cast<unsigned long long>(groups.stats(group, 0).sum));
+        screen.text(row, memoryColumn, field, length, memoryWidth);
+        if (hasHistory[group])
+        {
+            length = formatMemoryChange(field, FieldSize, memoryDelta[group]);
+            screen.text(row, deltaColumn, field, length, deltaWidth);
+        }
+        else
+        {
+            screen.text(row, deltaColumn, L"N/A", 3, deltaWidth);
+        }
+        length = formatCpu(field, FieldSize, groups.stats(group, 3).sum);
+        screen.text(row, cpuColumn, field, length, cpuWidth);
+    }
+
+    if (suspectRows > 0)
+    {
+        row = lastGroupRow + 1;
+        screen.text(row - 1, 0, L"Possible memory leaks:", width);
+        for (int i = 0; i < suspectRows - 2; ++i, ++row)
+        {
+            const LeakSuspect& suspect = suspects[i];
+            cell.clear().number(suspect.pid).text(L"  ").text(names.display(suspect.nameId)).text(L"  ")
+                .memoryChange(static_cast<long long>(suspect.slope * 60)).text(L"/min for ")
+                .number(static_cast<unsigned long long>(suspect.growingFor)).text(L" s, now ")
+                .memory(suspect.current);
+            screen.text(row, 2, cell.data(), cell.size(), width - 2);
+        }
+    }
+
+    cell.clear().text(L"Press Ctrl+C to quit");
+    if (shown < order.size())
+        cell.text(L"  (").number(order.size() - shown).text(L" more groups below, enlarge the window to see them)");
+    screen.text(statusRow, 0, cell.data(), cell.size(), width);
+
+    screen.present();
+}
+
+bool LiveView::setFilter(const std::wstring& text, std::string& error)
+{
+    if (!filter.compile(text, error))
+        return false;
+    previousMatchedPids.clear();
+    matchedPids.clear();    // Matched by the old filter, so no exit is counted on the next frame
+    return true;
+}
+
+void LiveView::setTrackedGroup(const std::wstring& label, std::vector<DWORD> pids)
+{
+    trackedLabel = label;
+    trackedPids = std::move(pids);
+}
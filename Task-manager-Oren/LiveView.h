@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Format.h"
+#include "GroupingEngine.h"
+#include "LeakDetector.h"
+#include "NamePool.h"
+#include "ProcessFilter.h"
+#include "ProcessInfo.h"
+#include "ProcessTable.h"
+#include "TerminalRenderer.h"
+
+// Lays out the live monitor screen: name groups with instances, memory, memory change
+// and CPU, then any leak suspects, then a status line. Everything is composed into a
+// TerminalRenderer, which only sends what changed since the last frame.
+class LiveView
+{
+public:
+    // Composes and presents one frame for a snapshot
+    void render(TerminalRenderer& screen, const ProcessTable& table, const ProcessDelta& delta,
+        const std::vector<LeakSuspect>& suspects, unsigned long long sequence);
+
+    // Only counts processes matching a filter expression from now on (empty text = all).
+    // Returns false with a message in error if the expression does not parse.
+    bool setFilter(const std::wstring& text, std::string& error);
+
+    // Shows the processes with these PIDs (sorted) as one extra group above the others,
+    // e.g. the commands of a running batch. An empty list hides the row.
+    void setTrackedGroup(const std::wstring& label, std::vector<DWORD> pids);
+
+private:
+    // Most leak suspects shown under the table
+    static constexpr int MaxSuspectRows = 5;
+    static constexpr size_t FieldSize = 40;
+
+    // Processes counted, and the rows of the current frame that match
+    ProcessFilter filter;
+    std::vector<uint8_t> filterMask;
+
+    // PIDs the filter matched on this frame and the previous one (sorted), so exited
+    // processes only change the groups they were counted in
+    std::vector<DWORD> matchedPids;
+    std::vector<DWORD> previousMatchedPids;
+
+    // Tracked group shown above the name groups
+    std::wstring trackedLabel;
+    std::vector<DWORD> trackedPids;
+
+    // Reused on every frame
+    GroupingEngine groups;
+    std::vector<long long> memoryDelta;
+    std::vector<unsigned char> hasHistory;
+    std::vector<uint32_t> order;
+    TextRow cell;                  // Longer lines (title, leaks, status)
+    wchar_t field[FieldSize];      // One number at a time
+};
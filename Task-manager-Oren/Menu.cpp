@@ -1,21 +1,81 @@
 #include "Menu.h"
+#include "Benchmark.h"
+#include "Format.h"
+#include "SnapshotReplay.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cwchar>
+#include <cwctype>
 #include <iostream>
+#include <limits>
 #include <string>
 
-Menu::Menu(ProcessManager& pm) : processManager(pm) {}
+// Whole line as an unsigned decimal number
+static bool parseUnsignedInput(const std::wstring& text, unsigned long long& value)
+{
+    if (text.empty() || !std::iswdigit(text[0]))
+        return false;
+    wchar_t* end = nullptr;
+    errno = 0;
+    value = std::wcstoull(text.c_str(), &end, 10);
+    return errno == 0 && *end == L'\0';
+}
+
+Menu::Menu(ProcessManager& pm, ProcessSampler& sampler) : processManager(pm), sampler(sampler) {}
 
 void Menu::printMenu()
 {
     //Main options
-    std::cout << "Choose an option:\n";
-    std::cout << "1. Sort by Name (Alphabetical)\n";
-    std::cout << "2. Sort by Memory Size\n";
-    std::cout << "3. Launch a new program\n";    
-    std::cout << "4. Search Processes by Name\n";
-    std::cout << "5. Terminate a process by Name\n";
-    std::cout << "6. Live Monitoring\n";
-    std::cout << "0. Exit\n";
-    std::cout << "Enter choice: ";
+    std::wcout << L"Choose an option:\n";
+    std::wcout << L"1. Sort by Name (Alphabetical)\n";
+    std::wcout << L"2. Sort by Memory Size\n";
+    std::wcout << L"3. Launch a new program\n";    
+    std::wcout << L"4. Search Processes by Name\n";
+    std::wcout << L"5. Terminate a process by Name\n";
+    std::wcout << L"6. Live Monitoring\n";
+    std::wcout << L"7. Benchmark process refresh\n";
+    std::wcout << L"8. Sort by CPU Usage\n";
+    std::wcout << L"9. Top Memory Growers (last 10 minutes)\n";
+    std::wcout << L"10. Suspected Memory Leaks\n";
+    std::wcout << L"11. Change Memory Units\n";
+    if (sampler.isRecording())
+        std::wcout << L"12. Stop Recording (" << sampler.recordedFrames() << L" frames so far)\n";
+    else
+        std::wcout << L"12. Start Recording to File\n";
+    std::wcout << L"13. Replay a Recording\n";
+    if (metricsExporter && metricsExporter->isRunning())
+        std::wcout << L"14. Stop Metrics Endpoint (port " << metricsExporter->port() << L", "
+            << metricsExporter->scrapesServed() << L" scrapes so far)\n";
+    else
+        std::wcout << L"14. Start Metrics Endpoint (Prometheus)\n";
+    std::wcout << L"15. Filter Processes (e.g. name=java* and memory>2GB)\n";
+    std::wcout << L"16. Process Tree\n";
+    if (processLauncher.hasBatch())
+    {
+        BatchProgress progress = processLauncher.batchProgress();
+        std::wcout << L"17. Launched Batch (" << progress.finished << L" of " << progress.total << L" done, "
+            << progress.running << L" running" << (progress.active ? L")\n" : L", finished)\n");
+    }
+    else
+    {
+        std::wcout << L"17. Run a Batch of Commands from a File\n";
+    }
+    std::wcout << L"18. Memory Details (PSS/USS/Swap)\n";
+    std::wcout << L"19. I/O, Threads and Handles\n";
+    std::wcout << L"20. Top Processes by Memory\n";
+    size_t ruleCount = sampler.alerts().rules().size();
+    if (ruleCount > 0)
+        std::wcout << L"21. Alerts (" << ruleCount << L" rules, " << sampler.alerts().firedCount() << L" fired so far)\n";
+    else
+        std::wcout << L"21. Alerts\n";
+    size_t policyCount = sampler.guard().policies().size();
+    if (policyCount > 0)
+        std::wcout << L"22. Resource Guard (" << policyCount << L" policies, " << sampler.guard().actionCount() << L" actions so far)\n";
+    else
+        std::wcout << L"22. Resource Guard (memory and CPU caps on process groups)\n";
+    std::wcout << L"0. Exit\n";
+    std::wcout << L"Enter choice: ";
 }
 
 void Menu::runMenu()
@@ -23,24 +83,26 @@ void Menu::runMenu()
     int choice = -1;
     while (choice != 0)
     {
+        processLauncher.reapChildren();    // Programs launched from the menu that have exited since
         printMenu();
-        std::cin >> choice;
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  
+        std::wcin >> choice;
+        std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  
 
         switch (choice)
         {
         case 1:
-            processManager.sortByName();
-            processManager.printGroupedProcessesByName();
+            syncWithSampler();
+            pageThrough(L"Groups", [this](size_t first, size_t count) { return processManager.printGroupedProcessesByName(first, count); });
             break;
         case 2:
-            processManager.sortByMemory();
-            processManager.printGroupedProcessesByMemory();
+            syncWithSampler();
+            pageThrough(L"Groups", [this](size_t first, size_t count) { return processManager.printGroupedProcessesByMemory(first, count); });
             break;
         case 3:
             launchProcess();
             break;
         case 4:
+            syncWithSampler();
             searchProcessesByName();
             break;
         case 5:
@@ -48,11 +110,81 @@ void Menu::runMenu()
             break;
         case 6:
             liveMonitor();
+            break;
+        case 7:
+            runBenchmark();
+            break;
+        case 8:
+            syncWithSampler();
+            pageThrough(L"Groups", [this](size_t first, size_t count) { return processManager.printGroupedProcessesByCpu(first, count); });
+            break;
+        case 9:
+            printTopGrowers();
+            break;
+        case 10:
+        {
+            std::vector<LeakSuspect> suspects = sampler.leaks().suspects(std::chrono::steady_clock::now());
+            if (suspects.empty())
+            {
+                LeakThresholds thresholds = sampler.leaks().getThresholds();
+                std::wcout << L"No process has grown by more than " << formatMemory(static_cast<size_t>(thresholds.minSlope * 60))
+                    << L"/min for " << thresholds.minDuration.count() << L" seconds.\n";
+            }
+            else
+            {
+                printLeakSuspects(suspects);
+            }
+            break;
+        }
+        case 11:
+            chooseMemoryUnit();
+            break;
+        case 12:
+            toggleRecording();
+            break;
+        case 13:
+            replayRecording();
+            break;
+        case 14:
+            toggleMetricsEndpoint();
+            break;
+        case 15:
+            syncWithSampler();
+            filterProcesses();
+            break;
+        case 16:
+            syncWithSampler();
+            showProcessTree();
+            break;
+        case 17:
+            runBatch();
+            break;
+        case 18:
+            syncWithSampler();
+            showMemoryDetails();
+            break;
+        case 19:
+            syncWithSampler();
+            showActivity();
+            break;
+        case 20:
+            syncWithSampler();
+            pageThrough(L"Processes", [this](size_t first, size_t count)
+                {
+                    return processManager.printProcessPage({ { SortKey::Accessible, false }, { SortKey::Memory, true } }, first, count);
+                });
+            break;
+        case 21:
+            manageAlerts();
+            break;
+        case 22:
+            manageGuard();
+            break;
         case 0:
-            std::cout << "Goodbye!\n";
+            std::wcout << L"Goodbye!\n";
             break;
         default:
-            std::cout << "Invalid choice!\n";
+            std::wcout << L"Invalid choice!\n";
             break;
         }
     }
@@ -93,7 +225,11 @@ void Menu::terminateProcessByName()
         return;
     }
 
-    if (processManager.terminateProcessesByName(nameToKill)) 
+    TerminationOptions options;
+    if (!askGracePeriod(options))
+        return;
+
+    if (processManager.terminateProcessesByName(nameToKill, options)) 
     {
         std::wcout << L"All processes named \"" << nameToKill << L"\" terminated successfully.\n";
     }
@@ -103,93 +239,498 @@ void Menu::terminateProcessByName()
     }
 }
 
+bool Menu::askGracePeriod(TerminationOptions& options)
+{
+    std::wcout << L"Seconds to let them exit before killing them (Enter for "
+        << options.grace.count() / 1000 << L", 0 to kill at once): ";
+    std::wstring input;
+    std::getline(std::wcin, input);
+    if (input.empty())
+        return true;
+
+    unsigned long long seconds = 0;
+    if (!parseUnsignedInput(input, seconds) || seconds > 3600)
+    {
+        std::wcout << L"Invalid number of seconds.\n";
+        return false;
+    }
+    options.grace = std::chrono::seconds(seconds);
+    return true;
+}
+
+void Menu::runBatch()
+{
+    if (!processLauncher.hasBatch())
+    {
+        std::string path;
+        std::wstring input;
+        std::wcout << L"File with one command per line: ";
+        std::getline(std::wcin, input);
+        path = toNarrow(input);
+        std::vector<std::wstring> commands;
+        if (input.empty() || !ProcessLauncher::readBatchFile(path, commands))
+        {
+            std::wcout << L"Cannot read the file.\n";
+            return;
+        }
+        if (commands.empty())
+        {
+            std::wcout << L"The file has no commands.\n";
+            return;
+        }
+
+        BatchOptions options;
+        options.quiet = true;    // Their output would run through the menu
+        std::wcout << L"Most commands running at once (Enter for " << options.concurrency << L"): ";
+        std::getline(std::wcin, input);
+        unsigned long long concurrency = 0;
+        if (!input.empty())
+        {
+            if (!parseUnsignedInput(input, concurrency) || concurrency == 0 || concurrency > 4096)
+            {
+                std::wcout << L"Invalid number.\n";
+                return;
+            }
+            options.concurrency = static_cast<unsigned>(concurrency);
+        }
+
+        processLauncher.startBatch(std::move(commands), options);
+        std::wcout << L"Batch started; choose this option again to follow it. Its processes show up\n"
+            << L"as one group at the top of the live monitor.\n";
+        return;
+    }
+
+    // The tracked group: what is running now, with figures from the latest snapshot
+    BatchProgress progress = processLauncher.batchProgress();
+    std::vector<DWORD> pids = processLauncher.runningPids();
+    if (!pids.empty())
+    {
+        // Fresh figures: batch commands are often younger than the sampler's last snapshot
+        processManager.refreshProcessList();
+        std::wcout << pids.size() << L" running:\n";
+        processManager.printProcessList(processManager.getProcessesByPid(pids));
+    }
+
+    std::wcout << ProcessLauncher::describeBatch(processLauncher.batchResults());
+    if (progress.active)
+    {
+        std::wstring answer;
+        std::wcout << L"Stop starting the remaining commands? (y/n): ";
+        std::getline(std::wcin, answer);
+        if (answer == L"y" || answer == L"Y")
+            processLauncher.cancelBatch();
+    }
+    else
+    {
+        processLauncher.clearBatch();
+    }
+}
+
 void Menu::liveMonitor()
 {
-    std::map<std::wstring, size_t> previousMemory;
+    std::wstring expression;
+    std::wcout << L"Filter expression (Enter to show every process, ? for help): ";
+    std::getline(std::wcin, expression);
+    if (expression == L"?")
+    {
+        std::wcout << ProcessFilter::syntax() << L"Filter expression: ";
+        std::getline(std::wcin, expression);
+    }
+    std::string error;
+    if (!liveView.setFilter(expression, error))
+    {
+        std::wcout << L"Invalid filter: " << error.c_str() << L"\n";
+        return;
+    }
 
-    std::wcout << L"Live monitoring started. Press Ctrl+C to quit.\n";
+    // The renderer owns the whole terminal from here on
+    if (!liveScreen)
+        liveScreen = std::make_unique<TerminalRenderer>();
+    liveScreen->invalidate();
 
+    unsigned long long lastSequence = 0;
     while (true)
     {
-        processManager.refreshProcessList();
-        const std::vector<ProcessInfo>& list = processManager.getProcessList();
+        // Collection runs on the sampler thread; we only wait for its next snapshot, waking
+        // up 20 times a second to follow terminal resizes
+        SnapshotHandle snapshot = sampler.waitForNewer(lastSequence, std::chrono::milliseconds(50));
+        bool resized = liveScreen->updateSize();
+        if (!snapshot || (snapshot->sequence == lastSequence && !resized))
+            continue;
+
+        lastSequence = snapshot->sequence;
+        liveView.setTrackedGroup(L"[launched batch]", processLauncher.runningPids());
+        liveView.render(*liveScreen, snapshot->table, snapshot->delta,
+            sampler.leaks().suspects(snapshot->takenAt), snapshot->sequence);
+    }
+}
 
-        printGroupedProcessesLive(list, previousMemory);// auto changes the previousMemory into current memory when finished
+void Menu::filterProcesses()
+{
+    std::wcout << ProcessFilter::syntax();
+    std::wstring expression;
+    std::wcout << L"Enter the filter expression: ";
+    std::getline(std::wcin, expression);
+    if (expression.empty())
+    {
+        std::wcout << L"No input given. Returning to menu.\n";
+        return;
+    }
 
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+    ProcessFilter filter;
+    std::string error;
+    if (!filter.compile(expression, error))
+    {
+        std::wcout << L"Invalid filter: " << error.c_str() << L"\n";
+        return;
+    }
 
+    // Matching rows, largest memory first; table rows and list entries line up
+    const ProcessTable& table = processManager.getProcessTable();
+    const std::vector<ProcessInfo>& list = processManager.getProcessList();
+    std::vector<uint8_t> mask;
+    filter.evaluate(table, processNames(), mask);
+    std::vector<ProcessInfo> matches;
+    for (uint32_t row = 0; row < table.size(); ++row)
+    {
+        if (mask[row])
+            matches.push_back(list[row]);
     }
+    if (matches.empty())
+    {
+        std::wcout << L"No process matches.\n";
+        return;
+    }
+    std::stable_sort(matches.begin(), matches.end(), [](const ProcessInfo& a, const ProcessInfo& b)
+        {
+            if (a.isAccessible != b.isAccessible)
+                return a.isAccessible;
+            return a.memoryUsage > b.memoryUsage;
+        });
+
+    std::wcout << L"\n" << matches.size() << L" of " << table.size() << L" processes match:\n";
+    processManager.printProcessList(matches);
+
+    std::wstring answer;
+    std::wcout << L"Terminate these processes? (y/n): ";
+    std::getline(std::wcin, answer);
+    if (answer != L"y" && answer != L"Y")
+        return;
+    TerminationOptions options;
+    if (!askGracePeriod(options))
+        return;
+    std::vector<DWORD> pids;
+    for (const ProcessInfo& proc : matches)
+        pids.push_back(proc.pid);
+    processManager.terminateProcesses(pids, options);
 }
 
-void Menu::printGroupedProcessesLive(const std::vector<ProcessInfo>& processList, std::map<std::wstring, size_t>& previousMemory)
+void Menu::showMemoryDetails()
 {
-    std::map<std::wstring, ProcessGroup> currentGroups;
+    std::wstring input;
+    std::wcout << L"How many processes (Enter for 20): ";
+    std::getline(std::wcin, input);
+    unsigned long long count = 20;
+    if (!input.empty() && (!parseUnsignedInput(input, count) || count == 0))
+    {
+        std::wcout << L"Invalid count.\n";
+        return;
+    }
+
+    // The sampler reads the breakdown of the largest processes every tick and of the rest
+    // now and then; reading everything here takes a file (or working set walk) per process
+    std::wcout << L"Read the breakdown of every process now? (y/n): ";
+    std::getline(std::wcin, input);
+    if (input == L"y" || input == L"Y")
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t read = processManager.refreshMemoryDetail(0);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::wcout << L"Read " << read << L" breakdowns in " << elapsed.count() << L" ms.\n";
+    }
+
+    const std::vector<ProcessInfo>& list = processManager.getProcessList();
+    std::vector<size_t> rows(list.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+        rows[i] = i;
+    size_t shown = static_cast<size_t>(std::min<unsigned long long>(count, rows.size()));
+    std::partial_sort(rows.begin(), rows.begin() + shown, rows.end(),
+        [&list](size_t a, size_t b) { return list[a].memoryUsage > list[b].memoryUsage; });
+
+    const int nameWidth = 24;
+    TextRow line;
+    line.text(L"PID", 10).text(L"Name", nameWidth).text(L"RSS", 12).text(L"PSS", 12).text(L"USS", 12)
+        .text(L"Shared", 12).text(L"Swap", 12).text(L"Peak", 12).text(L"Faults", 12).text(L"Major").print(std::wcout);
+    line.repeat(L'-', 10 + nameWidth + 12 * 7 + 8).print(std::wcout);
+
+    for (size_t i = 0; i < shown; ++i)
+    {
+        const ProcessInfo& proc = list[rows[i]];
+        line.number(proc.pid, 10).text(processManager.cleanName(proc.name), nameWidth);
+        if (!proc.isAccessible)
+        {
+            line.text(L"Access Denied").print(std::wcout);
+            continue;
+        }
+        line.memory(proc.memoryUsage, 12);
+        if (proc.memoryDetailRefresh != 0)
+        {
+            line.memory(proc.memoryDetail.proportional, 12).memory(proc.memoryDetail.unique, 12)
+                .memory(proc.memoryDetail.shared, 12).memory(proc.memoryDetail.swap, 12);
+        }
+        else
+        {
+            line.text(L"-", 12).text(L"-", 12).text(L"-", 12).text(L"-", 12);
+        }
+        line.memory(proc.peakMemory, 12).number(proc.pageFaults, 12).number(proc.majorFaults).print(std::wcout);
+    }
 
-    // Group current processes by cleaned name
-    for (size_t i = 0; i < processList.size(); ++i)
+    // The gap between the two sums is what counting shared pages once per process adds
+    unsigned long long residentTotal = 0;
+    unsigned long long proportionalTotal = 0;
+    size_t detailed = 0;
+    for (const ProcessInfo& proc : list)
     {
-        const ProcessInfo& proc = processList[i];
-        if (!proc.isAccessible) continue;
+        if (proc.memoryDetailRefresh == 0)
+            continue;
+        residentTotal += proc.memoryUsage;
+        proportionalTotal += proc.memoryDetail.proportional;
+        ++detailed;
+    }
+    std::wcout << L"\n" << detailed << L" of " << list.size() << L" processes have a breakdown: RSS adds up to "
+        << formatMemory(static_cast<size_t>(residentTotal)) << L", PSS to " << formatMemory(static_cast<size_t>(proportionalTotal)) << L".\n";
+}
+
+void Menu::showActivity()
+{
+    static const SortKey keys[] = { SortKey::Io, SortKey::ReadRate, SortKey::WriteRate, SortKey::IoOps,
+        SortKey::Threads, SortKey::Handles, SortKey::ContextSwitches };
 
-        std::wstring name = processManager.cleanName(proc.name);
-        currentGroups[name].count++;
-        currentGroups[name].totalMemory += proc.memoryUsage;
+    std::wcout << L"Order by:\n";
+    std::wcout << L"1. Disk I/O (read + write per second)\n";
+    std::wcout << L"2. Reads per second\n";
+    std::wcout << L"3. Writes per second\n";
+    std::wcout << L"4. I/O calls per second\n";
+    std::wcout << L"5. Threads\n";
+    std::wcout << L"6. Handles / open files\n";
+    std::wcout << L"7. Context switches per second\n";
+    std::wcout << L"Enter choice: ";
+    std::wstring input;
+    std::getline(std::wcin, input);
+    unsigned long long choice = 0;
+    if (!parseUnsignedInput(input, choice) || choice < 1 || choice > 7)
+    {
+        std::wcout << L"Invalid choice!\n";
+        return;
     }
+    SortKey key = keys[choice - 1];
 
-    // Find max name length
-    size_t maxNameLength = 12;
-    for (std::map<std::wstring, ProcessGroup>::iterator it = currentGroups.begin(); it != currentGroups.end(); ++it)
+    std::wcout << L"Group by name? (y/n): ";
+    std::getline(std::wcin, input);
+    const size_t shown = 30;
+    if (input == L"y" || input == L"Y")
     {
-        if (it->first.length() > maxNameLength)
-            maxNameLength = it->first.length();
+        processManager.printGroupedActivity(key, shown);
+    }
+    else
+    {
+        processManager.sortBy({ { SortKey::Accessible, false }, { key, true }, { SortKey::Memory, true } });
+        processManager.printActivity(shown);
     }
 
-    std::wcout << std::left
-        << std::setw(static_cast<int>(maxNameLength) + 4) << L"Process Name"
-        << std::setw(12) << L"Instances"
-        << std::setw(15) << L"Memory"
-        << L"Delta\n";
-    std::wcout << std::wstring(maxNameLength + 36, L'-') << L"\n";
+    // Rates need two refreshes of the same process
+    std::wcout << L"\nRates are per second over the last sampling interval.\n";
+}
 
-    // Display each group
-    for (std::map<std::wstring, ProcessGroup>::iterator it = currentGroups.begin(); it != currentGroups.end(); ++it)
+void Menu::showProcessTree()
+{
+    std::wstring input;
+    std::wcout << L"Root PID (Enter for the whole tree): ";
+    std::getline(std::wcin, input);
+    unsigned long long rootPid = 0;
+    bool wholeTree = input.empty();
+    if (!wholeTree && (!parseUnsignedInput(input, rootPid) || rootPid > 0xFFFFFFFFull))
     {
-        const std::wstring& name = it->first;
-        const ProcessGroup& group = it->second;
+        std::wcout << L"Invalid PID.\n";
+        return;
+    }
 
-        size_t prevMem = previousMemory.count(name) ? previousMemory[name] : 0;
-        size_t currMem = group.totalMemory;
+    std::wcout << L"Maximum depth (Enter for no limit): ";
+    std::getline(std::wcin, input);
+    unsigned long long maxDepth = ~0ULL;
+    if (!input.empty() && !parseUnsignedInput(input, maxDepth))
+    {
+        std::wcout << L"Invalid depth.\n";
+        return;
+    }
 
-        std::wstring deltaStr;
-        if (previousMemory.count(name))
+    const ProcessTable& table = processManager.getProcessTable();
+    const ProcessTree& tree = processManager.getProcessTree();
+    const NamePool& names = processNames();
+
+    std::vector<uint32_t> starts;
+    if (wholeTree)
+    {
+        starts = tree.roots();
+    }
+    else
+    {
+        uint32_t row = tree.findRow(static_cast<DWORD>(rootPid));
+        if (row == ProcessTree::NoRow)
         {
-            long long delta = static_cast<long long>(currMem) - static_cast<long long>(prevMem);
-            if (delta > 0)
-                deltaStr = L"+" + formatMemory(delta);
-            else if (delta < 0)
-                deltaStr = L"-" + formatMemory(-delta);
-            else
-                deltaStr = L"0 MB";
+            std::wcout << L"No process with PID " << rootPid << L".\n";
+            return;
         }
+        starts.push_back(row);
+    }
+
+    // Siblings largest subtree first, so the heavy branches lead
+    auto bySubtreeMemory = [&tree](uint32_t a, uint32_t b)
+        {
+            if (tree.subtreeMemory(a) != tree.subtreeMemory(b))
+                return tree.subtreeMemory(a) > tree.subtreeMemory(b);
+            return a < b;
+        };
+    std::sort(starts.begin(), starts.end(), bySubtreeMemory);
+
+    const int nameWidth = 40;
+    TextRow line;
+    line.text(L"PID", 10).text(L"Name", nameWidth).text(L"Memory", 15).text(L"Tree Memory", 15)
+        .text(L"Tree CPU", 10).text(L"Processes", 10).print(std::wcout);
+    line.repeat(L'-', 10 + nameWidth + 15 + 15 + 10 + 10).print(std::wcout);
+
+    // Depth-first with an explicit stack of (row, depth below the first row shown)
+    std::vector<std::pair<uint32_t, uint32_t>> pending;
+    for (auto it = starts.rbegin(); it != starts.rend(); ++it)
+        pending.emplace_back(*it, 0);
+    std::vector<uint32_t> siblings;
+    std::wstring label;
+    while (!pending.empty())
+    {
+        uint32_t row = pending.back().first;
+        uint32_t depth = pending.back().second;
+        pending.pop_back();
+
+        label.assign(depth * 2, L' ');
+        label += names.display(table.nameId[row]);
+        line.number(table.pid[row], 10).text(label, nameWidth);
+        if (table.accessible(row))
+            line.memory(table.memory[row], 15);
         else
+            line.text(L"Access Denied", 15);
+        line.memory(tree.subtreeMemory(row), 15).cpu(static_cast<long long>(tree.subtreeCpu(row)), 10)
+            .number(tree.subtreeSize(row), 10).print(std::wcout);
+
+        if (tree.childCount(row) == 0)
+            continue;
+        if (depth >= maxDepth)
         {
-            deltaStr = L"N/A";
+            label.assign((depth + 1) * 2, L' ');
+            label += L"... " + std::to_wstring(tree.subtreeSize(row) - 1) + L" more";
+            line.text(L"", 10).text(label, nameWidth).print(std::wcout);
+            continue;
         }
+        siblings.assign(tree.children(row), tree.children(row) + tree.childCount(row));
+        std::sort(siblings.begin(), siblings.end(), bySubtreeMemory);
+        for (auto it = siblings.rbegin(); it != siblings.rend(); ++it)
+            pending.emplace_back(*it, depth + 1);
+    }
+
+    std::wcout << L"PID of a subtree to terminate (Enter to skip): ";
+    std::getline(std::wcin, input);
+    unsigned long long target = 0;
+    if (input.empty())
+        return;
+    if (!parseUnsignedInput(input, target) || target > 0xFFFFFFFFull)
+    {
+        std::wcout << L"Invalid PID.\n";
+        return;
+    }
+    uint32_t targetRow = tree.findRow(static_cast<DWORD>(target));
+    if (targetRow == ProcessTree::NoRow)
+    {
+        std::wcout << L"No process with PID " << target << L".\n";
+        return;
+    }
+
+    std::wcout << L"Terminate " << names.display(table.nameId[targetRow]) << L" (PID " << target << L") and "
+        << tree.subtreeSize(targetRow) - 1 << L" processes below it? (y/n): ";
+    std::getline(std::wcin, input);
+    if (input != L"y" && input != L"Y")
+    {
+        std::wcout << L"Cancelled.\n";
+        return;
+    }
+    TerminationOptions options;
+    if (askGracePeriod(options))
+        processManager.terminateProcessTree(static_cast<DWORD>(target), options);
+}
+
+void Menu::printTopGrowers()
+{
+    const NamePool& names = processNames();
+    const MetricsHistory& history = sampler.history();
+    const std::chrono::seconds window = std::chrono::minutes(10);
+
+    std::vector<HistoryGrowth> groups = history.topGrowers(10, window, true);
+    std::vector<HistoryGrowth> processes = history.topGrowers(10, window, false);
+
+    TextRow line;
+    std::wcout << L"\nProcess groups:\n";
+    line.text(L"Process Name", 30).text(L"Growth", 15).text(L"Memory").print(std::wcout);
+    line.repeat(L'-', 60).print(std::wcout);
+    for (const HistoryGrowth& group : groups)
+    {
+        line.text(names.display(group.nameId), 30)
+            .memoryChange(group.growth, 15)
+            .memory(group.current)
+            .print(std::wcout);
+    }
+
+    std::wcout << L"\nProcesses:\n";
+    line.text(L"PID", 10).text(L"Name", 30).text(L"Growth", 15).text(L"Memory").print(std::wcout);
+    line.repeat(L'-', 70).print(std::wcout);
+    for (const HistoryGrowth& proc : processes)
+    {
+        line.number(proc.pid, 10)
+            .text(names.display(proc.nameId), 30)
+            .memoryChange(proc.growth, 15)
+            .memory(proc.current)
+            .print(std::wcout);
+    }
+}
+
+void Menu::printLeakSuspects(const std::vector<LeakSuspect>& suspects)
+{
+    const NamePool& names = processNames();
+
+    TextRow line, rate, duration;
+    line.text(L"PID", 10).text(L"Name", 30).text(L"Rate", 16).text(L"Growing For", 14)
+        .text(L"Growth", 15).text(L"Memory").print(std::wcout);
+    line.repeat(L'-', 95).print(std::wcout);
 
-        previousMemory[name] = currMem;
+    for (const LeakSuspect& suspect : suspects)
+    {
+        // "+1.00 MB/min" and "120 s" are built first so each pads as one field
+        rate.clear().memoryChange(static_cast<long long>(suspect.slope * 60)).text(L"/min");
+        duration.clear().number(static_cast<unsigned long long>(suspect.growingFor)).text(L" s");
 
-        std::wcout << std::left
-            << std::setw(static_cast<int>(maxNameLength) + 4) << name
-            << std::setw(12) << group.count
-            << std::setw(15) << formatMemory(currMem)
-            << deltaStr << L"\n";
+        line.number(suspect.pid, 10)
+            .text(names.display(suspect.nameId), 30)
+            .text(rate.data(), rate.size(), 16)
+            .text(duration.data(), duration.size(), 14)
+            .memoryChange(suspect.growth, 15)
+            .memory(suspect.current)
+            .print(std::wcout);
     }
 }
 
 void Menu::searchProcessesByName()
 {
     std::wstring searchTerm;
-    std::wcout << L"Enter the program name or full path to launch (e.g. notepad.exe): ";
+    std::wcout << L"Enter part of the process name to search for.\n"
+        << L"Use * and ? for a wildcard match of the whole name, =name for an exact name,\n"
+        << L"^text for names starting with text, or re:pattern for a regular expression: ";
     std::getline(std::wcin, searchTerm);
 
     if (searchTerm.empty()) 
@@ -198,31 +739,532 @@ void Menu::searchProcessesByName()
         return;
     }
 
-    const auto& list = processManager.getProcessList();
-    std::vector<ProcessInfo> matches;
+    SearchMode mode = SearchMode::Substring;
+    if (searchTerm.compare(0, 3, L"re:") == 0)
+    {
+        mode = SearchMode::Regex;
+        searchTerm.erase(0, 3);
+    }
+    else if (searchTerm[0] == L'=')
+    {
+        mode = SearchMode::Exact;
+        searchTerm.erase(0, 1);
+    }
+    else if (searchTerm[0] == L'^')
+    {
+        mode = SearchMode::Prefix;
+        searchTerm.erase(0, 1);
+    }
+    else if (searchTerm.find_first_of(L"*?") != std::wstring::npos)
+    {
+        mode = SearchMode::Glob;
+    }
+
+    std::vector<DWORD> pids;
+    std::string error;
+    if (!processManager.getSearchIndex().find(mode, searchTerm, pids, error))
+    {
+        std::wcout << L"Invalid regular expression: " << error.c_str() << L"\n";
+        return;
+    }
+
+    if (pids.empty()) 
+    {
+        std::wcout << L"No matching processes found.\n";
+        return;
+    }
+
+    std::wcout << L"\nMatching Processes:\n";
+    processManager.printProcessList(processManager.getProcessesByPid(pids)); 
+}
+
+void Menu::manageAlerts()
+{
+    AlertEngine& alerts = sampler.alerts();
+    std::vector<AlertRule> rules = alerts.rules();
+    std::vector<ActiveAlert> active = alerts.active(std::chrono::steady_clock::now());
 
-    for (const auto& proc : list) 
+    TextRow line;
+    if (rules.empty())
     {
-        std::wstring clean = processManager.cleanName(proc.name);
-        std::wstring lowerName = clean;
-        std::wstring lowerSearch = searchTerm;
-        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::towlower);
-        std::transform(lowerSearch.begin(), lowerSearch.end(), lowerSearch.begin(), ::towlower);
+        std::wcout << L"\nNo alert rules yet.\n";
+    }
+    else
+    {
+        std::wcout << L"\nRules:\n";
+        for (size_t i = 0; i < rules.size(); ++i)
+        {
+            size_t firing = static_cast<size_t>(std::count_if(active.begin(), active.end(), [i](const ActiveAlert& alert) { return alert.rule == i; }));
+            line.number(i + 1, 5).text(rules[i].text);
+            if (firing > 0)
+                line.text(L"  [active: ").number(firing).text(L"]");
+            line.print(std::wcout);
+        }
+    }
 
-        if (lowerName.find(lowerSearch) != std::wstring::npos)
+    if (!active.empty())
+    {
+        std::wcout << L"\nActive alerts:\n";
+        line.text(L"Rule", 6).text(L"PID", 10).text(L"Name", 30).text(L"Held For").print(std::wcout);
+        line.repeat(L'-', 60).print(std::wcout);
+        for (const ActiveAlert& alert : active)
         {
-            matches.push_back(proc);
+            line.number(alert.rule + 1, 6);
+            if (alert.pid != 0)
+                line.number(alert.pid, 10);
+            else
+                line.text(L"-", 10);
+            line.text(alert.name, 30).number(static_cast<unsigned long long>(alert.heldFor)).text(L" s").print(std::wcout);
         }
     }
 
-    if (matches.empty()) 
+    std::vector<std::wstring> recent = alerts.recentLog(10);
+    if (!recent.empty())
     {
-        std::wcout << L"No matching processes found.\n";
+        std::wcout << L"\nRecent log:\n";
+        for (const std::wstring& entry : recent)
+            std::wcout << L"  " << entry << L"\n";
+    }
+
+    std::wcout << L"\n1. Add a rule\n";
+    std::wcout << L"2. Remove a rule\n";
+    std::wcout << L"3. Load rules from a file\n";
+    std::wcout << L"4. Show the whole log\n";
+    std::wcout << L"0. Back\n";
+    std::wcout << L"Enter choice: ";
+
+    int choice = 0;
+    std::wcin >> choice;
+    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::string error;
+    switch (choice)
+    {
+    case 1:
+    {
+        std::wcout << AlertEngine::syntax() << L"Enter the rule: ";
+        std::wstring text;
+        std::getline(std::wcin, text);
+        if (text.empty())
+            std::wcout << L"No input given. Returning to menu.\n";
+        else if (alerts.addRule(text, error))
+            std::wcout << L"Rule added; it is checked from the next sample on.\n";
+        else
+            std::wcout << L"Invalid rule: " << error.c_str() << L"\n";
+        break;
+    }
+    case 2:
+    {
+        std::wcout << L"Enter the number of the rule to remove: ";
+        std::wstring text;
+        std::getline(std::wcin, text);
+        unsigned long long number = 0;
+        if (!parseUnsignedInput(text, number) || number == 0 || !alerts.removeRule(static_cast<size_t>(number - 1)))
+            std::wcout << L"No such rule.\n";
+        else
+            std::wcout << L"Rule removed.\n";
+        break;
+    }
+    case 3:
+    {
+        std::wcout << L"Enter the rules file: ";
+        std::wstring path;
+        std::getline(std::wcin, path);
+        if (path.empty())
+            std::wcout << L"No input given. Returning to menu.\n";
+        else if (alerts.loadRules(toNarrow(path), error))
+            std::wcout << L"Rules loaded; there are " << alerts.rules().size() << L" now.\n";
+        else
+            std::wcout << L"Could not load the rules: " << error.c_str() << L"\n";
+        break;
+    }
+    case 4:
+        for (const std::wstring& entry : alerts.recentLog(~size_t(0)))
+            std::wcout << L"  " << entry << L"\n";
+        break;
+    case 0:
+        break;
+    default:
+        std::wcout << L"Invalid choice!\n";
+        break;
+    }
+}
+
+void Menu::manageGuard()
+{
+    ResourceGuard& guard = sampler.guard();
+    std::vector<GuardPolicy> policies = guard.policies();
+    std::vector<GuardStatus> status = guard.status();
+
+    TextRow line;
+    if (policies.empty())
+    {
+        std::wcout << L"\nNo guard policies yet.\n";
+    }
+    else
+    {
+        std::wcout << L"\nPolicies:\n";
+        for (size_t i = 0; i < policies.size(); ++i)
+            line.number(i + 1, 5).text(policies[i].text).print(std::wcout);
+    }
+
+    if (!status.empty())
+    {
+        std::wcout << L"\nGuarded groups:\n";
+        line.text(L"Policy", 8).text(L"Name", 30).text(L"Count", 8).text(L"Memory", 14).text(L"CPU", 10)
+            .text(L"Killed", 8).text(L"State").print(std::wcout);
+        line.repeat(L'-', 88).print(std::wcout);
+        for (const GuardStatus& group : status)
+        {
+            line.number(group.policy + 1, 8).text(group.name, 30).number(group.instances, 8)
+                .memory(group.memory, 14).cpu(std::llround(group.cpu * 100.0), 10)
+                .number(group.kills, 8).text(group.over ? L"OVER" : L"ok").print(std::wcout);
+        }
+    }
+
+    std::vector<std::wstring> recent = guard.recentLog(10);
+    if (!recent.empty())
+    {
+        std::wcout << L"\nRecent log:\n";
+        for (const std::wstring& entry : recent)
+            std::wcout << L"  " << entry << L"\n";
+    }
+
+    std::wcout << L"\n1. Add a policy\n";
+    std::wcout << L"2. Load policies from a file\n";
+    std::wcout << L"3. Show the whole log\n";
+    std::wcout << L"0. Back\n";
+    std::wcout << L"Enter choice: ";
+
+    int choice = 0;
+    std::wcin >> choice;
+    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::string error;
+    switch (choice)
+    {
+    case 1:
+    {
+        std::wcout << ResourceGuard::syntax() << L"Enter the policy: ";
+        std::wstring text;
+        std::getline(std::wcin, text);
+        if (text.empty())
+            std::wcout << L"No input given. Returning to menu.\n";
+        else if (guard.addPolicy(text, error))
+            std::wcout << L"Policy added; it is enforced from the next sample on.\n";
+        else
+            std::wcout << L"Invalid policy: " << error.c_str() << L"\n";
+        break;
+    }
+    case 2:
+    {
+        std::wcout << L"Enter the policies file: ";
+        std::wstring path;
+        std::getline(std::wcin, path);
+        if (path.empty())
+            std::wcout << L"No input given. Returning to menu.\n";
+        else if (guard.loadPolicies(toNarrow(path), error))
+            std::wcout << L"Policies loaded; there are " << guard.policies().size() << L" now.\n";
+        else
+            std::wcout << L"Could not load the policies: " << error.c_str() << L"\n";
+        break;
+    }
+    case 3:
+        for (const std::wstring& entry : guard.recentLog(~size_t(0)))
+            std::wcout << L"  " << entry << L"\n";
+        break;
+    case 0:
+        break;
+    default:
+        std::wcout << L"Invalid choice!\n";
+        break;
+    }
+}
+
+void Menu::chooseMemoryUnit()
+{
+    std::wcout << L"Show memory in:\n";
+    std::wcout << L"1. MB, GB above 1 GB (default)\n";
+    std::wcout << L"2. KB\n";
+    std::wcout << L"3. MB\n";
+    std::wcout << L"4. GB\n";
+    std::wcout << L"5. Bytes\n";
+    std::wcout << L"Enter choice: ";
+
+    int choice = 0;
+    std::wcin >> choice;
+    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    static const MemoryUnit units[] = { MemoryUnit::Auto, MemoryUnit::KB, MemoryUnit::MB, MemoryUnit::GB, MemoryUnit::Bytes };
+    if (choice < 1 || choice > 5)
+    {
+        std::wcout << L"Invalid choice!\n";
         return;
     }
+    setDisplayMemoryUnit(units[choice - 1]);
+}
 
-    std::wcout << L"\nMatching Processes:\n";
-    processManager.printProcessList(matches); 
+void Menu::toggleRecording()
+{
+    if (sampler.isRecording())
+    {
+        unsigned long long frames = sampler.stopRecording();
+        std::wcout << L"Recording stopped after " << frames << L" frames.\n";
+        return;
+    }
+
+    std::wstring path;
+    std::wcout << L"Enter the file to record to: ";
+    std::getline(std::wcin, path);
+    if (path.empty())
+    {
+        std::wcout << L"No input given. Returning to menu.\n";
+        return;
+    }
+
+    if (sampler.startRecording(toNarrow(path)))
+        std::wcout << L"Recording every snapshot to " << path << L". Choose 12 again to stop.\n";
+    else
+        std::wcout << L"Could not create " << path << L".\n";
+}
+
+void Menu::toggleMetricsEndpoint()
+{
+    if (metricsExporter && metricsExporter->isRunning())
+    {
+        metricsExporter->stop();
+        std::wcout << L"Metrics endpoint stopped after " << metricsExporter->scrapesServed() << L" scrapes.\n";
+        metricsExporter.reset();
+        return;
+    }
+
+    int port = -1;
+    std::wcout << L"Enter the port to serve on (0 picks a free one): ";
+    std::wcin >> port;
+    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (port < 0 || port > 65535)
+    {
+        std::wcout << L"Invalid port. Returning to menu.\n";
+        return;
+    }
+
+    metricsExporter = std::make_unique<MetricsExporter>(sampler);
+    std::string error;
+    if (!metricsExporter->start("127.0.0.1", static_cast<uint16_t>(port), error))
+    {
+        std::wcout << L"Could not start the endpoint: " << error.c_str() << L".\n";
+        metricsExporter.reset();
+        return;
+    }
+    std::wcout << L"Serving metrics at http://127.0.0.1:" << metricsExporter->port()
+        << L"/metrics. Choose 14 again to stop.\n";
 }
 
+void Menu::replayRecording()
+{
+    std::wstring path;
+    std::wcout << L"Enter the recording to replay: ";
+    std::getline(std::wcin, path);
+    if (path.empty())
+    {
+        std::wcout << L"No input given. Returning to menu.\n";
+        return;
+    }
 
+    SnapshotReplay replay;
+    std::string error;
+    if (!replay.open(toNarrow(path), error))
+    {
+        std::wcout << L"Cannot replay " << path << L": " << error.c_str() << L"\n";
+        return;
+    }
+    long long start = replay.startTime();
+    std::wcout << replay.frameCount() << L" frames over " << (replay.endTime() - start) / 1000.0 << L" seconds.\n";
+    replay.next();
+
+    // The replayed frame stands in for the live snapshot until the menu syncs again
+    int choice = -1;
+    while (choice != 0)
+    {
+        processManager.loadProcessList(replay.processes(), replay.delta());
+        std::wcout << L"\nFrame " << replay.frameIndex() + 1 << L" of " << replay.frameCount()
+            << L", " << (replay.time() - start) / 1000.0 << L" s in, " << replay.processes().size() << L" processes\n";
+        std::wcout << L"1. Next Frame\n";
+        std::wcout << L"2. Jump to Time\n";
+        std::wcout << L"3. Sort by Name\n";
+        std::wcout << L"4. Sort by Memory Size\n";
+        std::wcout << L"5. Sort by CPU Usage\n";
+        std::wcout << L"6. All Processes by Memory\n";
+        std::wcout << L"0. Back\n";
+        std::wcout << L"Enter choice: ";
+        std::wcin >> choice;
+        std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+        switch (choice)
+        {
+        case 1:
+            if (!replay.next())
+                std::wcout << L"End of the recording.\n";
+            break;
+        case 2:
+        {
+            std::wcout << L"Seconds from the start: ";
+            double seconds = 0;
+            std::wcin >> seconds;
+            std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            if (!replay.seek(start + static_cast<long long>(seconds * 1000.0)))
+                std::wcout << L"The recording is damaged at that point.\n";
+            break;
+        }
+        case 3:
+            pageThrough(L"Groups", [this](size_t first, size_t count) { return processManager.printGroupedProcessesByName(first, count); });
+            break;
+        case 4:
+            pageThrough(L"Groups", [this](size_t first, size_t count) { return processManager.printGroupedProcessesByMemory(first, count); });
+            break;
+        case 5:
+            pageThrough(L"Groups", [this](size_t first, size_t count) { return processManager.printGroupedProcessesByCpu(first, count); });
+            break;
+        case 6:
+            pageThrough(L"Processes", [this](size_t first, size_t count)
+                {
+                    return processManager.printProcessPage({ { SortKey::Accessible, false }, { SortKey::Memory, true } }, first, count);
+                });
+            break;
+        case 0:
+            break;
+        default:
+            std::wcout << L"Invalid choice!\n";
+            break;
+        }
+    }
+}
+
+void Menu::runBenchmark()
+{
+    std::wcout << L"Choose a benchmark:\n";
+    std::wcout << L"1. Refresh backend (500 to 50k PIDs)\n";
+    std::wcout << L"2. Collection thread scaling\n";
+    std::wcout << L"3. Process table sort and grouping\n";
+    std::wcout << L"4. Grouping engine\n";
+    std::wcout << L"5. Metrics history (20k PIDs, one hour at 1 Hz)\n";
+    std::wcout << L"6. Live view rendering (2k groups)\n";
+    std::wcout << L"7. Table formatting (100k rows)\n";
+    std::wcout << L"8. Headless export formats (20k processes)\n";
+    std::wcout << L"9. Snapshot recording and replay (5k processes, one hour)\n";
+    std::wcout << L"10. Metrics endpoint (20k processes, concurrent scrapers)\n";
+    std::wcout << L"11. Process name search (50k processes)\n";
+    std::wcout << L"12. Filter expressions (50k processes)\n";
+    std::wcout << L"13. Process tree and subtree totals (50k processes)\n";
+    std::wcout << L"14. Bulk termination (1000 child processes)\n";
+    std::wcout << L"15. Batch launcher (10k short-lived processes)\n";
+    std::wcout << L"16. Memory collection tiers (RSS vs PSS/USS/swap)\n";
+    std::wcout << L"17. Top-N selection and paged views (50k processes)\n";
+    std::wcout << L"18. Alert rules (500 rules, 20k processes)\n";
+    std::wcout << L"19. Resource guard (tick cost and reaction time)\n";
+    std::wcout << L"Enter choice: ";
+
+    int choice = 0;
+    std::wcin >> choice;
+    std::wcin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::wcout << L"Running benchmark, this can take a while...\n";
+    switch (choice)
+    {
+    case 1:
+        runRefreshBenchmark();
+        break;
+    case 2:
+        runCollectionScalingBenchmark();
+        break;
+    case 3:
+        runProcessTableBenchmark();
+        break;
+    case 4:
+        runGroupingBenchmark();
+        break;
+    case 5:
+        runHistoryBenchmark();
+        break;
+    case 6:
+        runLiveViewBenchmark();
+        break;
+    case 7:
+        runFormattingBenchmark();
+        break;
+    case 8:
+        runExportBenchmark();
+        break;
+    case 9:
+        runRecordingBenchmark();
+        break;
+    case 10:
+        runMetricsExporterBenchmark();
+        break;
+    case 11:
+        runSearchBenchmark();
+        break;
+    case 12:
+        runFilterBenchmark();
+        break;
+    case 13:
+        runProcessTreeBenchmark();
+        break;
+    case 14:
+        runTerminationBenchmark();
+        break;
+    case 15:
+        runLaunchBenchmark();
+        break;
+    case 16:
+        runMemoryDetailBenchmark();
+        break;
+    case 17:
+        runTopNBenchmark();
+        break;
+    case 18:
+        runAlertBenchmark();
+        break;
+    case 19:
+        runGuardBenchmark();
+        break;
+    default:
+        std::wcout << L"Invalid choice!\n";
+        break;
+    }
+}
+
+void Menu::pageThrough(const wchar_t* what, const std::function<size_t(size_t, size_t)>& printPage)
+{
+    size_t first = 0;
+    std::wstring input;
+    while (true)
+    {
+        size_t total = printPage(first, PageSize);
+        size_t last = std::min(first + PageSize, total);
+        std::wcout << L"\n" << what << L" " << (total ? first + 1 : 0) << L"-" << last << L" of " << total << L". ";
+        if (last < total)
+            std::wcout << L"n = next page, ";
+        if (first > 0)
+            std::wcout << L"p = previous page, ";
+        std::wcout << L"Enter = back: ";
+
+        if (!std::getline(std::wcin, input))
+            return;
+        if ((input == L"n" || input == L"N") && last < total)
+            first += PageSize;
+        else if ((input == L"p" || input == L"P") && first > 0)
+            first -= PageSize;
+        else
+            return;
+    }
+}
+
+void Menu::syncWithSampler()
+{
+    SnapshotHandle snapshot = sampler.acquire();
+    if (snapshot)
+    {
+        processManager.loadProcessList(snapshot->processes, snapshot->delta);
+    }
+}
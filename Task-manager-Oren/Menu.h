@@ -1,21 +1,32 @@
 #pragma once
 
+#include "LiveView.h"
+#include "MetricsExporter.h"
 #include "ProcessManager.h"
 #include "ProcessLauncher.h"
+#include "ProcessSampler.h"
+#include "TerminalRenderer.h"
 #include <chrono>
+#include <functional>
+#include <memory>
 #include <thread>
+#ifdef _WIN32
 #include <conio.h> 
+#endif
 // Class to handle the user interface menu
 class Menu
 {
 public:
-    // Constructor takes a reference to the ProcessManager to interact with processes
-    Menu(ProcessManager& pm);
+    // Constructor takes the ProcessManager used for the views and the sampler feeding it
+    Menu(ProcessManager& pm, ProcessSampler& sampler);
 
     // Main loop to run the menu until user exits
     void runMenu();
 
 private:
+    // Entries per page of the paged views
+    static constexpr size_t PageSize = 20;
+
     // Prints the menu options to the console
     void printMenu();
 
@@ -25,19 +36,77 @@ private:
     //Dunction for terminating processes
     void terminateProcessByName();
 
+    //function for asking how long processes get to exit before they are killed
+    bool askGracePeriod(TerminationOptions& options);
+
+    //function for starting a batch of commands, or following the one that is running
+    void runBatch();
+
     //function for live monitoring
     void liveMonitor();
 
-    //function for printing procsses in an orgenized manner
-    void printGroupedProcessesLive(const std::vector<ProcessInfo>& processList,
-        std::map<std::wstring, size_t>& previousMemory);
-
     //function to serch for procsses by name
     void searchProcessesByName();
 
+    //function for listing the processes that match a filter expression
+    void filterProcesses();
+
+    //function for showing the process tree and terminating a subtree
+    void showProcessTree();
+
+    //function for listing the largest processes with their memory breakdown (PSS/USS/swap)
+    void showMemoryDetails();
+
+    //function for listing the busiest processes or groups by I/O, threads, handles or context switches
+    void showActivity();
+
+    //function for listing the processes and groups that grew the most lately
+    void printTopGrowers();
+
+    //function for listing processes that look like they leak memory
+    void printLeakSuspects(const std::vector<LeakSuspect>& suspects);
+
+    //function for listing the alert rules, what has fired, and adding or removing rules
+    void manageAlerts();
+
+    //function for listing the guarded process groups, the guard's log, and adding policies
+    void manageGuard();
+
+    //function for picking the unit memory is shown in
+    void chooseMemoryUnit();
+
+    //function for starting or stopping a recording of the sampler's snapshots
+    void toggleRecording();
+
+    //function for starting or stopping the Prometheus metrics endpoint
+    void toggleMetricsEndpoint();
+
+    //function for stepping through a recording with the usual views
+    void replayRecording();
+
+    //function for timing the refresh backend
+    void runBenchmark();
+
+    //function for showing a view one page at a time; printPage(first, count) prints one page
+    //and returns how many entries the view has in total
+    void pageThrough(const wchar_t* what, const std::function<size_t(size_t, size_t)>& printPage);
+
+    //Copies the sampler's latest snapshot into the ProcessManager used for the views
+    void syncWithSampler();
+
     //Reference to ProcessLauncher instance for launching a new process
     ProcessLauncher processLauncher;
 
     // Reference to ProcessManager instance for accessing and managing processes
     ProcessManager& processManager;
+
+    // Background sampler that keeps collecting while the menu waits for input
+    ProcessSampler& sampler;
+
+    // Live view layout and the terminal it draws on (created on first use)
+    LiveView liveView;
+    std::unique_ptr<TerminalRenderer> liveScreen;
+
+    // Metrics endpoint fed by the sampler (while started from the menu)
+    std::unique_ptr<MetricsExporter> metricsExporter;
 };
@@ -0,0 +1,571 @@
+#include "MetricsExporter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET SocketHandle;
+typedef WSAPOLLFD PollEntry;
+static const SocketHandle NoSocket = INVALID_SOCKET;
+static int pollSockets(PollEntry* entries, size_t count, int timeoutMs) { return WSAPoll(entries, static_cast<ULONG>(count), timeoutMs); }
+static void closeSocket(SocketHandle s) { closesocket(s); }
+static bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+static const int SendFlags = 0;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+typedef pollfd PollEntry;
+static const SocketHandle NoSocket = -1;
+static int pollSockets(PollEntry* entries, size_t count, int timeoutMs) { return poll(entries, static_cast<nfds_t>(count), timeoutMs); }
+static void closeSocket(SocketHandle s) { close(s); }
+static bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+static const int SendFlags = MSG_NOSIGNAL;    // A scraper hanging up must not kill us with SIGPIPE
+#endif
+
+const char MetricsFormatter::EofMarker[] = "# EOF\n";
+
+static const size_t MaxConnections = 256;
+static const size_t RequestCapacity = 8192;
+static const std::chrono::seconds IdleTimeout(60);
+
+static bool setNonBlocking(SocketHandle s)
+{
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+MetricsFormatter::MetricsFormatter(size_t topGroups) : topGroups(topGroups)
+{
+}
+
+static void appendNumber(std::string& out, unsigned long long value)
+{
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, static_cast<size_t>(end - digits));
+}
+
+// Hundredths as a decimal with two places
+static void appendHundredths(std::string& out, unsigned long long hundredths)
+{
+    appendNumber(out, hundredths / 100);
+    out.push_back('.');
+    out.push_back(static_cast<char>('0' + hundredths % 100 / 10));
+    out.push_back(static_cast<char>('0' + hundredths % 10));
+}
+
+// Label value: UTF-8 with backslash, quote and newline escaped as the exposition format wants
+static void appendLabel(std::string& out, const std::wstring& value)
+{
+    for (wchar_t wc : value)
+    {
+        unsigned long c = static_cast<unsigned long>(wc);
+        if (c == '\\' || c == '"')
+        {
+            out.push_back('\\');
+            out.push_back(static_cast<char>(c));
+        }
+        else if (c == '\n')
+        {
+            out.append("\\n");
+        }
+        else if (c < 0x80)
+        {
+            out.push_back(static_cast<char>(c));
+        }
+        else if (c < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+    }
+}
+
+void MetricsFormatter::build(const ProcessTable& table, const NamePool& names, unsigned long long sequence,
+    long long unixMs, std::string& out)
+{
+    // Same grouping as the "sort by memory" view, but counting every instance
+    groups.group(table, names, GroupBy::Name, { Metric::Memory, Metric::Cpu }, true);
+    groups.orderBySum(0, order);
+
+    size_t shown = std::min(topGroups, order.size());
+    long long otherMemory = 0, otherCpu = 0, otherCount = 0;
+    for (size_t i = shown; i < order.size(); ++i)
+    {
+        otherMemory += groups.stats(order[i], 0).sum;
+        otherCpu += groups.stats(order[i], 1).sum;
+        otherCount += groups.count(order[i]);
+    }
+    bool haveOther = shown < order.size();
+
+    struct Family
+    {
+        const char* name;
+        const char* help;
+        int column;        // 0 memory, 1 CPU, 2 instances
+    };
+    static const Family families[] = {
+        { "taskmgr_group_memory_bytes", "Memory used by the processes with this name.", 0 },
+        { "taskmgr_group_cpu_percent", "CPU used by the processes with this name over the last tick, in percent of one core.", 1 },
+        { "taskmgr_group_instances", "Number of processes with this name.", 2 },
+    };
+
+    out.clear();
+    out.append("# HELP taskmgr_processes Number of processes on the host.\n# TYPE taskmgr_processes gauge\ntaskmgr_processes ");
+    appendNumber(out, table.size());
+    out.append("\n# HELP taskmgr_process_names Number of distinct process names.\n# TYPE taskmgr_process_names gauge\ntaskmgr_process_names ");
+    appendNumber(out, order.size());
+    out.append("\n# HELP taskmgr_snapshot_sequence Sampler tick the metrics were taken from.\n# TYPE taskmgr_snapshot_sequence gauge\ntaskmgr_snapshot_sequence ");
+    appendNumber(out, sequence);
+    out.append("\n# HELP taskmgr_snapshot_timestamp_seconds When the snapshot was taken.\n# TYPE taskmgr_snapshot_timestamp_seconds gauge\ntaskmgr_snapshot_timestamp_seconds ");
+    appendNumber(out, static_cast<unsigned long long>(unixMs / 1000));
+    out.push_back('.');
+    out.push_back(static_cast<char>('0' + unixMs % 1000 / 100));
+    out.push_back(static_cast<char>('0' + unixMs % 100 / 10));
+    out.push_back(static_cast<char>('0' + unixMs % 10));
+    out.push_back('\n');
+
+    for (const Family& family : families)
+    {
+        out.append("# HELP ").append(family.name).push_back(' ');
+        out.append(family.help).append("\n# TYPE ").append(family.name).append(" gauge\n");
+
+        for (size_t i = 0; i <= shown; ++i)
+        {
+            bool other = i == shown;
+            if (other && !haveOther)
+                break;
+
+            uint32_t group = other ? 0 : order[i];
+            out.append(family.name).append("{name=\"");
+            if (other)
+                out.append("(other)");
+            else
+                appendLabel(out, names.display(static_cast<uint32_t>(groups.key(group))));
+            out.append("\"} ");
+
+            if (family.column == 0)
+                appendNumber(out, static_cast<unsigned long long>(other ? otherMemory : groups.stats(group, 0).sum));
+            else if (family.column == 1)
+                appendHundredths(out, static_cast<unsigned long long>(other ? otherCpu : groups.stats(group, 1).sum));
+            else
+                appendNumber(out, static_cast<unsigned long long>(other ? otherCount : groups.count(group)));
+            out.push_back('\n');
+        }
+    }
+    out.append(EofMarker, EofMarkerLength);
+}
+
+// One client: its unparsed request bytes and the response being sent
+struct MetricsExporter::Connection
+{
+    SocketHandle socket = NoSocket;
+    char request[RequestCapacity];
+    size_t requestLength = 0;
+
+    char header[256];
+    size_t headerLength = 0;
+    size_t headerSent = 0;
+    std::shared_ptr<const std::string> page;    // Keeps the page alive while it is sent
+    const char* body = nullptr;
+    size_t bodyLeft = 0;
+
+    bool closeAfterResponse = false;
+    std::chrono::steady_clock::time_point lastActive;
+
+    bool sending() const { return headerSent < headerLength || bodyLeft > 0; }
+};
+
+MetricsExporter::MetricsExporter(ProcessSampler& sampler, size_t topGroups)
+    : sampler(sampler), formatter(topGroups)
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    stop();
+}
+
+bool MetricsExporter::start(const std::string& address, uint16_t port, std::string& error)
+{
+    if (running)
+        stop();
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        error = "cannot initialize Winsock";
+        return false;
+    }
+#endif
+
+    sockaddr_in bindAddress;
+    std::memset(&bindAddress, 0, sizeof(bindAddress));
+    bindAddress.sin_family = AF_INET;
+    bindAddress.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr) != 1)
+    {
+        error = "'" + address + "' is not an IPv4 address";
+        return false;
+    }
+
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == NoSocket)
+    {
+        error = "cannot create a socket";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    if (bind(s, reinterpret_cast<sockaddr*>(&bindAddress), sizeof(bindAddress)) != 0
+        || listen(s, 64) != 0 || !setNonBlocking(s))
+    {
+        closeSocket(s);
+        error = "cannot listen on " + address + ":" + std::to_string(port);
+        return false;
+    }
+
+    sockaddr_in bound;
+    socklen_t boundLength = sizeof(bound);
+    getsockname(s, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+    boundPort = ntohs(bound.sin_port);
+
+    listener = static_cast<intptr_t>(s);
+    running = true;
+    refresher = std::thread(&MetricsExporter::refreshLoop, this);
+    server = std::thread(&MetricsExporter::serveLoop, this);
+    return true;
+}
+
+void MetricsExporter::stop()
+{
+    if (!running.exchange(false))
+        return;
+
+    refresher.join();
+    server.join();
+    closeSocket(static_cast<SocketHandle>(listener));
+    listener = -1;
+    std::atomic_store(&page, std::shared_ptr<const std::string>());
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool MetricsExporter::isRunning() const
+{
+    return running;
+}
+
+uint16_t MetricsExporter::port() const
+{
+    return boundPort;
+}
+
+unsigned long long MetricsExporter::pagesBuilt() const
+{
+    return pages;
+}
+
+unsigned long long MetricsExporter::scrapesServed() const
+{
+    return scrapes;
+}
+
+void MetricsExporter::refreshLoop()
+{
+    const NamePool& names = processNames();
+    unsigned long long sequence = 0;
+    std::shared_ptr<std::string> spare;
+
+    while (running)
+    {
+        SnapshotHandle snapshot = sampler.waitForNewer(sequence, std::chrono::milliseconds(250));
+        if (!snapshot || snapshot->sequence <= sequence)
+            continue;
+        sequence = snapshot->sequence;
+
+        // The previous page is reused once no scraper holds it any more
+        std::shared_ptr<std::string> next = spare && spare.use_count() == 1 ? spare : std::make_shared<std::string>();
+        long long unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        formatter.build(snapshot->table, names, sequence, unixMs, *next);
+        snapshot.release();
+
+        std::shared_ptr<const std::string> previous = std::atomic_exchange(&page, std::shared_ptr<const std::string>(next));
+        spare = std::const_pointer_cast<std::string>(previous);
+        ++pages;
+    }
+}
+
+// Case-insensitive search inside the request header block
+static bool headerContains(const char* begin, const char* end, const char* text)
+{
+    size_t length = std::strlen(text);
+    for (const char* p = begin; p + length <= end; ++p)
+    {
+        size_t i = 0;
+        while (i < length && std::tolower(static_cast<unsigned char>(p[i])) == text[i])
+            ++i;
+        if (i == length)
+            return true;
+    }
+    return false;
+}
+
+bool MetricsExporter::handleRequest(Connection& connection)
+{
+    char* begin = connection.request;
+    char* end = begin + connection.requestLength;
+    const char terminator[] = "\r\n\r\n";
+    char* headersEnd = std::search(begin, end, terminator, terminator + 4);
+    if (headersEnd == end)
+        return connection.requestLength < RequestCapacity;    // Wait for the rest, unless it is too big
+    headersEnd += 4;
+
+    char* lineEnd = std::search(begin, headersEnd, terminator, terminator + 2);
+    char* methodEnd = std::find(begin, lineEnd, ' ');
+    char* targetEnd = std::find(std::min(methodEnd + 1, lineEnd), lineEnd, ' ');
+    std::string method(begin, methodEnd);
+    std::string target(std::min(methodEnd + 1, lineEnd), targetEnd);
+    bool http10 = headerContains(targetEnd, lineEnd, "http/1.0");
+    bool head = method == "HEAD";
+
+    connection.closeAfterResponse = headerContains(lineEnd, headersEnd, "connection: close")
+        || (http10 && !headerContains(lineEnd, headersEnd, "connection: keep-alive"));
+
+    const char* status = "200 OK";
+    const char* contentType = "text/plain; charset=utf-8";
+    connection.page.reset();
+    connection.body = nullptr;
+    connection.bodyLeft = 0;
+
+    static const char notFound[] = "Not found; process metrics are at /metrics\n";
+    static const char notAllowed[] = "Only GET and HEAD are supported\n";
+    static const char notReady[] = "No snapshot has been taken yet\n";
+    static const char index[] = "Process metrics are at /metrics\n";
+
+    std::string path = target.substr(0, target.find('?'));
+    if (method != "GET" && !head)
+    {
+        status = "405 Method Not Allowed";
+        connection.body = notAllowed;
+        connection.bodyLeft = sizeof(notAllowed) - 1;
+    }
+    else if (path == "/metrics")
+    {
+        connection.page = std::atomic_load(&page);
+        if (!connection.page)
+        {
+            status = "503 Service Unavailable";
+            connection.body = notReady;
+            connection.bodyLeft = sizeof(notReady) - 1;
+        }
+        else
+        {
+            // The page ends with "# EOF", which only OpenMetrics wants
+            bool openMetrics = headerContains(lineEnd, headersEnd, "application/openmetrics-text");
+            contentType = openMetrics ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+                : "text/plain; version=0.0.4; charset=utf-8";
+            connection.body = connection.page->data();
+            connection.bodyLeft = connection.page->size() - (openMetrics ? 0 : MetricsFormatter::EofMarkerLength);
+            ++scrapes;
+        }
+    }
+    else if (path == "/")
+    {
+        connection.body = index;
+        connection.bodyLeft = sizeof(index) - 1;
+    }
+    else
+    {
+        status = "404 Not Found";
+        connection.body = notFound;
+        connection.bodyLeft = sizeof(notFound) - 1;
+    }
+
+    int length = std::snprintf(connection.header, sizeof(connection.header),
+        "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+        status, contentType, connection.bodyLeft, connection.closeAfterResponse ? "close" : "keep-alive");
+    connection.headerLength = length > 0 ? static_cast<size_t>(length) : 0;
+    connection.headerSent = 0;
+    if (head)
+    {
+        connection.bodyLeft = 0;
+        connection.page.reset();
+    }
+
+    // Keep any pipelined bytes for the next request
+    size_t consumed = static_cast<size_t>(headersEnd - begin);
+    std::memmove(begin, headersEnd, connection.requestLength - consumed);
+    connection.requestLength -= consumed;
+    return true;
+}
+
+void MetricsExporter::serveLoop()
+{
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<PollEntry> entries;
+    SocketHandle listenSocket = static_cast<SocketHandle>(listener);
+
+    while (running)
+    {
+        entries.clear();
+        PollEntry accept;
+        accept.fd = listenSocket;
+        accept.events = connections.size() < MaxConnections ? POLLIN : 0;
+        accept.revents = 0;
+        entries.push_back(accept);
+        for (const auto& connection : connections)
+        {
+            PollEntry entry;
+            entry.fd = connection->socket;
+            entry.events = connection->sending() ? POLLOUT : POLLIN;
+            entry.revents = 0;
+            entries.push_back(entry);
+        }
+
+        // A short timeout so stop() is noticed and idle clients can be dropped
+        if (pollSockets(entries.data(), entries.size(), 250) < 0)
+            continue;
+        auto now = std::chrono::steady_clock::now();
+
+        if (entries[0].revents & POLLIN)
+        {
+            while (connections.size() < MaxConnections)
+            {
+                SocketHandle client = ::accept(listenSocket, nullptr, nullptr);
+                if (client == NoSocket)
+                    break;
+                if (!setNonBlocking(client))
+                {
+                    closeSocket(client);
+                    continue;
+                }
+                // Header and body go out in separate sends; without this Nagle holds the
+                // body back until the client's delayed ACK of the header
+                int noDelay = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                std::unique_ptr<Connection> connection = std::make_unique<Connection>();
+                connection->socket = client;
+                connection->lastActive = now;
+                connections.push_back(std::move(connection));
+            }
+        }
+
+        // Only the connections that were polled; new ones wait for the next round
+        size_t polled = entries.size() - 1;
+        for (size_t i = 0; i < polled; ++i)
+        {
+            Connection& connection = *connections[i];
+            short events = entries[i + 1].revents;
+            bool keep = true;
+
+            if (events & (POLLERR | POLLNVAL))
+            {
+                keep = false;
+            }
+            else if (connection.sending() && (events & POLLOUT))
+            {
+                while (keep && connection.sending())
+                {
+                    bool inHeader = connection.headerSent < connection.headerLength;
+                    const char* data = inHeader ? connection.header + connection.headerSent : connection.body;
+                    size_t length = inHeader ? connection.headerLength - connection.headerSent : connection.bodyLeft;
+                    int sent = send(connection.socket, data, static_cast<int>(std::min<size_t>(length, 1 << 20)), SendFlags);
+                    if (sent <= 0)
+                    {
+                        keep = sent < 0 && wouldBlock();
+                        break;
+                    }
+                    if (inHeader)
+                    {
+                        connection.headerSent += static_cast<size_t>(sent);
+                    }
+                    else
+                    {
+                        connection.body += sent;
+                        connection.bodyLeft -= static_cast<size_t>(sent);
+                    }
+                }
+                connection.lastActive = now;
+                if (keep && !connection.sending())
+                {
+                    connection.page.reset();
+                    if (connection.closeAfterResponse)
+                        keep = false;
+                    else if (connection.requestLength > 0)
+                        keep = handleRequest(connection);    // A pipelined request was already read
+                }
+            }
+            else if (!connection.sending() && (events & (POLLIN | POLLHUP)))
+            {
+                int received = recv(connection.socket, connection.request + connection.requestLength,
+                    static_cast<int>(RequestCapacity - connection.requestLength), 0);
+                if (received <= 0)
+                {
+                    keep = received < 0 && wouldBlock();
+                }
+                else
+                {
+                    connection.requestLength += static_cast<size_t>(received);
+                    connection.lastActive = now;
+                    keep = handleRequest(connection);
+                }
+            }
+            else if (now - connection.lastActive > IdleTimeout)
+            {
+                keep = false;
+            }
+
+            if (!keep)
+            {
+                closeSocket(connection.socket);
+                connection.socket = NoSocket;
+            }
+        }
+
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+            [](const std::unique_ptr<Connection>& connection) { return connection->socket == NoSocket; }),
+            connections.end());
+    }
+
+    for (const auto& connection : connections)
+        closeSocket(connection->socket);
+}
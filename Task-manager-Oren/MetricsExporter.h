@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GroupingEngine.h"
+#include "NamePool.h"
+#include "ProcessSampler.h"
+#include "ProcessTable.h"
+
+// Turns one snapshot into a Prometheus / OpenMetrics page: memory, CPU and instance count
+// per process name (the groups printGroupedProcessesByMemory shows), for the topGroups
+// largest names by memory plus one "(other)" series holding the rest, so the number of
+// series stays bounded however many names the host runs.
+class MetricsFormatter
+{
+public:
+    explicit MetricsFormatter(size_t topGroups);
+
+    // Rebuilds out (reusing its capacity). The page ends with the OpenMetrics "# EOF"
+    // line; the Prometheus text format is the same page without it (see EofMarker).
+    void build(const ProcessTable& table, const NamePool& names, unsigned long long sequence,
+        long long unixMs, std::string& out);
+
+    static const char EofMarker[];
+    static constexpr size_t EofMarkerLength = 6;
+
+private:
+    size_t topGroups;
+    GroupingEngine groups;
+    std::vector<uint32_t> order;
+};
+
+// Serves the formatter's page over HTTP (GET /metrics). The page is rebuilt once per
+// sampler tick on a thread of its own and published as an immutable shared buffer; a
+// scrape only takes a reference to the current buffer and sends it, so any number of
+// scrapers costs no extra work on the process data. Connections are served by a single
+// poll() loop with keep-alive.
+class MetricsExporter
+{
+public:
+    static constexpr size_t DefaultTopGroups = 20;
+
+    MetricsExporter(ProcessSampler& sampler, size_t topGroups = DefaultTopGroups);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // Listens on address:port (port 0 picks a free one) and starts both threads
+    bool start(const std::string& address, uint16_t port, std::string& error);
+
+    // Stops serving and closes every connection
+    void stop();
+
+    bool isRunning() const;
+
+    // Port actually listened on
+    uint16_t port() const;
+
+    // Pages built and scrapes answered so far
+    unsigned long long pagesBuilt() const;
+    unsigned long long scrapesServed() const;
+
+private:
+    struct Connection;
+
+    // Waits for each new snapshot and publishes its page
+    void refreshLoop();
+
+    // Accepts connections and answers requests until stopped
+    void serveLoop();
+
+    // Parses buffered request bytes and queues a response; false if the connection must close
+    bool handleRequest(Connection& connection);
+
+    ProcessSampler& sampler;
+    MetricsFormatter formatter;
+
+    // Current page; swapped with std::atomic_store, read with std::atomic_load
+    std::shared_ptr<const std::string> page;
+
+    std::thread refresher;
+    std::thread server;
+    std::atomic<bool> running{ false };
+    std::atomic<unsigned long long> pages{ 0 };
+    std::atomic<unsigned long long> scrapes{ 0 };
+    intptr_t listener = -1;        // Socket handle (SOCKET on Windows)
+    uint16_t boundPort = 0;
+};
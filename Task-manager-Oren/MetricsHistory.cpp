@@ -0,0 +1,521 @@
+#include "MetricsHistory.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Bucket width (seconds) and block limit of each tier, finest first
+static const uint32_t TierWidth[MetricsHistory::TierCount] = { 1, 10, 60 };
+static const uint16_t TierBlockLimit[MetricsHistory::TierCount] = { 16, 8, 8 };
+
+// LEB128: 7 bits per byte, high bit set on all but the last byte
+static size_t writeVarint(uint8_t* out, uint64_t value)
+{
+    size_t length = 0;
+    while (value >= 0x80)
+    {
+        out[length++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = static_cast<uint8_t>(value);
+    return length;
+}
+
+static uint64_t readVarint(const uint8_t* data, size_t& pos)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    while (true)
+    {
+        uint8_t byte = data[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+        shift += 7;
+    }
+}
+
+// Small changes of either sign become small unsigned numbers
+static uint64_t zigzag(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+MetricsHistory::MetricsHistory(size_t blockBudget)
+    : maxBlocks(static_cast<uint32_t>(std::max<size_t>(blockBudget / BlockSize, 1)))
+{
+    static_assert(sizeof(Block) == BlockSize, "Block layout must fill exactly BlockSize bytes");
+}
+
+MetricsHistory::Block& MetricsHistory::block(uint32_t index)
+{
+    return chunks[index / BlocksPerChunk][index % BlocksPerChunk];
+}
+
+const MetricsHistory::Block& MetricsHistory::block(uint32_t index) const
+{
+    return chunks[index / BlocksPerChunk][index % BlocksPerChunk];
+}
+
+uint32_t MetricsHistory::secondsSince(std::chrono::steady_clock::time_point at) const
+{
+    long long seconds = std::chrono::duration_cast<std::chrono::seconds>(at - epoch).count();
+    return seconds > 0 ? static_cast<uint32_t>(seconds) : 0;
+}
+
+void MetricsHistory::record(const ProcessTable& table, const ProcessDelta& delta, std::chrono::steady_clock::time_point at)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!started)
+    {
+        epoch = at;
+        started = true;
+    }
+    uint32_t now = std::max(secondsSince(at), latestTime);
+    latestTime = now;
+    reclaimExpired(now);
+
+    // Exited processes first, so a recycled PID below starts a fresh series
+    for (const ProcessInfo& proc : delta.removed)
+    {
+        auto found = seriesByPid.find(proc.pid);
+        if (found != seriesByPid.end() && series[found->second].alive)
+            killSeries(found->second, now);
+    }
+
+    for (uint32_t row = 0; row < table.size(); ++row)
+    {
+        if (!table.accessible(row))
+            continue;
+
+        DWORD pid = table.pid[row];
+        auto found = seriesByPid.find(pid);
+        uint32_t slot = found != seriesByPid.end() ? found->second : None;
+        if (slot != None && series[slot].alive && (table.flags[row] & ProcessTable::IsNew))
+        {
+            killSeries(slot, now); // A snapshot was skipped and the PID got recycled meanwhile
+        }
+        if (slot == None || !series[slot].alive)
+        {
+            slot = createSeries(table.nameId[row], pid, false, now);
+            seriesByPid[pid] = slot;
+        }
+        addSample(series[slot], now, table.memory[row] >> 10);
+    }
+
+    // Name groups: an exited group comes back to life in its old series
+    groups.group(table, processNames(), GroupBy::Name, { Metric::Memory });
+    for (uint32_t group = 0; group < groups.groupCount(); ++group)
+    {
+        uint32_t nameId = static_cast<uint32_t>(groups.key(group));
+        auto found = seriesByName.find(nameId);
+        uint32_t slot;
+        if (found == seriesByName.end())
+        {
+            slot = createSeries(nameId, 0, true, now);
+            seriesByName[nameId] = slot;
+        }
+        else
+        {
+            slot = found->second;
+            if (!series[slot].alive)
+            {
+                series[slot].alive = true;
+                ++series[slot].generation; // Invalidates its entry in deadQueue
+            }
+        }
+        addSample(series[slot], now, static_cast<uint64_t>(groups.stats(group, 0).sum) >> 10);
+    }
+
+    // A group only disappears when one of its processes exits
+    for (const ProcessInfo& proc : delta.removed)
+    {
+        if (groups.find(proc.nameId) != GroupingEngine::NotFound)
+            continue;
+
+        auto found = seriesByName.find(proc.nameId);
+        if (found != seriesByName.end() && series[found->second].alive)
+            killSeries(found->second, now);
+    }
+}
+
+uint32_t MetricsHistory::createSeries(uint32_t nameId, DWORD pid, bool group, uint32_t now)
+{
+    uint32_t slot;
+    if (!freeSlots.empty())
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(series.size());
+        series.emplace_back();
+    }
+
+    Series& created = series[slot];
+    uint32_t generation = created.generation + 1;
+    created = Series();
+    created.generation = generation;
+    created.nameId = nameId;
+    created.pid = pid;
+    created.group = group;
+    created.alive = true;
+    created.firstTime = now;
+    return slot;
+}
+
+void MetricsHistory::killSeries(uint32_t slot, uint32_t now)
+{
+    Series& dead = series[slot];
+    dead.alive = false;
+    ++dead.generation;
+    deadQueue.push_back({ slot, dead.generation, now });
+}
+
+void MetricsHistory::freeSeries(uint32_t slot)
+{
+    Series& freed = series[slot];
+    for (Tier& tier : freed.tiers)
+    {
+        for (uint32_t index = tier.head; index != None; index = block(index).next)
+            freeBlocks.push_back(index);
+    }
+
+    // The index may already point at a newer series with the same PID
+    if (freed.group)
+    {
+        auto found = seriesByName.find(freed.nameId);
+        if (found != seriesByName.end() && found->second == slot)
+            seriesByName.erase(found);
+    }
+    else
+    {
+        auto found = seriesByPid.find(freed.pid);
+        if (found != seriesByPid.end() && found->second == slot)
+            seriesByPid.erase(found);
+    }
+
+    uint32_t generation = freed.generation + 1;
+    freed = Series();
+    freed.generation = generation;
+    freeSlots.push_back(slot);
+}
+
+void MetricsHistory::reclaimExpired(uint32_t now)
+{
+    while (!deadQueue.empty())
+    {
+        const DeadEntry& entry = deadQueue.front();
+        const Series& dead = series[entry.slot];
+        if (dead.alive || dead.generation != entry.generation)
+        {
+            deadQueue.pop_front(); // Revived or already freed
+            continue;
+        }
+        if (now - entry.diedAt < DeadRetention)
+            break;
+
+        freeSeries(entry.slot);
+        deadQueue.pop_front();
+    }
+}
+
+void MetricsHistory::addSample(Series& target, uint32_t now, uint64_t valueKb)
+{
+    target.latest = valueKb;
+    for (size_t t = 0; t < TierCount; ++t)
+    {
+        Tier& tier = target.tiers[t];
+        uint32_t bucket = now - now % TierWidth[t];
+
+        // A new bucket closes the previous one; it is only written if the value moved
+        if (tier.hasPending && tier.pendingTime != bucket)
+        {
+            if (tier.tail == None || tier.pendingValue != tier.lastValue)
+                appendPoint(tier, t, tier.pendingTime, tier.pendingValue);
+        }
+        tier.hasPending = true;
+        tier.pendingTime = bucket;
+        tier.pendingValue = valueKb;
+    }
+}
+
+void MetricsHistory::appendPoint(Tier& tier, size_t tierIndex, uint32_t time, uint64_t value)
+{
+    if (tier.tail != None)
+    {
+        uint8_t encoded[20];
+        size_t length = writeVarint(encoded, time - tier.lastTime);
+        length += writeVarint(encoded + length, zigzag(static_cast<int64_t>(value - tier.lastValue)));
+
+        Block& last = block(tier.tail);
+        if (last.used + length <= PayloadSize)
+        {
+            std::memcpy(last.data + last.used, encoded, length);
+            last.used = static_cast<uint8_t>(last.used + length);
+            tier.lastTime = time;
+            tier.lastValue = value;
+            return;
+        }
+    }
+
+    uint32_t index = allocateBlock(tier, tierIndex);
+    if (index == None)
+    {
+        ++dropped;
+        return;
+    }
+
+    Block& opened = block(index);
+    opened.next = None;
+    opened.firstTime = time;
+    opened.firstValue = value;
+    opened.used = 0;
+    if (tier.tail != None)
+        block(tier.tail).next = index;
+    else
+        tier.head = index;
+    tier.tail = index;
+    ++tier.blockCount;
+    tier.lastTime = time;
+    tier.lastValue = value;
+}
+
+uint32_t MetricsHistory::allocateBlock(Tier& tier, size_t tierIndex)
+{
+    if (tier.blockCount >= TierBlockLimit[tierIndex])
+        return recycleOldest(tier);
+
+    if (!freeBlocks.empty())
+    {
+        uint32_t index = freeBlocks.back();
+        freeBlocks.pop_back();
+        return index;
+    }
+
+    if (blocksAllocated < maxBlocks)
+    {
+        if (blocksAllocated % BlocksPerChunk == 0)
+            chunks.emplace_back(new Block[BlocksPerChunk]);
+        return blocksAllocated++;
+    }
+
+    // Over budget: give up exited processes early, oldest first
+    while (!deadQueue.empty())
+    {
+        DeadEntry entry = deadQueue.front();
+        deadQueue.pop_front();
+        const Series& dead = series[entry.slot];
+        if (dead.alive || dead.generation != entry.generation)
+            continue;
+
+        freeSeries(entry.slot);
+        if (!freeBlocks.empty())
+        {
+            uint32_t index = freeBlocks.back();
+            freeBlocks.pop_back();
+            return index;
+        }
+    }
+
+    // Still nothing: shorten this tier's own history, or else another series' 1 s tier
+    // (the coarser tiers still cover what it loses)
+    if (tier.blockCount > 0)
+        return recycleOldest(tier);
+
+    for (size_t scanned = 0; scanned < series.size(); ++scanned)
+    {
+        stealCursor = (stealCursor + 1) % series.size();
+        Tier& finest = series[stealCursor].tiers[0];
+        if (finest.blockCount > 1)
+            return recycleOldest(finest);
+    }
+    return None;
+}
+
+uint32_t MetricsHistory::recycleOldest(Tier& tier)
+{
+    uint32_t index = tier.head;
+    tier.head = block(index).next;
+    if (tier.head == None)
+        tier.tail = None;
+    --tier.blockCount;
+    tier.truncated = true;
+    return index;
+}
+
+const MetricsHistory::Tier& MetricsHistory::coveringTier(const Series& target, uint32_t t) const
+{
+    for (const Tier& tier : target.tiers)
+    {
+        if (!tier.truncated || (tier.head != None && block(tier.head).firstTime <= t))
+            return tier;
+    }
+    return target.tiers[TierCount - 1];
+}
+
+uint64_t MetricsHistory::valueAt(const Series& target, uint32_t t) const
+{
+    const Tier& tier = coveringTier(target, t);
+
+    // The open bucket is newer than every stored point
+    if (tier.hasPending && tier.pendingTime <= t)
+        return tier.pendingValue;
+
+    for (uint32_t index = tier.head; index != None;)
+    {
+        const Block& current = block(index);
+        if (current.firstTime > t)
+            break;
+
+        // Skip whole blocks when the next one still starts before t
+        if (current.next != None && block(current.next).firstTime <= t)
+        {
+            index = current.next;
+            continue;
+        }
+
+        uint32_t time = current.firstTime;
+        uint64_t value = current.firstValue;
+        size_t pos = 0;
+        while (pos < current.used)
+        {
+            uint32_t gap = static_cast<uint32_t>(readVarint(current.data, pos));
+            int64_t change = unzigzag(readVarint(current.data, pos));
+            if (time + gap > t)
+                break;
+            time += gap;
+            value += static_cast<uint64_t>(change);
+        }
+        return value;
+    }
+
+    // t is before the first point: the series started inside the window
+    if (tier.head != None)
+        return block(tier.head).firstValue;
+    return tier.hasPending ? tier.pendingValue : target.latest;
+}
+
+std::vector<HistoryPoint> MetricsHistory::pointsSince(const Series& target, uint32_t since) const
+{
+    std::vector<HistoryPoint> points;
+    const Tier& tier = coveringTier(target, since);
+
+    bool haveCarry = false;
+    HistoryPoint carry = { 0, 0 };
+    auto emit = [&](uint32_t time, uint64_t value)
+        {
+            if (time < since)
+            {
+                carry = { since, value << 10 };
+                haveCarry = true;
+                return;
+            }
+            if (haveCarry && time > since)
+                points.push_back(carry);
+            haveCarry = false;
+            points.push_back({ time, value << 10 });
+        };
+
+    for (uint32_t index = tier.head; index != None; index = block(index).next)
+    {
+        const Block& current = block(index);
+        uint32_t time = current.firstTime;
+        uint64_t value = current.firstValue;
+        emit(time, value);
+
+        size_t pos = 0;
+        while (pos < current.used)
+        {
+            time += static_cast<uint32_t>(readVarint(current.data, pos));
+            value += static_cast<uint64_t>(unzigzag(readVarint(current.data, pos)));
+            emit(time, value);
+        }
+    }
+
+    if (tier.hasPending)
+        emit(std::max(tier.pendingTime, since), tier.pendingValue);
+    if (haveCarry)
+        points.push_back(carry);
+    return points;
+}
+
+std::vector<HistoryGrowth> MetricsHistory::topGrowers(size_t count, std::chrono::seconds window, bool byGroup) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint32_t span = static_cast<uint32_t>(std::max<long long>(window.count(), 0));
+    uint32_t since = latestTime > span ? latestTime - span : 0;
+
+    std::vector<HistoryGrowth> growers;
+    for (const Series& candidate : series)
+    {
+        if (!candidate.alive || candidate.group != byGroup)
+            continue;
+
+        long long growth = static_cast<long long>(candidate.latest) - static_cast<long long>(valueAt(candidate, since));
+        growers.push_back({ candidate.nameId, candidate.pid, growth * 1024, candidate.latest << 10 });
+    }
+
+    size_t kept = std::min(count, growers.size());
+    std::partial_sort(growers.begin(), growers.begin() + kept, growers.end(),
+        [](const HistoryGrowth& a, const HistoryGrowth& b) { return a.growth > b.growth; });
+    growers.resize(kept);
+    return growers;
+}
+
+std::vector<HistoryPoint> MetricsHistory::processSeries(DWORD pid, std::chrono::seconds window) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = seriesByPid.find(pid);
+    if (found == seriesByPid.end())
+        return {};
+
+    uint32_t span = static_cast<uint32_t>(std::max<long long>(window.count(), 0));
+    return pointsSince(series[found->second], latestTime > span ? latestTime - span : 0);
+}
+
+std::vector<HistoryPoint> MetricsHistory::groupSeries(uint32_t nameId, std::chrono::seconds window) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = seriesByName.find(nameId);
+    if (found == seriesByName.end())
+        return {};
+
+    uint32_t span = static_cast<uint32_t>(std::max<long long>(window.count(), 0));
+    return pointsSince(series[found->second], latestTime > span ? latestTime - span : 0);
+}
+
+size_t MetricsHistory::memoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Hash nodes hold the pair plus a next pointer and the cached hash
+    size_t nodeBytes = sizeof(std::pair<const DWORD, uint32_t>) + 2 * sizeof(void*);
+    return chunks.size() * BlocksPerChunk * sizeof(Block)
+        + series.capacity() * sizeof(Series)
+        + (freeSlots.capacity() + freeBlocks.capacity()) * sizeof(uint32_t)
+        + (seriesByPid.size() + seriesByName.size()) * nodeBytes
+        + (seriesByPid.bucket_count() + seriesByName.bucket_count()) * sizeof(void*)
+        + deadQueue.size() * sizeof(DeadEntry);
+}
+
+size_t MetricsHistory::seriesCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return series.size() - freeSlots.size();
+}
+
+unsigned long long MetricsHistory::droppedPoints() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
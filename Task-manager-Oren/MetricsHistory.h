@@ -0,0 +1,185 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "GroupingEngine.h"
+#include "NamePool.h"
+#include "ProcessInfo.h"
+#include "ProcessTable.h"
+
+// Memory growth of one process or name group over a query window
+struct HistoryGrowth
+{
+    uint32_t nameId;                 // Interned name (see NamePool)
+    DWORD pid;                       // 0 for name groups
+    long long growth;                // Bytes gained over the window (negative if it shrank)
+    unsigned long long current;      // Latest value in bytes
+};
+
+// One stored point of a series
+struct HistoryPoint
+{
+    uint32_t time;                   // Seconds since the first recorded snapshot
+    unsigned long long value;        // Memory in bytes
+};
+
+// Fixed-budget memory history of every process and every name group.
+//
+// Each series keeps three tiers of points: 1 s, 10 s and 60 s buckets (the last value of
+// each bucket). A point is only written when the value changed, so an idle process costs
+// next to nothing. Points are packed into 128-byte blocks as varint deltas (time gap,
+// then zigzag KB change) after a full first point in the block header, and each tier is a
+// short chain of blocks that recycles its oldest block once it reaches its block limit.
+//
+// Memory budget: blocks come from one pool capped at blockBudget bytes (16 MB by default).
+// When it runs dry, exited series are reclaimed first, then live tiers recycle their own
+// oldest block and new series take over the oldest 1 s blocks of others. On top of that
+// each tracked series costs about 250 bytes of bookkeeping (sizeof(Series), its index
+// entry and spare vector capacity). For 20k PIDs sampled at 1 Hz for an hour that is the
+// 16 MB of blocks plus ~5.5 MB, as measured by the metrics history benchmark.
+class MetricsHistory
+{
+public:
+    static constexpr size_t TierCount = 3;
+    static constexpr size_t BlockSize = 128;
+    static constexpr size_t DefaultBudget = 16 * 1024 * 1024;
+
+    // Exited processes are kept this long (seconds) unless their blocks are needed sooner
+    static constexpr uint32_t DeadRetention = 3600;
+
+    explicit MetricsHistory(size_t blockBudget = DefaultBudget);
+
+    // Adds one snapshot: a point per accessible row and per name group. delta.removed
+    // ends the series of exited processes. Times must not go backwards.
+    void record(const ProcessTable& table, const ProcessDelta& delta, std::chrono::steady_clock::time_point at);
+
+    // The count live processes (or name groups) whose memory grew most over the last window
+    std::vector<HistoryGrowth> topGrowers(size_t count, std::chrono::seconds window, bool byGroup) const;
+
+    // Points of a process (live or recently exited) over the last window, from the finest
+    // tier that still covers it; empty if the PID is unknown
+    std::vector<HistoryPoint> processSeries(DWORD pid, std::chrono::seconds window) const;
+
+    // Same for a name group
+    std::vector<HistoryPoint> groupSeries(uint32_t nameId, std::chrono::seconds window) const;
+
+    // Bytes held: block pool, series bookkeeping and the indexes
+    size_t memoryUsage() const;
+
+    // Series currently tracked (live and exited)
+    size_t seriesCount() const;
+
+    // Points that could not be stored because the block budget was exhausted
+    unsigned long long droppedPoints() const;
+
+private:
+    static constexpr uint32_t None = 0xFFFFFFFFu;
+    static constexpr size_t PayloadSize = BlockSize - 17;
+    static constexpr uint32_t BlocksPerChunk = 512;
+
+    struct Block
+    {
+        uint32_t next;               // Newer block in the same tier, or None
+        uint32_t firstTime;          // First point, stored in full
+        uint64_t firstValue;
+        uint8_t used;                // Bytes of data in use
+        uint8_t data[PayloadSize];   // Later points as (time gap, zigzag value change) varints
+    };
+
+    struct Tier
+    {
+        uint32_t head = None;        // Oldest block
+        uint32_t tail = None;        // Newest block
+        uint16_t blockCount = 0;
+        bool truncated = false;      // Some of the oldest points were recycled
+        bool hasPending = false;
+        uint32_t pendingTime = 0;    // Open bucket and its latest value, written once the bucket closes
+        uint64_t pendingValue = 0;
+        uint32_t lastTime = 0;       // Last written point, the base of the next delta
+        uint64_t lastValue = 0;
+    };
+
+    struct Series
+    {
+        uint32_t nameId = 0;
+        DWORD pid = 0;
+        bool group = false;
+        bool alive = false;
+        uint32_t generation = 0;     // Bumped whenever the slot dies or is reused
+        uint32_t firstTime = 0;
+        uint64_t latest = 0;         // Latest value in KB
+        Tier tiers[TierCount];
+    };
+
+    struct DeadEntry
+    {
+        uint32_t slot;
+        uint32_t generation;
+        uint32_t diedAt;
+    };
+
+    Block& block(uint32_t index);
+    const Block& block(uint32_t index) const;
+
+    // Starts a series in a free slot
+    uint32_t createSeries(uint32_t nameId, DWORD pid, bool group, uint32_t now);
+
+    // Marks a series exited; it stays readable until reclaimed
+    void killSeries(uint32_t slot, uint32_t now);
+
+    // Returns a series' blocks to the pool and its slot to the free list
+    void freeSeries(uint32_t slot);
+
+    // Feeds one sample into every tier of a series
+    void addSample(Series& series, uint32_t now, uint64_t valueKb);
+
+    // Appends a point to a tier, opening a new block when the current one is full
+    void appendPoint(Tier& tier, size_t tierIndex, uint32_t time, uint64_t value);
+
+    // Finds a block for tier: pool, exited series, the tier's own oldest block, or the
+    // oldest block of some other series' 1 s tier
+    uint32_t allocateBlock(Tier& tier, size_t tierIndex);
+
+    // Unlinks and returns the tier's oldest block
+    uint32_t recycleOldest(Tier& tier);
+
+    // Frees exited series whose retention ran out
+    void reclaimExpired(uint32_t now);
+
+    // Value (KB) of a series at time t and the points of the covering tier
+    uint64_t valueAt(const Series& series, uint32_t t) const;
+    std::vector<HistoryPoint> pointsSince(const Series& series, uint32_t since) const;
+
+    // Tier with the finest resolution that holds everything from t on
+    const Tier& coveringTier(const Series& series, uint32_t t) const;
+
+    // Seconds since the first record
+    uint32_t secondsSince(std::chrono::steady_clock::time_point at) const;
+
+    mutable std::mutex mutex;
+
+    // Block pool: fixed chunks that never move, plus a free list
+    std::vector<std::unique_ptr<Block[]>> chunks;
+    uint32_t blocksAllocated = 0;
+    uint32_t maxBlocks;
+    std::vector<uint32_t> freeBlocks;
+
+    std::vector<Series> series;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<DWORD, uint32_t> seriesByPid;
+    std::unordered_map<uint32_t, uint32_t> seriesByName;
+    std::deque<DeadEntry> deadQueue;     // In order of death, so expiry only looks at the front
+    size_t stealCursor = 0;              // Where the search for a block to take over resumes
+
+    GroupingEngine groups;               // Reused for the per-name sums
+    bool started = false;
+    std::chrono::steady_clock::time_point epoch;
+    uint32_t latestTime = 0;
+    unsigned long long dropped = 0;
+};
@@ -0,0 +1,80 @@
+#include "NamePool.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cwctype>
+
+NamePool::NamePool()
+{
+    intern(std::wstring());
+}
+
+uint32_t NamePool::intern(const std::wstring& rawName)
+{
+    std::lock_guard<std::mutex> lock(internMutex);
+
+    auto found = idsByRawName.find(rawName);
+    if (found != idsByRawName.end())
+        return found->second;
+
+    uint32_t id = count.load();
+    if (id / BlockSize >= MaxBlocks)
+        return 0; // Pool is full: fall back to the empty name
+
+    std::unique_ptr<Entry[]>& block = blocks[id / BlockSize];
+    if (!block)
+        block.reset(new Entry[BlockSize]);
+
+    Entry& added = block[id % BlockSize];
+    added.display = cleanProcessName(rawName);
+    added.lower = added.display;
+    std::transform(added.lower.begin(), added.lower.end(), added.lower.begin(), towlower);
+
+    auto folded = idsByLowerName.find(added.lower);
+    if (folded != idsByLowerName.end())
+    {
+        added.foldedId = folded->second;
+    }
+    else
+    {
+        added.foldedId = id;
+        idsByLowerName.emplace(added.lower, id);
+    }
+
+    idsByRawName.emplace(rawName, id);
+
+    // Publish only once the entry is complete
+    count.store(id + 1);
+    return id;
+}
+
+uint32_t NamePool::size() const
+{
+    return count.load();
+}
+
+const NamePool::Entry& NamePool::entry(uint32_t id) const
+{
+    return blocks[id / BlockSize][id % BlockSize];
+}
+
+const std::wstring& NamePool::display(uint32_t id) const
+{
+    return entry(id).display;
+}
+
+const std::wstring& NamePool::lower(uint32_t id) const
+{
+    return entry(id).lower;
+}
+
+uint32_t NamePool::foldedId(uint32_t id) const
+{
+    return entry(id).foldedId;
+}
+
+NamePool& processNames()
+{
+    static NamePool pool;
+    return pool;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Interns executable names so every distinct name is cleaned and lowercased only once.
+// IDs are dense (0, 1, 2, ...) and never change, so they can index plain arrays.
+// Interning takes a lock; looking up an ID that has been handed out never does,
+// because entries live in fixed blocks that are never moved.
+class NamePool
+{
+public:
+    // ID 0 is the empty name, also handed out if the pool ever fills up
+    NamePool();
+
+    // Returns the ID of a raw executable name (e.g. "Chrome.exe"), adding it if needed
+    uint32_t intern(const std::wstring& rawName);
+
+    // Number of names interned so far
+    uint32_t size() const;
+
+    // Name without ".exe", as displayed
+    const std::wstring& display(uint32_t id) const;
+
+    // Lowercase display name, for case-insensitive sorting and matching
+    const std::wstring& lower(uint32_t id) const;
+
+    // Names that only differ in case share the same folded ID
+    uint32_t foldedId(uint32_t id) const;
+
+private:
+    struct Entry
+    {
+        std::wstring display;
+        std::wstring lower;
+        uint32_t foldedId = 0;
+    };
+
+    static constexpr uint32_t BlockSize = 1024;
+    static constexpr uint32_t MaxBlocks = 4096;
+
+    const Entry& entry(uint32_t id) const;
+
+    std::unique_ptr<Entry[]> blocks[MaxBlocks];
+    std::atomic<uint32_t> count{ 0 };
+
+    // Only touched under internMutex
+    std::mutex internMutex;
+    std::unordered_map<std::wstring, uint32_t> idsByRawName;
+    std::unordered_map<std::wstring, uint32_t> idsByLowerName;
+};
+
+// The pool shared by every ProcessManager, so IDs stay valid across snapshots
+NamePool& processNames();
@@ -0,0 +1,577 @@
+#include "ProcessFilter.h"
+#include "UserNames.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwchar>
+#include <cwctype>
+
+const char* ProcessFilter::syntax()
+{
+    return
+        "Filter expressions compare process fields, e.g.  name=java* and memory>2GB and user=build\n"
+        "  Fields:      pid, parent, name, user, state, memory (mem), cpu\n"
+        "  Comparisons: = != < <= > >=  (name, user and state only take = and !=)\n"
+        "  Names and users ignore case and may use * and ? wildcards; quote values with spaces.\n"
+        "  Memory takes B, KB, MB, GB or TB; cpu is in percent of one core (e.g. cpu>50).\n"
+        "  States: running, sleeping, disk, zombie, stopped, idle (or R, S, D, Z, T, I).\n"
+        "  Combine with and, or, not and parentheses; \"and\" may be left out.\n"
+        "  Memory and cpu tests never match processes whose counters cannot be read.\n";
+}
+
+// Turns the expression text into tests and a postfix program by recursive descent:
+//   or  := and { ("or" | "||") and }
+//   and := not { ["and" | "&&"] not }
+//   not := ("not" | "!") not | "(" or ")" | field op value
+class FilterParser
+{
+public:
+    FilterParser(const std::wstring& text, ProcessFilter& filter, std::string& error)
+        : text(text), filter(filter), error(error)
+    {
+    }
+
+    bool parse()
+    {
+        next();
+        if (token == Token::End)
+            return true;    // Empty: matches everything
+        if (!parseOr())
+            return false;
+        if (token != Token::End)
+            return fail("unexpected '" + toNarrow(value) + "'");
+        return true;
+    }
+
+private:
+    enum class Token { End, Word, Quoted, Compare, Open, Close, Not, And, Or, Invalid };
+
+    // Reads the next token into token/value/compare
+    void next()
+    {
+        while (position < text.size() && std::iswspace(text[position]))
+            ++position;
+        tokenStart = position;
+        value.clear();
+        if (position >= text.size())
+        {
+            token = Token::End;
+            return;
+        }
+
+        wchar_t c = text[position];
+        wchar_t following = position + 1 < text.size() ? text[position + 1] : L'\0';
+        if (c == L'(' || c == L')')
+        {
+            token = c == L'(' ? Token::Open : Token::Close;
+            value = c;
+            ++position;
+        }
+        else if (c == L'"' || c == L'\'')
+        {
+            size_t close = text.find(c, position + 1);
+            if (close == std::wstring::npos)
+            {
+                token = Token::Invalid;
+                value = L"unterminated quote";
+                return;
+            }
+            token = Token::Quoted;
+            value = text.substr(position + 1, close - position - 1);
+            position = close + 1;
+        }
+        else if (c == L'&' && following == L'&')
+        {
+            token = Token::And;
+            value = L"&&";
+            position += 2;
+        }
+        else if (c == L'|' && following == L'|')
+        {
+            token = Token::Or;
+            value = L"||";
+            position += 2;
+        }
+        else if (c == L'=' || c == L'<' || c == L'>' || (c == L'!' && following == L'='))
+        {
+            token = Token::Compare;
+            bool twoChars = following == L'=';
+            value = text.substr(position, twoChars ? 2 : 1);
+            position += twoChars ? 2 : 1;
+            if (value == L"=" || value == L"==")
+                compare = ProcessFilter::Compare::Equal;
+            else if (value == L"!=")
+                compare = ProcessFilter::Compare::NotEqual;
+            else if (value == L"<")
+                compare = ProcessFilter::Compare::Less;
+            else if (value == L"<=")
+                compare = ProcessFilter::Compare::LessEqual;
+            else if (value == L">")
+                compare = ProcessFilter::Compare::Greater;
+            else
+                compare = ProcessFilter::Compare::GreaterEqual;
+        }
+        else if (c == L'!')
+        {
+            token = Token::Not;
+            value = L"!";
+            ++position;
+        }
+        else
+        {
+            // A bare word runs until a space or a character with a meaning of its own
+            while (position < text.size() && !std::iswspace(text[position])
+                && std::wcschr(L"()=<>!&|\"'", text[position]) == nullptr)
+                ++position;
+            if (position == tokenStart)
+            {
+                token = Token::Invalid;
+                value = text.substr(position, 1);
+                ++position;
+                return;
+            }
+            value = text.substr(tokenStart, position - tokenStart);
+            std::wstring lower = value;
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+            token = lower == L"and" ? Token::And : lower == L"or" ? Token::Or : lower == L"not" ? Token::Not : Token::Word;
+        }
+    }
+
+    bool fail(const std::string& message)
+    {
+        error = message + " at column " + std::to_string(tokenStart + 1);
+        return false;
+    }
+
+    void emit(ProcessFilter::Step step, uint32_t test = 0)
+    {
+        filter.program.push_back({ step, test });
+    }
+
+    bool parseOr()
+    {
+        if (!parseAnd())
+            return false;
+        while (token == Token::Or)
+        {
+            next();
+            if (!parseAnd())
+                return false;
+            emit(ProcessFilter::Step::Or);
+        }
+        return true;
+    }
+
+    bool parseAnd()
+    {
+        if (!parseNot())
+            return false;
+        while (token == Token::And || token == Token::Word || token == Token::Not || token == Token::Open)
+        {
+            if (token == Token::And)
+                next();
+            if (!parseNot())
+                return false;
+            emit(ProcessFilter::Step::And);
+        }
+        return true;
+    }
+
+    bool parseNot()
+    {
+        if (token == Token::Not)
+        {
+            next();
+            if (!parseNot())
+                return false;
+            emit(ProcessFilter::Step::Not);
+            return true;
+        }
+        if (token == Token::Open)
+        {
+            next();
+            if (!parseOr())
+                return false;
+            if (token != Token::Close)
+                return fail("expected ')'");
+            next();
+            return true;
+        }
+        return parseComparison();
+    }
+
+    bool parseComparison()
+    {
+        if (token == Token::Invalid)
+            return fail(value == L"unterminated quote" ? "unterminated quote" : "unexpected '" + toNarrow(value) + "'");
+        if (token != Token::Word)
+            return fail(token == Token::End ? "expression ends too early" : "expected a field name");
+
+        ProcessFilter::Test test;
+        std::wstring field = value;
+        std::transform(field.begin(), field.end(), field.begin(), ::towlower);
+        if (field == L"pid")
+            test.field = ProcessFilter::Field::Pid;
+        else if (field == L"parent" || field == L"ppid")
+            test.field = ProcessFilter::Field::Parent;
+        else if (field == L"memory" || field == L"mem")
+            test.field = ProcessFilter::Field::Memory;
+        else if (field == L"cpu")
+            test.field = ProcessFilter::Field::Cpu;
+        else if (field == L"name")
+            test.field = ProcessFilter::Field::Name;
+        else if (field == L"user")
+            test.field = ProcessFilter::Field::User;
+        else if (field == L"state")
+            test.field = ProcessFilter::Field::State;
+        else
+            return fail("unknown field '" + toNarrow(value) + "'");
+
+        next();
+        if (token != Token::Compare)
+            return fail("expected a comparison after '" + toNarrow(field) + "'");
+        test.compare = compare;
+        bool textField = test.field == ProcessFilter::Field::Name || test.field == ProcessFilter::Field::User
+            || test.field == ProcessFilter::Field::State;
+        if (textField && compare != ProcessFilter::Compare::Equal && compare != ProcessFilter::Compare::NotEqual)
+            return fail(toNarrow(field) + " only takes = and !=");
+
+        next();
+        if (token != Token::Word && token != Token::Quoted)
+            return fail("expected a value after '" + toNarrow(field) + "'");
+        if (!parseValue(test))
+            return false;
+
+        filter.tests.push_back(std::move(test));
+        emit(ProcessFilter::Step::Test, static_cast<uint32_t>(filter.tests.size() - 1));
+        next();
+        return true;
+    }
+
+    // Number with an optional suffix (unit letters or %); false if there is no number
+    static bool parseNumber(const std::wstring& text, double& number, std::wstring& suffix)
+    {
+        wchar_t* end = nullptr;
+        number = std::wcstod(text.c_str(), &end);
+        if (end == text.c_str() || !(number >= 0.0) || std::isinf(number))
+            return false;
+        suffix = end;
+        std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::towlower);
+        return true;
+    }
+
+    bool parseValue(ProcessFilter::Test& test)
+    {
+        double number = 0.0;
+        std::wstring suffix;
+        switch (test.field)
+        {
+        case ProcessFilter::Field::Pid:
+        case ProcessFilter::Field::Parent:
+            if (!parseNumber(value, number, suffix) || !suffix.empty() || number != std::floor(number) || number > 4294967295.0)
+                return fail("expected a process ID");
+            test.number = static_cast<unsigned long long>(number);
+            return true;
+
+        case ProcessFilter::Field::Memory:
+        {
+            static const struct { const wchar_t* suffix; double scale; } units[] = {
+                { L"", 1.0 }, { L"b", 1.0 },
+                { L"k", 1024.0 }, { L"kb", 1024.0 }, { L"kib", 1024.0 },
+                { L"m", 1048576.0 }, { L"mb", 1048576.0 }, { L"mib", 1048576.0 },
+                { L"g", 1073741824.0 }, { L"gb", 1073741824.0 }, { L"gib", 1073741824.0 },
+                { L"t", 1099511627776.0 }, { L"tb", 1099511627776.0 }, { L"tib", 1099511627776.0 },
+            };
+            if (!parseNumber(value, number, suffix))
+                return fail("expected a memory size such as 512MB");
+            for (const auto& unit : units)
+            {
+                if (suffix == unit.suffix)
+                {
+                    test.number = static_cast<unsigned long long>(number * unit.scale + 0.5);
+                    return true;
+                }
+            }
+            return fail("unknown memory unit '" + toNarrow(suffix) + "'");
+        }
+
+        case ProcessFilter::Field::Cpu:
+            if (!parseNumber(value, number, suffix) || (!suffix.empty() && suffix != L"%"))
+                return fail("expected a CPU percentage");
+            test.number = static_cast<unsigned long long>(number * 100.0 + 0.5);    // Hundredths, as in ProcessTable
+            return true;
+
+        case ProcessFilter::Field::Name:
+            test.text = value;
+            std::transform(test.text.begin(), test.text.end(), test.text.begin(), ::towlower);
+            test.glob = test.text.find_first_of(L"*?") != std::wstring::npos;
+            if (!test.glob)
+                test.text = cleanProcessName(test.text);    // "Notepad.exe" finds notepad too
+            return true;
+
+        case ProcessFilter::Field::User:
+            test.text = value;
+            std::transform(test.text.begin(), test.text.end(), test.text.begin(), ::towlower);
+            test.glob = test.text.find_first_of(L"*?") != std::wstring::npos;
+            test.numericUser = !test.text.empty() && std::all_of(test.text.begin(), test.text.end(), ::iswdigit);
+            if (test.numericUser)
+            {
+                if (!parseNumber(value, number, suffix) || number > 4294967294.0)
+                    return fail("user ID out of range");
+                test.number = static_cast<unsigned long long>(number);
+            }
+            return true;
+
+        case ProcessFilter::Field::State:
+        {
+            static const struct { const wchar_t* word; char letter; } states[] = {
+                { L"running", 'R' }, { L"sleeping", 'S' }, { L"disk", 'D' }, { L"zombie", 'Z' },
+                { L"stopped", 'T' }, { L"traced", 't' }, { L"idle", 'I' }, { L"dead", 'X' },
+            };
+            if (value.size() == 1 && value[0] < 0x80)
+            {
+                // Single letters as /proc shows them; only "t" (traced) is lowercase there
+                test.number = static_cast<unsigned long long>(value[0] == L't' ? 't' : std::towupper(value[0]));
+                return true;
+            }
+            std::wstring lower = value;
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::towlower);
+            for (const auto& state : states)
+            {
+                if (lower == state.word)
+                {
+                    test.number = static_cast<unsigned long long>(state.letter);
+                    return true;
+                }
+            }
+            return fail("unknown state '" + toNarrow(value) + "'");
+        }
+        }
+        return false;
+    }
+
+    const std::wstring& text;
+    ProcessFilter& filter;
+    std::string& error;
+
+    size_t position = 0;
+    size_t tokenStart = 0;
+    Token token = Token::End;
+    std::wstring value;
+    ProcessFilter::Compare compare = ProcessFilter::Compare::Equal;
+};
+
+bool ProcessFilter::compile(const std::wstring& text, std::string& error)
+{
+    ProcessFilter compiled;
+    FilterParser parser(text, compiled, error);
+    if (!parser.parse())
+        return false;
+
+    compiled.source = text;
+    source = std::move(compiled.source);
+    tests = std::move(compiled.tests);
+    program = std::move(compiled.program);
+    return true;
+}
+
+const std::wstring& ProcessFilter::text() const
+{
+    return source;
+}
+
+bool ProcessFilter::matchesAll() const
+{
+    return program.empty();
+}
+
+// One comparison over a whole column. The switch is outside the loops so each loop is a
+// plain compare-and-store the compiler can vectorize.
+template <typename T>
+static void compareColumn(const T* column, size_t count, uint8_t compare, T value, uint8_t* out)
+{
+    switch (compare)
+    {
+    case 0:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = column[i] == value;
+        break;
+    case 1:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = column[i] != value;
+        break;
+    case 2:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = column[i] < value;
+        break;
+    case 3:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = column[i] <= value;
+        break;
+    case 4:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = column[i] > value;
+        break;
+    default:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = column[i] >= value;
+        break;
+    }
+}
+
+void ProcessFilter::runTest(Test& test, const ProcessTable& table, const NamePool& names, uint8_t* out)
+{
+    size_t count = table.size();
+    uint8_t compare = static_cast<uint8_t>(test.compare);
+    bool negate = test.compare == Compare::NotEqual;
+
+    switch (test.field)
+    {
+    case Field::Pid:
+    case Field::Parent:
+    {
+        const DWORD* column = test.field == Field::Pid ? table.pid.data() : table.parentPid.data();
+        compareColumn(column, count, compare, static_cast<DWORD>(test.number), out);
+        break;
+    }
+    case Field::Memory:
+    case Field::Cpu:
+    {
+        if (test.field == Field::Memory)
+            compareColumn(table.memory.data(), count, compare, test.number, out);
+        else
+            compareColumn(table.cpu.data(), count, compare,
+                static_cast<uint32_t>(std::min<unsigned long long>(test.number, 0xFFFFFFFFu)), out);
+
+        // Counters of inaccessible processes are not known, so no test on them holds
+        const uint8_t* flags = table.flags.data();
+        for (size_t i = 0; i < count; ++i)
+            out[i] &= flags[i] & ProcessTable::Accessible;
+        break;
+    }
+    case Field::Name:
+    {
+        // Decide each name once; the table then only needs a lookup per row
+        for (uint32_t id = static_cast<uint32_t>(test.nameResults.size()); id < names.size(); ++id)
+        {
+            const std::wstring& name = names.lower(id);
+            bool match = test.glob ? globMatch(test.text, name) : name == test.text;
+            test.nameResults.push_back(static_cast<uint8_t>(match != negate));
+        }
+        const uint32_t* column = table.nameId.data();
+        const uint8_t* results = test.nameResults.data();
+        for (size_t i = 0; i < count; ++i)
+            out[i] = results[column[i]];
+        break;
+    }
+    case Field::User:
+    {
+        // Few distinct owners, usually in runs: remember the last one looked up
+        const uint32_t* column = table.user.data();
+        uint32_t lastUser = NoUser;
+        uint8_t lastResult = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t user = column[i];
+            if (user == NoUser)
+            {
+                out[i] = 0;
+                continue;
+            }
+            if (user != lastUser)
+            {
+                auto it = std::find_if(test.userResults.begin(), test.userResults.end(),
+                    [user](const std::pair<uint32_t, uint8_t>& entry) { return entry.first == user; });
+                if (it == test.userResults.end())
+                {
+                    bool match;
+                    if (test.numericUser)
+                    {
+                        match = user == test.number;
+                    }
+                    else
+                    {
+                        std::wstring name = userName(user);
+                        std::transform(name.begin(), name.end(), name.begin(), ::towlower);
+                        match = test.glob ? globMatch(test.text, name) : name == test.text;
+                    }
+                    test.userResults.emplace_back(user, static_cast<uint8_t>(match != negate));
+                    it = test.userResults.end() - 1;
+                }
+                lastUser = user;
+                lastResult = it->second;
+            }
+            out[i] = lastResult;
+        }
+        break;
+    }
+    case Field::State:
+        compareColumn(table.state.data(), count, compare, static_cast<char>(test.number), out);
+        break;
+    }
+}
+
+void ProcessFilter::evaluate(const ProcessTable& table, const NamePool& names, std::vector<uint8_t>& mask)
+{
+    size_t count = table.size();
+    if (program.empty())
+    {
+        mask.assign(count, 1);
+        return;
+    }
+
+    size_t depth = 0;
+    for (const Instruction& instruction : program)
+    {
+        if (instruction.step == Step::Test)
+        {
+            if (stack.size() <= depth)
+                stack.emplace_back();
+            stack[depth].resize(count);
+            runTest(tests[instruction.test], table, names, stack[depth].data());
+            ++depth;
+            continue;
+        }
+
+        uint8_t* top = stack[depth - 1].data();
+        if (instruction.step == Step::Not)
+        {
+            for (size_t i = 0; i < count; ++i)
+                top[i] ^= 1;
+            continue;
+        }
+
+        uint8_t* below = stack[depth - 2].data();
+        if (instruction.step == Step::And)
+        {
+            for (size_t i = 0; i < count; ++i)
+                below[i] &= top[i];
+        }
+        else
+        {
+            for (size_t i = 0; i < count; ++i)
+                below[i] |= top[i];
+        }
+        --depth;
+    }
+    mask.swap(stack[0]);
+}
+
+void ProcessFilter::select(const ProcessTable& table, const NamePool& names, const std::vector<uint32_t>& order,
+    std::vector<uint32_t>& rows)
+{
+    rows.clear();
+    if (program.empty())
+    {
+        rows = order;
+        return;
+    }
+
+    evaluate(table, names, selectMask);
+    for (uint32_t row : order)
+    {
+        if (selectMask[row])
+            rows.push_back(row);
+    }
+}
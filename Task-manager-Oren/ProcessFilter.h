@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "NamePool.h"
+#include "ProcessTable.h"
+
+// A filter expression such as  name=java* and memory>2GB and user=build  compiled into a
+// postfix program of column tests. Evaluation runs each test as one tight loop over a
+// ProcessTable column into a byte mask and combines the masks with and/or/not, so a
+// filter costs a few linear passes over the snapshot whatever its shape. Name and user
+// tests are decided once per distinct name or user and then looked up per row.
+class ProcessFilter
+{
+public:
+    // Parses text (an empty text matches everything). On a syntax error returns false
+    // with a message in error and leaves the previous filter in place.
+    bool compile(const std::wstring& text, std::string& error);
+
+    // The expression last compiled
+    const std::wstring& text() const;
+
+    // True when no expression is set
+    bool matchesAll() const;
+
+    // Sets mask[row] to 1 for the rows of table that match and 0 for the others
+    void evaluate(const ProcessTable& table, const NamePool& names, std::vector<uint8_t>& mask);
+
+    // The rows of order that match, in the same order
+    void select(const ProcessTable& table, const NamePool& names, const std::vector<uint32_t>& order,
+        std::vector<uint32_t>& rows);
+
+    // Short description of the language for prompts and --help
+    static const char* syntax();
+
+private:
+    friend class FilterParser;
+
+    enum class Field : uint8_t { Pid, Parent, Memory, Cpu, Name, User, State };
+    enum class Compare : uint8_t { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+    // One comparison of a field with a constant
+    struct Test
+    {
+        Field field;
+        Compare compare;
+        unsigned long long number = 0;    // pid, parent, memory (bytes), cpu (hundredths), numeric user, state letter
+        std::wstring text;                // Lowercase name or user pattern
+        bool glob = false;                // text has wildcards
+        bool numericUser = false;
+
+        // Outcome per NamePool ID (name tests) or per user ID (user tests), filled as they
+        // show up. Hosts have few owners, so those are a short list searched in order.
+        std::vector<uint8_t> nameResults;
+        std::vector<std::pair<uint32_t, uint8_t>> userResults;
+    };
+
+    enum class Step : uint8_t { Test, And, Or, Not };
+    struct Instruction
+    {
+        Step step;
+        uint32_t test;    // Index into tests for Step::Test
+    };
+
+    // Writes the outcome of one test for every row into out
+    void runTest(Test& test, const ProcessTable& table, const NamePool& names, uint8_t* out);
+
+    std::wstring source;
+    std::vector<Test> tests;
+    std::vector<Instruction> program;
+
+    // Evaluation stack of row masks and the mask select() uses, reused between calls
+    std::vector<std::vector<uint8_t>> stack;
+    std::vector<uint8_t> selectMask;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifdef _WIN32
+// Prevents Windows headers from defining conflicting macros like min/max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+// Same width as the Windows process ID so the rest of the code stays platform neutral
+typedef std::uint32_t DWORD;
+#endif
+
+// Memory counters that are expensive to read (smaps_rollup on Linux, a working set walk on
+// Windows), so they are collected less often than the rest: see ProcessManager::setMemoryDetailPolicy
+struct MemoryDetail
+{
+    unsigned long long unique = 0;          // USS: resident pages no other process maps
+    unsigned long long proportional = 0;    // PSS: unique plus each shared page divided among its sharers
+    unsigned long long shared = 0;          // Resident pages other processes map too
+    unsigned long long swap = 0;            // Swapped out (Linux); private commit outside the working set (Windows)
+    unsigned long long peak = 0;            // Peak resident size if the reader knows it (Linux VmHWM), else 0
+};
+
+// Holds information about a single process
+struct ProcessInfo
+{
+    DWORD pid;                        // Process ID
+    DWORD parentPid;                  // Process that started it
+    std::wstring name;               // Name of the process
+    unsigned long long memoryUsage;  // Memory used by the process (in bytes)
+    bool isAccessible;               // Can we read its memory info?
+    unsigned long long startTime;    // When the process started (detects PID reuse)
+    long long memoryDelta;           // Memory change since the previous refresh
+    bool isNew;                      // First seen in the latest refresh
+    uint32_t nameId;                 // Interned name (see NamePool)
+    unsigned long long cpuTime;      // User + kernel time used so far (nanoseconds)
+    double cpuUsage;                 // Percent of one core used since the previous refresh
+    uint32_t userId = 0xFFFFFFFFu;   // Owner: uid on Linux, account RID on Windows (see UserNames.h)
+    char state = '?';                // R running, S sleeping, D disk wait, Z zombie, T stopped,
+                                     // I idle, ... as in /proc/<pid>/stat; '?' if not known
+    unsigned long long pageFaults = 0;   // Page faults so far (minor and major)
+    unsigned long long majorFaults = 0;  // Faults that had to read from disk (Linux only)
+    unsigned long long peakMemory = 0;   // Largest working set / resident size known so far
+    MemoryDetail memoryDetail;           // Expensive counters, as of memoryDetailRefresh
+    unsigned long long memoryDetailRefresh = 0;  // Refresh they were read in (0 = never)
+    uint32_t threadCount = 0;
+    uint32_t handleCount = 0;            // Open file descriptors / handles
+    unsigned long long readBytes = 0;    // I/O so far (Linux: what reached storage)
+    unsigned long long writeBytes = 0;
+    unsigned long long readOps = 0;      // Read / write calls so far
+    unsigned long long writeOps = 0;
+    unsigned long long contextSwitches = 0;
+    double readRate = 0.0;               // Per second since the previous refresh, like cpuUsage
+    double writeRate = 0.0;              // (bytes for these two, calls or switches for the rest)
+    double readOpsRate = 0.0;
+    double writeOpsRate = 0.0;
+    double contextSwitchRate = 0.0;
+};
+
+// Used for grouping processes by name
+struct ProcessGroup 
+{
+    int count = 0;              // How many instances of the process
+    size_t totalMemory = 0;     // Combined memory usage of all instances
+};
+
+// What changed between the two most recent refreshes
+struct ProcessDelta
+{
+    std::vector<DWORD> added;            // PIDs seen for the first time
+    std::vector<DWORD> changed;          // PIDs whose memory, access, CPU, I/O, threads or handles changed
+    std::vector<ProcessInfo> removed;    // Processes that exited, as last seen
+};
@@ -1,8 +1,101 @@
 #include "ProcessLauncher.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
 #include <windows.h>
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#ifdef _WIN32
+// Appends one argument so that CreateProcessW's command-line parsing gives it back unchanged:
+// quoted if it is empty or holds whitespace or quotes, with backslashes doubled before a quote
+static void appendQuoted(std::wstring& commandLine, const std::wstring& arg)
+{
+    if (!arg.empty() && arg.find_first_of(L" \t\n\v\"") == std::wstring::npos)
+    {
+        commandLine += arg;
+        return;
+    }
+
+    commandLine += L'"';
+    for (size_t i = 0;; ++i)
+    {
+        size_t backslashes = 0;
+        while (i < arg.size() && arg[i] == L'\\')
+        {
+            ++backslashes;
+            ++i;
+        }
+        if (i == arg.size())
+        {
+            commandLine.append(backslashes * 2, L'\\');
+            break;
+        }
+        if (arg[i] == L'"')
+            commandLine.append(backslashes * 2 + 1, L'\\');
+        else
+            commandLine.append(backslashes, L'\\');
+        commandLine += arg[i];
+    }
+    commandLine += L'"';
+}
+#endif
+
+#ifndef _WIN32
+// Splits a command line on whitespace, like CreateProcessW does for simple commands
+static std::vector<std::string> splitCommandLine(const std::wstring& commandLine)
+{
+    std::istringstream stream(toNarrow(commandLine));
+    std::vector<std::string> args;
+    std::string arg;
+    while (stream >> arg)
+        args.push_back(arg);
+    return args;
+}
+
+// pidfd_open (Linux 5.3+) has no libc wrapper on older systems
+static int openPidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+#endif
+
+ProcessLauncher::~ProcessLauncher()
+{
+    cancelBatch();
+    if (batchThread.joinable())
+        batchThread.join();
+}
 
 bool ProcessLauncher::launch(const std::wstring& programPath)
 {
+#ifdef _WIN32
     STARTUPINFO si = { sizeof(STARTUPINFO) };
     PROCESS_INFORMATION pi;
 
@@ -17,4 +110,476 @@ bool ProcessLauncher::launch(const std::wstring& programPath)
         return true;
     }
     return false;
+#else
+    std::vector<std::string> args = splitCommandLine(programPath);
+    return spawnChild(args);
+#endif
+}
+
+bool ProcessLauncher::launch(const std::vector<std::wstring>& args)
+{
+    if (args.empty())
+        return false;
+#ifdef _WIN32
+    std::wstring commandLine;
+    for (const std::wstring& arg : args)
+    {
+        if (!commandLine.empty())
+            commandLine += L' ';
+        appendQuoted(commandLine, arg);
+    }
+    return launch(commandLine);
+#else
+    std::vector<std::string> narrow;
+    for (const std::wstring& arg : args)
+        narrow.push_back(toNarrow(arg));
+    return spawnChild(narrow);
+#endif
+}
+
+#ifndef _WIN32
+bool ProcessLauncher::spawnChild(std::vector<std::string>& args)
+{
+    reapChildren();
+    if (args.empty())
+        return false;
+
+    std::vector<char*> argv;
+    for (auto& a : args)
+        argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+        return false;
+    std::lock_guard<std::mutex> lock(childMutex);
+    launchedChildren.push_back(static_cast<DWORD>(pid));
+    return true;
+}
+#endif
+
+void ProcessLauncher::reapChildren()
+{
+#ifndef _WIN32
+    // Only our own: waiting for any child would take the exit status of a batch's commands
+    std::lock_guard<std::mutex> lock(childMutex);
+    launchedChildren.erase(std::remove_if(launchedChildren.begin(), launchedChildren.end(), [](DWORD child)
+        {
+            return waitpid(static_cast<pid_t>(child), nullptr, WNOHANG) != 0;
+        }), launchedChildren.end());
+#endif
+}
+
+bool ProcessLauncher::claimBatch(const std::vector<std::wstring>& commands)
+{
+    std::lock_guard<std::mutex> lock(batchMutex);
+    if (progress.active)
+        return false;
+    results.assign(commands.size(), LaunchResult());
+    for (size_t i = 0; i < commands.size(); ++i)
+        results[i].command = commands[i];
+    running.clear();
+    progress = BatchProgress();
+    progress.total = commands.size();
+    progress.active = true;
+    return true;
+}
+
+std::vector<LaunchResult> ProcessLauncher::runBatch(const std::vector<std::wstring>& commands, const BatchOptions& options)
+{
+    if (!claimBatch(commands))
+        return {};
+    return runClaimedBatch(commands, options);
+}
+
+std::vector<LaunchResult> ProcessLauncher::runClaimedBatch(const std::vector<std::wstring>& commands, const BatchOptions& options)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // One command in flight
+    struct Slot
+    {
+        size_t index;
+        DWORD pid;
+        Clock::time_point started;
+#ifdef _WIN32
+        HANDLE handle;
+#else
+        int pidfd;    // -1: no pidfd support, collected by polling
+#endif
+    };
+    std::vector<Slot> slots;
+
+    // Both record under the lock, so the views see a consistent picture
+    auto recordStart = [this](size_t index, DWORD pid, bool started, unsigned long error)
+        {
+            std::lock_guard<std::mutex> lock(batchMutex);
+            LaunchResult& result = results[index];
+            result.started = started;
+            result.pid = pid;
+            result.error = error;
+            if (started)
+            {
+                running.insert(std::upper_bound(running.begin(), running.end(), pid), pid);
+                ++progress.running;
+            }
+            else
+            {
+                ++progress.failed;
+            }
+        };
+    auto recordExit = [this](const Slot& slot, const LaunchResult& exit)
+        {
+            std::lock_guard<std::mutex> lock(batchMutex);
+            LaunchResult& result = results[slot.index];
+            result.exited = true;
+            result.exitCode = exit.exitCode;
+            result.signal = exit.signal;
+            result.userSeconds = exit.userSeconds;
+            result.systemSeconds = exit.systemSeconds;
+            result.peakMemory = exit.peakMemory;
+            result.wallSeconds = std::chrono::duration<double>(Clock::now() - slot.started).count();
+            auto it = std::lower_bound(running.begin(), running.end(), slot.pid);
+            if (it != running.end() && *it == slot.pid)
+                running.erase(it);
+            --progress.running;
+            ++progress.finished;
+            if (exit.exitCode != 0 || exit.signal != 0)
+                ++progress.failed;
+        };
+
+    size_t next = 0;
+#ifdef _WIN32
+    size_t limit = std::max<size_t>(1, std::min<size_t>(options.concurrency, MAXIMUM_WAIT_OBJECTS));
+    std::vector<HANDLE> handles;
+    std::vector<wchar_t> commandLine;
+    while (true)
+    {
+        while (next < commands.size() && slots.size() < limit && !cancelled)
+        {
+            size_t index = next++;
+            STARTUPINFOW si = { sizeof(STARTUPINFOW) };
+            PROCESS_INFORMATION pi;
+            commandLine.assign(commands[index].begin(), commands[index].end());
+            commandLine.push_back(L'\0');    // CreateProcessW may write to the command line
+            if (CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, FALSE,
+                options.quiet ? CREATE_NO_WINDOW : 0, nullptr, nullptr, &si, &pi))
+            {
+                CloseHandle(pi.hThread);
+                slots.push_back({ index, pi.dwProcessId, Clock::now(), pi.hProcess });
+                recordStart(index, pi.dwProcessId, true, 0);
+            }
+            else
+            {
+                recordStart(index, 0, false, GetLastError());
+            }
+        }
+        if (slots.empty())
+            break;
+
+        // Woken by the first exit; the timeout only lets cancellation through
+        handles.clear();
+        for (const Slot& slot : slots)
+            handles.push_back(slot.handle);
+        DWORD signalled = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE, 100);
+        if (signalled >= WAIT_OBJECT_0 + handles.size())
+            continue;
+
+        Slot slot = slots[signalled - WAIT_OBJECT_0];
+        slots.erase(slots.begin() + (signalled - WAIT_OBJECT_0));
+
+        LaunchResult exit;
+        DWORD code = 0;
+        GetExitCodeProcess(slot.handle, &code);
+        exit.exitCode = static_cast<int>(code);
+        FILETIME created, ended, kernel, user;
+        if (GetProcessTimes(slot.handle, &created, &ended, &kernel, &user))
+        {
+            auto seconds = [](const FILETIME& time)
+                {
+                    return static_cast<double>((static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+                };
+            exit.userSeconds = seconds(user);
+            exit.systemSeconds = seconds(kernel);
+        }
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(slot.handle, &counters, sizeof(counters)))
+            exit.peakMemory = counters.PeakWorkingSetSize;
+        CloseHandle(slot.handle);
+        recordExit(slot, exit);
+    }
+#else
+    size_t limit = std::max<size_t>(1, options.concurrency);
+
+    // Every child starts with an empty standard input, so none of them reads the menu's
+    // input, and with default signal handling whatever this process has set up
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    if (options.quiet)
+    {
+        posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, 1, 2);
+    }
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t noSignals, defaultSignals;
+    sigemptyset(&noSignals);
+    sigemptyset(&defaultSignals);
+    for (int signal : { SIGTERM, SIGINT, SIGPIPE, SIGCHLD, SIGHUP })
+        sigaddset(&defaultSignals, signal);
+    posix_spawnattr_setsigmask(&attributes, &noSignals);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+    flags |= POSIX_SPAWN_USEVFORK;    // glibc already spawns with CLONE_VFORK; older ones need asking
+#endif
+    posix_spawnattr_setflags(&attributes, flags);
+
+    // Exits arrive as readable pidfds; children without one are polled every millisecond
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    size_t polled = 0;
+    std::vector<epoll_event> events(64);
+    std::vector<std::string> args;
+    std::vector<char*> argv;
+
+    auto collect = [&](size_t position)
+        {
+            Slot slot = slots[position];
+            slots[position] = slots.back();
+            slots.pop_back();
+            if (slot.pidfd >= 0)
+                close(slot.pidfd);
+            else
+                --polled;
+
+            int status = 0;
+            rusage usage = {};
+            LaunchResult exit;
+            if (wait4(static_cast<pid_t>(slot.pid), &status, 0, &usage) > 0)
+            {
+                if (WIFEXITED(status))
+                    exit.exitCode = WEXITSTATUS(status);
+                else if (WIFSIGNALED(status))
+                {
+                    exit.signal = WTERMSIG(status);
+                    exit.exitCode = 128 + exit.signal;
+                }
+                exit.userSeconds = static_cast<double>(usage.ru_utime.tv_sec) + usage.ru_utime.tv_usec / 1e6;
+                exit.systemSeconds = static_cast<double>(usage.ru_stime.tv_sec) + usage.ru_stime.tv_usec / 1e6;
+                exit.peakMemory = static_cast<unsigned long long>(usage.ru_maxrss) * 1024;
+            }
+            recordExit(slot, exit);
+        };
+
+    while (true)
+    {
+        while (next < commands.size() && slots.size() < limit && !cancelled)
+        {
+            size_t index = next++;
+            args = splitCommandLine(commands[index]);
+            if (args.empty())
+            {
+                recordStart(index, 0, false, EINVAL);
+                continue;
+            }
+            argv.clear();
+            for (auto& a : args)
+                argv.push_back(&a[0]);
+            argv.push_back(nullptr);
+
+            pid_t pid;
+            int error = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+            if (error != 0)
+            {
+                recordStart(index, 0, false, static_cast<unsigned long>(error));
+                continue;
+            }
+
+            // The child stays our zombie until collected, so its PID cannot be reused before
+            // the pidfd is open
+            int pidfd = epoll >= 0 ? openPidfd(pid) : -1;
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u64 = static_cast<uint64_t>(pid);
+            if (pidfd >= 0 && epoll_ctl(epoll, EPOLL_CTL_ADD, pidfd, &event) != 0)
+            {
+                close(pidfd);
+                pidfd = -1;
+            }
+            if (pidfd < 0)
+                ++polled;
+            slots.push_back({ index, static_cast<DWORD>(pid), Clock::now(), pidfd });
+            recordStart(index, static_cast<DWORD>(pid), true, 0);
+        }
+        if (slots.empty())
+            break;
+
+        // The timeout only lets cancellation through, unless some children are polled
+        int ready = epoll >= 0 ? epoll_wait(epoll, events.data(), static_cast<int>(events.size()), polled ? 1 : 100) : 0;
+        if (epoll < 0)
+            usleep(1000);
+        for (int i = 0; i < ready; ++i)
+        {
+            DWORD pid = static_cast<DWORD>(events[i].data.u64);
+            auto it = std::find_if(slots.begin(), slots.end(), [pid](const Slot& slot) { return slot.pid == pid; });
+            if (it != slots.end())
+                collect(static_cast<size_t>(it - slots.begin()));
+        }
+        for (size_t position = 0; polled && position < slots.size();)
+        {
+            // si_pid stays 0 while the child is still running
+            siginfo_t info{};
+            if (slots[position].pidfd < 0 && waitid(P_PID, static_cast<id_t>(slots[position].pid), &info, WEXITED | WNOHANG | WNOWAIT) == 0
+                && info.si_pid != 0)
+                collect(position);
+            else
+                ++position;
+        }
+    }
+
+    if (epoll >= 0)
+        close(epoll);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+#endif
+
+    std::lock_guard<std::mutex> lock(batchMutex);
+    progress.active = false;
+    return results;
+}
+
+bool ProcessLauncher::startBatch(std::vector<std::wstring> commands, const BatchOptions& options)
+{
+    // Marked active before the thread runs, so the views never see a started batch as idle
+    // and a second start is refused instead of waiting for this one
+    if (!claimBatch(commands))
+        return false;
+
+    // The previous batch is no longer active, so its thread is only returning
+    if (batchThread.joinable())
+        batchThread.join();
+
+    cancelled = false;
+    batchStarted = true;
+    batchThread = std::thread([this, commands = std::move(commands), options]() { runClaimedBatch(commands, options); });
+    return true;
+}
+
+void ProcessLauncher::cancelBatch()
+{
+    cancelled = true;
+}
+
+bool ProcessLauncher::hasBatch() const
+{
+    return batchStarted;
+}
+
+void ProcessLauncher::clearBatch()
+{
+    if (batchThread.joinable())
+        batchThread.join();
+    batchStarted = false;
+    std::lock_guard<std::mutex> lock(batchMutex);
+    results.clear();
+    running.clear();
+    progress = BatchProgress();
+}
+
+BatchProgress ProcessLauncher::batchProgress() const
+{
+    std::lock_guard<std::mutex> lock(batchMutex);
+    return progress;
+}
+
+std::vector<DWORD> ProcessLauncher::runningPids() const
+{
+    std::lock_guard<std::mutex> lock(batchMutex);
+    return running;
+}
+
+std::vector<LaunchResult> ProcessLauncher::batchResults() const
+{
+    std::lock_guard<std::mutex> lock(batchMutex);
+    return results;
+}
+
+bool ProcessLauncher::readBatchFile(const std::string& path, std::vector<std::wstring>& commands)
+{
+    std::ifstream file;
+    if (path != "-")
+    {
+        file.open(path);
+        if (!file)
+            return false;
+    }
+    std::istream& in = path == "-" ? std::cin : file;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        commands.push_back(toWide(line.substr(first, last - first + 1)));
+    }
+    return true;
+}
+
+std::wstring ProcessLauncher::describeBatch(const std::vector<LaunchResult>& results)
+{
+    std::wostringstream out;
+    size_t notStarted = 0, succeeded = 0, nonZero = 0, pending = 0;
+    double user = 0.0, system = 0.0, longest = 0.0;
+    unsigned long long peak = 0;
+    for (const LaunchResult& result : results)
+    {
+        if (!result.started)
+        {
+            // Never started: either it failed to, or the batch was cancelled first
+            if (result.error != 0)
+            {
+                ++notStarted;
+                out << L"Could not start \"" << result.command << L"\" (Error code: " << result.error << L")\n";
+            }
+            else
+            {
+                ++pending;
+            }
+            continue;
+        }
+        if (!result.exited)
+        {
+            ++pending;
+            continue;
+        }
+
+        user += result.userSeconds;
+        system += result.systemSeconds;
+        longest = std::max(longest, result.wallSeconds);
+        peak = std::max(peak, result.peakMemory);
+        if (result.exitCode == 0 && result.signal == 0)
+        {
+            ++succeeded;
+            continue;
+        }
+        ++nonZero;
+        out << L"PID " << result.pid << L" \"" << result.command << L"\" ";
+        if (result.signal)
+            out << L"killed by signal " << result.signal << L"\n";
+        else
+            out << L"exited with code " << result.exitCode << L"\n";
+    }
+
+    out << results.size() << L" commands: " << succeeded << L" succeeded, " << nonZero << L" exited with an error, "
+        << notStarted << L" could not start";
+    if (pending)
+        out << L", " << pending << L" not finished";
+    out << L"\n" << std::fixed;
+    out.precision(2);
+    out << L"CPU " << user << L" s user, " << system << L" s system; longest " << longest
+        << L" s; largest peak memory " << formatMemory(static_cast<size_t>(peak)) << L"\n";
+    return out.str();
 }
@@ -1,10 +1,121 @@
 #pragma once
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "ProcessInfo.h"
+
+// What became of one command of a batch
+struct LaunchResult
+{
+    std::wstring command;
+    DWORD pid = 0;
+    bool started = false;
+    bool exited = false;
+    unsigned long error = 0;              // errno / GetLastError when it could not be started
+    int exitCode = 0;
+    int signal = 0;                       // Signal that ended it (Linux), 0 = it exited
+    double userSeconds = 0.0;             // CPU time of the process itself
+    double systemSeconds = 0.0;
+    unsigned long long peakMemory = 0;    // Peak resident set / working set, bytes
+    double wallSeconds = 0.0;             // From start to exit
+};
+
+// Where a batch stands
+struct BatchProgress
+{
+    size_t total = 0;
+    size_t running = 0;
+    size_t finished = 0;    // Exited, whatever the exit code
+    size_t failed = 0;      // Could not be started, or exited non-zero / by a signal
+    bool active = false;    // Still starting commands or waiting for them
+};
+
+struct BatchOptions
+{
+    // Most commands running at once (at most 64 on Windows, the limit of one wait)
+    unsigned concurrency = 16;
+
+    // Discard the commands' output; their input is always empty
+    bool quiet = false;
+};
 
 class ProcessLauncher
 {
 public:
+    ProcessLauncher() = default;
+    ~ProcessLauncher();
+
+    ProcessLauncher(const ProcessLauncher&) = delete;
+    ProcessLauncher& operator=(const ProcessLauncher&) = delete;
+
     // Launches a program given its name or full path
     // Returns true if successful, false otherwise
     bool launch(const std::wstring& programPath);
+
+    // Launches a program with exactly these arguments (args[0] is the program): none of them
+    // is split again, whatever spaces or quotes it holds
+    bool launch(const std::vector<std::wstring>& args);
+
+    // Collects the children of launch() that have exited, so they do not linger as zombies
+    // until the next launch. Cheap; long-running callers call it periodically (safe from
+    // any thread).
+    void reapChildren();
+
+    // Runs every command line (split like launch does), at most options.concurrency at a
+    // time, and returns once all of them have exited. Results follow the order of commands.
+    // Processes are kept as handles (pidfds on Linux) so exit codes and resource usage are
+    // collected as each one finishes, without polling.
+    std::vector<LaunchResult> runBatch(const std::vector<std::wstring>& commands, const BatchOptions& options);
+
+    // Runs a batch on a background thread; false if one is still running
+    bool startBatch(std::vector<std::wstring> commands, const BatchOptions& options);
+
+    // Stops the background batch from starting more commands (running ones finish normally)
+    void cancelBatch();
+
+    // True from startBatch until clearBatch
+    bool hasBatch() const;
+
+    // Waits for the background batch and forgets it
+    void clearBatch();
+
+    BatchProgress batchProgress() const;
+
+    // PIDs of the batch's commands that are running now, sorted: the group the views track
+    std::vector<DWORD> runningPids() const;
+
+    // Results so far, in command order
+    std::vector<LaunchResult> batchResults() const;
+
+    // Reads one command per line ("-" = standard input); blank lines and # comments are skipped
+    static bool readBatchFile(const std::string& path, std::vector<std::wstring>& commands);
+
+    // Totals of a batch plus one line per command that failed
+    static std::wstring describeBatch(const std::vector<LaunchResult>& results);
+
+private:
+    // State of the batch being run, shared with the views
+    mutable std::mutex batchMutex;
+    std::vector<LaunchResult> results;
+    std::vector<DWORD> running;
+    BatchProgress progress;
+    std::atomic<bool> cancelled{ false };
+    std::thread batchThread;
+    bool batchStarted = false;
+
+    // Resets the shared state for commands and marks the batch active; false if one already is
+    bool claimBatch(const std::vector<std::wstring>& commands);
+
+    // Body of runBatch once claimBatch has succeeded
+    std::vector<LaunchResult> runClaimedBatch(const std::vector<std::wstring>& commands, const BatchOptions& options);
+
+    // Starts args[0] with args, remembering the child for reapChildren (Linux)
+    bool spawnChild(std::vector<std::string>& args);
+
+    // Children of launch() not collected yet (Linux), so they do not linger as zombies
+    std::mutex childMutex;
+    std::vector<DWORD> launchedChildren;
 };
@@ -1,57 +1,360 @@
 #include "ProcessManager.h"
-#include "Utils.h" // For formatMemory function
+#include "Format.h"
+#include "Utils.h"
 
-// Refresh the list of currently running processes on the system
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+ProcessManager::ProcessManager() : snapshotSource(createDefaultSnapshotSource()) {}
+
+ProcessManager::ProcessManager(std::unique_ptr<ProcessSnapshotSource> source) : snapshotSource(std::move(source)) {}
+
+// Refresh the list of currently running processes on the system.
+// Known PIDs are updated in place, so the cost follows the churn rather than the process count.
 bool ProcessManager::refreshProcessList()
 {
-    processList.clear();  // Clear any existing processes from the list
-
-    // Take a snapshot of all running processes
-    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-    if (snapshot == INVALID_HANDLE_VALUE)
+    if (pidIndexDirty)
     {
-        return false;
+        rebuildPidIndex();
     }
 
-    PROCESSENTRY32W entry;
-    entry.dwSize = sizeof(PROCESSENTRY32W);
+    lastDelta.added.clear();
+    lastDelta.changed.clear();
+    lastDelta.removed.clear();
+    seenThisRefresh.assign(processList.size(), 0);
+
+    // CPU rates are CPU time over the wall time since the previous refresh
+    auto now = std::chrono::steady_clock::now();
+    refreshInterval = lastRefreshTime == std::chrono::steady_clock::time_point()
+        ? 0
+        : std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastRefreshTime).count();
+    lastRefreshTime = now;
+
+    bool success;
+    if (collectionPool)
+    {
+        success = collectInParallel();
+    }
+    else
+    {
+        success = snapshotSource->forEachProcess([this](const ProcessSample& sample) { mergeSample(sample); });
+    }
 
-    // Get the first process from the snapshot
-    if (!Process32FirstW(snapshot, &entry))
+    if (!success)
     {
-        CloseHandle(snapshot);
+        // Part of the list may have been merged; the search index must start over
+        deltaBaseVersion = 0;
+        ++listVersion;
         return false;
     }
 
-    do
+    // Drop processes that were not reported, moving the last entry into the hole
+    for (size_t slot = 0; slot < processList.size();)
+    {
+        if (seenThisRefresh[slot])
+        {
+            ++slot;
+            continue;
+        }
+
+        pidIndex.erase(processList[slot].pid);
+        lastDelta.removed.push_back(std::move(processList[slot]));
+
+        size_t last = processList.size() - 1;
+        if (slot != last)
+        {
+            processList[slot] = std::move(processList[last]);
+            seenThisRefresh[slot] = seenThisRefresh[last];
+            pidIndex[processList[slot].pid] = slot;
+        }
+        processList.pop_back();
+        seenThisRefresh.pop_back();
+    }
+
+    // The expensive tier: everything now and then, otherwise just the largest processes
+    ++refreshCount;
+    if (detailPolicy.every > 0 && refreshCount % detailPolicy.every == 1 % detailPolicy.every)
+        refreshMemoryDetail(0);
+    else if (detailPolicy.topCount > 0)
+        refreshMemoryDetail(detailPolicy.topCount);
+
+    deltaBaseVersion = listVersion++;
+    invalidateViews();
+    return true; // Successfully refreshed process list
+}
+
+// Per-second rate of a counter over interval nanoseconds (0 without an interval or if it went backwards)
+static double perSecond(unsigned long long now, unsigned long long before, long long interval)
+{
+    return interval > 0 && now > before ? 1e9 * static_cast<double>(now - before) / static_cast<double>(interval) : 0.0;
+}
+
+// Copies the counters that need no previous value
+static void copyCounters(const ProcessSample& sample, ProcessInfo& proc)
+{
+    proc.pageFaults = sample.pageFaults;
+    proc.majorFaults = sample.majorFaults;
+    proc.threadCount = sample.threadCount;
+    proc.handleCount = sample.handleCount;
+    proc.readBytes = sample.readBytes;
+    proc.writeBytes = sample.writeBytes;
+    proc.readOps = sample.readOps;
+    proc.writeOps = sample.writeOps;
+    proc.contextSwitches = sample.contextSwitches;
+}
+
+// Fold one sample into the list: update a known PID, or add a new (or recycled) one
+void ProcessManager::mergeSample(const ProcessSample& sample)
+{
+    auto it = pidIndex.find(sample.pid);
+    size_t slot;
+
+    if (it != pidIndex.end())
     {
-        ProcessInfo pinfo;
-        pinfo.pid = entry.th32ProcessID;
-        pinfo.name = entry.szExeFile; // Process executable name
-        pinfo.isAccessible = true;    // Assume accessible at first
-        pinfo.memoryUsage = 0;
+        slot = it->second;
+        if (seenThisRefresh[slot])
+            return; // Already reported in this walk
 
-        // Try to open the process for querying memory info
-        HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pinfo.pid);
-        if (hProcess)
+        ProcessInfo& proc = processList[slot];
+        if (proc.startTime == sample.startTime)
         {
-            PROCESS_MEMORY_COUNTERS pmc;
-            if (GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc)))
+            // Same process as last time: only the counters can have changed
+            seenThisRefresh[slot] = 1;
+            proc.memoryDelta = static_cast<long long>(sample.memoryUsage) - static_cast<long long>(proc.memoryUsage);
+            proc.isNew = false;
+            // Also when a rate goes back to zero or a count moves, so readers of the delta
+            // (alerts, leaks) never hold on to a stale value; context switches alone do not
+            // count, or nearly every process would be in the set on every tick
+            if (proc.memoryDelta != 0 || proc.isAccessible != sample.isAccessible || proc.cpuTime != sample.cpuTime
+                || proc.cpuUsage != 0.0 || proc.readBytes != sample.readBytes || proc.writeBytes != sample.writeBytes
+                || proc.readRate != 0.0 || proc.writeRate != 0.0
+                || proc.threadCount != sample.threadCount || proc.handleCount != sample.handleCount)
             {
-                pinfo.memoryUsage = pmc.WorkingSetSize;  // Store current memory usage
+                lastDelta.changed.push_back(sample.pid);
             }
-            CloseHandle(hProcess);
+            proc.memoryUsage = sample.memoryUsage;
+            proc.isAccessible = sample.isAccessible;
+            proc.peakMemory = std::max({ proc.peakMemory, sample.peakMemory, sample.memoryUsage });
+            proc.parentPid = sample.parentPid; // Orphans get re-parented
+            proc.userId = sample.userId;       // setuid() can change the owner
+            proc.state = sample.state;
+
+            // The previous CPU time is in the slot the PID index just gave us
+            unsigned long long cpuSpent = sample.cpuTime > proc.cpuTime ? sample.cpuTime - proc.cpuTime : 0;
+            proc.cpuUsage = refreshInterval > 0 ? 100.0 * static_cast<double>(cpuSpent) / static_cast<double>(refreshInterval) : 0.0;
+            proc.cpuTime = sample.cpuTime;
+
+            // Same for the I/O and scheduling counters
+            proc.readRate = perSecond(sample.readBytes, proc.readBytes, refreshInterval);
+            proc.writeRate = perSecond(sample.writeBytes, proc.writeBytes, refreshInterval);
+            proc.readOpsRate = perSecond(sample.readOps, proc.readOps, refreshInterval);
+            proc.writeOpsRate = perSecond(sample.writeOps, proc.writeOps, refreshInterval);
+            proc.contextSwitchRate = perSecond(sample.contextSwitches, proc.contextSwitches, refreshInterval);
+            copyCounters(sample, proc);
+            return;
         }
-        else
+
+        // The PID was recycled: the old process exited and a new one took its slot
+        lastDelta.removed.push_back(proc);
+    }
+    else
+    {
+        slot = processList.size();
+        processList.emplace_back();
+        seenThisRefresh.push_back(0);
+        pidIndex[sample.pid] = slot;
+    }
+
+    ProcessInfo& proc = processList[slot];
+    seenThisRefresh[slot] = 1;
+    proc.pid = sample.pid;
+    proc.parentPid = sample.parentPid;
+    copyName(sample, proc.name);
+    proc.nameId = processNames().intern(proc.name);
+    proc.memoryUsage = sample.memoryUsage;
+    proc.isAccessible = sample.isAccessible;
+    proc.startTime = sample.startTime;
+    proc.memoryDelta = 0;
+    proc.cpuTime = sample.cpuTime;
+    proc.cpuUsage = 0.0; // No rate until it has been seen twice
+    proc.userId = sample.userId;
+    proc.state = sample.state;
+    copyCounters(sample, proc);
+    proc.readRate = 0.0;
+    proc.writeRate = 0.0;
+    proc.readOpsRate = 0.0;
+    proc.writeOpsRate = 0.0;
+    proc.contextSwitchRate = 0.0;
+    proc.peakMemory = std::max(sample.peakMemory, sample.memoryUsage);
+    proc.memoryDetail = MemoryDetail();
+    proc.memoryDetailRefresh = 0;
+    proc.isNew = true;
+    lastDelta.added.push_back(sample.pid);
+}
+
+// Let the worker pool read the processes into per-worker chunks, then merge the chunks
+// one after another on this thread. Workers never share anything, so no lock is needed.
+bool ProcessManager::collectInParallel()
+{
+    size_t count = 0;
+    if (!snapshotSource->beginWalk(count))
+        return false;
+
+    for (auto& chunk : chunks)
+    {
+        chunk.samples.clear();
+        chunk.nameOffsets.clear();
+        chunk.utf8Names.clear();
+        chunk.wideNames.clear();
+    }
+
+    collectionPool->parallelFor(count, 128, [this](size_t begin, size_t end, unsigned worker)
+        {
+            SampleChunk& chunk = chunks[worker];
+            ProcessSample sample;
+            for (size_t i = begin; i < end; ++i)
+            {
+                if (!snapshotSource->sampleAt(i, sample, chunk.scratch))
+                    continue;
+
+                // The name lives in scratch, which the next read overwrites, so keep a copy
+                if (sample.wideName)
+                {
+                    chunk.nameOffsets.push_back(chunk.wideNames.size());
+                    chunk.wideNames.append(sample.wideName, sample.nameLength);
+                }
+                else
+                {
+                    chunk.nameOffsets.push_back(chunk.utf8Names.size());
+                    chunk.utf8Names.append(sample.utf8Name, sample.nameLength);
+                }
+                chunk.samples.push_back(sample);
+            }
+        });
+
+    for (auto& chunk : chunks)
+    {
+        for (size_t i = 0; i < chunk.samples.size(); ++i)
         {
-            pinfo.isAccessible = false; // Mark as inaccessible if cannot open
+            ProcessSample& sample = chunk.samples[i];
+            if (sample.wideName)
+                sample.wideName = chunk.wideNames.data() + chunk.nameOffsets[i];
+            else
+                sample.utf8Name = chunk.utf8Names.data() + chunk.nameOffsets[i];
+            mergeSample(sample);
         }
+    }
+    return true;
+}
+
+// Replace the pool; one thread means collecting on the calling thread
+void ProcessManager::setCollectionThreads(unsigned threads)
+{
+    if (threads <= 1)
+    {
+        collectionPool.reset();
+        chunks.clear();
+        return;
+    }
 
-        processList.push_back(pinfo); // Add this process info to the list
-    } while (Process32NextW(snapshot, &entry)); // Continue through the snapshot
+    collectionPool = std::make_unique<WorkerPool>(threads);
+    chunks.resize(threads);
+}
 
-    CloseHandle(snapshot);
-    return true; // Successfully refreshed process list
+void ProcessManager::setMemoryDetailPolicy(const MemoryDetailPolicy& policy)
+{
+    detailPolicy = policy;
+}
+
+// Pick the processes to read: the largest ones by resident memory (nth_element, so no full
+// sort), or all of them. Processes without resident memory (kernel threads) have nothing to break down.
+size_t ProcessManager::refreshMemoryDetail(size_t topCount)
+{
+    detailSlots.clear();
+    for (size_t slot = 0; slot < processList.size(); ++slot)
+    {
+        if (processList[slot].isAccessible && processList[slot].memoryUsage > 0)
+            detailSlots.push_back(slot);
+    }
+
+    if (topCount > 0 && topCount < detailSlots.size())
+    {
+        std::nth_element(detailSlots.begin(), detailSlots.begin() + topCount, detailSlots.end(),
+            [this](size_t a, size_t b) { return processList[a].memoryUsage > processList[b].memoryUsage; });
+        detailSlots.resize(topCount);
+    }
+
+    size_t read = readMemoryDetails();
+    tableDirty = true; // The breakdown columns changed; rows and their order did not
+    return read;
+}
+
+// Each slot is written by one worker only, so the reads need no lock
+size_t ProcessManager::readMemoryDetails()
+{
+    unsigned long long stamp = std::max(refreshCount, 1ULL);
+    auto readRange = [this, stamp](size_t begin, size_t end, SampleScratch& scratch)
+        {
+            size_t read = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                ProcessInfo& proc = processList[detailSlots[i]];
+                MemoryDetail detail;
+                if (!snapshotSource->readMemoryDetail(proc.pid, detail, scratch))
+                    continue;
+                proc.memoryDetail = detail;
+                proc.memoryDetailRefresh = stamp;
+                proc.peakMemory = std::max(proc.peakMemory, detail.peak);
+                ++read;
+            }
+            return read;
+        };
+
+    if (!collectionPool || detailSlots.size() < 64)
+        return readRange(0, detailSlots.size(), detailScratch);
+
+    std::vector<size_t> counts(chunks.size(), 0);
+    collectionPool->parallelFor(detailSlots.size(), 16, [&](size_t begin, size_t end, unsigned worker)
+        {
+            counts[worker] += readRange(begin, end, chunks[worker].scratch);
+        });
+
+    size_t read = 0;
+    for (size_t count : counts)
+        read += count;
+    return read;
+}
+
+// Get what the last refresh added, removed and changed
+const ProcessDelta& ProcessManager::getLastDelta() const
+{
+    return lastDelta;
+}
+
+// Take over a list collected by someone else; the index is rebuilt on the next refresh
+void ProcessManager::loadProcessList(const std::vector<ProcessInfo>& processes, const ProcessDelta& delta)
+{
+    processList = processes;
+    lastDelta = delta;
+    lastRefreshTime = std::chrono::steady_clock::now();
+    pidIndexDirty = true;
+    deltaBaseVersion = 0;    // Not known to follow the list we had
+    ++listVersion;
+    invalidateViews();
+}
+
+// Rebuild the PID index after the list has been reordered
+void ProcessManager::rebuildPidIndex()
+{
+    pidIndex.clear();
+    for (size_t slot = 0; slot < processList.size(); ++slot)
+    {
+        pidIndex[processList[slot].pid] = slot;
+    }
+    pidIndexDirty = false;
 }
 
 // Get the current list of processes (read-only)
@@ -60,238 +363,436 @@ const std::vector<ProcessInfo>& ProcessManager::getProcessList() const
     return processList;
 }
 
-// Sort processes alphabetically by name (case-insensitive), inaccessible processes last
-void ProcessManager::sortByName()
+// Look a PID up through the index; after loadProcessList the index is stale until the
+// next refresh, so fall back to a scan
+const ProcessInfo* ProcessManager::findProcess(DWORD pid) const
 {
-    std::sort(processList.begin(), processList.end(), [this](const ProcessInfo& a, const ProcessInfo& b)
-        {
-            // Ensure inaccessible processes go last
-            if (!a.isAccessible && b.isAccessible) return false;
-            if (a.isAccessible && !b.isAccessible) return true;
+    if (!pidIndexDirty)
+    {
+        auto it = pidIndex.find(pid);
+        return it != pidIndex.end() ? &processList[it->second] : nullptr;
+    }
 
-            // Clean names by removing ".exe" and convert to lowercase for comparison
-            std::wstring aClean = cleanName(a.name);
-            std::wstring bClean = cleanName(b.name);
-            std::transform(aClean.begin(), aClean.end(), aClean.begin(), towlower);
-            std::transform(bClean.begin(), bClean.end(), bClean.begin(), towlower);
+    for (const auto& proc : processList)
+    {
+        if (proc.pid == pid)
+            return &proc;
+    }
+    return nullptr;
+}
 
-            return aClean < bClean;
-        });
+// Sort processes alphabetically by name (case-insensitive), inaccessible processes last.
+// Only a permutation of row indices is sorted; processList itself keeps its order.
+void ProcessManager::sortByName()
+{
+    sortBy({ { SortKey::Accessible, false }, { SortKey::Name, false } });
 }
 
 // Sort processes by memory usage descending, inaccessible processes last
 void ProcessManager::sortByMemory()
 {
-    std::sort(processList.begin(), processList.end(), [](const ProcessInfo& a, const ProcessInfo& b)
-        {
-            // Inaccessible processes are always last
-            if (!a.isAccessible && b.isAccessible) return false;
-            if (a.isAccessible && !b.isAccessible) return true;
+    sortBy({ { SortKey::Accessible, false }, { SortKey::Memory, true } });
+}
 
-            return a.memoryUsage > b.memoryUsage;
-        });
+// Sort processes by CPU usage descending, memory breaking ties
+void ProcessManager::sortByCpu()
+{
+    sortBy({ { SortKey::Accessible, false }, { SortKey::Cpu, true }, { SortKey::Memory, true } });
 }
 
-// Remove ".exe" extension for cleaner display
-std::wstring ProcessManager::cleanName(const std::wstring& name) const
+// Any stable multi-key order; repeating an order before the next refresh is free
+void ProcessManager::sortBy(const SortOrder& fields)
+{
+    displayOrder = &sorter.order(getProcessTable(), processNames(), fields);
+}
+
+// Forget everything derived from processList
+void ProcessManager::invalidateViews()
+{
+    tableDirty = true;
+    treeDirty = true;
+    sorter.invalidate();
+    displayOrder = nullptr;
+}
+
+// Column copy of processList, rebuilt the first time it is needed after a change
+const ProcessTable& ProcessManager::getProcessTable() const
+{
+    if (tableDirty)
+    {
+        table.assign(processList);
+        tableDirty = false;
+    }
+    return table;
+}
+
+// Tree over the table rows, rebuilt the first time it is needed after a change
+const ProcessTree& ProcessManager::getProcessTree() const
 {
-    size_t pos = name.find(L".exe");
-    if (pos != std::wstring::npos)
+    if (treeDirty)
     {
-        return name.substr(0, pos);
+        tree.build(getProcessTable());
+        treeDirty = false;
     }
-    return name;
+    return tree;
+}
+
+// Remove ".exe" extension for cleaner display
+std::wstring ProcessManager::cleanName(const std::wstring& name) const
+{
+    return cleanProcessName(name);
 }
 
 void ProcessManager::printProcessList(const std::vector<ProcessInfo>& list) const
 {
+    const NamePool& names = processNames();
     size_t nameWidth = getLongestNameLength() + 5;
 
-    std::wcout << std::left << std::setw(10) << L"PID"
-        << std::setw(nameWidth) << L"Name"
-        << std::setw(15) << L"Memory"
-        << L"\n";
-
-    std::wcout << std::wstring(10 + nameWidth + 15, L'-') << L"\n";
+    int width = static_cast<int>(nameWidth);
+    TextRow line;
+    line.text(L"PID", 10).text(L"Name", width).text(L"Memory", 15).print(std::wcout);
+    line.repeat(L'-', 10 + width + 15).print(std::wcout);
 
     for (const auto& proc : list)
     {
-        std::wcout << std::left << std::setw(10) << proc.pid
-            << std::setw(nameWidth) << cleanName(proc.name).c_str();
+        line.number(proc.pid, 10).text(names.display(proc.nameId), width);
 
         if (proc.isAccessible)
-            std::wcout << std::setw(15) << formatMemory(proc.memoryUsage).c_str();
+            line.memory(proc.memoryUsage, 15);
         else
-            std::wcout << std::setw(15) << L"Access Denied";
+            line.text(L"Access Denied", 15);
 
-        std::wcout << L"\n";
+        line.print(std::wcout);
     }
 }
 
 // Calculate longest process name length (for formatting output)
 size_t ProcessManager::getLongestNameLength() const
 {
+    const ProcessTable& rows = getProcessTable();
+    const NamePool& names = processNames();
+
     size_t maxLength = 0;
-    for (const auto& proc : processList)
+    for (uint32_t row = 0; row < rows.size(); ++row)
     {
-        if (proc.isAccessible)
+        if (rows.accessible(row))
         {
-            size_t len = cleanName(proc.name).length();
-            if (len > maxLength)
-                maxLength = len;
+            maxLength = std::max(maxLength, names.display(rows.nameId[row]).length());
         }
     }
     return maxLength;
 }
 
-// Print detailed list of processes (PID, Name, Memory usage)
+// Print detailed list of processes (PID, Name, Memory usage) in the last sorted order
 void ProcessManager::printProcessList() const
 {
+    const ProcessTable& rows = getProcessTable();
+    const NamePool& names = processNames();
     size_t nameWidth = getLongestNameLength() + 5;
+    bool sorted = displayOrder && displayOrder->size() == rows.size();
 
-    // Print headers with alignment
-    std::wcout << std::left << std::setw(10) << L"PID"
-        << std::setw(nameWidth) << L"Name"
-        << std::setw(15) << L"Memory"
-        << L"\n";
-
-    // Print separator line
-    std::wcout << std::wstring(10 + nameWidth + 15, L'-') << L"\n";
+    // Print headers with alignment, then a separator line
+    int width = static_cast<int>(nameWidth);
+    TextRow line;
+    line.text(L"PID", 10).text(L"Name", width).text(L"Memory", 15).print(std::wcout);
+    line.repeat(L'-', 10 + width + 15).print(std::wcout);
 
     // Print each process info, handling inaccessible processes
-    for (const auto& proc : processList)
+    for (uint32_t i = 0; i < rows.size(); ++i)
     {
-        std::wcout << std::left << std::setw(10) << proc.pid
-            << std::setw(nameWidth) << cleanName(proc.name).c_str();
+        uint32_t row = sorted ? (*displayOrder)[i] : i;
+        line.number(rows.pid[row], 10).text(names.display(rows.nameId[row]), width);
 
-        if (proc.isAccessible)
+        if (rows.accessible(row))
         {
-            std::wcout << std::setw(15) << formatMemory(proc.memoryUsage).c_str();
+            line.memory(rows.memory[row], 15);
         }
         else
         {
-            std::wcout << std::setw(15) << L"Access Denied";
+            line.text(L"Access Denied", 15);
         }
 
-        std::wcout << L"\n";
+        line.print(std::wcout);
     }
 }
 
-// Group processes by name, sum memory, then print sorted by total memory descending
-void ProcessManager::printGroupedProcessesByMemory() const
+// End of the page [first, first + count), without overflowing for an unlimited count
+static size_t limitFor(size_t first, size_t count)
+{
+    return count > GroupingEngine::NoLimit - first ? GroupingEngine::NoLimit : first + count;
+}
+
+// Only the rows up to the end of the page are selected (see ProcessSorter::top)
+const std::vector<uint32_t>& ProcessManager::topProcesses(const SortOrder& fields, size_t count)
 {
-    std::map<std::wstring, ProcessGroup> grouped;
+    return sorter.top(getProcessTable(), processNames(), fields, count);
+}
 
-    // Aggregate counts and memory per cleaned process name
-    for (const auto& p : processList)
+size_t ProcessManager::printProcessPage(const SortOrder& fields, size_t first, size_t count)
+{
+    const ProcessTable& rows = getProcessTable();
+    const NamePool& names = processNames();
+    size_t end = std::min(rows.size(), limitFor(first, count));
+    const std::vector<uint32_t>& order = topProcesses(fields, end);
+
+    // Name column sized for this page only
+    size_t nameLength = 0;
+    for (size_t i = first; i < end; ++i)
+        nameLength = std::max(nameLength, names.display(rows.nameId[order[i]]).length());
+    int width = static_cast<int>(nameLength) + 5;
+
+    TextRow line;
+    line.text(L"PID", 10).text(L"Name", width).text(L"Memory", 15).text(L"CPU").print(std::wcout);
+    line.repeat(L'-', 10 + width + 15 + 8).print(std::wcout);
+    for (size_t i = first; i < end; ++i)
     {
-        if (p.isAccessible)
-        {
-            std::wstring name = cleanName(p.name);
-            grouped[name].count++;
-            grouped[name].totalMemory += static_cast<unsigned long long>(p.memoryUsage);
-        }
+        uint32_t row = order[i];
+        line.number(rows.pid[row], 10).text(names.display(rows.nameId[row]), width);
+        if (rows.accessible(row))
+            line.memory(rows.memory[row], 15).cpu(rows.cpu[row]);
+        else
+            line.text(L"Access Denied", 15);
+        line.print(std::wcout);
     }
+    return rows.size();
+}
 
-    // Copy to vector for sorting by total memory usage
-    std::vector<std::pair<std::wstring, ProcessGroup>> vecGrouped(grouped.begin(), grouped.end());
-
-    // Sort descending by total memory
-    std::sort(vecGrouped.begin(), vecGrouped.end(),
-        [](const auto& a, const auto& b)
-        {
-            return a.second.totalMemory > b.second.totalMemory;
-        });
+// Metrics every grouped view collects, in the column order printNameGroups expects
+static const std::vector<Metric>& nameGroupMetrics()
+{
+    static const std::vector<Metric> metrics = { Metric::Memory, Metric::Cpu, Metric::Proportional,
+        Metric::Unique, Metric::Swap, Metric::HasDetail };
+    return metrics;
+}
 
+// Prints name groups order[first..] (built with nameGroupMetrics); shared by the grouped views
+static void printNameGroups(const GroupingEngine& groups, const std::vector<uint32_t>& order, size_t first, const NamePool& names)
+{
     // Find max name length for formatting
     size_t maxNameLength = 0;
-    for (const auto& entry : vecGrouped)
+    for (size_t i = first; i < order.size(); ++i)
     {
-        maxNameLength = std::max(maxNameLength, entry.first.length());
+        maxNameLength = std::max(maxNameLength, names.display(static_cast<uint32_t>(groups.key(order[i]))).length());
     }
 
-    // Print header
-    std::wcout << std::left
-        << std::setw(static_cast<int>(maxNameLength) + 4) << L"Process Name"
-        << std::setw(12) << L"Instances"
-        << L"Total Memory\n";
-
-    std::wcout << std::wstring(maxNameLength + 32, L'-') << L"\n";
+    // Print header. Resident memory counts shared pages once per process; PSS splits them
+    // between their users and USS leaves them out, so those two add up across a group.
+    int nameWidth = static_cast<int>(maxNameLength) + 4;
+    TextRow line;
+    line.text(L"Process Name", nameWidth).text(L"Instances", 12).text(L"Total Memory", 16)
+        .text(L"PSS", 14).text(L"USS", 14).text(L"Swap", 14).text(L"CPU").print(std::wcout);
+    line.repeat(L'-', nameWidth + 78).print(std::wcout);
+
+    // Print each grouped entry; a '*' marks groups only partly covered by a memory breakdown
+    size_t partial = 0;
+    for (size_t i = first; i < order.size(); ++i)
+    {
+        uint32_t group = order[i];
+        long long detailed = groups.stats(group, 5).sum;
+        line.text(names.display(static_cast<uint32_t>(groups.key(group))), nameWidth)
+            .number(groups.count(group), 12)
+            .memory(static_cast<unsigned long long>(groups.stats(group, 0).sum), 16);
+        if (detailed == 0)
+        {
+            line.text(L"-", 14).text(L"-", 14).text(L"-", 14);
+        }
+        else
+        {
+            line.memory(static_cast<unsigned long long>(groups.stats(group, 2).sum), 14)
+                .memory(static_cast<unsigned long long>(groups.stats(group, 3).sum), 14)
+                .memory(static_cast<unsigned long long>(groups.stats(group, 4).sum), 14);
+        }
+        line.cpu(groups.stats(group, 1).sum);
+        if (detailed != 0 && detailed < static_cast<long long>(groups.count(group)))
+        {
+            line.text(L" *");
+            ++partial;
+        }
+        line.print(std::wcout);
+    }
 
-    // Print each grouped entry
-    for (const auto& entry : vecGrouped)
+    if (partial > 0)
     {
-        std::wcout << std::left
-            << std::setw(static_cast<int>(maxNameLength) + 4) << entry.first
-            << std::setw(12) << entry.second.count
-            << formatMemory(entry.second.totalMemory) << L"\n";
+        std::wcout << L"\n* PSS/USS/Swap cover only the processes whose memory breakdown has been read ("
+            << partial << L" groups).\n";
     }
 }
 
+// Group processes by name, sum memory, then print sorted by total memory descending
+size_t ProcessManager::printGroupedProcessesByMemory(size_t first, size_t count) const
+{
+    const NamePool& names = processNames();
+    std::vector<uint32_t> order;
+    grouper.group(getProcessTable(), names, GroupBy::Name, nameGroupMetrics());
+    grouper.orderBySum(0, order, limitFor(first, count));
+
+    printNameGroups(grouper, order, first, names);
+    return grouper.groupCount();
+}
+
+// Group processes by name, sum CPU usage, then print the busiest groups first
+size_t ProcessManager::printGroupedProcessesByCpu(size_t first, size_t count) const
+{
+    const NamePool& names = processNames();
+    std::vector<uint32_t> order;
+    grouper.group(getProcessTable(), names, GroupBy::Name, nameGroupMetrics());
+    grouper.orderBySum(1, order, limitFor(first, count));
+
+    printNameGroups(grouper, order, first, names);
+    return grouper.groupCount();
+}
+
 // Group processes by name (case-insensitive), sum memory, then print sorted alphabetically ignoring case
-void ProcessManager::printGroupedProcessesByName() const
+size_t ProcessManager::printGroupedProcessesByName(size_t first, size_t count) const
+{
+    const NamePool& names = processNames();
+    std::vector<uint32_t> order;
+    grouper.group(getProcessTable(), names, GroupBy::FoldedName, nameGroupMetrics());
+    grouper.orderByName(names, order, limitFor(first, count));
+
+    printNameGroups(grouper, order, first, names);
+    return grouper.groupCount();
+}
+
+// Header of the activity views; the name column comes first
+static void printActivityHeader(TextRow& line, const std::wstring& first, int firstWidth, int nameWidth)
 {
-    // Use case-insensitive comparator for keys
-    std::map<std::wstring, ProcessGroup, CaseInsensitiveCompare> grouped;
+    line.text(first, firstWidth).text(L"Name", nameWidth)
+        .text(L"Read/s", 12).text(L"Write/s", 12).text(L"I/O calls/s", 13).text(L"Threads", 9)
+        .text(L"Handles", 9).text(L"Switches/s").print(std::wcout);
+    line.repeat(L'-', firstWidth + nameWidth + 12 + 12 + 13 + 9 + 9 + 10).print(std::wcout);
+}
 
-    // Aggregate counts and memory per cleaned process name
-    for (const auto& p : processList)
+// Rows in the last sorted order; rates are shown with the memory units, per second
+void ProcessManager::printActivity(size_t limit) const
+{
+    const ProcessTable& rows = getProcessTable();
+    const NamePool& names = processNames();
+    bool sorted = displayOrder && displayOrder->size() == rows.size();
+    int nameWidth = static_cast<int>(getLongestNameLength()) + 4;
+
+    TextRow line;
+    printActivityHeader(line, L"PID", 10, nameWidth);
+    size_t count = std::min(limit, rows.size());
+    for (uint32_t i = 0; i < count; ++i)
     {
-        if (p.isAccessible)
+        uint32_t row = sorted ? (*displayOrder)[i] : i;
+        line.number(rows.pid[row], 10).text(names.display(rows.nameId[row]), nameWidth);
+        if (!rows.accessible(row))
         {
-            std::wstring name = cleanName(p.name);
-            grouped[name].count++;
-            grouped[name].totalMemory += p.memoryUsage;
+            line.text(L"Access Denied").print(std::wcout);
+            continue;
         }
+        line.memory(rows.readRate[row], 12).memory(rows.writeRate[row], 12).number(rows.ioOpsRate[row], 13)
+            .number(rows.threads[row], 9).number(rows.handles[row], 9).number(rows.switchRate[row])
+            .print(std::wcout);
     }
+}
 
-    // Find max name length for formatting
-    size_t maxNameLength = 0;
-    for (const auto& entry : grouped)
+// Group processes by name, sum the activity columns, then print the groups in key order
+void ProcessManager::printGroupedActivity(SortKey key, size_t limit) const
+{
+    const NamePool& names = processNames();
+    std::vector<uint32_t> order;
+    grouper.group(getProcessTable(), names, GroupBy::Name,
+        { Metric::ReadRate, Metric::WriteRate, Metric::IoOps, Metric::Threads, Metric::Handles, Metric::ContextSwitches });
+
+    switch (key)
     {
-        maxNameLength = std::max(maxNameLength, entry.first.length());
+    case SortKey::ReadRate:
+        grouper.orderBySum(0, order, limit);
+        break;
+    case SortKey::WriteRate:
+        grouper.orderBySum(1, order, limit);
+        break;
+    case SortKey::IoOps:
+        grouper.orderBySum(2, order, limit);
+        break;
+    case SortKey::Threads:
+        grouper.orderBySum(3, order, limit);
+        break;
+    case SortKey::Handles:
+        grouper.orderBySum(4, order, limit);
+        break;
+    case SortKey::ContextSwitches:
+        grouper.orderBySum(5, order, limit);
+        break;
+    default:
+        grouper.orderBySums(0, 1, order, limit);    // Read plus write
+        break;
     }
 
-    // Print header
-    std::wcout << std::left
-        << std::setw(static_cast<int>(maxNameLength) + 4) << L"Process Name"
-        << std::setw(12) << L"Instances"
-        << L"Total Memory\n";
-
-    std::wcout << std::wstring(maxNameLength + 32, L'-') << L"\n";
+    size_t nameLength = 0;
+    for (uint32_t group : order)
+        nameLength = std::max(nameLength, names.display(static_cast<uint32_t>(grouper.key(group))).length());
+    int nameWidth = static_cast<int>(nameLength) + 4;
 
-    // Print each grouped entry
-    for (const auto& entry : grouped)
+    TextRow line;
+    printActivityHeader(line, L"Instances", 11, nameWidth);
+    size_t count = std::min(limit, order.size());
+    for (size_t i = 0; i < count; ++i)
     {
-        std::wcout << std::left
-            << std::setw(static_cast<int>(maxNameLength) + 4) << entry.first
-            << std::setw(12) << entry.second.count
-            << formatMemory(entry.second.totalMemory) << L"\n";
+        uint32_t group = order[i];
+        line.number(grouper.count(group), 11).text(names.display(static_cast<uint32_t>(grouper.key(group))), nameWidth)
+            .memory(static_cast<unsigned long long>(grouper.stats(group, 0).sum), 12)
+            .memory(static_cast<unsigned long long>(grouper.stats(group, 1).sum), 12)
+            .number(static_cast<unsigned long long>(grouper.stats(group, 2).sum), 13)
+            .number(static_cast<unsigned long long>(grouper.stats(group, 3).sum), 9)
+            .number(static_cast<unsigned long long>(grouper.stats(group, 4).sum), 9)
+            .number(static_cast<unsigned long long>(grouper.stats(group, 5).sum))
+            .print(std::wcout);
     }
 }
 
 std::vector<ProcessInfo> ProcessManager::getProcessesByName(const std::wstring& name) const
 {
-    std::wstring lowerName = name;
-    std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), towlower);
+    std::vector<DWORD> pids;
+    std::string error;
+    getSearchIndex().find(SearchMode::Exact, cleanName(name), pids, error);
+    return getProcessesByPid(pids);
+}
 
-    std::vector<ProcessInfo> result;
-    for (const auto& proc : processList)
+// Bring the index up to date: from the last delta if it is one refresh behind, else from scratch
+const ProcessSearchIndex& ProcessManager::getSearchIndex() const
+{
+    if (searchIndexVersion != listVersion)
     {
-        std::wstring cleanProcName = cleanName(proc.name);
-        std::wstring lowerProcName = cleanProcName;
-        std::transform(lowerProcName.begin(), lowerProcName.end(), lowerProcName.begin(), towlower);
+        if (searchIndexVersion != 0 && searchIndexVersion == deltaBaseVersion)
+            searchIndex.apply(getProcessTable(), lastDelta, processNames());
+        else
+            searchIndex.rebuild(getProcessTable(), processNames());
+        searchIndexVersion = listVersion;
+    }
+    return searchIndex;
+}
 
-        if (lowerProcName == lowerName)
+std::vector<ProcessInfo> ProcessManager::getProcessesByPid(const std::vector<DWORD>& pids) const
+{
+    std::vector<ProcessInfo> result;
+    result.reserve(pids.size());
+    if (!pidIndexDirty)
+    {
+        for (DWORD pid : pids)
         {
-            result.push_back(proc);
+            const ProcessInfo* proc = findProcess(pid);
+            if (proc)
+                result.push_back(*proc);
         }
+        return result;
+    }
+
+    // No PID index after loadProcessList: one pass over the list instead of one per PID
+    for (const auto& proc : processList)
+    {
+        if (std::binary_search(pids.begin(), pids.end(), proc.pid))
+            result.push_back(proc);
     }
     return result;
 }
 
 bool ProcessManager::terminateProcessByPID(DWORD pid)
 {
+#ifdef _WIN32
     // Open process with terminate rights
     HANDLE hProcess = OpenProcess(PROCESS_TERMINATE, FALSE, pid);
     if (hProcess == NULL)
@@ -302,52 +803,122 @@ bool ProcessManager::terminateProcessByPID(DWORD pid)
 
     CloseHandle(hProcess);
     return success;
+#else
+    return kill(static_cast<pid_t>(pid), SIGKILL) == 0;
+#endif
+}
+
+bool ProcessManager::lowerPriority(DWORD pid, unsigned long& error)
+{
+#ifdef _WIN32
+    HANDLE hProcess = OpenProcess(PROCESS_SET_INFORMATION | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (hProcess == NULL)
+    {
+        error = GetLastError();
+        return false;
+    }
+
+    // Idle and below normal are already low enough
+    DWORD current = GetPriorityClass(hProcess);
+    bool success = current == IDLE_PRIORITY_CLASS || current == BELOW_NORMAL_PRIORITY_CLASS
+        || SetPriorityClass(hProcess, BELOW_NORMAL_PRIORITY_CLASS) != 0;
+    if (!success)
+        error = GetLastError();
+    CloseHandle(hProcess);
+    return success;
+#else
+    const int loweredNice = 10;
+
+    // Never raise a priority: only root may, and a process niced further has its reasons
+    errno = 0;
+    int current = getpriority(PRIO_PROCESS, static_cast<id_t>(pid));
+    if (current == -1 && errno != 0)
+    {
+        error = static_cast<unsigned long>(errno);
+        return false;
+    }
+    if (current >= loweredNice)
+        return true;
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(pid), loweredNice) != 0)
+    {
+        error = static_cast<unsigned long>(errno);
+        return false;
+    }
+    return true;
+#endif
 }
 
-bool ProcessManager::terminateProcessesByName(const std::wstring& targetName)
+std::vector<TerminationResult> ProcessManager::endProcesses(const std::vector<DWORD>& pids, const TerminationOptions& options)
 {
-    bool allTerminated = true;
+    ProcessTerminator terminator(options);
+    return terminator.terminate(pids);
+}
 
-    // Normalize the target name: lowercase and strip .exe
-    std::wstring normalizedTarget = targetName;
-    std::transform(normalizedTarget.begin(), normalizedTarget.end(), normalizedTarget.begin(), ::towlower);
+std::vector<TerminationResult> ProcessManager::endProcesses(const std::vector<DWORD>& pids, const std::vector<unsigned long long>& startTimes,
+    const TerminationOptions& options)
+{
+    ProcessTerminator terminator(options);
+    return terminator.terminate(pids, startTimes);
+}
 
+bool ProcessManager::terminateProcesses(const std::vector<DWORD>& pids, const TerminationOptions& options)
+{
+    std::vector<TerminationResult> results = endProcesses(pids, options);
+    ProcessTerminator::printSummary(results, std::wcout);
+
+    return std::all_of(results.begin(), results.end(), [](const TerminationResult& result)
+        {
+            return result.outcome == TerminationOutcome::Exited || result.outcome == TerminationOutcome::Killed
+                || result.outcome == TerminationOutcome::AlreadyGone;
+        });
+}
+
+bool ProcessManager::terminateProcessesByName(const std::wstring& targetName, const TerminationOptions& options)
+{
     // Refresh process list before attempting termination
     refreshProcessList();
 
-    for (const auto& proc : processList)
+    // Matched case-insensitively without .exe, through the search index
+    std::vector<DWORD> pids;
+    for (const auto& proc : getProcessesByName(targetName))
     {
-        if (!proc.isAccessible)
-            continue;
+        if (proc.isAccessible)
+            pids.push_back(proc.pid);
+    }
+    if (pids.empty())
+    {
+        std::wcout << L"No accessible process named \"" << targetName << L"\".\n";
+        return true;
+    }
 
-        std::wstring procName = cleanName(proc.name);  // Remove .exe and lowercase
-        std::transform(procName.begin(), procName.end(), procName.begin(), ::towlower);
+    return terminateProcesses(pids, options);
+}
 
-        if (procName == normalizedTarget)
-        {
-            HANDLE hProcess = OpenProcess(PROCESS_TERMINATE, FALSE, proc.pid);
-            if (hProcess)
-            {
-                if (!TerminateProcess(hProcess, 0))
-                {
-                    std::wcout << L"Failed to terminate process PID: " << proc.pid
-                        << L" (Error code: " << GetLastError() << L")\n";
-                    allTerminated = false;
-                }
-                else
-                {
-                    std::wcout << L"Terminated process PID: " << proc.pid << L"\n";
-                }
-                CloseHandle(hProcess);
-            }
-            else
-            {
-                std::wcout << L"Cannot open process PID: " << proc.pid
-                    << L" (Error code: " << GetLastError() << L")\n";
-                allTerminated = false;
-            }
-        }
+bool ProcessManager::terminateProcessTree(DWORD pid, const TerminationOptions& options)
+{
+    // Refresh process list so the tree has the children started since the last look
+    refreshProcessList();
+
+    const ProcessTree& processTree = getProcessTree();
+    uint32_t root = processTree.findRow(pid);
+    if (root == ProcessTree::NoRow)
+    {
+        std::wcout << L"No process with PID " << pid << L".\n";
+        return false;
     }
 
-    return allTerminated;
+    // Parents before children, so nothing is left to restart what was just killed; the
+    // whole subtree is frozen first so no member can fork a replacement or notice its
+    // siblings dying before the signals land
+    std::vector<uint32_t> rows;
+    processTree.subtree(root, rows);
+    const ProcessTable& rowsTable = getProcessTable();
+    std::vector<DWORD> pids;
+    pids.reserve(rows.size());
+    for (uint32_t row : rows)
+        pids.push_back(rowsTable.pid[row]);
+
+    TerminationOptions treeOptions = options;
+    treeOptions.freezeFirst = true;
+    return terminateProcesses(pids, treeOptions);
 }
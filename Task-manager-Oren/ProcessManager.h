@@ -1,90 +1,156 @@
 #pragma once
 
-// Prevents Windows headers from defining conflicting macros like min/max
-#define NOMINMAX
-
-// Windows-specific headers for working with processes
-#include <windows.h>
-#include <tlhelp32.h>
-#include <psapi.h>
-
 // Standard C++ headers
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <iomanip>
 #include <cwctype>
 #include <vector>
 #include <map>
+#include <memory>
 #include <sstream>
-
+#include <unordered_map>
+
+#include "ProcessInfo.h"
+#include "ProcessSnapshotSource.h"
+#include "ProcessTable.h"
+#include "ProcessSearchIndex.h"
+#include "ProcessSorter.h"
+#include "ProcessTerminator.h"
+#include "ProcessTree.h"
+#include "GroupingEngine.h"
+#include "NamePool.h"
+#include "WorkerPool.h"
 #include "Utils.h"
 
-// Link against the Psapi library (used for memory info)
-#pragma comment(lib, "psapi.lib")
-
-// Holds information about a single process
-struct ProcessInfo
+// When the memory breakdown of ProcessInfo::memoryDetail is read. Resident memory, faults
+// and peak come with every refresh; the breakdown means reading a file per process
+// (smaps_rollup) or walking its working set, so it is kept to the processes that matter.
+struct MemoryDetailPolicy
 {
-    DWORD pid;                        // Process ID
-    std::wstring name;               // Name of the process
-    unsigned long long memoryUsage;  // Memory used by the process (in bytes)
-    bool isAccessible;               // Can we read its memory info?
-};
-
-// Used to sort process names in a case-insensitive way
-struct CaseInsensitiveCompare
-{
-    bool operator()(const std::wstring& a, const std::wstring& b) const
-    {
-        std::wstring lowerA = a;
-        std::wstring lowerB = b;
-        // Convert both strings to lowercase for fair comparison
-        std::transform(lowerA.begin(), lowerA.end(), lowerA.begin(), towlower);
-        std::transform(lowerB.begin(), lowerB.end(), lowerB.begin(), towlower);
-        return lowerA < lowerB;
-    }
-};
-
-// Used for grouping processes by name
-struct ProcessGroup 
-{
-    int count = 0;              // How many instances of the process
-    size_t totalMemory = 0;     // Combined memory usage of all instances
+    size_t topCount = 0;    // The largest processes by resident memory, read after every refresh
+    unsigned every = 0;     // Every process, read after one refresh in this many (0 = never)
 };
 
 // Manages the list of processes and handles sorting/printing
 class ProcessManager
 {
 public:
-    // Fills the internal process list with current system processes
+    // Uses the native snapshot source for this platform
+    ProcessManager();
+
+    // Uses the given snapshot source instead (e.g. a synthetic /proc tree)
+    explicit ProcessManager(std::unique_ptr<ProcessSnapshotSource> source);
+
+    // Brings the internal process list up to date with the system.
+    // Entries are kept across refreshes: only new PIDs get their name copied, exited
+    // ones are dropped, and the rest just have their counters updated.
     bool refreshProcessList();
 
+    // Spreads per-process collection over this many threads (1 = the calling thread only)
+    void setCollectionThreads(unsigned threads);
+
+    // Which processes get their memory breakdown read after each refresh
+    void setMemoryDetailPolicy(const MemoryDetailPolicy& policy);
+
+    // Reads the memory breakdown now, for the topCount largest processes by resident
+    // memory (0 = every process). Returns how many could be read.
+    size_t refreshMemoryDetail(size_t topCount);
+
+    // What the most recent refresh added, removed and changed
+    const ProcessDelta& getLastDelta() const;
+
+    // Replaces the list with one collected elsewhere (e.g. a ProcessSampler snapshot)
+    void loadProcessList(const std::vector<ProcessInfo>& processes, const ProcessDelta& delta);
+
     // Gives read-only access to the process list
     const std::vector<ProcessInfo>& getProcessList() const;
 
+    // The process with this PID, or null (valid until the next refresh)
+    const ProcessInfo* findProcess(DWORD pid) const;
+
+    // Gives the same processes as columns (built lazily after each change)
+    const ProcessTable& getProcessTable() const;
+
+    // Parent/child structure of the same rows as getProcessTable (built lazily after each change)
+    const ProcessTree& getProcessTree() const;
+
     // Prints all processes individually
     void printProcessList() const;
 
-    // Sorts the list alphabetically by name (case-insensitive)
+    // Orders printProcessList alphabetically by name (case-insensitive)
     void sortByName();
 
-    // Sorts the list by memory usage, largest first
+    // Orders printProcessList by memory usage, largest first
     void sortByMemory();
 
+    // Orders printProcessList by CPU usage, busiest first
+    void sortByCpu();
+
+    // Orders printProcessList by several keys, most significant first (stable)
+    void sortBy(const SortOrder& fields);
+
+    // The first count rows in the given order, without sorting the rest (see ProcessSorter::top)
+    const std::vector<uint32_t>& topProcesses(const SortOrder& fields, size_t count);
+
+    // Prints rows [first, first + count) of the given order with their memory and CPU.
+    // Only rows up to the end of the page are selected and sorted. Returns the row count.
+    size_t printProcessPage(const SortOrder& fields, size_t first, size_t count);
+
+    // The grouped views below print the groups [first, first + count) of their order, sorting
+    // only up to the end of that page, and return the number of groups
+
     // Groups by process name and prints total memory for each group (sorted by memory)
-    void printGroupedProcessesByMemory() const;
+    size_t printGroupedProcessesByMemory(size_t first = 0, size_t count = GroupingEngine::NoLimit) const;
 
     // Groups by process name and prints total memory for each group (sorted by name)
-    void printGroupedProcessesByName() const;
+    size_t printGroupedProcessesByName(size_t first = 0, size_t count = GroupingEngine::NoLimit) const;
+
+    // Groups by process name and prints total CPU usage for each group (busiest first)
+    size_t printGroupedProcessesByCpu(size_t first = 0, size_t count = GroupingEngine::NoLimit) const;
+
+    // Prints the first limit processes of the last sorted order with their I/O rates,
+    // threads, handles and context switches
+    void printActivity(size_t limit) const;
+
+    // Groups by process name and prints the same columns summed per group, ordered by key
+    // (one of the activity keys of SortKey; anything else orders by I/O)
+    void printGroupedActivity(SortKey key, size_t limit) const;
 
     // Return all processes matching name (case-insensitive, cleaned)
     std::vector<ProcessInfo> getProcessesByName(const std::wstring& name) const;
 
+    // Name search index over the current list (brought up to date lazily)
+    const ProcessSearchIndex& getSearchIndex() const;
+
+    // The processes with these PIDs (ascending, as ProcessSearchIndex::find returns them)
+    std::vector<ProcessInfo> getProcessesByPid(const std::vector<DWORD>& pids) const;
+
     //Terminates a procsses by id
     bool terminateProcessByPID(DWORD pid);
 
+    //Lowers a procsses priority (nice 10 on Linux, below normal on Windows) unless it is already that low.
+    //False with errno / GetLastError in error if it could not be changed.
+    static bool lowerPriority(DWORD pid, unsigned long& error);
+
+    //Terminates a set of procsses (polite request, grace period, then forced), printing the outcome per PID.
+    //Returns true when every one of them is gone.
+    bool terminateProcesses(const std::vector<DWORD>& pids, const TerminationOptions& options = TerminationOptions());
+
+    //Terminates a set of procsses like terminateProcesses without printing anything; one result per PID
+    static std::vector<TerminationResult> endProcesses(const std::vector<DWORD>& pids, const TerminationOptions& options = TerminationOptions());
+
+    //Same for PIDs remembered earlier, each with the start time it had then; a PID that now belongs to another
+    //procsses is left alone (see ProcessTerminator::terminate)
+    static std::vector<TerminationResult> endProcesses(const std::vector<DWORD>& pids, const std::vector<unsigned long long>& startTimes,
+        const TerminationOptions& options);
+
     //Terminates all procsses by name
-    bool terminateProcessesByName(const std::wstring& targetName);
+    bool terminateProcessesByName(const std::wstring& targetName, const TerminationOptions& options = TerminationOptions());
+
+    //Terminates a process and everything below it in the process tree
+    bool terminateProcessTree(DWORD pid, const TerminationOptions& options = TerminationOptions());
 
     // Removes the ".exe" extension from process names
     std::wstring cleanName(const std::wstring& name) const;
@@ -92,9 +158,89 @@ public:
     //Function to print the procsses list, overload
     void printProcessList(const std::vector<ProcessInfo>& list) const;
 private:
+    // Samples gathered by one worker during a parallel refresh
+    struct SampleChunk
+    {
+        std::vector<ProcessSample> samples;
+        std::vector<size_t> nameOffsets;    // Where each sample's name starts in its arena
+        std::string utf8Names;
+        std::wstring wideNames;
+        SampleScratch scratch;
+    };
+
     // Stores all the processes currently retrieved from the system
     std::vector<ProcessInfo> processList;
 
+    // Where refreshProcessList gets its data from
+    std::unique_ptr<ProcessSnapshotSource> snapshotSource;
+
+    // PID -> position in processList, kept in sync by refreshProcessList
+    std::unordered_map<DWORD, size_t> pidIndex;
+
+    // Set when processList is replaced wholesale so the index is rebuilt before the next refresh
+    bool pidIndexDirty = false;
+
+    // Column copy of processList and whether it is out of date
+    mutable ProcessTable table;
+    mutable bool tableDirty = true;
+
+    // Process tree over table and whether it is out of date
+    mutable ProcessTree tree;
+    mutable bool treeDirty = true;
+
+    // Sorted views of table, cached until the next change
+    ProcessSorter sorter;
+
+    // Reused by the grouped views
+    mutable GroupingEngine grouper;
+
+    // Name search index and the list version it reflects (0 = never built). lastDelta
+    // leads from deltaBaseVersion to listVersion, so an index one refresh behind is
+    // updated from it; otherwise (e.g. after loadProcessList) it is rebuilt.
+    mutable ProcessSearchIndex searchIndex;
+    mutable unsigned long long searchIndexVersion = 0;
+    unsigned long long listVersion = 1;
+    unsigned long long deltaBaseVersion = 0;
+
+    // Row order chosen by the last sort (null = list order); points into sorter's cache
+    const std::vector<uint32_t>* displayOrder = nullptr;
+
+    // Marks the table, sorted views and display order as stale
+    void invalidateViews();
+
+    // Per-slot "seen in this refresh" marks, reused between refreshes
+    std::vector<unsigned char> seenThisRefresh;
+
+    // Added/removed/changed sets from the most recent refresh
+    ProcessDelta lastDelta;
+
+    // When the last refresh ran and the wall time since the one before (ns, 0 = first refresh)
+    std::chrono::steady_clock::time_point lastRefreshTime;
+    long long refreshInterval = 0;
+
+    // Workers for parallel collection (null when collecting serially) and their chunks
+    std::unique_ptr<WorkerPool> collectionPool;
+    std::vector<SampleChunk> chunks;
+
+    // Memory breakdown cadence, successful refreshes so far (stamped into memoryDetailRefresh),
+    // and the slots picked for the next read
+    MemoryDetailPolicy detailPolicy;
+    unsigned long long refreshCount = 0;
+    std::vector<size_t> detailSlots;
+    SampleScratch detailScratch;
+
+    // Recomputes pidIndex from the current order of processList
+    void rebuildPidIndex();
+
+    // Folds one sample into processList, pidIndex and lastDelta
+    void mergeSample(const ProcessSample& sample);
+
+    // Reads every process through collectionPool and merges the per-worker chunks
+    bool collectInParallel();
+
+    // Reads the memory breakdown of the processes in detailSlots
+    size_t readMemoryDetails();
+
     // Finds the longest process name (used for formatting)
     size_t getLongestNameLength() const;
 
@@ -0,0 +1,239 @@
+#include "ProcessSampler.h"
+
+SnapshotHandle& SnapshotHandle::operator=(SnapshotHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        snapshot = other.snapshot;
+        other.snapshot = nullptr;
+    }
+    return *this;
+}
+
+void SnapshotHandle::release()
+{
+    if (snapshot)
+    {
+        snapshot->readers.fetch_sub(1);
+        snapshot = nullptr;
+    }
+}
+
+ProcessSampler::ProcessSampler(std::chrono::milliseconds interval)
+    : intervalMs(interval.count())
+{
+}
+
+ProcessSampler::ProcessSampler(std::unique_ptr<ProcessSnapshotSource> source, std::chrono::milliseconds interval)
+    : collector(std::move(source)), intervalMs(interval.count())
+{
+}
+
+ProcessSampler::~ProcessSampler()
+{
+    stop();
+}
+
+void ProcessSampler::start()
+{
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    if (running)
+        return;
+
+    running = true;
+    worker = std::thread(&ProcessSampler::run, this);
+}
+
+void ProcessSampler::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        if (!running)
+            return;
+        running = false;
+    }
+    wakeSampler.notify_all();
+    worker.join();
+}
+
+void ProcessSampler::setCollectionThreads(unsigned threads)
+{
+    collector.setCollectionThreads(threads);
+}
+
+void ProcessSampler::setMemoryDetailPolicy(const MemoryDetailPolicy& policy)
+{
+    collector.setMemoryDetailPolicy(policy);
+}
+
+void ProcessSampler::setInterval(std::chrono::milliseconds interval)
+{
+    intervalMs.store(interval.count());
+    wakeSampler.notify_all();
+}
+
+// Pin the current snapshot. If the sampler swapped it out between the load and the pin,
+// drop the pin and try again: a buffer is only rewritten while it is unpinned and not current.
+SnapshotHandle ProcessSampler::acquire() const
+{
+    while (true)
+    {
+        ProcessSnapshot* snapshot = current.load();
+        if (!snapshot)
+            return SnapshotHandle();
+
+        snapshot->readers.fetch_add(1);
+        if (current.load() == snapshot)
+            return SnapshotHandle(snapshot);
+
+        snapshot->readers.fetch_sub(1);
+    }
+}
+
+SnapshotHandle ProcessSampler::waitForNewer(unsigned long long sequence, std::chrono::milliseconds timeout) const
+{
+    SnapshotHandle handle = acquire();
+    if (handle && handle->sequence > sequence)
+        return handle;
+    handle.release();
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    snapshotPublished.wait_for(lock, timeout, [this, sequence]()
+        {
+            ProcessSnapshot* snapshot = current.load();
+            return snapshot && snapshot->sequence > sequence;
+        });
+    lock.unlock();
+
+    return acquire();
+}
+
+const MetricsHistory& ProcessSampler::history() const
+{
+    return metricsHistory;
+}
+
+LeakDetector& ProcessSampler::leaks()
+{
+    return leakDetector;
+}
+
+AlertEngine& ProcessSampler::alerts()
+{
+    return alertEngine;
+}
+
+ResourceGuard& ProcessSampler::guard()
+{
+    return resourceGuard;
+}
+
+bool ProcessSampler::startRecording(const std::string& path)
+{
+    std::unique_ptr<SnapshotRecorder> file = std::make_unique<SnapshotRecorder>();
+    if (!file->open(path))
+        return false;
+
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    recorder = std::move(file);
+    return true;
+}
+
+unsigned long long ProcessSampler::stopRecording()
+{
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    if (!recorder)
+        return 0;
+
+    unsigned long long frames = recorder->frameCount();
+    recorder->close();
+    recorder.reset();
+    return frames;
+}
+
+bool ProcessSampler::isRecording() const
+{
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    return recorder != nullptr;
+}
+
+unsigned long long ProcessSampler::recordedFrames() const
+{
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    return recorder ? recorder->frameCount() : 0;
+}
+
+void ProcessSampler::run()
+{
+    while (true)
+    {
+        auto tickStart = std::chrono::steady_clock::now();
+        sampleOnce();
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        auto deadline = tickStart + std::chrono::milliseconds(intervalMs.load());
+        long long interval = intervalMs.load();
+        wakeSampler.wait_until(lock, deadline, [this, interval]()
+            {
+                return !running || intervalMs.load() != interval;
+            });
+        if (!running)
+            return;
+    }
+}
+
+void ProcessSampler::sampleOnce()
+{
+    if (!collector.refreshProcessList())
+        return;
+
+    ProcessSnapshot* snapshot = freeBuffer();
+
+    // Copy-assignment reuses the buffer's strings and vectors, so a warmed-up buffer
+    // does not allocate unless the process count or a name got bigger
+    snapshot->processes = collector.getProcessList();
+    snapshot->table = collector.getProcessTable();
+    snapshot->delta = collector.getLastDelta();
+    snapshot->sequence = nextSequence++;
+    snapshot->takenAt = std::chrono::steady_clock::now();
+
+    current.store(snapshot);
+
+    // Take the lock so a reader between its check and its wait cannot miss the wake-up
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    snapshotPublished.notify_all();
+
+    // The guard goes first: it is the one with a reaction time to keep
+    resourceGuard.update(collector, snapshot->takenAt);
+
+    // Readers already have the snapshot; the history catches up behind them
+    metricsHistory.record(collector.getProcessTable(), collector.getLastDelta(), snapshot->takenAt);
+    leakDetector.update(collector, snapshot->takenAt);
+    alertEngine.update(collector, snapshot->takenAt);
+
+    std::lock_guard<std::mutex> lock(recorderMutex);
+    if (recorder)
+    {
+        long long unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!recorder->append(collector.getProcessList(), unixMs))
+            recorder.reset();    // Disk full or similar: stop rather than fail every tick
+    }
+}
+
+ProcessSnapshot* ProcessSampler::freeBuffer()
+{
+    ProcessSnapshot* published = current.load();
+    for (auto& buffer : buffers)
+    {
+        if (buffer.get() != published && buffer->readers.load() == 0)
+            return buffer.get();
+    }
+
+    // Every buffer is current or pinned by a slow reader: grow the pool instead of waiting
+    buffers.push_back(std::make_unique<ProcessSnapshot>());
+    return buffers.back().get();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AlertEngine.h"
+#include "LeakDetector.h"
+#include "MetricsHistory.h"
+#include "ProcessManager.h"
+#include "ResourceGuard.h"
+#include "SnapshotRecorder.h"
+
+// An immutable picture of the system published by ProcessSampler
+struct ProcessSnapshot
+{
+    std::vector<ProcessInfo> processes;                // Every process at the time of the tick
+    ProcessTable table;                                // The same processes as columns
+    ProcessDelta delta;                                // Changes since the previous tick
+    unsigned long long sequence = 0;                   // 1 for the first tick, then increasing
+    std::chrono::steady_clock::time_point takenAt;     // When the refresh finished
+
+    // Readers currently holding this buffer; the sampler only reuses it at zero
+    mutable std::atomic<int> readers{ 0 };
+};
+
+// Keeps a snapshot pinned while it is being read
+class SnapshotHandle
+{
+public:
+    SnapshotHandle() = default;
+    explicit SnapshotHandle(const ProcessSnapshot* snapshot) : snapshot(snapshot) {}
+    SnapshotHandle(SnapshotHandle&& other) noexcept : snapshot(other.snapshot) { other.snapshot = nullptr; }
+    SnapshotHandle& operator=(SnapshotHandle&& other) noexcept;
+    SnapshotHandle(const SnapshotHandle&) = delete;
+    SnapshotHandle& operator=(const SnapshotHandle&) = delete;
+    ~SnapshotHandle() { release(); }
+
+    const ProcessSnapshot* get() const { return snapshot; }
+    const ProcessSnapshot* operator->() const { return snapshot; }
+    const ProcessSnapshot& operator*() const { return *snapshot; }
+    explicit operator bool() const { return snapshot != nullptr; }
+
+    // Unpins the snapshot early
+    void release();
+
+private:
+    const ProcessSnapshot* snapshot = nullptr;
+};
+
+// Runs refreshProcessList on its own thread and publishes each result as a snapshot.
+// Readers grab the latest snapshot with an atomic load and a pin count, so they
+// never wait for a collection in progress and never see a half-written list.
+class ProcessSampler
+{
+public:
+    // Samples the native snapshot source every interval
+    explicit ProcessSampler(std::chrono::milliseconds interval);
+
+    // Samples the given source instead
+    ProcessSampler(std::unique_ptr<ProcessSnapshotSource> source, std::chrono::milliseconds interval);
+
+    ~ProcessSampler();
+
+    // Starts the background thread (the first snapshot follows right away)
+    void start();
+
+    // Stops the background thread and waits for it to finish
+    void stop();
+
+    // Spreads each refresh over this many threads; call before start()
+    void setCollectionThreads(unsigned threads);
+
+    // Which processes get their memory breakdown read on each tick; call before start()
+    void setMemoryDetailPolicy(const MemoryDetailPolicy& policy);
+
+    // Changes the sampling interval, effective from the next tick
+    void setInterval(std::chrono::milliseconds interval);
+
+    // Returns the latest snapshot (empty handle before the first tick). Never blocks.
+    SnapshotHandle acquire() const;
+
+    // Waits until a snapshot newer than sequence is published or the timeout expires
+    SnapshotHandle waitForNewer(unsigned long long sequence, std::chrono::milliseconds timeout) const;
+
+    // Memory history of every tick so far (safe to query from any thread)
+    const MetricsHistory& history() const;
+
+    // Leak suspects, updated from each tick's delta (safe to use from any thread)
+    LeakDetector& leaks();
+
+    // Alert rules, evaluated against each tick's delta (safe to use from any thread)
+    AlertEngine& alerts();
+
+    // Group caps, enforced right after each tick is published (safe to use from any thread)
+    ResourceGuard& guard();
+
+    // Appends every following tick to a recording file (replacing any recording in progress)
+    bool startRecording(const std::string& path);
+
+    // Closes the recording; returns the number of frames it got
+    unsigned long long stopRecording();
+
+    // Whether a recording is in progress and its frames so far (0 when not recording)
+    bool isRecording() const;
+    unsigned long long recordedFrames() const;
+
+private:
+    // Body of the background thread
+    void run();
+
+    // Refreshes once and publishes the result
+    void sampleOnce();
+
+    // Finds a buffer that is neither current nor pinned, adding one if all are busy
+    ProcessSnapshot* freeBuffer();
+
+    ProcessManager collector;                                  // Only touched by the sampler thread
+    std::vector<std::unique_ptr<ProcessSnapshot>> buffers;     // Only grown by the sampler thread
+    std::atomic<ProcessSnapshot*> current{ nullptr };          // Latest published snapshot
+    MetricsHistory metricsHistory;                             // Fed by the sampler thread after each publish
+    LeakDetector leakDetector;                                 // Same
+    AlertEngine alertEngine;                                   // Same
+    ResourceGuard resourceGuard;                               // Same
+    std::unique_ptr<SnapshotRecorder> recorder;                // Null when not recording
+    mutable std::mutex recorderMutex;                          // Guards recorder
+    std::atomic<long long> intervalMs;
+    unsigned long long nextSequence = 1;
+
+    std::thread worker;
+    bool running = false;                                      // Guarded by wakeMutex
+    mutable std::mutex wakeMutex;                              // Only for sleeping/waking, never held while reading
+    mutable std::condition_variable wakeSampler;
+    mutable std::condition_variable snapshotPublished;
+};
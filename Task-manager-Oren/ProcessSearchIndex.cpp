@@ -0,0 +1,270 @@
+#include "ProcessSearchIndex.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <regex>
+
+// Three characters packed into one key (code points fit in 21 bits)
+static uint64_t trigramKey(const wchar_t* text)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(text[0]) & 0x1FFFFF) << 42)
+        | (static_cast<uint64_t>(static_cast<uint32_t>(text[1]) & 0x1FFFFF) << 21)
+        | (static_cast<uint64_t>(static_cast<uint32_t>(text[2]) & 0x1FFFFF));
+}
+
+void ProcessSearchIndex::indexNewNames()
+{
+    uint32_t total = pool->size();
+    if (total == indexedNames)
+        return;
+
+    size_t firstNew = sortedNames.size();
+    std::vector<uint64_t> keys;
+    for (uint32_t id = indexedNames; id < total; ++id)
+    {
+        if (pool->foldedId(id) != id)
+            continue;    // Same name in another case; its PIDs go to the folded ID
+
+        sortedNames.push_back(id);
+
+        // Each trigram once per name, so postings stay duplicate-free and ascending
+        const std::wstring& lower = pool->lower(id);
+        keys.clear();
+        for (size_t i = 0; i + 3 <= lower.size(); ++i)
+            keys.push_back(trigramKey(lower.data() + i));
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (uint64_t key : keys)
+            trigrams[key].push_back(id);
+    }
+    indexedNames = total;
+    pidsByName.resize(total);
+
+    // Only the new names need sorting; they are merged into the list that is already sorted
+    auto byName = [this](uint32_t a, uint32_t b) { return pool->lower(a) < pool->lower(b); };
+    std::sort(sortedNames.begin() + firstNew, sortedNames.end(), byName);
+    std::inplace_merge(sortedNames.begin(), sortedNames.begin() + firstNew, sortedNames.end(), byName);
+}
+
+void ProcessSearchIndex::addPid(uint32_t nameId, DWORD pid)
+{
+    std::vector<DWORD>& pids = pidsByName[pool->foldedId(nameId)];
+    pids.insert(std::upper_bound(pids.begin(), pids.end(), pid), pid);
+    ++processes;
+}
+
+bool ProcessSearchIndex::removePid(uint32_t nameId, DWORD pid)
+{
+    if (nameId >= pidsByName.size())
+        return false;
+    std::vector<DWORD>& pids = pidsByName[pool->foldedId(nameId)];
+    auto it = std::lower_bound(pids.begin(), pids.end(), pid);
+    if (it == pids.end() || *it != pid)
+        return false;
+    pids.erase(it);
+    --processes;
+    return true;
+}
+
+void ProcessSearchIndex::rebuild(const ProcessTable& table, const NamePool& names)
+{
+    pool = &names;
+    indexNewNames();
+
+    for (std::vector<DWORD>& pids : pidsByName)
+        pids.clear();
+    for (uint32_t row = 0; row < table.size(); ++row)
+        pidsByName[names.foldedId(table.nameId[row])].push_back(table.pid[row]);
+    for (std::vector<DWORD>& pids : pidsByName)
+        std::sort(pids.begin(), pids.end());
+    processes = table.size();
+}
+
+void ProcessSearchIndex::apply(const ProcessTable& table, const ProcessDelta& delta, const NamePool& names)
+{
+    if (pool != &names)
+    {
+        rebuild(table, names);
+        return;
+    }
+    indexNewNames();
+
+    // Removals first: a recycled PID is both removed (old name) and added (new name)
+    bool consistent = true;
+    for (const ProcessInfo& proc : delta.removed)
+        consistent = removePid(proc.nameId, proc.pid) && consistent;
+    for (uint32_t row = 0; row < table.size(); ++row)
+    {
+        if (table.flags[row] & ProcessTable::IsNew)
+            addPid(table.nameId[row], table.pid[row]);
+    }
+
+    if (!consistent || processes != table.size())
+        rebuild(table, names);
+}
+
+size_t ProcessSearchIndex::processCount() const
+{
+    return processes;
+}
+
+std::pair<size_t, size_t> ProcessSearchIndex::prefixRange(const std::wstring& prefix) const
+{
+    auto first = std::lower_bound(sortedNames.begin(), sortedNames.end(), prefix,
+        [this](uint32_t id, const std::wstring& value) { return pool->lower(id) < value; });
+    auto last = first;
+    while (last != sortedNames.end() && pool->lower(*last).compare(0, prefix.size(), prefix) == 0)
+        ++last;
+    return { static_cast<size_t>(first - sortedNames.begin()), static_cast<size_t>(last - sortedNames.begin()) };
+}
+
+bool ProcessSearchIndex::trigramCandidates(const std::wstring& text, std::vector<uint32_t>& candidates) const
+{
+    if (text.size() < 3)
+        return false;
+
+    // Intersect the postings, shortest first so the working set only shrinks
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (size_t i = 0; i + 3 <= text.size(); ++i)
+    {
+        auto it = trigrams.find(trigramKey(text.data() + i));
+        if (it == trigrams.end())
+        {
+            candidates.clear();
+            return true;
+        }
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(),
+        [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) { return a->size() < b->size(); });
+
+    candidates = *lists[0];
+    std::vector<uint32_t> kept;
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+    {
+        kept.clear();
+        std::set_intersection(candidates.begin(), candidates.end(), lists[i]->begin(), lists[i]->end(),
+            std::back_inserter(kept));
+        candidates.swap(kept);
+    }
+    return true;
+}
+
+void ProcessSearchIndex::matchNames(SearchMode mode, const std::wstring& lowerPattern, std::vector<uint32_t>& matched) const
+{
+    auto live = [this](uint32_t id) { return !pidsByName[id].empty(); };
+
+    if (mode == SearchMode::Exact || mode == SearchMode::Prefix)
+    {
+        std::pair<size_t, size_t> range = prefixRange(lowerPattern);
+        for (size_t i = range.first; i < range.second; ++i)
+        {
+            uint32_t id = sortedNames[i];
+            if (live(id) && (mode == SearchMode::Prefix || pool->lower(id).size() == lowerPattern.size()))
+                matched.push_back(id);
+        }
+        return;
+    }
+
+    if (mode == SearchMode::Substring)
+    {
+        std::vector<uint32_t> candidates;
+        if (trigramCandidates(lowerPattern, candidates))
+        {
+            for (uint32_t id : candidates)
+            {
+                if (live(id) && pool->lower(id).find(lowerPattern) != std::wstring::npos)
+                    matched.push_back(id);
+            }
+        }
+        else
+        {
+            // One or two characters: too short for trigrams, but still one check per name
+            for (uint32_t id : sortedNames)
+            {
+                if (live(id) && pool->lower(id).find(lowerPattern) != std::wstring::npos)
+                    matched.push_back(id);
+            }
+        }
+        return;
+    }
+
+    // Glob: narrow by the literal text before the first wildcard, or else by the
+    // longest literal run, then check the whole pattern on what is left
+    size_t wildcard = lowerPattern.find_first_of(L"*?");
+    if (wildcard == std::wstring::npos)
+    {
+        matchNames(SearchMode::Exact, lowerPattern, matched);
+        return;
+    }
+    if (wildcard > 0)
+    {
+        std::pair<size_t, size_t> range = prefixRange(lowerPattern.substr(0, wildcard));
+        for (size_t i = range.first; i < range.second; ++i)
+        {
+            uint32_t id = sortedNames[i];
+            if (live(id) && globMatch(lowerPattern, pool->lower(id)))
+                matched.push_back(id);
+        }
+        return;
+    }
+
+    std::wstring longestRun;
+    for (size_t start = 0; start < lowerPattern.size();)
+    {
+        size_t end = lowerPattern.find_first_of(L"*?", start);
+        if (end == std::wstring::npos)
+            end = lowerPattern.size();
+        if (end - start > longestRun.size())
+            longestRun = lowerPattern.substr(start, end - start);
+        start = end + 1;
+    }
+    std::vector<uint32_t> candidates;
+    const std::vector<uint32_t>& checked = trigramCandidates(longestRun, candidates) ? candidates : sortedNames;
+    for (uint32_t id : checked)
+    {
+        if (live(id) && globMatch(lowerPattern, pool->lower(id)))
+            matched.push_back(id);
+    }
+}
+
+bool ProcessSearchIndex::find(SearchMode mode, const std::wstring& pattern, std::vector<DWORD>& pids, std::string& error) const
+{
+    pids.clear();
+    if (!pool)
+        return true;
+
+    std::vector<uint32_t> matched;
+    if (mode == SearchMode::Regex)
+    {
+        // Regexes cannot use the name index, but still only run once per distinct name
+        std::wregex expression;
+        try
+        {
+            expression.assign(pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        }
+        catch (const std::regex_error& e)
+        {
+            error = e.what();
+            return false;
+        }
+        for (uint32_t id : sortedNames)
+        {
+            if (!pidsByName[id].empty() && std::regex_search(pool->display(id), expression))
+                matched.push_back(id);
+        }
+    }
+    else
+    {
+        std::wstring lowerPattern = pattern;
+        std::transform(lowerPattern.begin(), lowerPattern.end(), lowerPattern.begin(), ::towlower);
+        matchNames(mode, lowerPattern, matched);
+    }
+
+    for (uint32_t id : matched)
+        pids.insert(pids.end(), pidsByName[id].begin(), pidsByName[id].end());
+    if (matched.size() > 1)
+        std::sort(pids.begin(), pids.end());
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "NamePool.h"
+#include "ProcessInfo.h"
+#include "ProcessTable.h"
+
+// How ProcessSearchIndex::find compares the pattern with process names (always case-insensitive)
+enum class SearchMode
+{
+    Exact,       // The whole name
+    Prefix,      // The start of the name
+    Substring,   // Anywhere in the name
+    Glob,        // Whole name with * and ? wildcards
+    Regex        // ECMAScript regular expression found anywhere in the name
+};
+
+// Answers name searches with PID lists without touching every process. Names are
+// indexed once, when they first show up in the NamePool: a list of lowercase names in
+// sorted order for exact and prefix lookups, and trigram -> name postings for substring
+// and glob lookups. Each snapshot only maintains which PIDs carry each name, so a query
+// matches the (few) distinct names and then collects their PIDs.
+class ProcessSearchIndex
+{
+public:
+    // Indexes every process of the table from scratch
+    void rebuild(const ProcessTable& table, const NamePool& names);
+
+    // Follows one refresh: drops delta.removed and adds the rows the table flags as new.
+    // The index must hold the processes of the refresh before; if the counts do not add
+    // up it rebuilds instead.
+    void apply(const ProcessTable& table, const ProcessDelta& delta, const NamePool& names);
+
+    // PIDs (ascending) of the processes whose display name matches pattern.
+    // Returns false with a message in error if pattern is not a valid regular expression.
+    bool find(SearchMode mode, const std::wstring& pattern, std::vector<DWORD>& pids, std::string& error) const;
+
+    // Processes indexed
+    size_t processCount() const;
+
+private:
+    // Adds the names interned since the last call to the sorted list and trigram postings
+    void indexNewNames();
+
+    // Appends the IDs of live names matching the query to matched
+    void matchNames(SearchMode mode, const std::wstring& lowerPattern, std::vector<uint32_t>& matched) const;
+
+    // Names sharing every trigram of text (sorted by ID); false if text is too short to narrow anything
+    bool trigramCandidates(const std::wstring& text, std::vector<uint32_t>& candidates) const;
+
+    // Range of sortedNames whose lowercase name starts with prefix
+    std::pair<size_t, size_t> prefixRange(const std::wstring& prefix) const;
+
+    void addPid(uint32_t nameId, DWORD pid);
+    bool removePid(uint32_t nameId, DWORD pid);
+
+    const NamePool* pool = nullptr;
+
+    // Name side, only ever grows. IDs are folded (names differing in case count as one).
+    uint32_t indexedNames = 0;                                        // Pool IDs looked at so far
+    std::vector<uint32_t> sortedNames;                                // Folded IDs by lowercase name
+    std::unordered_map<uint64_t, std::vector<uint32_t>> trigrams;     // Trigram -> folded IDs, ascending
+
+    // Process side: PIDs of each folded name (sorted), for the current snapshot
+    std::vector<std::vector<DWORD>> pidsByName;
+    size_t processes = 0;
+};
@@ -0,0 +1,78 @@
+#include "ProcessSnapshotSource.h"
+
+#ifdef _WIN32
+#include "WindowsSnapshotSource.h"
+#else
+#include "LinuxSnapshotSource.h"
+#endif
+
+// Decodes UTF-8 into an existing wide string without releasing its buffer
+static void assignUtf8(std::wstring& out, const char* text, size_t length)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        unsigned long codePoint = c;
+        size_t extra = 0;
+
+        if (c >= 0xF0 && c < 0xF8) { codePoint = c & 0x07; extra = 3; }
+        else if (c >= 0xE0 && c < 0xF0) { codePoint = c & 0x0F; extra = 2; }
+        else if (c >= 0xC0 && c < 0xE0) { codePoint = c & 0x1F; extra = 1; }
+
+        if (i + extra >= length)
+        {
+            // Truncated sequence (comm is cut at 15 bytes): keep the raw byte
+            codePoint = c;
+            extra = 0;
+        }
+        for (size_t k = 1; k <= extra; ++k)
+            codePoint = (codePoint << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+
+        out.push_back(static_cast<wchar_t>(codePoint));
+        i += extra + 1;
+    }
+}
+
+void copyName(const ProcessSample& sample, std::wstring& out)
+{
+    if (sample.wideName)
+    {
+        out.assign(sample.wideName, sample.nameLength);
+    }
+    else
+    {
+        assignUtf8(out, sample.utf8Name, sample.nameLength);
+    }
+}
+
+bool ProcessSnapshotSource::readMemoryDetail(DWORD, MemoryDetail&, SampleScratch&)
+{
+    return false;
+}
+
+bool ProcessSnapshotSource::forEachProcess(const std::function<void(const ProcessSample&)>& visit)
+{
+    size_t count = 0;
+    if (!beginWalk(count))
+        return false;
+
+    SampleScratch scratch;
+    ProcessSample sample;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (sampleAt(i, sample, scratch))
+            visit(sample);
+    }
+    return true;
+}
+
+std::unique_ptr<ProcessSnapshotSource> createDefaultSnapshotSource()
+{
+#ifdef _WIN32
+    return std::make_unique<WindowsSnapshotSource>();
+#else
+    return std::make_unique<LinuxSnapshotSource>();
+#endif
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "ProcessInfo.h"
+
+// One process as reported by a snapshot source during a walk
+struct ProcessSample
+{
+    DWORD pid;                        // Process ID
+    DWORD parentPid;                  // Process that started it
+    unsigned long long startTime;     // Platform start time, tells a recycled PID from the old process
+    unsigned long long memoryUsage;   // Working set / resident size in bytes
+    unsigned long long cpuTime;       // User + kernel time used so far, in nanoseconds
+    bool isAccessible;                // Could the counters be read?
+    uint32_t userId;                  // Owner (see UserNames.h), NoUser if unknown
+    char state;                       // Scheduler state letter (see ProcessInfo::state)
+    unsigned long long pageFaults;    // Page faults so far, minor and major
+    unsigned long long majorFaults;   // Faults that had to read from disk (0 if not known)
+    unsigned long long peakMemory;    // Peak working set in bytes, 0 if this walk does not know it
+    uint32_t threadCount;
+    uint32_t handleCount;             // Open file descriptors / handles
+    unsigned long long readBytes;     // I/O so far (0 when not allowed to read it)
+    unsigned long long writeBytes;
+    unsigned long long readOps;       // Read / write calls so far
+    unsigned long long writeOps;
+    unsigned long long contextSwitches;   // Voluntary and involuntary, 0 if not known
+
+    // Executable name inside the source's own buffer, only valid during the callback.
+    // Windows hands out wide text, Linux the raw UTF-8 bytes; decode with copyName.
+    const wchar_t* wideName;
+    const char* utf8Name;
+    size_t nameLength;
+};
+
+// Per-thread buffers a source reads into while sampling one process
+struct SampleScratch
+{
+    alignas(8) char fileBuffer[4096];    // Enough for stat, io, status and smaps_rollup (aligned for getdents64)
+    char pathBuffer[64];
+};
+
+// Where ProcessManager gets its process list from (one implementation per platform).
+// A walk has two phases: beginWalk lists the processes, then sampleAt reads each one.
+// The second phase is where the syscalls are, so it can be spread over several threads.
+class ProcessSnapshotSource
+{
+public:
+    virtual ~ProcessSnapshotSource() = default;
+
+    // Lists the running processes; sampleAt is then valid for indices [0, count).
+    // Returns false if the system could not be enumerated at all.
+    virtual bool beginWalk(size_t& count) = 0;
+
+    // Reads the process at index of the current walk. Safe to call from several threads
+    // at once as long as each passes its own scratch; sample's name points into scratch
+    // or into the walk. Returns false if the process exited in the meantime.
+    virtual bool sampleAt(size_t index, ProcessSample& sample, SampleScratch& scratch) = 0;
+
+    // Reads the expensive memory counters of one process (e.g. one found by the last walk).
+    // Safe to call from several threads with separate scratch buffers. Returns false if
+    // the process is gone, not accessible or the source has no such counters.
+    virtual bool readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch& scratch);
+
+    // Walks everything on the calling thread, calling visit once per process
+    bool forEachProcess(const std::function<void(const ProcessSample&)>& visit);
+};
+
+// Decodes the sample's name into out, reusing out's buffer
+void copyName(const ProcessSample& sample, std::wstring& out);
+
+// Creates the native snapshot source for the platform we were built for
+std::unique_ptr<ProcessSnapshotSource> createDefaultSnapshotSource();
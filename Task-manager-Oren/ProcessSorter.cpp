@@ -0,0 +1,280 @@
+#include "ProcessSorter.h"
+
+#include <algorithm>
+#include <numeric>
+
+void radixSortRows(std::vector<uint32_t>& rows, const std::vector<uint64_t>& keys, std::vector<uint32_t>& scratch)
+{
+    if (rows.size() < 2)
+        return;
+
+    // Which bits differ at all between the keys; digits outside that mask need no pass
+    uint64_t allOr = 0;
+    uint64_t allAnd = ~0ULL;
+    for (uint32_t row : rows)
+    {
+        allOr |= keys[row];
+        allAnd &= keys[row];
+    }
+    uint64_t varying = allOr ^ allAnd;
+
+    scratch.resize(rows.size());
+    for (unsigned shift = 0; shift < 64; shift += 8)
+    {
+        if (((varying >> shift) & 0xFF) == 0)
+            continue;
+
+        size_t counts[257] = {};
+        for (uint32_t row : rows)
+            ++counts[((keys[row] >> shift) & 0xFF) + 1];
+        for (size_t digit = 1; digit < 257; ++digit)
+            counts[digit] += counts[digit - 1];
+
+        for (uint32_t row : rows)
+            scratch[counts[(keys[row] >> shift) & 0xFF]++] = row;
+
+        rows.swap(scratch);
+    }
+}
+
+// Packs the first three characters of a name into 63 bits. Shorter names are padded
+// with zeros, so comparing prefixes never contradicts comparing the whole strings.
+static uint64_t namePrefix(const std::wstring& name)
+{
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        uint64_t c = i < name.size() ? static_cast<uint64_t>(static_cast<uint32_t>(name[i])) & 0x1FFFFF : 0;
+        prefix = (prefix << 21) | c;
+    }
+    return prefix;
+}
+
+void ProcessSorter::rankNames(const ProcessTable& table, const NamePool& names)
+{
+    if (ranksValid)
+        return;
+
+    // Distinct names in this table
+    const uint32_t unused = 0xFFFFFFFFu;
+    nameRank.assign(names.size(), unused);
+    std::vector<uint32_t> present;
+    for (uint32_t id : table.nameId)
+    {
+        if (nameRank[id] == unused)
+        {
+            nameRank[id] = 0;
+            present.push_back(id);
+        }
+    }
+
+    // Radix sort by prefix, then settle runs with the same prefix by comparing full names
+    std::vector<uint64_t> prefixes(names.size(), 0);
+    for (uint32_t id : present)
+        prefixes[id] = namePrefix(names.lower(id));
+    radixSortRows(present, prefixes, scratchRows);
+
+    for (size_t begin = 0; begin < present.size();)
+    {
+        size_t end = begin + 1;
+        while (end < present.size() && prefixes[present[end]] == prefixes[present[begin]])
+            ++end;
+        if (end - begin > 1)
+        {
+            std::sort(present.begin() + begin, present.begin() + end, [&names](uint32_t a, uint32_t b)
+                {
+                    return names.lower(a) < names.lower(b);
+                });
+        }
+        begin = end;
+    }
+
+    for (uint32_t i = 0; i < present.size(); ++i)
+        nameRank[present[i]] = i;
+    ranksValid = true;
+}
+
+void ProcessSorter::buildKeys(const ProcessTable& table, const SortField& field, std::vector<uint64_t>& out)
+{
+    size_t count = table.size();
+    out.resize(count);
+
+    for (size_t row = 0; row < count; ++row)
+    {
+        uint64_t key = 0;
+        switch (field.key)
+        {
+        case SortKey::Accessible:
+            key = (table.flags[row] & ProcessTable::Accessible) ? 0 : 1;
+            break;
+        case SortKey::Memory:
+            key = table.memory[row];
+            break;
+        case SortKey::Cpu:
+            key = table.cpu[row];
+            break;
+        case SortKey::Name:
+            key = nameRank[table.nameId[row]];
+            break;
+        case SortKey::Pid:
+            key = table.pid[row];
+            break;
+        case SortKey::Threads:
+            key = table.threads[row];
+            break;
+        case SortKey::Handles:
+            key = table.handles[row];
+            break;
+        case SortKey::Io:
+            key = table.readRate[row] + table.writeRate[row];
+            break;
+        case SortKey::ReadRate:
+            key = table.readRate[row];
+            break;
+        case SortKey::WriteRate:
+            key = table.writeRate[row];
+            break;
+        case SortKey::IoOps:
+            key = table.ioOpsRate[row];
+            break;
+        case SortKey::ContextSwitches:
+            key = table.switchRate[row];
+            break;
+        }
+        out[row] = field.descending ? ~key : key;
+    }
+}
+
+const ProcessSorter::CachedOrder* ProcessSorter::findCached(const SortOrder& fields, size_t count) const
+{
+    for (const auto& cached : cache)
+    {
+        if (cached.fields.size() != fields.size() || (!cached.complete && cached.rows.size() < count))
+            continue;
+
+        bool same = true;
+        for (size_t i = 0; i < fields.size() && same; ++i)
+            same = cached.fields[i].key == fields[i].key && cached.fields[i].descending == fields[i].descending;
+        if (same)
+            return &cached;
+    }
+    return nullptr;
+}
+
+const std::vector<uint32_t>& ProcessSorter::order(const ProcessTable& table, const NamePool& names, const SortOrder& fields)
+{
+    const CachedOrder* cached = findCached(fields, table.size());
+    if (cached && cached->complete)
+        return cached->rows;
+
+    cache.push_back(CachedOrder{ fields, std::vector<uint32_t>(table.size()), true });
+    std::vector<uint32_t>& rows = cache.back().rows;
+    std::iota(rows.begin(), rows.end(), 0u);
+
+    // Least significant field first; each pass is stable so earlier passes break ties
+    for (size_t i = fields.size(); i-- > 0;)
+    {
+        if (fields[i].key == SortKey::Name)
+            rankNames(table, names);
+        buildKeys(table, fields[i], keys);
+        radixSortRows(rows, keys, scratchRows);
+    }
+    return rows;
+}
+
+const std::vector<uint32_t>& ProcessSorter::top(const ProcessTable& table, const NamePool& names, const SortOrder& fields, size_t count)
+{
+    count = std::min(count, table.size());
+    const CachedOrder* cached = findCached(fields, count);
+    if (cached)
+        return cached->rows;
+
+    size_t fieldCount = fields.size();
+    fieldKeys.resize(fieldCount);
+    bool byName = false;
+    for (size_t i = 0; i < fieldCount; ++i)
+    {
+        if (fields[i].key == SortKey::Name)
+        {
+            rankNames(table, names);
+            byName = true;
+        }
+        buildKeys(table, fields[i], fieldKeys[i]);
+    }
+
+    // Lexicographic over the key columns, then by row: a strict total order matching the stable sort
+    auto before = [this, fieldCount](uint32_t a, uint32_t b)
+        {
+            for (size_t i = 0; i < fieldCount; ++i)
+            {
+                uint64_t ka = fieldKeys[i][a];
+                uint64_t kb = fieldKeys[i][b];
+                if (ka != kb)
+                    return ka < kb;
+            }
+            return a < b;
+        };
+
+    cache.push_back(CachedOrder{ fields, std::vector<uint32_t>(), false });
+    std::vector<uint32_t>& rows = cache.back().rows;
+
+    // If at least count rows still come no later than the last cutoff, the new top rows
+    // are all among them (the count-th row cannot come after the cutoff), so only they
+    // need selecting
+    Cutoff* cutoff = nullptr;
+    for (auto& known : cutoffs)
+    {
+        bool same = known.fields.size() == fieldCount;
+        for (size_t i = 0; i < fieldCount && same; ++i)
+            same = known.fields[i].key == fields[i].key && known.fields[i].descending == fields[i].descending;
+        if (same)
+        {
+            cutoff = &known;
+            break;
+        }
+    }
+    if (cutoff && !byName && count > 0)
+    {
+        rows.reserve(count * 2);
+        for (uint32_t row = 0; row < table.size(); ++row)
+        {
+            size_t i = 0;
+            while (i < fieldCount && fieldKeys[i][row] == cutoff->keys[i])
+                ++i;
+            if (i == fieldCount || fieldKeys[i][row] < cutoff->keys[i])
+                rows.push_back(row);
+        }
+        if (rows.size() < count)
+            rows.clear();
+    }
+    if (rows.empty())
+    {
+        rows.resize(table.size());
+        std::iota(rows.begin(), rows.end(), 0u);
+    }
+
+    if (count < rows.size())
+    {
+        std::nth_element(rows.begin(), rows.begin() + count, rows.end(), before);
+        rows.resize(count);
+    }
+    std::sort(rows.begin(), rows.end(), before);
+
+    if (count > 0 && !byName)
+    {
+        if (!cutoff)
+        {
+            cutoffs.push_back(Cutoff{ fields, std::vector<uint64_t>(fieldCount) });
+            cutoff = &cutoffs.back();
+        }
+        for (size_t i = 0; i < fieldCount; ++i)
+            cutoff->keys[i] = fieldKeys[i][rows[count - 1]];
+    }
+    return rows;
+}
+
+void ProcessSorter::invalidate()
+{
+    cache.clear();
+    ranksValid = false;
+}
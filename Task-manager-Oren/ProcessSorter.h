@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "NamePool.h"
+#include "ProcessTable.h"
+
+// Columns a process table can be ordered by
+enum class SortKey
+{
+    Accessible,   // Accessible rows before inaccessible ones
+    Memory,
+    Cpu,          // Usage over the last refresh interval
+    Name,         // Case-insensitive, by the interned lowercase name
+    Pid,
+    Threads,
+    Handles,
+    Io,           // Bytes read and written per second
+    ReadRate,
+    WriteRate,
+    IoOps,        // Read and write calls per second
+    ContextSwitches
+};
+
+// One level of a multi-key order
+struct SortField
+{
+    SortKey key;
+    bool descending;
+};
+
+// Most significant field first, e.g. { Accessible, Memory desc, Name }
+typedef std::vector<SortField> SortOrder;
+
+// Orders rows of a ProcessTable by several keys at once. Every key is turned into one
+// integer per row, and the row indices go through a stable LSD radix sort per key,
+// least significant key first. Results are cached until the table changes.
+class ProcessSorter
+{
+public:
+    // Returns the rows of table in the given order. Repeated calls with the same order
+    // cost nothing until invalidate() is called.
+    const std::vector<uint32_t>& order(const ProcessTable& table, const NamePool& names, const SortOrder& fields);
+
+    // Returns the first count rows of order(table, names, fields) without sorting the rest:
+    // one key column per field, nth_element to split off the first count rows, and a sort
+    // of just those. Ties go to the lower row, so the result is exactly the start of the
+    // stable order. The returned rows hold at least min(count, table.size()) entries (more
+    // when a full order was already cached) and stay cached until invalidate().
+    // Between tables the previous cutoff row's keys are kept, so when enough rows still
+    // beat it the selection only looks at those (not for name orders, whose ranks change).
+    const std::vector<uint32_t>& top(const ProcessTable& table, const NamePool& names, const SortOrder& fields, size_t count);
+
+    // Drops cached orders and name ranks (call whenever the table is rebuilt)
+    void invalidate();
+
+private:
+    struct CachedOrder
+    {
+        SortOrder fields;
+        std::vector<uint32_t> rows;
+        bool complete;    // Every row, rather than the start of the order from top()
+    };
+
+    // Keys of the last row top() returned for an order, in field order
+    struct Cutoff
+    {
+        SortOrder fields;
+        std::vector<uint64_t> keys;
+    };
+
+    // Ranks the names used by table so that comparing ranks compares lowercase names
+    void rankNames(const ProcessTable& table, const NamePool& names);
+
+    // Fills out with one integer per row for the given field (ascending order of keys = wanted order)
+    void buildKeys(const ProcessTable& table, const SortField& field, std::vector<uint64_t>& out);
+
+    // Cached order for fields that holds at least count rows, or null
+    const CachedOrder* findCached(const SortOrder& fields, size_t count) const;
+
+    std::deque<CachedOrder> cache;     // deque keeps handed-out references valid as it grows
+    std::vector<uint32_t> nameRank;    // By name ID, valid while ranksValid
+    bool ranksValid = false;
+    std::vector<Cutoff> cutoffs;       // Kept across invalidate()
+
+    // Scratch reused between sorts
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> scratchRows;
+    std::vector<std::vector<uint64_t>> fieldKeys;    // One key column per field, for top()
+};
+
+// Stable LSD radix sort of rows by keys[row], 8 bits per pass; passes where every key
+// has the same digit are skipped, so small keys only cost a couple of passes
+void radixSortRows(std::vector<uint32_t>& rows, const std::vector<uint64_t>& keys, std::vector<uint32_t>& scratch);
@@ -0,0 +1,58 @@
+#include "ProcessTable.h"
+
+void ProcessTable::assign(const std::vector<ProcessInfo>& processes)
+{
+    size_t count = processes.size();
+    pid.resize(count);
+    parentPid.resize(count);
+    memory.resize(count);
+    memoryDelta.resize(count);
+    cpu.resize(count);
+    flags.resize(count);
+    nameId.resize(count);
+    user.resize(count);
+    state.resize(count);
+    proportional.resize(count);
+    unique.resize(count);
+    swap.resize(count);
+    threads.resize(count);
+    handles.resize(count);
+    readRate.resize(count);
+    writeRate.resize(count);
+    ioOpsRate.resize(count);
+    switchRate.resize(count);
+
+    for (size_t row = 0; row < count; ++row)
+    {
+        const ProcessInfo& proc = processes[row];
+        pid[row] = proc.pid;
+        parentPid[row] = proc.parentPid;
+        memory[row] = proc.memoryUsage;
+        memoryDelta[row] = proc.memoryDelta;
+        cpu[row] = static_cast<uint32_t>(proc.cpuUsage * 100.0 + 0.5);
+        flags[row] = static_cast<uint8_t>((proc.isAccessible ? Accessible : 0) | (proc.isNew ? IsNew : 0)
+            | (proc.memoryDetailRefresh != 0 ? HasDetail : 0));
+        nameId[row] = proc.nameId;
+        user[row] = proc.userId;
+        state[row] = proc.state;
+        proportional[row] = proc.memoryDetail.proportional;
+        unique[row] = proc.memoryDetail.unique;
+        swap[row] = proc.memoryDetail.swap;
+        threads[row] = proc.threadCount;
+        handles[row] = proc.handleCount;
+        readRate[row] = static_cast<unsigned long long>(proc.readRate + 0.5);
+        writeRate[row] = static_cast<unsigned long long>(proc.writeRate + 0.5);
+        ioOpsRate[row] = static_cast<unsigned long long>(proc.readOpsRate + proc.writeOpsRate + 0.5);
+        switchRate[row] = static_cast<unsigned long long>(proc.contextSwitchRate + 0.5);
+    }
+}
+
+size_t ProcessTable::size() const
+{
+    return pid.size();
+}
+
+bool ProcessTable::accessible(uint32_t row) const
+{
+    return (flags[row] & Accessible) != 0;
+}
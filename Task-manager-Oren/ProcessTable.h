@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ProcessInfo.h"
+
+// Column-wise copy of a process list. Rows are referenced by 32-bit index and names
+// by their NamePool ID, so sorting (ProcessSorter) and grouping (GroupingEngine) only ever move small integers.
+struct ProcessTable
+{
+    // Bits in flags
+    enum : uint8_t { Accessible = 1, IsNew = 2, HasDetail = 4 };
+
+    std::vector<DWORD> pid;
+    std::vector<DWORD> parentPid;
+    std::vector<unsigned long long> memory;
+    std::vector<long long> memoryDelta;
+    std::vector<uint32_t> cpu;         // CPU usage in hundredths of a percent of one core
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> nameId;
+    std::vector<uint32_t> user;        // Owner's user ID (see UserNames.h)
+    std::vector<char> state;           // Scheduler state letter
+    std::vector<unsigned long long> proportional;   // Memory breakdown (0 unless HasDetail)
+    std::vector<unsigned long long> unique;
+    std::vector<unsigned long long> swap;
+    std::vector<uint32_t> threads;
+    std::vector<uint32_t> handles;
+    std::vector<unsigned long long> readRate;         // Bytes per second
+    std::vector<unsigned long long> writeRate;
+    std::vector<unsigned long long> ioOpsRate;        // Read and write calls per second
+    std::vector<unsigned long long> switchRate;       // Context switches per second
+
+    // Copies the columns out of a process list (reuses the column buffers)
+    void assign(const std::vector<ProcessInfo>& processes);
+
+    // Number of rows
+    size_t size() const;
+
+    // Is the row's memory counter valid?
+    bool accessible(uint32_t row) const;
+};
@@ -0,0 +1,494 @@
+#include "ProcessTerminator.h"
+
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// pidfd_open and pidfd_send_signal (Linux 5.3+) have no libc wrappers on older systems
+static int openPidfd(DWORD pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, static_cast<pid_t>(pid), 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int sendSignal(int pidfd, DWORD pid, int signal)
+{
+#ifdef SYS_pidfd_send_signal
+    if (pidfd >= 0)
+        return static_cast<int>(syscall(SYS_pidfd_send_signal, pidfd, signal, nullptr, 0));
+#else
+    (void)pidfd;
+#endif
+    return kill(static_cast<pid_t>(pid), signal);
+}
+
+// Reads /proc/<pid>/stat and returns what follows the name (the last ')'), or null if the
+// process is gone. The name may itself contain ')'.
+static const char* readStat(DWORD pid, char* line, size_t size)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%u/stat", static_cast<unsigned>(pid));
+    FILE* file = std::fopen(path, "r");
+    if (!file)
+        return nullptr;
+    size_t length = std::fread(line, 1, size - 1, file);
+    std::fclose(file);
+    line[length] = '\0';
+
+    const char* close = nullptr;
+    for (const char* p = line; *p; ++p)
+    {
+        if (*p == ')')
+            close = p;
+    }
+    return close;
+}
+
+// For targets without a pidfd: gone, or a zombie waiting for its parent
+static bool processGone(DWORD pid)
+{
+    if (kill(static_cast<pid_t>(pid), 0) != 0)
+        return errno == ESRCH;
+
+    // The state follows the name
+    char line[512];
+    const char* close = readStat(pid, line, sizeof(line));
+    return !close || (close[1] == ' ' && close[2] == 'Z');
+}
+
+// Start time of a running process in clock ticks after boot (field 22 of stat, the one
+// LinuxSnapshotSource reports); false if it is gone
+static bool readStartTime(DWORD pid, unsigned long long& startTime)
+{
+    char line[512];
+    const char* close = readStat(pid, line, sizeof(line));
+    if (!close)
+        return false;
+
+    // Fields 3 to 21 come first
+    const char* cursor = close + 1;
+    for (int field = 3; field < 22; ++field)
+    {
+        while (*cursor == ' ')
+            ++cursor;
+        while (*cursor && *cursor != ' ')
+            ++cursor;
+    }
+    char* end = nullptr;
+    startTime = std::strtoull(cursor, &end, 10);
+    return end != cursor;
+}
+#endif
+
+ProcessTerminator::ProcessTerminator(const TerminationOptions& options) : options(options) {}
+
+ProcessTerminator::~ProcessTerminator() = default;
+
+std::vector<TerminationResult> ProcessTerminator::terminate(const std::vector<DWORD>& pids)
+{
+    return terminate(pids, {});
+}
+
+std::vector<TerminationResult> ProcessTerminator::terminate(const std::vector<DWORD>& pids, const std::vector<unsigned long long>& startTimes)
+{
+    results.clear();
+    targets.clear();
+    results.reserve(pids.size());
+    targets.reserve(pids.size());
+
+#ifdef _WIN32
+    DWORD self = GetCurrentProcessId();
+#else
+    DWORD self = static_cast<DWORD>(getpid());
+#endif
+    for (size_t i = 0; i < pids.size(); ++i)
+    {
+        DWORD pid = pids[i];
+        results.push_back({ pid, TerminationOutcome::AlreadyGone, 0 });
+        if (pid == self)
+        {
+            results.back().outcome = TerminationOutcome::Skipped;
+            continue;
+        }
+        Target target;
+        target.pid = pid;
+        target.result = results.size() - 1;
+        target.startTime = i < startTimes.size() ? startTimes[i] : 0;
+        targets.push_back(target);
+    }
+
+    openAll();
+
+    if (options.grace.count() > 0)
+    {
+        if (options.freezeFirst)
+            signalAll(Round::Freeze);
+        signalAll(Round::Polite);
+        if (options.freezeFirst)
+            signalAll(Round::Resume);    // Everyone wakes up with the request already pending
+        waitAll(std::chrono::steady_clock::now() + options.grace, TerminationOutcome::Exited);
+    }
+    else if (options.freezeFirst)
+    {
+        signalAll(Round::Freeze);
+    }
+
+    signalAll(Round::Force);
+    waitAll(std::chrono::steady_clock::now() + options.killWait, TerminationOutcome::Killed);
+
+    // Whatever was forced and is still around did not go
+    for (Target& target : targets)
+    {
+        if (!target.done)
+            results[target.result].outcome = TerminationOutcome::Survived;
+    }
+
+    closeAll();
+    return results;
+}
+
+void ProcessTerminator::forEach(size_t count, const std::function<void(size_t, size_t)>& body)
+{
+    unsigned threads = std::min(8u, std::thread::hardware_concurrency());
+    if (count < ParallelThreshold || threads < 2)
+    {
+        body(0, count);
+        return;
+    }
+    if (!pool)
+        pool = std::make_unique<WorkerPool>(threads);
+    pool->parallelFor(count, 64, [&body](size_t begin, size_t end, unsigned) { body(begin, end); });
+}
+
+void ProcessTerminator::openAll()
+{
+    forEach(targets.size(), [this](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Target& target = targets[i];
+#ifdef _WIN32
+                DWORD access = PROCESS_TERMINATE | SYNCHRONIZE | (target.startTime ? PROCESS_QUERY_LIMITED_INFORMATION : 0);
+                target.handle = OpenProcess(access, FALSE, target.pid);
+                if (target.handle == NULL)
+                {
+                    DWORD error = GetLastError();
+                    target.done = true;
+                    if (error != ERROR_INVALID_PARAMETER)    // Anything but "no such process"
+                    {
+                        results[target.result].outcome = TerminationOutcome::Denied;
+                        results[target.result].errorCode = error;
+                    }
+                    continue;
+                }
+
+                // The handle pins the process, so its creation time is the one we will signal
+                FILETIME creation, exitTime, kernel, user;
+                if (target.startTime && GetProcessTimes(target.handle, &creation, &exitTime, &kernel, &user)
+                    && ((static_cast<unsigned long long>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime) != target.startTime)
+                {
+                    CloseHandle(target.handle);
+                    target.handle = NULL;
+                    target.done = true;
+                }
+#else
+                // Anyone may open a pidfd; permission is checked when signalling
+                target.pidfd = openPidfd(target.pid);
+                if (target.pidfd < 0 && errno == ESRCH)
+                {
+                    target.done = true;
+                    continue;
+                }
+
+                // Read after the pidfd is open: if stat still shows the expected start time,
+                // the pidfd is that process (without a pidfd the check is best effort)
+                unsigned long long startTime = 0;
+                if (target.startTime && (!readStartTime(target.pid, startTime) || startTime != target.startTime))
+                {
+                    if (target.pidfd >= 0)
+                        close(target.pidfd);
+                    target.pidfd = -1;
+                    target.done = true;
+                }
+#endif
+            }
+        });
+}
+
+#ifdef _WIN32
+namespace
+{
+    struct WindowSearch
+    {
+        std::unordered_map<DWORD, size_t>* targetOfPid;
+        std::vector<HWND>* windows;
+    };
+
+    BOOL CALLBACK collectWindow(HWND window, LPARAM parameter)
+    {
+        WindowSearch* search = reinterpret_cast<WindowSearch*>(parameter);
+        DWORD pid = 0;
+        GetWindowThreadProcessId(window, &pid);
+        auto it = search->targetOfPid->find(pid);
+        if (it != search->targetOfPid->end() && IsWindowVisible(window) && !(*search->windows)[it->second])
+            (*search->windows)[it->second] = window;
+        return TRUE;
+    }
+}
+#endif
+
+void ProcessTerminator::signalAll(Round round)
+{
+#ifdef _WIN32
+    // Windows has no signals; processes with a window are asked to close it, the rest can
+    // only be terminated
+    if (round == Round::Freeze || round == Round::Resume)
+        return;
+    if (round == Round::Polite)
+    {
+        std::unordered_map<DWORD, size_t> targetOfPid;
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            if (!targets[i].done)
+                targetOfPid.emplace(targets[i].pid, i);
+        }
+        std::vector<HWND> windows(targets.size(), NULL);
+        WindowSearch search = { &targetOfPid, &windows };
+        EnumWindows(collectWindow, reinterpret_cast<LPARAM>(&search));
+        for (size_t i = 0; i < targets.size(); ++i)
+            targets[i].window = windows[i];
+    }
+#endif
+
+    forEach(targets.size(), [this, round](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                Target& target = targets[i];
+                if (target.done)
+                    continue;
+                TerminationResult& result = results[target.result];
+#ifdef _WIN32
+                if (round == Round::Polite)
+                {
+                    target.asked = target.window && PostMessageW(target.window, WM_CLOSE, 0, 0);
+                    continue;
+                }
+                target.asked = TerminateProcess(target.handle, 1) != 0;
+                if (!target.asked && WaitForSingleObject(target.handle, 0) != WAIT_OBJECT_0)
+                {
+                    target.done = true;
+                    result.outcome = TerminationOutcome::Denied;
+                    result.errorCode = GetLastError();
+                }
+                target.asked = true;    // Exited or not, the wait settles it
+#else
+                int signal = round == Round::Freeze ? SIGSTOP : round == Round::Polite ? SIGTERM
+                    : round == Round::Resume ? SIGCONT : SIGKILL;
+                if (sendSignal(target.pidfd, target.pid, signal) == 0)
+                {
+                    target.asked = true;
+                }
+                else if (errno == ESRCH)
+                {
+                    // Gone between rounds: after an earlier signal that counts as exiting on request
+                    target.done = true;
+                    result.outcome = target.asked ? TerminationOutcome::Exited : TerminationOutcome::AlreadyGone;
+                }
+                else
+                {
+                    target.done = true;
+                    result.outcome = TerminationOutcome::Denied;
+                    result.errorCode = static_cast<unsigned long>(errno);
+                }
+#endif
+            }
+        });
+}
+
+void ProcessTerminator::waitAll(std::chrono::steady_clock::time_point deadline, TerminationOutcome outcome)
+{
+    std::vector<size_t> waiting;
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        if (!targets[i].done && targets[i].asked)
+            waiting.push_back(i);
+    }
+
+    auto settle = [&](size_t& slot)
+        {
+            Target& target = targets[waiting[slot]];
+            target.done = true;
+            results[target.result].outcome = outcome;
+            waiting[slot] = waiting.back();
+            waiting.pop_back();
+        };
+
+#ifdef _WIN32
+    std::vector<HANDLE> handles;
+    while (!waiting.empty())
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            break;
+        DWORD remaining = static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1;
+
+        // One call can wait on 64 handles; beyond that, wait on the first 64 briefly and
+        // sweep the rest
+        size_t count = std::min<size_t>(waiting.size(), MAXIMUM_WAIT_OBJECTS);
+        handles.clear();
+        for (size_t i = 0; i < count; ++i)
+            handles.push_back(targets[waiting[i]].handle);
+        WaitForMultipleObjects(static_cast<DWORD>(count), handles.data(), FALSE,
+            waiting.size() > count ? std::min<DWORD>(remaining, 20) : remaining);
+
+        for (size_t slot = 0; slot < waiting.size();)
+        {
+            if (WaitForSingleObject(targets[waiting[slot]].handle, 0) == WAIT_OBJECT_0)
+                settle(slot);
+            else
+                ++slot;
+        }
+    }
+#else
+    // pidfds go into one epoll set, so each wakeup costs the processes that exited rather
+    // than the whole set; targets without a pidfd are probed every 10 ms alongside
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<uint8_t> probed(targets.size(), 0);
+    bool probing = false;
+    for (size_t index : waiting)
+    {
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.u64 = index;
+        if (targets[index].pidfd < 0 || epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, targets[index].pidfd, &event) != 0)
+        {
+            probed[index] = 1;
+            probing = true;
+        }
+    }
+
+    std::vector<epoll_event> events(256);
+    std::vector<uint8_t> exited(targets.size(), 0);
+    while (!waiting.empty())
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            break;
+        long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() + 1;
+        int timeout = static_cast<int>(std::min<long long>(remaining, probing ? 10 : 1000));
+
+        bool any = false;
+        int ready = epoll >= 0 ? epoll_wait(epoll, events.data(), static_cast<int>(events.size()), timeout) : 0;
+        if (epoll < 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        for (int i = 0; i < ready; ++i)
+        {
+            exited[events[i].data.u64] = 1;
+            any = true;
+        }
+        if (probing)
+        {
+            for (size_t index : waiting)
+            {
+                if (probed[index] && processGone(targets[index].pid))
+                {
+                    exited[index] = 1;
+                    any = true;
+                }
+            }
+        }
+        if (!any)
+            continue;
+
+        for (size_t slot = 0; slot < waiting.size();)
+        {
+            if (exited[waiting[slot]])
+                settle(slot);
+            else
+                ++slot;
+        }
+    }
+    if (epoll >= 0)
+        close(epoll);
+#endif
+}
+
+void ProcessTerminator::closeAll()
+{
+    for (Target& target : targets)
+    {
+#ifdef _WIN32
+        if (target.handle)
+            CloseHandle(target.handle);
+        target.handle = NULL;
+#else
+        if (target.pidfd >= 0)
+            close(target.pidfd);
+        target.pidfd = -1;
+#endif
+    }
+}
+
+const wchar_t* ProcessTerminator::outcomeName(TerminationOutcome outcome)
+{
+    switch (outcome)
+    {
+    case TerminationOutcome::Exited: return L"exited";
+    case TerminationOutcome::Killed: return L"killed";
+    case TerminationOutcome::AlreadyGone: return L"already gone";
+    case TerminationOutcome::Denied: return L"denied";
+    case TerminationOutcome::Survived: return L"survived";
+    case TerminationOutcome::Skipped: return L"skipped (this process)";
+    }
+    return L"?";
+}
+
+void ProcessTerminator::printSummary(const std::vector<TerminationResult>& results, std::wostream& out)
+{
+    // Every PID while the list is short, otherwise only the ones still running
+    const size_t listAll = 30;
+    for (const TerminationResult& result : results)
+    {
+        bool problem = result.outcome == TerminationOutcome::Denied || result.outcome == TerminationOutcome::Survived
+            || result.outcome == TerminationOutcome::Skipped;
+        if (!problem && results.size() > listAll)
+            continue;
+        out << L"PID " << result.pid << L": " << outcomeName(result.outcome);
+        if (result.outcome == TerminationOutcome::Denied)
+            out << L" (Error code: " << result.errorCode << L")";
+        out << L"\n";
+    }
+
+    size_t counts[6] = {};
+    for (const TerminationResult& result : results)
+        ++counts[static_cast<size_t>(result.outcome)];
+    out << results.size() << L" processes:";
+    const TerminationOutcome order[] = { TerminationOutcome::Exited, TerminationOutcome::Killed, TerminationOutcome::AlreadyGone,
+        TerminationOutcome::Denied, TerminationOutcome::Survived, TerminationOutcome::Skipped };
+    const wchar_t* separator = L" ";
+    for (TerminationOutcome outcome : order)
+    {
+        if (counts[static_cast<size_t>(outcome)] == 0)
+            continue;
+        out << separator << counts[static_cast<size_t>(outcome)] << L" " << outcomeName(outcome);
+        separator = L", ";
+    }
+    out << L"\n";
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "ProcessInfo.h"
+#include "WorkerPool.h"
+
+// What happened to one PID
+enum class TerminationOutcome : uint8_t
+{
+    Exited,         // Left on its own after the polite request
+    Killed,         // Left after the forced kill
+    AlreadyGone,    // Not running by the time we got to it
+    Denied,         // Not allowed to signal or open it
+    Survived,       // Still there after the forced kill's deadline (e.g. stuck in the kernel)
+    Skipped         // Our own process
+};
+
+struct TerminationResult
+{
+    DWORD pid;
+    TerminationOutcome outcome;
+    unsigned long errorCode = 0;    // errno / GetLastError for Denied
+};
+
+struct TerminationOptions
+{
+    // How long processes get to exit after the polite request (0 = kill straight away)
+    std::chrono::milliseconds grace{ 3000 };
+
+    // How long to wait for processes to go after the forced kill
+    std::chrono::milliseconds killWait{ 2000 };
+
+    // Stop the whole set before signalling it, so members of a process tree cannot fork
+    // replacements or react to each other's exit (Linux only)
+    bool freezeFirst = false;
+};
+
+// Ends a set of processes in two rounds: a polite request to all of them (SIGTERM on Linux,
+// WM_CLOSE to their windows on Windows), one shared deadline, then a forced kill (SIGKILL /
+// TerminateProcess) for whatever is left. Signals go out from several threads for large
+// sets, and exits are waited for on process handles (pidfds in an epoll set on Linux) rather
+// than by probing PIDs, which also keeps a recycled PID from being signalled by mistake.
+class ProcessTerminator
+{
+public:
+    explicit ProcessTerminator(const TerminationOptions& options = TerminationOptions());
+    ~ProcessTerminator();
+
+    // Terminates every PID in pids. One result per PID, in the same order.
+    std::vector<TerminationResult> terminate(const std::vector<DWORD>& pids);
+
+    // Same, for PIDs remembered a while ago: startTimes[i] is when pids[i] started, as
+    // ProcessSample::startTime gives it (0 = not known). A PID whose process started at
+    // another time was recycled; it is left alone and reported AlreadyGone. The time is
+    // checked once the process handle is open, so the process cannot be swapped after it.
+    std::vector<TerminationResult> terminate(const std::vector<DWORD>& pids, const std::vector<unsigned long long>& startTimes);
+
+    // Counts per outcome, then one line per PID (only the ones that did not go when there are many)
+    static void printSummary(const std::vector<TerminationResult>& results, std::wostream& out);
+
+    static const wchar_t* outcomeName(TerminationOutcome outcome);
+
+private:
+    // Sets at least this large are signalled from the worker pool
+    static constexpr size_t ParallelThreshold = 256;
+
+    // A PID still being worked on
+    struct Target
+    {
+        DWORD pid;
+        size_t result;          // Index into the results
+        unsigned long long startTime = 0;    // Expected start time, 0 = not checked
+#ifdef _WIN32
+        HANDLE handle = NULL;
+        HWND window = NULL;     // A top-level window to send WM_CLOSE to, if it has one
+#else
+        int pidfd = -1;         // -1: no pidfd (old kernel, out of descriptors), watched by probing
+#endif
+        bool asked = false;     // Got the current round's signal and is being waited for
+        bool done = false;
+    };
+
+    enum class Round { Freeze, Polite, Resume, Force };
+
+    // Opens a handle on every target; the ones that cannot be opened are settled here
+    void openAll();
+
+    // Sends one round's signal to every target still pending
+    void signalAll(Round round);
+
+    // Waits until every asked target has exited or until deadline, settling exits as outcome
+    void waitAll(std::chrono::steady_clock::time_point deadline, TerminationOutcome outcome);
+
+    // Releases the handles
+    void closeAll();
+
+    // Runs body(first, last) over [0, count), in parallel for large counts
+    void forEach(size_t count, const std::function<void(size_t, size_t)>& body);
+
+    TerminationOptions options;
+    std::vector<Target> targets;
+    std::vector<TerminationResult> results;
+    std::unique_ptr<WorkerPool> pool;
+};
@@ -0,0 +1,183 @@
+#include "ProcessTree.h"
+
+#include <algorithm>
+
+size_t ProcessTree::slotOf(DWORD pid) const
+{
+    // Fibonacci hashing, as in GroupingEngine
+    return static_cast<size_t>((pid * 0x9E3779B97F4A7C15ULL) >> 32) & slotMask;
+}
+
+void ProcessTree::build(const ProcessTable& table)
+{
+    uint32_t count = static_cast<uint32_t>(table.size());
+
+    pids.assign(table.pid.begin(), table.pid.end());
+    size_t capacity = 64;
+    while (capacity < static_cast<size_t>(count) * 2)
+        capacity *= 2;
+    slotRow.assign(capacity, NoRow);
+    slotMask = capacity - 1;
+    for (uint32_t row = 0; row < count; ++row)
+    {
+        size_t slot = slotOf(pids[row]);
+        while (slotRow[slot] != NoRow && pids[slotRow[slot]] != pids[row])
+            slot = (slot + 1) & slotMask;
+        if (slotRow[slot] == NoRow)
+            slotRow[slot] = row;    // A duplicate PID keeps its first row
+    }
+
+    parentRow.resize(count);
+    for (uint32_t row = 0; row < count; ++row)
+    {
+        uint32_t up = findRow(table.parentPid[row]);
+        parentRow[row] = up != row ? up : NoRow;
+    }
+
+    // Break parent loops. Each row walks up until it reaches a row already settled or a
+    // root; reaching a row of its own walk means a loop, which is cut there. Every row is
+    // walked through once, so this stays linear.
+    marks.assign(count, 0);    // 0 = not seen, 1 = on the current walk, 2 = settled
+    for (uint32_t row = 0; row < count; ++row)
+    {
+        uint32_t up = row;
+        while (up != NoRow && marks[up] == 0)
+        {
+            marks[up] = 1;
+            up = parentRow[up];
+        }
+        if (up != NoRow && marks[up] == 1)
+            parentRow[up] = NoRow;
+        for (uint32_t settle = row; settle != NoRow && marks[settle] == 1; settle = parentRow[settle])
+            marks[settle] = 2;
+    }
+
+    // Children in CSR form: count per parent, prefix sums, then place each row
+    childOffsets.assign(count + 1, 0);
+    rootRows.clear();
+    for (uint32_t row = 0; row < count; ++row)
+    {
+        if (parentRow[row] == NoRow)
+            rootRows.push_back(row);
+        else
+            ++childOffsets[parentRow[row] + 1];
+    }
+    for (uint32_t row = 0; row < count; ++row)
+        childOffsets[row + 1] += childOffsets[row];
+    childRows.resize(childOffsets[count]);
+    work.assign(childOffsets.begin(), childOffsets.end() - 1);
+    for (uint32_t row = 0; row < count; ++row)
+    {
+        if (parentRow[row] != NoRow)
+            childRows[work[parentRow[row]]++] = row;
+    }
+
+    // Depth-first order with an explicit stack (trees can be deeper than the call stack)
+    preorder.clear();
+    depths.assign(count, 0);
+    work.clear();
+    for (auto root = rootRows.rbegin(); root != rootRows.rend(); ++root)
+        work.push_back(*root);
+    while (!work.empty())
+    {
+        uint32_t row = work.back();
+        work.pop_back();
+        preorder.push_back(row);
+        for (uint32_t i = childOffsets[row + 1]; i > childOffsets[row]; --i)
+        {
+            uint32_t child = childRows[i - 1];
+            depths[child] = depths[row] + 1;
+            work.push_back(child);
+        }
+    }
+
+    // Totals: in reverse depth-first order every subtree is complete before its parent needs it
+    memoryTotals.resize(count);
+    cpuTotals.resize(count);
+    sizeTotals.resize(count);
+    for (uint32_t row = 0; row < count; ++row)
+    {
+        memoryTotals[row] = table.accessible(row) ? table.memory[row] : 0;
+        cpuTotals[row] = table.cpu[row];
+        sizeTotals[row] = 1;
+    }
+    for (auto it = preorder.rbegin(); it != preorder.rend(); ++it)
+    {
+        uint32_t row = *it;
+        uint32_t up = parentRow[row];
+        if (up == NoRow)
+            continue;
+        memoryTotals[up] += memoryTotals[row];
+        cpuTotals[up] += cpuTotals[row];
+        sizeTotals[up] += sizeTotals[row];
+    }
+}
+
+const std::vector<uint32_t>& ProcessTree::roots() const
+{
+    return rootRows;
+}
+
+uint32_t ProcessTree::parent(uint32_t row) const
+{
+    return parentRow[row];
+}
+
+const uint32_t* ProcessTree::children(uint32_t row) const
+{
+    return childRows.data() + childOffsets[row];
+}
+
+uint32_t ProcessTree::childCount(uint32_t row) const
+{
+    return childOffsets[row + 1] - childOffsets[row];
+}
+
+uint32_t ProcessTree::depth(uint32_t row) const
+{
+    return depths[row];
+}
+
+unsigned long long ProcessTree::subtreeMemory(uint32_t row) const
+{
+    return memoryTotals[row];
+}
+
+unsigned long long ProcessTree::subtreeCpu(uint32_t row) const
+{
+    return cpuTotals[row];
+}
+
+uint32_t ProcessTree::subtreeSize(uint32_t row) const
+{
+    return sizeTotals[row];
+}
+
+uint32_t ProcessTree::findRow(DWORD pid) const
+{
+    if (slotRow.empty())
+        return NoRow;
+    size_t slot = slotOf(pid);
+    while (slotRow[slot] != NoRow)
+    {
+        if (pids[slotRow[slot]] == pid)
+            return slotRow[slot];
+        slot = (slot + 1) & slotMask;
+    }
+    return NoRow;
+}
+
+void ProcessTree::subtree(uint32_t row, std::vector<uint32_t>& rows) const
+{
+    rows.clear();
+    if (row == NoRow)
+        return;
+
+    // Breadth-first: rows itself serves as the queue, and parents come before children
+    rows.push_back(row);
+    for (size_t next = 0; next < rows.size(); ++next)
+    {
+        const uint32_t* first = children(rows[next]);
+        rows.insert(rows.end(), first, first + childCount(rows[next]));
+    }
+}
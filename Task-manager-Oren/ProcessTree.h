@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ProcessTable.h"
+
+// Parent/child structure of one snapshot, over ProcessTable rows. Children are stored in
+// compressed sparse row form (one offsets array, one flat array of child rows), built in
+// linear time by counting children per parent. Subtree totals (memory, CPU, process count)
+// come from a single pass over the depth-first order in reverse, so every child is added
+// into its parent before the parent is added into its own.
+//
+// A process whose parent is not in the snapshot is a root. PID reuse can make a chain of
+// parent links loop back on itself; the first process of such a loop found is made a root.
+class ProcessTree
+{
+public:
+    static constexpr uint32_t NoRow = 0xFFFFFFFFu;
+
+    // Rebuilds everything for table
+    void build(const ProcessTable& table);
+
+    // Rows without a parent in the snapshot
+    const std::vector<uint32_t>& roots() const;
+
+    // Row of the parent, or NoRow for roots
+    uint32_t parent(uint32_t row) const;
+
+    // Children of a row: childCount(row) entries starting at children(row)
+    const uint32_t* children(uint32_t row) const;
+    uint32_t childCount(uint32_t row) const;
+
+    // Distance from the root of its tree (roots are 0)
+    uint32_t depth(uint32_t row) const;
+
+    // Totals over a row and everything below it
+    unsigned long long subtreeMemory(uint32_t row) const;
+    unsigned long long subtreeCpu(uint32_t row) const;     // Hundredths of a percent, as ProcessTable::cpu
+    uint32_t subtreeSize(uint32_t row) const;
+
+    // Row of a PID, or NoRow
+    uint32_t findRow(DWORD pid) const;
+
+    // Rows of the subtree under row (row included), parents before their children
+    void subtree(uint32_t row, std::vector<uint32_t>& rows) const;
+
+private:
+    // PID -> row: open addressing over slotRow (NoRow = empty), at most half full
+    size_t slotOf(DWORD pid) const;
+    std::vector<DWORD> pids;
+    std::vector<uint32_t> slotRow;
+    size_t slotMask = 0;
+
+    std::vector<uint32_t> parentRow;
+    std::vector<uint32_t> childOffsets;    // size() + 1 entries
+    std::vector<uint32_t> childRows;
+    std::vector<uint32_t> rootRows;
+    std::vector<uint32_t> preorder;        // Depth-first, parents first
+    std::vector<uint32_t> depths;
+    std::vector<unsigned long long> memoryTotals;
+    std::vector<unsigned long long> cpuTotals;
+    std::vector<uint32_t> sizeTotals;
+
+    // Reused during build
+    std::vector<uint8_t> marks;
+    std::vector<uint32_t> work;
+};
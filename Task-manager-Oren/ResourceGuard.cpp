@@ -0,0 +1,681 @@
+#include "ResourceGuard.h"
+#include "NamePool.h"
+#include "ProcessManager.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char* ResourceGuard::syntax()
+{
+    return
+        "Guard policies, one per line:\n"
+        "  NAME [memory SIZE] [cpu PERCENT] [for DURATION] [cooldown DURATION] [grace DURATION] [-> STEPS]\n"
+        "  e.g.  node memory 16GB -> renice, kill\n"
+        "  The caps apply to all processes of the name together; NAME ignores case and .exe\n"
+        "  and may use * and ? (each matching name is then capped on its own).\n"
+        "  STEPS (default renice, kill):\n"
+        "    renice  lower the priority of the whole group as soon as it goes over\n"
+        "    kill    terminate its largest instance once it has been over for DURATION (default 1s),\n"
+        "            at most one per cooldown (default 5s), giving it grace (default 1s) to exit\n"
+        "    cgroup  keep the group in a cgroup v2 group with the caps as its memory.max and\n"
+        "            cpu.max (Linux only)\n";
+}
+
+// Parses "NAME [memory SIZE] [cpu PERCENT] [for D] [cooldown D] [grace D] [-> STEPS]"
+static bool parsePolicy(const std::wstring& text, GuardPolicy& policy, std::string& error)
+{
+    policy = GuardPolicy();
+    std::wstring condition = text;
+    size_t arrow = condition.find(L"->");
+    if (arrow != std::wstring::npos)
+    {
+        std::wstring steps = condition.substr(arrow + 2);
+        condition.resize(arrow);
+        std::replace(steps.begin(), steps.end(), L',', L' ');
+        policy.renice = policy.kill = false;
+
+        std::wistringstream stream(steps);
+        for (std::wstring step; stream >> step;)
+        {
+            std::transform(step.begin(), step.end(), step.begin(), ::towlower);
+            if (step == L"renice")
+                policy.renice = true;
+            else if (step == L"kill")
+                policy.kill = true;
+            else if (step == L"cgroup")
+                policy.cgroup = true;
+            else
+            {
+                error = "unknown step '" + toNarrow(step) + "' (renice, kill or cgroup)";
+                return false;
+            }
+        }
+        if (!policy.renice && !policy.kill && !policy.cgroup)
+        {
+            error = "expected renice, kill or cgroup after ->";
+            return false;
+        }
+#ifdef _WIN32
+        if (policy.cgroup)
+        {
+            error = "cgroup limits need Linux";
+            return false;
+        }
+#endif
+    }
+
+    std::vector<std::wstring> words;
+    std::wistringstream stream(condition);
+    for (std::wstring word; stream >> word;)
+        words.push_back(word);
+    if (words.empty())
+    {
+        error = "expected a process name";
+        return false;
+    }
+
+    policy.name = words[0];
+    std::transform(policy.name.begin(), policy.name.end(), policy.name.begin(), ::towlower);
+    if (policy.name.find_first_of(L"*?") == std::wstring::npos)
+        policy.name = cleanProcessName(policy.name);
+
+    for (size_t next = 1; next < words.size(); next += 2)
+    {
+        std::wstring option = words[next];
+        std::transform(option.begin(), option.end(), option.begin(), ::towlower);
+        if (next + 1 >= words.size())
+        {
+            error = "expected a value after '" + toNarrow(option) + "'";
+            return false;
+        }
+        const std::wstring& value = words[next + 1];
+
+        if (option == L"memory" || option == L"mem")
+        {
+            double bytes = 0.0;
+            if (!parseMemorySize(value, bytes) || bytes < 1.0)
+            {
+                error = "expected a memory size such as 16GB instead of '" + toNarrow(value) + "'";
+                return false;
+            }
+            policy.memoryCap = static_cast<unsigned long long>(bytes + 0.5);
+        }
+        else if (option == L"cpu")
+        {
+            wchar_t* end = nullptr;
+            policy.cpuCap = std::wcstod(value.c_str(), &end);
+            if (end == value.c_str() || !(policy.cpuCap > 0.0) || std::isinf(policy.cpuCap) || (*end != L'\0' && std::wcscmp(end, L"%") != 0))
+            {
+                error = "expected a CPU percentage such as 400 instead of '" + toNarrow(value) + "'";
+                return false;
+            }
+        }
+        else if (option == L"for" || option == L"cooldown" || option == L"grace")
+        {
+            std::chrono::milliseconds& duration = option == L"for" ? policy.killAfter
+                : option == L"cooldown" ? policy.cooldown : policy.grace;
+            if (!parseDuration(value, duration))
+            {
+                error = "expected a duration such as 30s instead of '" + toNarrow(value) + "'";
+                return false;
+            }
+        }
+        else
+        {
+            error = "unknown option '" + toNarrow(option) + "' (memory, cpu, for, cooldown or grace)";
+            return false;
+        }
+    }
+
+    if (policy.memoryCap == 0 && policy.cpuCap == 0.0)
+    {
+        error = "a policy needs a memory or cpu cap";
+        return false;
+    }
+    return true;
+}
+
+ResourceGuard::ResourceGuard()
+{
+#ifdef _WIN32
+    ownPid = GetCurrentProcessId();
+#else
+    ownPid = static_cast<DWORD>(getpid());
+#endif
+}
+
+ResourceGuard::~ResourceGuard()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    if (jobThread.joinable())
+        jobThread.join();
+}
+
+bool ResourceGuard::addPolicy(const std::wstring& text, std::string& error)
+{
+    GuardPolicy policy;
+    if (!parsePolicy(text, policy, error))
+        return false;
+    policy.text = text;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    policyList.push_back(std::move(policy));
+    policyOfName.clear();    // Names are matched again; existing groups keep their state
+    placeAll = true;
+    return true;
+}
+
+bool ResourceGuard::loadPolicies(const std::string& path, std::string& error)
+{
+    std::ifstream file;
+    if (path != "-")
+    {
+        file.open(path);
+        if (!file)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+    }
+    std::istream& in = path == "-" ? std::cin : file;
+
+    std::vector<GuardPolicy> parsed;
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number)
+    {
+        std::wstring text = toWide(line);
+        size_t first = text.find_first_not_of(L" \t\r");
+        if (first == std::wstring::npos || text[first] == L'#')
+            continue;
+        text = text.substr(first, text.find_last_not_of(L" \t\r") + 1 - first);
+
+        GuardPolicy policy;
+        if (!parsePolicy(text, policy, error))
+        {
+            error = path + ":" + std::to_string(number) + ": " + error;
+            return false;
+        }
+        policy.text = text;
+        parsed.push_back(std::move(policy));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (GuardPolicy& policy : parsed)
+        policyList.push_back(std::move(policy));
+    policyOfName.clear();
+    placeAll = true;
+    return true;
+}
+
+std::vector<GuardPolicy> ResourceGuard::policies() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return policyList;
+}
+
+std::vector<GuardStatus> ResourceGuard::status() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<GuardStatus> result;
+    for (const auto& entry : groups)
+    {
+        const GroupState& state = entry.second;
+        result.push_back({ static_cast<size_t>(entry.first >> 32), processNames().display(static_cast<uint32_t>(entry.first)),
+            state.instances, state.memory, state.cpu, state.over, state.kills });
+    }
+    std::sort(result.begin(), result.end(), [](const GuardStatus& a, const GuardStatus& b)
+        {
+            return a.policy != b.policy ? a.policy < b.policy : a.name < b.name;
+        });
+    return result;
+}
+
+std::vector<std::wstring> ResourceGuard::recentLog(size_t count) const
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    size_t first = logLines.size() > count ? logLines.size() - count : 0;
+    return std::vector<std::wstring>(logLines.begin() + static_cast<std::ptrdiff_t>(first), logLines.end());
+}
+
+void ResourceGuard::setLogSink(std::function<void(const std::wstring& line)> sink)
+{
+    std::lock_guard<std::mutex> lock(logMutex);
+    logSink = std::move(sink);
+}
+
+void ResourceGuard::setActionsEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    actionsEnabled = enabled;
+}
+
+void ResourceGuard::setActionLimit(unsigned perMinute)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    actionLimit = perMinute;
+}
+
+void ResourceGuard::setCgroupRoot(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cgroupRoot = path;
+}
+
+unsigned long long ResourceGuard::actionCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return actions;
+}
+
+void ResourceGuard::update(const ProcessManager& manager, std::chrono::steady_clock::time_point at)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ++tick;
+    if (policyList.empty())
+        return;
+
+    const ProcessDelta& delta = manager.getLastDelta();
+    for (const ProcessInfo& proc : delta.removed)
+        reniced.erase(proc.pid);
+
+    // Cgroup groups take in new members as they appear (every process after a policy change)
+    bool anyCgroup = std::any_of(policyList.begin(), policyList.end(), [](const GuardPolicy& policy) { return policy.cgroup; });
+    if (anyCgroup)
+    {
+        std::unordered_map<uint64_t, size_t> moved;
+        auto place = [&](const ProcessInfo& proc)
+            {
+                uint32_t policy = policyFor(proc.nameId);
+                if (policy == NoPolicy || !policyList[policy].cgroup || proc.pid == ownPid)
+                    return;
+                uint32_t foldedId = processNames().foldedId(proc.nameId);
+                if (placeInCgroup(policy, foldedId, groups[keyOf(policy, foldedId)], proc.pid))
+                    ++moved[keyOf(policy, foldedId)];
+            };
+        if (placeAll)
+        {
+            for (const ProcessInfo& proc : manager.getProcessList())
+                place(proc);
+        }
+        else
+        {
+            for (DWORD pid : delta.added)
+            {
+                const ProcessInfo* proc = manager.findProcess(pid);
+                if (proc)
+                    place(*proc);
+            }
+        }
+        for (const auto& entry : moved)
+        {
+            log(std::wstring(actionsEnabled ? L"moved " : L"(dry run) would move ") + std::to_wstring(entry.second)
+                + L" process(es) of " + processNames().display(static_cast<uint32_t>(entry.first)) + L" into its cgroup");
+        }
+    }
+    placeAll = false;
+
+    // One pass over the table for every group's totals; instances we cannot read add nothing
+    grouper.group(manager.getProcessTable(), processNames(), GroupBy::FoldedName, { Metric::Memory, Metric::Cpu });
+    for (uint32_t group = 0; group < grouper.groupCount(); ++group)
+    {
+        uint32_t foldedId = static_cast<uint32_t>(grouper.key(group));
+        uint32_t policy = policyFor(foldedId);
+        if (policy == NoPolicy)
+            continue;
+
+        GroupState& state = groups[keyOf(policy, foldedId)];
+        state.instances = grouper.count(group);
+        state.memory = static_cast<unsigned long long>(grouper.stats(group, 0).sum);
+        state.cpu = static_cast<double>(grouper.stats(group, 1).sum) / 100.0;
+        state.seenTick = tick;
+        enforce(policy, foldedId, state, manager, at);
+    }
+
+    // Groups whose last instance is gone are under their caps by definition
+    for (auto& entry : groups)
+    {
+        GroupState& state = entry.second;
+        if (state.seenTick == tick)
+            continue;
+        state.instances = 0;
+        state.memory = 0;
+        state.cpu = 0.0;
+        enforce(static_cast<uint32_t>(entry.first >> 32), static_cast<uint32_t>(entry.first), state, manager, at);
+    }
+}
+
+uint32_t ResourceGuard::policyFor(uint32_t nameId)
+{
+    if (nameId >= policyOfName.size())
+        policyOfName.resize(std::max<size_t>(nameId + 1, processNames().size()), Unresolved);
+
+    uint32_t& policy = policyOfName[nameId];
+    if (policy == Unresolved)
+    {
+        // The first policy that names it wins
+        const std::wstring& name = processNames().lower(nameId);
+        policy = NoPolicy;
+        for (uint32_t i = 0; i < policyList.size(); ++i)
+        {
+            if (globMatch(policyList[i].name, name))
+            {
+                policy = i;
+                break;
+            }
+        }
+    }
+    return policy;
+}
+
+// Memory, CPU and instance count of a group, for the log
+static std::wstring describeUsage(unsigned long long memory, double cpu, uint32_t instances)
+{
+    return formatMemory(static_cast<size_t>(memory)) + L", " + formatCpu(std::llround(cpu * 100.0))
+        + L" in " + std::to_wstring(instances) + L" process(es)";
+}
+
+void ResourceGuard::enforce(uint32_t policy, uint32_t foldedId, GroupState& state, const ProcessManager& manager,
+    std::chrono::steady_clock::time_point now)
+{
+    const GuardPolicy& definition = policyList[policy];
+    const std::wstring& name = processNames().display(foldedId);
+    bool memoryOver = definition.memoryCap > 0 && state.memory > definition.memoryCap;
+    bool cpuOver = definition.cpuCap > 0.0 && state.cpu > definition.cpuCap;
+
+    if (!memoryOver && !cpuOver)
+    {
+        if (state.over)
+        {
+            state.over = false;
+            log(name + L" is back under its caps: " + describeUsage(state.memory, state.cpu, state.instances));
+        }
+        return;
+    }
+    if (!state.over)
+    {
+        state.over = true;
+        state.overSince = now;
+        log(name + L" is over its caps (" + describeCaps(definition) + L"): "
+            + describeUsage(state.memory, state.cpu, state.instances));
+    }
+
+    if (definition.renice)
+        reniceGroup(foldedId, manager, now);
+
+    if (!definition.kill || state.killPending || now - state.overSince < definition.killAfter
+        || (state.lastKill != std::chrono::steady_clock::time_point() && now - state.lastKill < definition.cooldown))
+        return;
+
+    // The largest instance by whatever is over: memory first, it is what runs a host out
+    const std::vector<uint32_t>& group = membersOf(foldedId, manager);
+    const ProcessTable& table = manager.getProcessTable();
+    auto largest = std::max_element(group.begin(), group.end(), [&](uint32_t a, uint32_t b)
+        {
+            return memoryOver ? table.memory[a] < table.memory[b] : table.cpu[a] < table.cpu[b];
+        });
+    if (largest == group.end() || !allowAction(now))
+        return;
+
+    DWORD pid = table.pid[*largest];
+    const ProcessInfo* proc = manager.findProcess(pid);
+    std::wstring what = name + L" (PID " + std::to_wstring(pid) + L", "
+        + (memoryOver ? formatMemory(static_cast<size_t>(table.memory[*largest])) : formatCpu(table.cpu[*largest])) + L")";
+    state.lastKill = now;
+    if (!actionsEnabled)
+    {
+        log(L"(dry run) would terminate " + what);
+        return;
+    }
+    log(L"terminating " + what);
+    state.killPending = true;
+    queue({ keyOf(policy, foldedId), pid, proc ? proc->startTime : 0, what, definition.grace });
+}
+
+const std::vector<uint32_t>& ResourceGuard::membersOf(uint32_t foldedId, const ProcessManager& manager)
+{
+    if (membersTick != tick)
+    {
+        for (uint32_t name : filledNames)
+            members[name].clear();
+        filledNames.clear();
+
+        const ProcessTable& table = manager.getProcessTable();
+        const NamePool& names = processNames();
+        for (uint32_t row = 0; row < table.size(); ++row)
+        {
+            if (!table.accessible(row) || table.pid[row] == ownPid || policyFor(table.nameId[row]) == NoPolicy)
+                continue;
+            uint32_t name = names.foldedId(table.nameId[row]);
+            if (name >= members.size())
+                members.resize(name + 1);
+            if (members[name].empty())
+                filledNames.push_back(name);
+            members[name].push_back(row);
+        }
+        membersTick = tick;
+    }
+
+    static const std::vector<uint32_t> none;
+    return foldedId < members.size() ? members[foldedId] : none;
+}
+
+void ResourceGuard::reniceGroup(uint32_t foldedId, const ProcessManager& manager, std::chrono::steady_clock::time_point now)
+{
+    const ProcessTable& table = manager.getProcessTable();
+    rows.clear();
+    for (uint32_t row : membersOf(foldedId, manager))
+    {
+        if (reniced.count(table.pid[row]) == 0)
+            rows.push_back(row);
+    }
+    if (rows.empty() || !allowAction(now))
+        return;
+
+    // A whole group is one action: the point is to do it at once
+    size_t lowered = 0;
+    unsigned long firstError = 0;
+    for (uint32_t row : rows)
+    {
+        unsigned long error = 0;
+        reniced.insert(table.pid[row]);    // Tried once; a failure is not retried every tick
+        if (!actionsEnabled || ProcessManager::lowerPriority(table.pid[row], error))
+            ++lowered;
+        else if (firstError == 0)
+            firstError = error;
+    }
+
+    std::wstring line = std::wstring(actionsEnabled ? L"lowered" : L"(dry run) would lower") + L" the priority of "
+        + std::to_wstring(lowered) + L" process(es) of " + processNames().display(foldedId);
+    if (lowered < rows.size())
+        line += L"; " + std::to_wstring(rows.size() - lowered) + L" could not be changed (error " + std::to_wstring(firstError) + L")";
+    log(line);
+}
+
+bool ResourceGuard::placeInCgroup(uint32_t policy, uint32_t foldedId, GroupState& state, DWORD pid)
+{
+#ifdef _WIN32
+    (void)policy;
+    (void)foldedId;
+    (void)state;
+    (void)pid;
+    return false;
+#else
+    if (state.cgroupFailed)
+        return false;
+    if (!actionsEnabled)
+        return true;
+
+    // Names come from the processes themselves; one that could leave the root is never a path
+    std::string name = toNarrow(processNames().lower(foldedId));
+    if (name.empty() || name == "." || name == ".." || name.find_first_of(std::string("/\0", 2)) != std::string::npos)
+    {
+        log(L"not limiting " + processNames().display(foldedId) + L" through a cgroup: its name cannot be a directory name");
+        state.cgroupFailed = true;
+        return false;
+    }
+
+    const GuardPolicy& definition = policyList[policy];
+    std::string directory = cgroupRoot + "/" + name;
+
+    // 0 or the errno of the step that failed (close can overwrite a write's errno)
+    auto writeFile = [](const std::string& path, const std::string& text)
+        {
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                return errno;
+            int error = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()) ? 0 : errno;
+            if (close(fd) != 0 && error == 0)
+                error = errno;
+            return error;
+        };
+
+    if (!state.cgroupReady)
+    {
+        // The controllers have to be enabled in the parent for the limit files to exist
+        std::string memoryMax = definition.memoryCap ? std::to_string(definition.memoryCap) : "max";
+        std::string cpuMax = definition.cpuCap > 0.0
+            ? std::to_string(static_cast<long long>(definition.cpuCap * 1000.0 + 0.5)) + " 100000" : "max 100000";
+        int error = mkdir(cgroupRoot.c_str(), 0755) == 0 || errno == EEXIST ? 0 : errno;
+        if (error == 0)
+            error = mkdir(directory.c_str(), 0755) == 0 || errno == EEXIST ? 0 : errno;
+        if (error == 0)
+        {
+            writeFile(cgroupRoot + "/cgroup.subtree_control", "+memory +cpu");    // Best effort: it may be on already
+            error = writeFile(directory + "/memory.max", memoryMax);
+        }
+        if (error == 0)
+            error = writeFile(directory + "/cpu.max", cpuMax);
+        if (error != 0)
+        {
+            log(L"cannot set up the cgroup " + toWide(directory) + L": " + toWide(std::strerror(error)));
+            state.cgroupFailed = true;
+            return false;
+        }
+        log(L"limiting " + processNames().display(foldedId) + L" through the cgroup " + toWide(directory)
+            + L" (memory.max " + toWide(memoryMax) + L", cpu.max " + toWide(cpuMax) + L")");
+        state.cgroupReady = true;
+    }
+
+    // A process that exited in the meantime is not an error worth reporting
+    int error = writeFile(directory + "/cgroup.procs", std::to_string(pid));
+    if (error == 0)
+        return true;
+    if (error != ESRCH && error != ENOENT)
+    {
+        log(L"cannot move PID " + std::to_wstring(pid) + L" into " + toWide(directory) + L": " + toWide(std::strerror(error)));
+        state.cgroupFailed = true;
+    }
+    return false;
+#endif
+}
+
+bool ResourceGuard::allowAction(std::chrono::steady_clock::time_point now)
+{
+    while (!recentActions.empty() && now - recentActions.front() >= std::chrono::minutes(1))
+        recentActions.pop_front();
+    if (recentActions.size() >= actionLimit)
+    {
+        if (limitLogged == std::chrono::steady_clock::time_point() || now - limitLogged >= std::chrono::minutes(1))
+        {
+            log(L"rate limit of " + std::to_wstring(actionLimit) + L" actions a minute reached; holding back");
+            limitLogged = now;
+        }
+        return false;
+    }
+    recentActions.push_back(now);
+    ++actions;
+    return true;
+}
+
+void ResourceGuard::log(const std::wstring& line)
+{
+    wchar_t stamp[16] = L"";
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    std::wcsftime(stamp, 16, L"%H:%M:%S ", &local);
+
+    std::lock_guard<std::mutex> lock(logMutex);
+    logLines.push_back(stamp + line);
+    if (logLines.size() > LogLines)
+        logLines.pop_front();
+    if (logSink)
+        logSink(logLines.back());
+}
+
+void ResourceGuard::queue(Job job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobs.push_back(std::move(job));
+        if (!jobThread.joinable())
+            jobThread = std::thread(&ResourceGuard::runJobs, this);
+    }
+    jobReady.notify_one();
+}
+
+void ResourceGuard::runJobs()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        TerminationOptions options;
+        options.grace = job.grace;
+        TerminationResult result = ProcessManager::endProcesses({ job.pid }, { job.startTime }, options).front();
+        bool ended = result.outcome == TerminationOutcome::Exited || result.outcome == TerminationOutcome::Killed
+            || result.outcome == TerminationOutcome::AlreadyGone;
+        log(std::wstring(ProcessTerminator::outcomeName(result.outcome)) + L": " + job.label);
+
+        // The cooldown runs from when the process is gone, not from when it was asked to go
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = groups.find(job.group);
+        if (found != groups.end())
+        {
+            found->second.killPending = false;
+            found->second.lastKill = std::chrono::steady_clock::now();
+            if (ended)
+                ++found->second.kills;
+        }
+    }
+}
+
+std::wstring ResourceGuard::describeCaps(const GuardPolicy& policy)
+{
+    std::wstring caps;
+    if (policy.memoryCap > 0)
+        caps = formatMemory(static_cast<size_t>(policy.memoryCap));
+    if (policy.cpuCap > 0.0)
+        caps += (caps.empty() ? L"" : L", ") + formatCpu(std::llround(policy.cpuCap * 100.0));
+    return caps;
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "GroupingEngine.h"
+#include "ProcessInfo.h"
+
+class ProcessManager;
+
+// Caps on the processes of one name taken together, and how they are enforced
+struct GuardPolicy
+{
+    std::wstring name;                               // Lowercase, without ".exe"; may hold * and ? (each matching name is capped on its own)
+    unsigned long long memoryCap = 0;                // Bytes over the whole group, 0 = no cap
+    double cpuCap = 0.0;                             // Percent of one core over the whole group, 0 = no cap
+    bool renice = true;                              // Lower the group's priority as soon as it goes over
+    bool kill = true;                                // Then terminate its largest instance
+    bool cgroup = false;                             // Put the group in a cgroup with the caps as kernel limits (Linux)
+    std::chrono::milliseconds killAfter{ 1000 };     // How long the group stays over before a kill
+    std::chrono::milliseconds cooldown{ 5000 };      // Least time between two kills in the group
+    std::chrono::milliseconds grace{ 1000 };         // What a killed instance gets to exit on its own
+    std::wstring text;                               // The policy as written
+};
+
+// Where one capped group stands
+struct GuardStatus
+{
+    size_t policy;
+    std::wstring name;
+    uint32_t instances;
+    unsigned long long memory;
+    double cpu;
+    bool over;
+    unsigned long long kills;    // Instances terminated so far
+};
+
+// Enforces group caps from the sampler's ticks: a decision is made right after each refresh,
+// so the reaction time is one sampling interval. Groups over a cap are first lowered in
+// priority, then, if they stay over, lose their largest instance (by the capped resource),
+// at most one per cooldown. Kills run on their own thread so the grace period never delays
+// a tick; all actions count against one rate limit and every decision is logged.
+class ResourceGuard
+{
+public:
+    ResourceGuard();
+    ~ResourceGuard();
+
+    ResourceGuard(const ResourceGuard&) = delete;
+    ResourceGuard& operator=(const ResourceGuard&) = delete;
+
+    // Describes the policy syntax
+    static const char* syntax();
+
+    // Parses one policy and adds it; false with a message in error if it does not parse
+    bool addPolicy(const std::wstring& text, std::string& error);
+
+    // Reads one policy per line; blank lines and # comments are skipped. Nothing is added
+    // unless every line parses ("-" = standard input).
+    bool loadPolicies(const std::string& path, std::string& error);
+
+    std::vector<GuardPolicy> policies() const;
+
+    // The groups the policies cover as of the last tick, by policy then name
+    std::vector<GuardStatus> status() const;
+
+    // The most recent log lines, oldest first
+    std::vector<std::wstring> recentLog(size_t count) const;
+
+    // Also hands every log line to sink (null = only the in-memory log). It is called with
+    // the log lock held, from the sampler's thread or the kill thread.
+    void setLogSink(std::function<void(const std::wstring& line)> sink);
+
+    // Decisions are only logged while disabled (a dry run)
+    void setActionsEnabled(bool enabled);
+
+    // Most renices and kills in any one minute, over all policies (cgroup moves are not limited:
+    // they only hand the limits to the kernel)
+    void setActionLimit(unsigned perMinute);
+
+    // Directory the cgroups are made in (Linux; a cgroup v2 directory we may write to, or any
+    // directory to see what would be written)
+    void setCgroupRoot(const std::string& path);
+
+    // Enforces the policies against the manager's last refresh. at is when it ran.
+    void update(const ProcessManager& manager, std::chrono::steady_clock::time_point at);
+
+    // Actions taken so far (or that would have been, in a dry run)
+    unsigned long long actionCount() const;
+
+private:
+    // Log lines kept in memory
+    static constexpr size_t LogLines = 200;
+
+    // Sentinel for a name not matched against the policies yet, and for no policy
+    static constexpr uint32_t Unresolved = 0xFFFFFFFFu;
+    static constexpr uint32_t NoPolicy = 0xFFFFFFFEu;
+
+    // One (policy, name) group
+    struct GroupState
+    {
+        uint32_t instances = 0;
+        unsigned long long memory = 0;
+        double cpu = 0.0;
+        unsigned long long seenTick = 0;
+        bool over = false;
+        std::chrono::steady_clock::time_point overSince;
+        std::chrono::steady_clock::time_point lastKill;
+        bool killPending = false;           // A kill is queued or running
+        bool cgroupReady = false;           // Its cgroup exists with the limits written
+        bool cgroupFailed = false;          // Making it failed (logged once)
+        unsigned long long kills = 0;
+    };
+
+    // A kill waiting for the kill thread
+    struct Job
+    {
+        uint64_t group;
+        DWORD pid;
+        unsigned long long startTime;    // When pid started, so a recycled PID is not signalled
+        std::wstring label;
+        std::chrono::milliseconds grace;
+    };
+
+    // Policy index for a name ID (NoPolicy if none covers it), looked up on first use
+    uint32_t policyFor(uint32_t nameId);
+
+    // Acts on one group over or under its caps
+    void enforce(uint32_t policy, uint32_t foldedId, GroupState& state, const ProcessManager& manager,
+        std::chrono::steady_clock::time_point now);
+
+    // Table rows of the group's processes in the manager, except our own. The first call in a
+    // tick sorts every guarded process into its group in one pass over the table.
+    const std::vector<uint32_t>& membersOf(uint32_t foldedId, const ProcessManager& manager);
+
+    // Lowers the priority of the group's members that have not been lowered yet
+    void reniceGroup(uint32_t foldedId, const ProcessManager& manager, std::chrono::steady_clock::time_point now);
+
+    // Moves a process into its group's cgroup, making the cgroup first if needed (Linux).
+    // False if it could not be moved.
+    bool placeInCgroup(uint32_t policy, uint32_t foldedId, GroupState& state, DWORD pid);
+
+    // Takes one action from the rate limit; false (logged once per minute) when it is used up
+    bool allowAction(std::chrono::steady_clock::time_point now);
+
+    // Writes one timestamped line to the log
+    void log(const std::wstring& line);
+
+    // Hands a kill to the kill thread (started on first use)
+    void queue(Job job);
+
+    // Body of the kill thread
+    void runJobs();
+
+    // Caps of a policy as text, e.g. "16.00 GB, 400.00%"
+    static std::wstring describeCaps(const GuardPolicy& policy);
+
+    static uint64_t keyOf(uint32_t policy, uint32_t foldedId) { return (static_cast<uint64_t>(policy) << 32) | foldedId; }
+
+    mutable std::mutex mutex;
+    std::vector<GuardPolicy> policyList;
+    std::vector<uint32_t> policyOfName;                 // Name ID -> policy, Unresolved until looked up
+    std::unordered_map<uint64_t, GroupState> groups;    // By (policy, folded name ID)
+    std::unordered_set<DWORD> reniced;                  // Lowered already (dropped when they exit)
+    GroupingEngine grouper;
+    std::vector<std::vector<uint32_t>> members;         // Folded name ID -> table rows, as of membersTick
+    std::vector<uint32_t> filledNames;                  // The names with rows in members
+    unsigned long long membersTick = 0;
+    std::vector<uint32_t> rows;                         // Reused by reniceGroup
+    unsigned long long tick = 0;
+    bool actionsEnabled = true;
+    unsigned actionLimit = 60;
+    std::deque<std::chrono::steady_clock::time_point> recentActions;
+    std::chrono::steady_clock::time_point limitLogged;
+    unsigned long long actions = 0;
+    std::string cgroupRoot = "/sys/fs/cgroup/task-manager";
+    bool placeAll = true;                               // Policies changed: check every process for a cgroup
+    DWORD ownPid;
+
+    // Log, guarded by its own lock so the kill thread can add to it during an update
+    mutable std::mutex logMutex;
+    std::deque<std::wstring> logLines;
+    std::function<void(const std::wstring&)> logSink;
+
+    // Kill thread and its queue
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::deque<Job> jobs;
+    std::thread jobThread;
+    bool stopping = false;
+};
@@ -0,0 +1,300 @@
+#include "SnapshotRecorder.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace recording;
+
+static const uint32_t NoName = 0xFFFFFFFFu;
+
+void appendVarint(std::string& out, unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void appendZigzag(std::string& out, long long value)
+{
+    appendVarint(out, (static_cast<unsigned long long>(value) << 1) ^ static_cast<unsigned long long>(value >> 63));
+}
+
+static void appendFixed(std::string& out, unsigned long long value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+static void appendFullEntry(std::string& out, unsigned long long pidGap, DWORD parentPid, uint32_t nameId,
+    unsigned long long memory, unsigned long long cpuTime, unsigned long long startTime, uint8_t flags)
+{
+    appendVarint(out, pidGap);
+    appendVarint(out, parentPid);
+    appendVarint(out, nameId);
+    appendVarint(out, memory);
+    appendVarint(out, cpuTime);
+    appendVarint(out, startTime);
+    out.push_back(static_cast<char>(flags));
+}
+
+SnapshotRecorder::~SnapshotRecorder()
+{
+    close();
+}
+
+bool SnapshotRecorder::open(const std::string& path, uint16_t interval)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    keyframeInterval = interval > 0 ? interval : 1;
+    offset = 0;
+    frames = 0;
+    lastUnixMs = 0;
+    previous.clear();
+    fileNameIds.clear();
+    names.clear();
+    keyframes.clear();
+
+    long long createdMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    frame.clear();
+    frame.append(FileMagic, 4);
+    appendFixed(frame, Version, 2);
+    appendFixed(frame, keyframeInterval, 2);
+    appendFixed(frame, static_cast<unsigned long long>(createdMs), 8);
+    if (!writeFrame())
+    {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotRecorder::isOpen() const
+{
+    return file != nullptr;
+}
+
+unsigned long long SnapshotRecorder::frameCount() const
+{
+    return frames;
+}
+
+unsigned long long SnapshotRecorder::bytesWritten() const
+{
+    return offset;
+}
+
+uint32_t SnapshotRecorder::fileNameId(const ProcessInfo& proc)
+{
+    if (proc.nameId >= fileNameIds.size())
+        fileNameIds.resize(proc.nameId + 1, NoName);
+
+    uint32_t& id = fileNameIds[proc.nameId];
+    if (id == NoName)
+    {
+        // First use: the Name record goes into this frame ahead of the frame record
+        id = static_cast<uint32_t>(names.size());
+        names.push_back(toNarrow(proc.name));
+
+        payload.clear();
+        appendVarint(payload, id);
+        appendVarint(payload, names.back().size());
+        payload.append(names.back());
+        finishRecord(Name);
+    }
+    return id;
+}
+
+void SnapshotRecorder::finishRecord(uint8_t type)
+{
+    frame.push_back(static_cast<char>(type));
+    appendVarint(frame, payload.size());
+    frame.append(payload);
+}
+
+void SnapshotRecorder::encodeKeyframe(long long unixMs)
+{
+    payload.clear();
+    appendVarint(payload, static_cast<unsigned long long>(unixMs));
+    appendVarint(payload, current.size());
+
+    DWORD lastPid = 0;
+    for (const Entry& entry : current)
+    {
+        appendFullEntry(payload, entry.pid - lastPid, entry.parentPid, entry.nameId,
+            entry.memory, entry.cpuTime, entry.startTime, entry.flags);
+        lastPid = entry.pid;
+    }
+}
+
+void SnapshotRecorder::encodeDelta(long long unixMs)
+{
+    // Walk both PID-ordered frames once; a recycled PID (new start time) counts as
+    // removed and added. The three lists are built side by side and joined at the end.
+    std::string& removed = removedList;
+    std::string& added = addedList;
+    std::string& changed = changedList;
+    removed.clear();
+    added.clear();
+    changed.clear();
+    size_t removedCount = 0, addedCount = 0, changedCount = 0;
+    DWORD lastRemoved = 0, lastAdded = 0, lastChanged = 0;
+
+    size_t i = 0, j = 0;
+    while (i < previous.size() || j < current.size())
+    {
+        const Entry* before = i < previous.size() ? &previous[i] : nullptr;
+        const Entry* after = j < current.size() ? &current[j] : nullptr;
+        bool recycled = before && after && before->pid == after->pid && before->startTime != after->startTime;
+
+        if (before && (!after || before->pid < after->pid || recycled))
+        {
+            appendVarint(removed, before->pid - lastRemoved);
+            lastRemoved = before->pid;
+            ++removedCount;
+            ++i;
+            if (!recycled)
+                continue;
+        }
+
+        if (after && (!before || after->pid < before->pid || recycled))
+        {
+            appendFullEntry(added, after->pid - lastAdded, after->parentPid, after->nameId,
+                after->memory, after->cpuTime, after->startTime, after->flags);
+            lastAdded = after->pid;
+            ++addedCount;
+            ++j;
+            continue;
+        }
+
+        // Same process in both frames: store only what moved
+        uint8_t mask = 0;
+        if (after->memory != before->memory) mask |= ChangedMemory;
+        if (after->cpuTime != before->cpuTime) mask |= ChangedCpu;
+        if (after->flags != before->flags) mask |= ChangedFlags;
+        if (after->parentPid != before->parentPid) mask |= ChangedParent;
+        if (mask)
+        {
+            appendVarint(changed, after->pid - lastChanged);
+            lastChanged = after->pid;
+            changed.push_back(static_cast<char>(mask));
+            if (mask & ChangedMemory)
+                appendZigzag(changed, static_cast<long long>(after->memory - before->memory));
+            if (mask & ChangedCpu)
+                appendZigzag(changed, static_cast<long long>(after->cpuTime - before->cpuTime));
+            if (mask & ChangedFlags)
+                changed.push_back(static_cast<char>(after->flags));
+            if (mask & ChangedParent)
+                appendVarint(changed, after->parentPid);
+            ++changedCount;
+        }
+        ++i;
+        ++j;
+    }
+
+    payload.clear();
+    appendZigzag(payload, unixMs - lastUnixMs);
+    appendVarint(payload, removedCount);
+    payload.append(removed);
+    appendVarint(payload, addedCount);
+    payload.append(added);
+    appendVarint(payload, changedCount);
+    payload.append(changed);
+}
+
+bool SnapshotRecorder::append(const std::vector<ProcessInfo>& processes, long long unixMs)
+{
+    if (!file)
+        return false;
+
+    frame.clear();
+    current.clear();
+    current.reserve(processes.size());
+    for (const ProcessInfo& proc : processes)
+    {
+        Entry entry;
+        entry.pid = proc.pid;
+        entry.parentPid = proc.parentPid;
+        entry.nameId = fileNameId(proc);
+        entry.memory = proc.isAccessible ? proc.memoryUsage : 0;
+        entry.cpuTime = proc.cpuTime;
+        entry.startTime = proc.startTime;
+        entry.flags = proc.isAccessible ? 1 : 0;
+        current.push_back(entry);
+    }
+    std::sort(current.begin(), current.end(), [](const Entry& a, const Entry& b) { return a.pid < b.pid; });
+
+    bool keyframe = frames % keyframeInterval == 0;
+    if (keyframe)
+    {
+        encodeKeyframe(unixMs);
+        keyframes.push_back({ unixMs, frames, offset + frame.size() });
+    }
+    else
+    {
+        encodeDelta(unixMs);
+    }
+    finishRecord(keyframe ? Keyframe : Delta);
+
+    if (!writeFrame())
+        return false;
+
+    previous.swap(current);
+    lastUnixMs = unixMs;
+    ++frames;
+    return true;
+}
+
+bool SnapshotRecorder::writeFrame()
+{
+    if (std::fwrite(frame.data(), 1, frame.size(), file) != frame.size() || std::fflush(file) != 0)
+        return false;
+    offset += frame.size();
+    return true;
+}
+
+bool SnapshotRecorder::close()
+{
+    if (!file)
+        return true;
+
+    payload.clear();
+    appendVarint(payload, frames);
+    appendVarint(payload, static_cast<unsigned long long>(lastUnixMs));
+    appendVarint(payload, names.size());
+    for (const std::string& name : names)
+    {
+        appendVarint(payload, name.size());
+        payload.append(name);
+    }
+    appendVarint(payload, keyframes.size());
+    for (const KeyframeMark& mark : keyframes)
+    {
+        appendVarint(payload, static_cast<unsigned long long>(mark.unixMs));
+        appendVarint(payload, mark.frame);
+        appendVarint(payload, mark.offset);
+    }
+
+    unsigned long long indexOffset = offset;
+    frame.clear();
+    finishRecord(Index);
+    frame.append(FooterMagic, 4);
+    appendFixed(frame, 0, 4);
+    appendFixed(frame, indexOffset, 8);
+
+    bool ok = writeFrame();
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
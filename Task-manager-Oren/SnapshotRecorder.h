@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ProcessInfo.h"
+
+// Recording file layout. Integers are LEB128 varints unless noted, signed ones zigzag-encoded.
+//
+//   header (16 bytes): char magic[4] = "TMRC", uint16 version = 1, uint16 keyframe interval,
+//                      int64 creation time in unix ms (both fixed-width little-endian)
+//   records:           uint8 type, varint payload length, payload
+//     Name      id, byte length, UTF-8 bytes. Appears before the first frame that uses it.
+//     Keyframe  unix ms, count, then count full entries ordered by PID
+//     Delta     signed ms since the previous frame, then three PID-ordered lists against
+//               the previous frame: removed PIDs, added full entries, changed entries
+//     Index     frame count, last unix ms, every name (length + bytes, in id order),
+//               then each keyframe as unix ms, frame number, file offset
+//   footer (16 bytes, only after a clean close): char magic[4] = "TMIX", uint32 0,
+//                      uint64 offset of the Index record (fixed-width little-endian)
+//
+//   full entry:    PID gap from the previous entry, parent PID, name id, memory, CPU time (ns),
+//                  start time, uint8 flags (1 = accessible)
+//   changed entry: PID gap, uint8 mask, then the fields the mask names: ChangedMemory (signed
+//                  byte change), ChangedCpu (signed ns change), ChangedFlags (uint8), ChangedParent
+//
+// A recording cut short by a crash has no footer; the reader then finds the frames by
+// walking the records, which the length prefixes make cheap.
+namespace recording
+{
+    enum RecordType : uint8_t { Name = 1, Keyframe = 2, Delta = 3, Index = 4 };
+    enum ChangeMask : uint8_t { ChangedMemory = 1, ChangedCpu = 2, ChangedFlags = 4, ChangedParent = 8 };
+
+    static const char FileMagic[4] = { 'T', 'M', 'R', 'C' };
+    static const char FooterMagic[4] = { 'T', 'M', 'I', 'X' };
+    static const uint16_t Version = 1;
+    static const size_t HeaderSize = 16;
+    static const size_t FooterSize = 16;
+}
+
+// Appends process snapshots to a recording file. Each frame is stored against the previous
+// one, so a quiet host costs a few bytes per changed process; every keyframeInterval frames
+// a full keyframe is written so a reader can start there instead of at the beginning.
+class SnapshotRecorder
+{
+public:
+    static constexpr uint16_t DefaultKeyframeInterval = 60;
+
+    SnapshotRecorder() = default;
+    SnapshotRecorder(const SnapshotRecorder&) = delete;
+    SnapshotRecorder& operator=(const SnapshotRecorder&) = delete;
+
+    // Closes the file cleanly if still open
+    ~SnapshotRecorder();
+
+    // Creates (or truncates) the file and writes the header
+    bool open(const std::string& path, uint16_t keyframeInterval = DefaultKeyframeInterval);
+
+    // Appends one snapshot taken at unixMs. The file is flushed after every frame so a
+    // crash loses at most the frame being written. False on a write error.
+    bool append(const std::vector<ProcessInfo>& processes, long long unixMs);
+
+    // Writes the index and footer and closes the file
+    bool close();
+
+    bool isOpen() const;
+
+    // Frames and bytes written so far
+    unsigned long long frameCount() const;
+    unsigned long long bytesWritten() const;
+
+private:
+    // What one process looked like in the previous frame
+    struct Entry
+    {
+        DWORD pid;
+        DWORD parentPid;
+        uint32_t nameId;                // Id in this file's name table
+        unsigned long long memory;
+        unsigned long long cpuTime;
+        unsigned long long startTime;
+        uint8_t flags;
+    };
+
+    // File name id for a NamePool id, adding a Name record to frame if it is new
+    uint32_t fileNameId(const ProcessInfo& proc);
+
+    void encodeKeyframe(long long unixMs);
+    void encodeDelta(long long unixMs);
+
+    // Moves payload into frame as one record of the given type
+    void finishRecord(uint8_t type);
+
+    bool writeFrame();
+
+    std::FILE* file = nullptr;
+    uint16_t keyframeInterval = DefaultKeyframeInterval;
+    unsigned long long offset = 0;              // Bytes written so far
+    unsigned long long frames = 0;
+    long long lastUnixMs = 0;
+
+    std::vector<Entry> previous;                // Last frame, by PID
+    std::vector<Entry> current;                 // Frame being written, by PID
+
+    std::vector<uint32_t> fileNameIds;          // By NamePool id, NoName until first used
+    std::vector<std::string> names;             // By file name id, UTF-8
+
+    // (unix ms, frame number, offset) of every keyframe, for the index
+    struct KeyframeMark
+    {
+        long long unixMs;
+        unsigned long long frame;
+        unsigned long long offset;
+    };
+    std::vector<KeyframeMark> keyframes;
+
+    std::string payload;                        // Record being built
+    std::string frame;                          // Everything this append writes
+    std::string removedList, addedList, changedList;    // Parts of a Delta record
+};
+
+// LEB128 varint writers, the plain and the zigzag (signed) form
+void appendVarint(std::string& out, unsigned long long value);
+void appendZigzag(std::string& out, long long value);
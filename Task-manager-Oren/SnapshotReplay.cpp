@@ -0,0 +1,700 @@
+#include "SnapshotReplay.h"
+#include "NamePool.h"
+#include "SnapshotRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace recording;
+
+// Bounds-checked decoding of a byte range; any overrun clears ok and yields zeros
+struct ByteReader
+{
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    ByteReader(const uint8_t* begin, size_t length) : p(begin), end(begin + length) {}
+
+    uint8_t byte()
+    {
+        if (p >= end)
+        {
+            ok = false;
+            return 0;
+        }
+        return *p++;
+    }
+
+    unsigned long long varint()
+    {
+        unsigned long long value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t b = byte();
+            value |= static_cast<unsigned long long>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    long long zigzag()
+    {
+        unsigned long long value = varint();
+        return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+    }
+
+    unsigned long long fixed(int bytes)
+    {
+        unsigned long long value = 0;
+        for (int i = 0; i < bytes; ++i)
+            value |= static_cast<unsigned long long>(byte()) << (8 * i);
+        return value;
+    }
+
+    // Next length bytes, or null if they run past the end
+    const uint8_t* take(size_t length)
+    {
+        if (static_cast<size_t>(end - p) < length)
+        {
+            ok = false;
+            return nullptr;
+        }
+        const uint8_t* start = p;
+        p += length;
+        return start;
+    }
+};
+
+// Raw fields of a full entry
+struct RawEntry
+{
+    DWORD pid;
+    DWORD parentPid;
+    unsigned long long nameId;
+    unsigned long long memory;
+    unsigned long long cpuTime;
+    unsigned long long startTime;
+    uint8_t flags;
+};
+
+static RawEntry readFullEntry(ByteReader& in, DWORD& lastPid)
+{
+    RawEntry entry;
+    entry.pid = lastPid + static_cast<DWORD>(in.varint());
+    entry.parentPid = static_cast<DWORD>(in.varint());
+    entry.nameId = in.varint();
+    entry.memory = in.varint();
+    entry.cpuTime = in.varint();
+    entry.startTime = in.varint();
+    entry.flags = in.byte();
+    lastPid = entry.pid;
+    return entry;
+}
+
+// UTF-8 to wide, as UTF-16 where wchar_t is 16 bits; malformed bytes become U+FFFD
+static std::wstring decodeUtf8(const uint8_t* bytes, size_t length)
+{
+    std::wstring text;
+    text.reserve(length);
+    size_t i = 0;
+    while (i < length)
+    {
+        unsigned long c = bytes[i];
+        int extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xE ? 2 : (c >> 3) == 0x1E ? 3 : -1;
+        bool valid = extra >= 0 && i + static_cast<size_t>(extra) < length;
+        for (int k = 1; valid && k <= extra; ++k)
+            valid = (bytes[i + k] & 0xC0) == 0x80;
+        if (!valid)
+        {
+            text.push_back(static_cast<wchar_t>(0xFFFD));
+            ++i;
+            continue;
+        }
+        if (extra > 0)
+            c &= 0x3F >> extra;
+        for (int k = 1; k <= extra; ++k)
+            c = (c << 6) | (bytes[i + k] & 0x3F);
+        i += extra + 1;
+
+        if (sizeof(wchar_t) == 2 && c >= 0x10000)
+        {
+            c -= 0x10000;
+            text.push_back(static_cast<wchar_t>(0xD800 + (c >> 10)));
+            text.push_back(static_cast<wchar_t>(0xDC00 + (c & 0x3FF)));
+        }
+        else
+        {
+            text.push_back(static_cast<wchar_t>(c));
+        }
+    }
+    return text;
+}
+
+SnapshotReplay::~SnapshotReplay()
+{
+    close();
+}
+
+bool SnapshotReplay::open(const std::string& path, std::string& error)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        error = "cannot open the file";
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(HeaderSize))
+    {
+        CloseHandle(file);
+        error = "the file is too short to be a recording";
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        error = "cannot map the file";
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        error = "cannot open the file";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(HeaderSize))
+    {
+        ::close(fd);
+        error = "the file is too short to be a recording";
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // The mapping keeps the file alive
+    if (view == MAP_FAILED)
+    {
+        error = "cannot map the file";
+        return false;
+    }
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(info.st_size);
+#endif
+
+    ByteReader header(data, HeaderSize);
+    const uint8_t* magic = header.take(4);
+    if (std::memcmp(magic, FileMagic, 4) != 0 || header.fixed(2) != Version)
+    {
+        close();
+        error = "not a recording, or written by a newer version";
+        return false;
+    }
+
+    // A cleanly closed file ends with a footer pointing at the index
+    bool indexed = false;
+    if (size >= HeaderSize + FooterSize)
+    {
+        ByteReader footer(data + size - FooterSize, FooterSize);
+        if (std::memcmp(footer.take(4), FooterMagic, 4) == 0)
+        {
+            footer.fixed(4);
+            unsigned long long indexOffset = footer.fixed(8);
+            indexed = indexOffset >= HeaderSize && indexOffset < size - FooterSize
+                && readIndex(static_cast<size_t>(indexOffset));
+        }
+    }
+    if (!indexed)
+        scanRecords();
+
+    if (frames == 0)
+    {
+        close();
+        error = "the recording has no frames";
+        return false;
+    }
+    return true;
+}
+
+void SnapshotReplay::close()
+{
+    if (data)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(data), size);
+#endif
+    }
+    data = nullptr;
+    size = 0;
+    dataEnd = 0;
+    names.clear();
+    keyframes.clear();
+    frames = 0;
+    lastTime = 0;
+    state.clear();
+    frameDelta = ProcessDelta();
+    haveFrame = false;
+}
+
+void SnapshotReplay::addName(const uint8_t* bytes, size_t length)
+{
+    FileName name;
+    name.name = decodeUtf8(bytes, length);
+    name.poolId = processNames().intern(name.name);
+    names.push_back(std::move(name));
+}
+
+bool SnapshotReplay::readIndex(size_t indexOffset)
+{
+    ByteReader record(data + indexOffset, size - FooterSize - indexOffset);
+    if (record.byte() != Index)
+        return false;
+    size_t length = static_cast<size_t>(record.varint());
+    const uint8_t* payload = record.take(length);
+    if (!record.ok)
+        return false;
+
+    ByteReader in(payload, length);
+    frames = in.varint();
+    lastTime = static_cast<long long>(in.varint());
+
+    unsigned long long nameCount = in.varint();
+    for (unsigned long long i = 0; i < nameCount && in.ok; ++i)
+    {
+        size_t nameLength = static_cast<size_t>(in.varint());
+        const uint8_t* bytes = in.take(nameLength);
+        if (bytes)
+            addName(bytes, nameLength);
+    }
+
+    unsigned long long keyframeCount = in.varint();
+    for (unsigned long long i = 0; i < keyframeCount && in.ok; ++i)
+    {
+        KeyframeMark mark;
+        mark.unixMs = static_cast<long long>(in.varint());
+        mark.frame = in.varint();
+        mark.offset = static_cast<size_t>(in.varint());
+        if (mark.offset < HeaderSize || mark.offset >= indexOffset)
+            in.ok = false;
+        keyframes.push_back(mark);
+    }
+
+    if (!in.ok || keyframes.empty())
+    {
+        names.clear();
+        keyframes.clear();
+        frames = 0;
+        return false;
+    }
+    dataEnd = indexOffset;
+    return true;
+}
+
+void SnapshotReplay::scanRecords()
+{
+    names.clear();
+    keyframes.clear();
+    frames = 0;
+
+    size_t position = HeaderSize;
+    dataEnd = position;
+    while (position < size)
+    {
+        ByteReader record(data + position, size - position);
+        uint8_t type = record.byte();
+        size_t length = static_cast<size_t>(record.varint());
+        const uint8_t* payload = record.take(length);
+        if (!record.ok || type == Index)
+            break;    // Cut short by a crash, or the end of the frames
+
+        ByteReader in(payload, length);
+        if (type == Name)
+        {
+            in.varint();    // Ids are dense and in file order
+            size_t nameLength = static_cast<size_t>(in.varint());
+            const uint8_t* bytes = in.take(nameLength);
+            if (!bytes)
+                break;
+            addName(bytes, nameLength);
+        }
+        else if (type == Keyframe)
+        {
+            lastTime = static_cast<long long>(in.varint());
+            keyframes.push_back({ lastTime, frames, position });
+            ++frames;
+        }
+        else if (type == Delta)
+        {
+            lastTime += in.zigzag();
+            ++frames;
+        }
+
+        position = static_cast<size_t>(record.p - data);
+        dataEnd = position;
+    }
+
+    // A delta with no keyframe before it cannot be decoded
+    if (keyframes.empty())
+        frames = 0;
+}
+
+unsigned long long SnapshotReplay::frameCount() const
+{
+    return frames;
+}
+
+long long SnapshotReplay::startTime() const
+{
+    return keyframes.empty() ? 0 : keyframes.front().unixMs;
+}
+
+long long SnapshotReplay::endTime() const
+{
+    return lastTime;
+}
+
+const std::vector<ProcessInfo>& SnapshotReplay::processes() const
+{
+    return state;
+}
+
+const ProcessDelta& SnapshotReplay::delta() const
+{
+    return frameDelta;
+}
+
+long long SnapshotReplay::time() const
+{
+    return frameTime;
+}
+
+unsigned long long SnapshotReplay::frameIndex() const
+{
+    return frameNumber;
+}
+
+bool SnapshotReplay::fillEntry(ProcessInfo& proc, DWORD pid, DWORD parentPid, unsigned long long nameId,
+    unsigned long long memory, unsigned long long cpuTime, unsigned long long startTime, uint8_t flags)
+{
+    if (nameId >= names.size())
+        return false;
+
+    const FileName& name = names[static_cast<size_t>(nameId)];
+    proc.pid = pid;
+    proc.parentPid = parentPid;
+    proc.name = name.name;
+    proc.nameId = name.poolId;
+    proc.memoryUsage = memory;
+    proc.isAccessible = (flags & 1) != 0;
+    proc.startTime = startTime;
+    proc.memoryDelta = 0;
+    proc.isNew = true;
+    proc.cpuTime = cpuTime;
+    proc.cpuUsage = 0.0;    // No rate until it has been seen twice, as when live
+    return true;
+}
+
+void SnapshotReplay::updateCpu(ProcessInfo& proc, unsigned long long previousCpuTime, long long elapsedMs)
+{
+    unsigned long long spent = proc.cpuTime > previousCpuTime ? proc.cpuTime - previousCpuTime : 0;
+    proc.cpuUsage = elapsedMs > 0 ? 100.0 * static_cast<double>(spent) / (static_cast<double>(elapsedMs) * 1e6) : 0.0;
+}
+
+bool SnapshotReplay::applyKeyframe(const uint8_t* payload, size_t length)
+{
+    ByteReader in(payload, length);
+    long long time = static_cast<long long>(in.varint());
+    unsigned long long count = in.varint();
+    long long elapsed = time - frameTime;
+
+    // Merge the full list with the current frame so the delta looks like a live refresh
+    nextState.clear();
+    frameDelta.added.clear();
+    frameDelta.changed.clear();
+    frameDelta.removed.clear();
+
+    size_t i = 0;
+    DWORD lastPid = 0;
+    for (unsigned long long n = 0; n < count && in.ok; ++n)
+    {
+        RawEntry entry = readFullEntry(in, lastPid);
+        while (i < state.size() && state[i].pid < entry.pid)
+            frameDelta.removed.push_back(std::move(state[i++]));
+
+        if (i < state.size() && state[i].pid == entry.pid && state[i].startTime == entry.startTime)
+        {
+            ProcessInfo proc = std::move(state[i++]);
+            bool accessible = (entry.flags & 1) != 0;
+            unsigned long long previousCpu = proc.cpuTime;
+            proc.memoryDelta = static_cast<long long>(entry.memory) - static_cast<long long>(proc.memoryUsage);
+            if (proc.memoryDelta != 0 || proc.isAccessible != accessible || proc.cpuTime != entry.cpuTime)
+                frameDelta.changed.push_back(entry.pid);
+            proc.memoryUsage = entry.memory;
+            proc.isAccessible = accessible;
+            proc.parentPid = entry.parentPid;
+            proc.cpuTime = entry.cpuTime;
+            proc.isNew = false;
+            updateCpu(proc, previousCpu, elapsed);
+            nextState.push_back(std::move(proc));
+            continue;
+        }
+
+        if (i < state.size() && state[i].pid == entry.pid)
+            frameDelta.removed.push_back(std::move(state[i++]));    // Recycled PID
+
+        nextState.emplace_back();
+        if (!fillEntry(nextState.back(), entry.pid, entry.parentPid, entry.nameId,
+            entry.memory, entry.cpuTime, entry.startTime, entry.flags))
+            return false;
+        frameDelta.added.push_back(entry.pid);
+    }
+    while (i < state.size())
+        frameDelta.removed.push_back(std::move(state[i++]));
+
+    if (!in.ok)
+        return false;
+    state.swap(nextState);
+    frameTime = time;
+    return true;
+}
+
+bool SnapshotReplay::applyDelta(const uint8_t* payload, size_t length)
+{
+    ByteReader in(payload, length);
+    long long elapsed = in.zigzag();
+    long long time = frameTime + elapsed;
+
+    nextState.clear();
+    frameDelta.added.clear();
+    frameDelta.changed.clear();
+    frameDelta.removed.clear();
+
+    // The removed PIDs come first; the payload is walked once, so keep a reader on each list
+    unsigned long long removedCount = in.varint();
+    ByteReader removed = in;
+    for (unsigned long long n = 0; n < removedCount && in.ok; ++n)
+        in.varint();
+    unsigned long long addedCount = in.varint();
+    ByteReader added = in;
+    DWORD skipPid = 0;
+    for (unsigned long long n = 0; n < addedCount && in.ok; ++n)
+        readFullEntry(in, skipPid);
+    unsigned long long changedCount = in.varint();
+    ByteReader changed = in;
+    if (!in.ok)
+        return false;
+
+    DWORD nextRemoved = 0, nextChanged = 0, lastAdded = 0;
+    bool haveRemoved = false, haveChanged = false, haveAdded = false;
+    RawEntry add{};
+    auto advanceRemoved = [&]()
+        {
+            haveRemoved = removedCount > 0;
+            if (haveRemoved)
+            {
+                nextRemoved += static_cast<DWORD>(removed.varint());
+                --removedCount;
+            }
+        };
+    auto advanceAdded = [&]()
+        {
+            haveAdded = addedCount > 0;
+            if (haveAdded)
+            {
+                add = readFullEntry(added, lastAdded);
+                --addedCount;
+            }
+        };
+    auto advanceChanged = [&]()
+        {
+            haveChanged = changedCount > 0;
+            if (haveChanged)
+            {
+                nextChanged += static_cast<DWORD>(changed.varint());
+                --changedCount;
+            }
+        };
+    advanceRemoved();
+    advanceAdded();
+    advanceChanged();
+
+    size_t i = 0;
+    while (i < state.size() || haveAdded)
+    {
+        if (i < state.size() && (!haveAdded || state[i].pid <= add.pid))
+        {
+            ProcessInfo& proc = state[i++];
+            if (haveRemoved && nextRemoved == proc.pid)
+            {
+                frameDelta.removed.push_back(std::move(proc));
+                advanceRemoved();
+                continue;
+            }
+            if (haveAdded && add.pid == proc.pid)
+                return false;    // Added while still present: the file is damaged
+
+            unsigned long long previousCpu = proc.cpuTime;
+            proc.memoryDelta = 0;
+            proc.isNew = false;
+            if (haveChanged && nextChanged == proc.pid)
+            {
+                uint8_t mask = changed.byte();
+                if (mask & ChangedMemory)
+                {
+                    proc.memoryDelta = changed.zigzag();
+                    proc.memoryUsage += static_cast<unsigned long long>(proc.memoryDelta);
+                }
+                if (mask & ChangedCpu)
+                    proc.cpuTime += static_cast<unsigned long long>(changed.zigzag());
+                if (mask & ChangedFlags)
+                    proc.isAccessible = (changed.byte() & 1) != 0;
+                if (mask & ChangedParent)
+                    proc.parentPid = static_cast<DWORD>(changed.varint());
+                if (mask & (ChangedMemory | ChangedCpu | ChangedFlags))
+                    frameDelta.changed.push_back(proc.pid);
+                advanceChanged();
+            }
+            updateCpu(proc, previousCpu, elapsed);
+            nextState.push_back(std::move(proc));
+            continue;
+        }
+
+        nextState.emplace_back();
+        if (!fillEntry(nextState.back(), add.pid, add.parentPid, add.nameId,
+            add.memory, add.cpuTime, add.startTime, add.flags))
+            return false;
+        frameDelta.added.push_back(add.pid);
+        advanceAdded();
+    }
+
+    if (!removed.ok || !added.ok || !changed.ok)
+        return false;
+    state.swap(nextState);
+    frameTime = time;
+    return true;
+}
+
+bool SnapshotReplay::decodeRecordAt(size_t& position)
+{
+    while (position < dataEnd)
+    {
+        ByteReader record(data + position, dataEnd - position);
+        uint8_t type = record.byte();
+        size_t length = static_cast<size_t>(record.varint());
+        const uint8_t* payload = record.take(length);
+        if (!record.ok)
+            return false;
+        position = static_cast<size_t>(record.p - data);
+
+        // Names are all known from open(), so Name records are just stepped over
+        if (type == Keyframe)
+            return applyKeyframe(payload, length);
+        if (type == Delta)
+            return applyDelta(payload, length);
+        if (type == Index)
+            return false;
+    }
+    return false;
+}
+
+bool SnapshotReplay::next()
+{
+    if (!data)
+        return false;
+
+    if (!haveFrame)
+    {
+        state.clear();
+        frameTime = 0;
+        cursor = keyframes.front().offset;
+        frameNumber = keyframes.front().frame;
+    }
+    else
+    {
+        if (frameNumber + 1 >= frames)
+            return false;
+        ++frameNumber;
+    }
+
+    haveFrame = decodeRecordAt(cursor);
+    return haveFrame;
+}
+
+bool SnapshotReplay::seek(long long unixMs)
+{
+    if (!data)
+        return false;
+
+    // Start from the last keyframe strictly before the target, so a target that is itself
+    // a keyframe still gets a delta against the frame before it
+    auto after = std::lower_bound(keyframes.begin(), keyframes.end(), unixMs,
+        [](const KeyframeMark& mark, long long t) { return mark.unixMs < t; });
+    const KeyframeMark& start = after == keyframes.begin() ? keyframes.front() : *(after - 1);
+
+    state.clear();
+    frameTime = 0;
+    cursor = start.offset;
+    frameNumber = start.frame;
+    haveFrame = decodeRecordAt(cursor);
+
+    // Step forward while the following frame is still not later than the target
+    while (haveFrame && frameNumber + 1 < frames)
+    {
+        size_t position = cursor;
+        long long nextTime = 0;
+        bool found = false;
+        while (position < dataEnd && !found)
+        {
+            ByteReader record(data + position, dataEnd - position);
+            uint8_t type = record.byte();
+            size_t length = static_cast<size_t>(record.varint());
+            const uint8_t* payload = record.take(length);
+            if (!record.ok)
+                break;
+            position = static_cast<size_t>(record.p - data);
+
+            ByteReader in(payload, length);
+            if (type == Keyframe)
+                nextTime = static_cast<long long>(in.varint());
+            else if (type == Delta)
+                nextTime = frameTime + in.zigzag();
+            found = type == Keyframe || type == Delta;
+        }
+        if (!found || nextTime > unixMs)
+            break;
+        next();
+    }
+    return haveFrame;
+}
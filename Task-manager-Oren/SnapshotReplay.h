@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ProcessInfo.h"
+
+// Reads a file written by SnapshotRecorder. The file is memory-mapped; open() only looks
+// at the index (or walks the record headers when the recording was never closed), and
+// frames are decoded on demand. Each decoded frame is a process list plus the delta
+// against the frame before, in the same form ProcessManager produces, so it can be fed
+// to ProcessManager::loadProcessList and shown by the usual views.
+class SnapshotReplay
+{
+public:
+    SnapshotReplay() = default;
+    SnapshotReplay(const SnapshotReplay&) = delete;
+    SnapshotReplay& operator=(const SnapshotReplay&) = delete;
+    ~SnapshotReplay();
+
+    // Maps the file and reads its index. On failure error says why.
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    // Frames in the file and the time span they cover (unix ms)
+    unsigned long long frameCount() const;
+    long long startTime() const;
+    long long endTime() const;
+
+    // Decodes the last frame taken at or before unixMs (the first frame if unixMs is earlier).
+    // Starts from the nearest keyframe before it, so the cost is at most one keyframe interval.
+    bool seek(long long unixMs);
+
+    // Decodes the frame after the current one; false at the end of the recording
+    bool next();
+
+    // The current frame: processes ordered by PID, what changed since the frame before,
+    // when it was taken and its position in the file (valid after seek or next)
+    const std::vector<ProcessInfo>& processes() const;
+    const ProcessDelta& delta() const;
+    long long time() const;
+    unsigned long long frameIndex() const;
+
+private:
+    struct KeyframeMark
+    {
+        long long unixMs;
+        unsigned long long frame;
+        size_t offset;
+    };
+
+    // Name table entry: the raw name and its NamePool id
+    struct FileName
+    {
+        std::wstring name;
+        uint32_t poolId;
+    };
+
+    // Reads the Index record the footer points at
+    bool readIndex(size_t indexOffset);
+
+    // Walks every record of a recording without footer to rebuild the index
+    void scanRecords();
+
+    void addName(const uint8_t* bytes, size_t length);
+
+    // Decodes the record at cursor into the current frame; false if it is not a frame
+    bool decodeRecordAt(size_t& position);
+    bool applyKeyframe(const uint8_t* payload, size_t length);
+    bool applyDelta(const uint8_t* payload, size_t length);
+
+    // Fills a ProcessInfo for a process appearing in this frame
+    bool fillEntry(ProcessInfo& proc, DWORD pid, DWORD parentPid, unsigned long long nameId,
+        unsigned long long memory, unsigned long long cpuTime, unsigned long long startTime, uint8_t flags);
+
+    // CPU usage of proc from the CPU time it had in the frame before
+    void updateCpu(ProcessInfo& proc, unsigned long long previousCpuTime, long long elapsedMs);
+
+    // Mapping
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    size_t dataEnd = 0;              // End of the frame records (start of the index, if any)
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    std::vector<FileName> names;
+    std::vector<KeyframeMark> keyframes;
+    unsigned long long frames = 0;
+    long long lastTime = 0;
+
+    // Current frame and where the next record starts
+    std::vector<ProcessInfo> state;
+    std::vector<ProcessInfo> nextState;
+    ProcessDelta frameDelta;
+    long long frameTime = 0;
+    unsigned long long frameNumber = 0;
+    size_t cursor = 0;
+    bool haveFrame = false;
+};
@@ -0,0 +1,308 @@
+#include "SnapshotWriter.h"
+#include "UserNames.h"
+
+#include <algorithm>
+#include <charconv>
+
+SnapshotWriter::SnapshotWriter(ExportFormat format) : format(format)
+{
+}
+
+void SnapshotWriter::appendNumber(unsigned long long value)
+{
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, static_cast<size_t>(end - digits));
+}
+
+void SnapshotWriter::appendCpu(unsigned long long hundredths)
+{
+    // Percent with two decimals, written from the integer so no floating point is involved
+    appendNumber(hundredths / 100);
+    out.push_back('.');
+    out.push_back(static_cast<char>('0' + hundredths % 100 / 10));
+    out.push_back(static_cast<char>('0' + hundredths % 10));
+}
+
+// Appends one code point as UTF-8
+static void appendUtf8(std::string& out, unsigned long c)
+{
+    if (c < 0x80)
+    {
+        out.push_back(static_cast<char>(c));
+    }
+    else if (c < 0x800)
+    {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else if (c < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+// Appends a wide name as UTF-8, joining UTF-16 surrogate pairs (Windows) and replacing
+// unpaired halves, which cannot be encoded
+static void appendWide(std::string& out, const std::wstring& name, bool escapeJson)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        unsigned long c = static_cast<unsigned long>(name[i]);
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < name.size()
+            && name[i + 1] >= 0xDC00 && name[i + 1] <= 0xDFFF)
+        {
+            c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<unsigned long>(name[i + 1]) - 0xDC00);
+            ++i;
+        }
+        else if (c >= 0xD800 && c <= 0xDFFF)
+        {
+            c = 0xFFFD;
+        }
+
+        if (escapeJson && (c == '"' || c == '\\'))
+        {
+            out.push_back('\\');
+            out.push_back(static_cast<char>(c));
+        }
+        else if (escapeJson && c < 0x20)
+        {
+            out.append("\\u00");
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xF]);
+        }
+        else if (!escapeJson && c == '"')
+        {
+            out.append("\"\"");
+        }
+        else
+        {
+            appendUtf8(out, c);
+        }
+    }
+}
+
+void SnapshotWriter::appendName(const std::wstring& name)
+{
+    out.push_back('"');
+    appendWide(out, name, format == ExportFormat::Ndjson);
+    out.push_back('"');
+}
+
+void SnapshotWriter::appendLittleEndian(unsigned long long value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+void SnapshotWriter::appendBinaryName(const std::wstring& name)
+{
+    // Length goes in front, so encode first and patch it in afterwards
+    size_t lengthAt = out.size();
+    appendLittleEndian(0, 2);
+    appendWide(out, name, false);
+    size_t length = out.size() - lengthAt - 2;
+    if (length > 0xFFFF)
+    {
+        out.resize(lengthAt + 2 + 0xFFFF);
+        length = 0xFFFF;
+    }
+    out[lengthAt] = static_cast<char>(length & 0xFF);
+    out[lengthAt + 1] = static_cast<char>(length >> 8);
+}
+
+void SnapshotWriter::appendBinaryHeader(RecordKind kind, size_t count, unsigned long long tick, long long unixMs)
+{
+    out.append("TMSN", 4);
+    out.push_back(1);
+    out.push_back(static_cast<char>(kind));
+    appendLittleEndian(0, 2);
+    appendLittleEndian(count, 4);
+    appendLittleEndian(tick, 8);
+    appendLittleEndian(static_cast<unsigned long long>(unixMs), 8);
+}
+
+void SnapshotWriter::writeProcesses(const ProcessTable& table, const NamePool& names, const std::vector<uint32_t>& rows,
+    size_t count, unsigned long long tick, long long unixMs)
+{
+    count = std::min(count, rows.size());
+
+    if (format == ExportFormat::Binary)
+    {
+        appendBinaryHeader(RecordKind::Processes, count, tick, unixMs);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t row = rows[i];
+            appendLittleEndian(table.pid[row], 4);
+            appendLittleEndian(table.parentPid[row], 4);
+            appendLittleEndian(table.memory[row], 8);
+            appendLittleEndian(table.cpu[row], 4);
+            out.push_back(static_cast<char>(table.flags[row]));
+            out.push_back(0);
+            appendBinaryName(names.display(table.nameId[row]));
+        }
+        return;
+    }
+
+    if (format == ExportFormat::Csv && !csvHeaderWritten)
+    {
+        out.append("tick,time,pid,ppid,name,memory,cpu,accessible\n");
+        csvHeaderWritten = true;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t row = rows[i];
+        bool accessible = table.accessible(row);
+        if (format == ExportFormat::Ndjson)
+        {
+            out.append("{\"tick\":");
+            appendNumber(tick);
+            out.append(",\"time\":");
+            appendNumber(static_cast<unsigned long long>(unixMs));
+            out.append(",\"pid\":");
+            appendNumber(table.pid[row]);
+            out.append(",\"ppid\":");
+            appendNumber(table.parentPid[row]);
+            out.append(",\"name\":");
+            appendName(names.display(table.nameId[row]));
+            out.append(",\"memory\":");
+            appendNumber(table.memory[row]);
+            out.append(",\"cpu\":");
+            appendCpu(table.cpu[row]);
+            out.append(accessible ? ",\"accessible\":true}\n" : ",\"accessible\":false}\n");
+        }
+        else
+        {
+            appendNumber(tick);
+            out.push_back(',');
+            appendNumber(static_cast<unsigned long long>(unixMs));
+            out.push_back(',');
+            appendNumber(table.pid[row]);
+            out.push_back(',');
+            appendNumber(table.parentPid[row]);
+            out.push_back(',');
+            appendName(names.display(table.nameId[row]));
+            out.push_back(',');
+            appendNumber(table.memory[row]);
+            out.push_back(',');
+            appendCpu(table.cpu[row]);
+            out.append(accessible ? ",1\n" : ",0\n");
+        }
+    }
+}
+
+void SnapshotWriter::writeGroups(const GroupingEngine& groups, GroupBy by, const std::vector<uint32_t>& order,
+    const std::vector<uint32_t>& nameIds, const NamePool& names, size_t count,
+    unsigned long long tick, long long unixMs)
+{
+    count = std::min(count, order.size());
+    bool byParent = by == GroupBy::ParentPid;
+    bool byUser = by == GroupBy::User;
+
+    if (format == ExportFormat::Binary)
+    {
+        appendBinaryHeader(byParent ? RecordKind::ParentGroups : byUser ? RecordKind::UserGroups : RecordKind::NameGroups,
+            count, tick, unixMs);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t group = order[i];
+            appendLittleEndian(byParent || byUser ? groups.key(group) : 0, 4);
+            appendLittleEndian(groups.count(group), 4);
+            appendLittleEndian(static_cast<unsigned long long>(groups.stats(group, 0).sum), 8);
+            appendLittleEndian(static_cast<unsigned long long>(groups.stats(group, 1).sum), 8);
+            if (byUser)
+                appendBinaryName(userName(static_cast<uint32_t>(groups.key(group))));
+            else
+                appendBinaryName(names.display(nameIds[group]));
+        }
+        return;
+    }
+
+    if (format == ExportFormat::Csv && !csvHeaderWritten)
+    {
+        out.append(byParent ? "tick,time,parent,name,instances,memory,cpu\n"
+            : byUser ? "tick,time,user,instances,memory,cpu\n" : "tick,time,name,instances,memory,cpu\n");
+        csvHeaderWritten = true;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t group = order[i];
+        if (format == ExportFormat::Ndjson)
+        {
+            out.append("{\"tick\":");
+            appendNumber(tick);
+            out.append(",\"time\":");
+            appendNumber(static_cast<unsigned long long>(unixMs));
+            if (byParent)
+            {
+                out.append(",\"parent\":");
+                appendNumber(groups.key(group));
+            }
+            if (byUser)
+            {
+                out.append(",\"user\":");
+                appendName(userName(static_cast<uint32_t>(groups.key(group))));
+            }
+            else
+            {
+                out.append(",\"name\":");
+                appendName(names.display(nameIds[group]));
+            }
+            out.append(",\"instances\":");
+            appendNumber(groups.count(group));
+            out.append(",\"memory\":");
+            appendNumber(static_cast<unsigned long long>(groups.stats(group, 0).sum));
+            out.append(",\"cpu\":");
+            appendCpu(static_cast<unsigned long long>(groups.stats(group, 1).sum));
+            out.append("}\n");
+        }
+        else
+        {
+            appendNumber(tick);
+            out.push_back(',');
+            appendNumber(static_cast<unsigned long long>(unixMs));
+            out.push_back(',');
+            if (byParent)
+            {
+                appendNumber(groups.key(group));
+                out.push_back(',');
+            }
+            if (byUser)
+                appendName(userName(static_cast<uint32_t>(groups.key(group))));
+            else
+                appendName(names.display(nameIds[group]));
+            out.push_back(',');
+            appendNumber(groups.count(group));
+            out.push_back(',');
+            appendNumber(static_cast<unsigned long long>(groups.stats(group, 0).sum));
+            out.push_back(',');
+            appendCpu(static_cast<unsigned long long>(groups.stats(group, 1).sum));
+            out.push_back('\n');
+        }
+    }
+}
+
+const std::string& SnapshotWriter::data() const
+{
+    return out;
+}
+
+bool SnapshotWriter::flush(std::FILE* file)
+{
+    bool ok = out.empty() || std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    ok = std::fflush(file) == 0 && ok;
+    out.clear();    // Keeps the capacity for the next snapshot
+    return ok;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "GroupingEngine.h"
+#include "NamePool.h"
+#include "ProcessTable.h"
+
+// Machine-readable output formats of the headless mode
+enum class ExportFormat
+{
+    Ndjson,    // One JSON object per line
+    Csv,       // Header line once, then one line per record
+    Binary     // Little-endian records, see below
+};
+
+// Binary layout (all integers little-endian, names UTF-8 without terminator):
+//   snapshot header, 28 bytes:
+//     char magic[4] = "TMSN", uint8 version = 1, uint8 kind (RecordKind), uint16 reserved = 0,
+//     uint32 recordCount, uint64 tick, int64 unix time in milliseconds
+//   process record: uint32 pid, uint32 parentPid, uint64 memory, uint32 cpu (hundredths of a
+//     percent), uint8 flags (ProcessTable bits), uint8 reserved, uint16 nameLength, name
+//   group record: uint32 parentPid or user ID (0 for name groups), uint32 instances, uint64
+//     memory, uint64 cpu (hundredths of a percent, summed), uint16 nameLength, name (the
+//     account name for user groups)
+enum class RecordKind : uint8_t
+{
+    Processes = 0,
+    NameGroups = 1,
+    ParentGroups = 2,
+    UserGroups = 3
+};
+
+// Serializes snapshots straight from ProcessTable / GroupingEngine columns into one
+// reusable byte buffer, so streaming costs no allocation once the buffer has grown.
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(ExportFormat format);
+
+    // Appends count rows of table, in the order given by rows
+    void writeProcesses(const ProcessTable& table, const NamePool& names, const std::vector<uint32_t>& rows,
+        size_t count, unsigned long long tick, long long unixMs);
+
+    // Appends count groups in the given order. groups must have been built with
+    // { Metric::Memory, Metric::Cpu }; nameIds holds the name shown for each group number
+    // (user groups show the account name instead).
+    void writeGroups(const GroupingEngine& groups, GroupBy by, const std::vector<uint32_t>& order,
+        const std::vector<uint32_t>& nameIds, const NamePool& names, size_t count,
+        unsigned long long tick, long long unixMs);
+
+    // Bytes written since the last flush
+    const std::string& data() const;
+
+    // Writes the buffer to out, flushes the stream and empties the buffer; false on a write error
+    bool flush(std::FILE* out);
+
+private:
+    void appendNumber(unsigned long long value);
+    void appendCpu(unsigned long long hundredths);
+    void appendName(const std::wstring& name);    // Escaped for the current text format
+    void appendBinaryName(const std::wstring& name);
+    void appendLittleEndian(unsigned long long value, int bytes);
+    void appendBinaryHeader(RecordKind kind, size_t count, unsigned long long tick, long long unixMs);
+
+    ExportFormat format;
+    std::string out;
+    bool csvHeaderWritten = false;
+};
@@ -0,0 +1,76 @@
+#include "SyntheticSnapshotSource.h"
+
+#include <chrono>
+
+// Spin rather than sleep: a real sample is syscall time, not idle time
+static void burn(unsigned nanos)
+{
+    if (nanos == 0)
+        return;
+    auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(nanos);
+    while (std::chrono::steady_clock::now() < until)
+    {
+    }
+}
+
+SyntheticSnapshotSource::SyntheticSnapshotSource(size_t processCount, unsigned sampleCostNanos, unsigned detailCostNanos)
+    : sampleCostNanos(sampleCostNanos), detailCostNanos(detailCostNanos)
+{
+    names.reserve(processCount);
+    for (size_t i = 0; i < processCount; ++i)
+    {
+        names.push_back("worker" + std::to_string(i % 97));
+    }
+}
+
+bool SyntheticSnapshotSource::beginWalk(size_t& count)
+{
+    count = names.size();
+    ++walks;
+    return true;
+}
+
+bool SyntheticSnapshotSource::sampleAt(size_t index, ProcessSample& sample, SampleScratch&)
+{
+    burn(sampleCostNanos);
+
+    sample.pid = static_cast<DWORD>(index + 1);
+    sample.parentPid = static_cast<DWORD>(index / 100 + 1); // Every 100 processes share a parent
+    sample.startTime = 1000 + index;
+    sample.memoryUsage = (1000 + index % 5000) * 4096ULL;
+    sample.cpuTime = walks * (index % 50) * 1000000ULL; // Up to 49 ms of CPU per walk
+    sample.isAccessible = true;
+    sample.userId = static_cast<uint32_t>(index % 7 == 0 ? 0 : 1000 + index % 3);   // root and three users
+    sample.state = index % 20 == 0 ? 'R' : 'S';
+    sample.pageFaults = walks * (index % 100);
+    sample.majorFaults = walks * (index % 3);
+    sample.peakMemory = 0;
+    sample.threadCount = static_cast<uint32_t>(1 + index % 40);
+    sample.handleCount = static_cast<uint32_t>(3 + index % 200);
+    sample.readBytes = walks * (index % 10) * 65536ULL;    // A tenth of the processes do no I/O
+    sample.writeBytes = walks * (index % 4) * 4096ULL;
+    sample.readOps = walks * (index % 10) * 16;
+    sample.writeOps = walks * (index % 4);
+    sample.contextSwitches = walks * (index % 25);
+    sample.wideName = nullptr;
+    sample.utf8Name = names[index].data();
+    sample.nameLength = names[index].size();
+    return true;
+}
+
+// A quarter of each process is private, the rest shared with three others; a tenth is swapped
+bool SyntheticSnapshotSource::readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch&)
+{
+    if (pid == 0 || pid > names.size())
+        return false;
+
+    burn(detailCostNanos);
+    size_t index = pid - 1;
+    unsigned long long resident = (1000 + index % 5000) * 4096ULL;
+    detail.unique = resident / 4;
+    detail.shared = resident - detail.unique;
+    detail.proportional = detail.unique + detail.shared / 4;
+    detail.swap = resident / 10;
+    detail.peak = resident + resident / 8;
+    return true;
+}
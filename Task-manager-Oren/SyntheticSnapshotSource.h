@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ProcessSnapshotSource.h"
+
+// In-memory stand-in for a large host, used by the benchmarks.
+// Each sampleAt burns sampleCostNanos of CPU to mimic the open/read/close of a real source,
+// and each readMemoryDetail burns detailCostNanos (a real smaps_rollup read walks every mapping).
+class SyntheticSnapshotSource : public ProcessSnapshotSource
+{
+public:
+    SyntheticSnapshotSource(size_t processCount, unsigned sampleCostNanos, unsigned detailCostNanos = 0);
+
+    bool beginWalk(size_t& count) override;
+    bool sampleAt(size_t index, ProcessSample& sample, SampleScratch& scratch) override;
+    bool readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch& scratch) override;
+
+private:
+    std::vector<std::string> names;    // One executable name per PID (97 distinct names)
+    unsigned sampleCostNanos;
+    unsigned detailCostNanos;
+    unsigned long long walks = 0;      // Drives the fake CPU counters
+};
@@ -0,0 +1,288 @@
+#include "TerminalRenderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// Unchanged cells shorter than this between two changed runs are resent rather than
+// skipped, since a cursor move costs about as much
+static const int MinSkip = 6;
+
+// Terminal size, or 80x24 when stdout is not a terminal
+static void queryTerminalSize(int& columns, int& rows)
+{
+    columns = 80;
+    rows = 24;
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+    {
+        columns = info.srWindow.Right - info.srWindow.Left + 1;
+        rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+    }
+#else
+    winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0)
+    {
+        columns = size.ws_col;
+        rows = size.ws_row;
+    }
+#endif
+    columns = std::max(20, std::min(columns, 1000));
+    rows = std::max(5, std::min(rows, 500));
+}
+
+TerminalRenderer::TerminalRenderer() : toTerminal(true)
+{
+#ifdef _WIN32
+    // Escape sequences and UTF-8 output need to be switched on for the console
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode))
+        SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+    int columns, rows;
+    queryTerminalSize(columns, rows);
+    resize(columns, rows);
+}
+
+TerminalRenderer::TerminalRenderer(int columns, int rows) : toTerminal(false)
+{
+    resize(columns, rows);
+}
+
+void TerminalRenderer::resize(int columns, int rows)
+{
+    width = columns;
+    height = rows;
+    back.assign(static_cast<size_t>(width) * height, L' ');
+    front.assign(back.size(), L' ');
+    out.reserve(back.size() * 4);
+    fullRedraw = true;
+}
+
+bool TerminalRenderer::updateSize()
+{
+    if (!toTerminal)
+        return false;
+
+    int columns, rows;
+    queryTerminalSize(columns, rows);
+    if (columns == width && rows == height)
+        return false;
+
+    resize(columns, rows);
+    return true;
+}
+
+int TerminalRenderer::columns() const
+{
+    return width;
+}
+
+int TerminalRenderer::rows() const
+{
+    return height;
+}
+
+void TerminalRenderer::invalidate()
+{
+    fullRedraw = true;
+}
+
+void TerminalRenderer::beginFrame()
+{
+    std::fill(back.begin(), back.end(), L' ');
+}
+
+void TerminalRenderer::text(int row, int column, const wchar_t* text, size_t length, int fieldWidth, Align align)
+{
+    if (row < 0 || row >= height || column >= width || fieldWidth <= 0)
+        return;
+
+    // The field is already blank, so only the text itself is copied
+    size_t shown = std::min(length, static_cast<size_t>(fieldWidth));
+    int start = column + (align == Align::Right ? fieldWidth - static_cast<int>(shown) : 0);
+    wchar_t* line = &back[static_cast<size_t>(row) * width];
+    for (size_t i = 0; i < shown; ++i)
+    {
+        int cell = start + static_cast<int>(i);
+        if (cell >= 0 && cell < width)
+            line[cell] = text[i];
+    }
+}
+
+void TerminalRenderer::text(int row, int column, const std::wstring& value, int fieldWidth, Align align)
+{
+    text(row, column, value.data(), value.size(), fieldWidth, align);
+}
+
+void TerminalRenderer::fill(int row, int column, int fieldWidth, wchar_t ch)
+{
+    if (row < 0 || row >= height)
+        return;
+
+    int begin = std::max(column, 0);
+    int end = std::min(column + fieldWidth, width);
+    wchar_t* line = &back[static_cast<size_t>(row) * width];
+    for (int cell = begin; cell < end; ++cell)
+        line[cell] = ch;
+}
+
+void TerminalRenderer::appendCell(wchar_t ch)
+{
+    unsigned long c = static_cast<unsigned long>(ch);
+    if (c < 0x20 || c == 0x7F)
+        c = '?'; // Control characters would move the cursor behind our back
+    if (c < 0x80)
+    {
+        out.push_back(static_cast<char>(c));
+    }
+    else if (c < 0x800)
+    {
+        out.push_back(static_cast<char>(0xC0 | (c >> 6)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else if (c < 0x10000)
+    {
+        out.push_back(static_cast<char>(0xE0 | (c >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xF0 | (c >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+    }
+}
+
+void TerminalRenderer::appendMove(int row, int column)
+{
+    char buffer[24];
+    int length = 0;
+    buffer[length++] = '\x1b';
+    buffer[length++] = '[';
+
+    // Two small decimal numbers; no need for the general formatter here
+    for (int value : { row + 1, column + 1 })
+    {
+        char digits[8];
+        int count = 0;
+        do
+        {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0)
+            buffer[length++] = digits[--count];
+        buffer[length++] = ';';
+    }
+    buffer[length - 1] = 'H';
+    out.append(buffer, static_cast<size_t>(length));
+}
+
+void TerminalRenderer::present()
+{
+    out.clear();
+    if (fullRedraw)
+    {
+        // Clear once, then the diff below only has to send the non-blank cells
+        out.append("\x1b[H\x1b[2J");
+        std::fill(front.begin(), front.end(), L' ');
+        fullRedraw = false;
+    }
+
+    for (int row = 0; row < height; ++row)
+    {
+        const wchar_t* next = &back[static_cast<size_t>(row) * width];
+        wchar_t* shown = &front[static_cast<size_t>(row) * width];
+
+        int column = 0;
+        while (column < width)
+        {
+            if (next[column] == shown[column])
+            {
+                ++column;
+                continue;
+            }
+
+            // Grow the run until MinSkip unchanged cells in a row are found
+            int start = column;
+            int end = column + 1;
+            int scan = end;
+            while (scan < width && scan - end < MinSkip)
+            {
+                if (next[scan] != shown[scan])
+                    end = scan + 1;
+                ++scan;
+            }
+
+            appendMove(row, start);
+            for (int cell = start; cell < end; ++cell)
+            {
+                appendCell(next[cell]);
+                shown[cell] = next[cell];
+            }
+            column = end;
+        }
+    }
+
+    if (!out.empty() && toTerminal)
+    {
+        // Leave the cursor on the last line so Ctrl+C does not print over the table
+        appendMove(height - 1, 0);
+        writeOut();
+    }
+}
+
+const std::string& TerminalRenderer::lastFrame() const
+{
+    return out;
+}
+
+void TerminalRenderer::writeOut() const
+{
+    // Anything still queued in the stream must reach the terminal before the frame
+    std::wcout.flush();
+
+#ifdef _WIN32
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    const char* data = out.data();
+    size_t remaining = out.size();
+    while (remaining > 0)
+    {
+        DWORD written = 0;
+        if (!WriteFile(console, data, static_cast<DWORD>(remaining), &written, nullptr) || written == 0)
+            return;
+        data += written;
+        remaining -= written;
+    }
+#else
+    const char* data = out.data();
+    size_t remaining = out.size();
+    while (remaining > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, data, remaining);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return;
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+#endif
+}
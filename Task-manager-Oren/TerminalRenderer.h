@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Draws full-screen frames with as little terminal output as possible.
+// A frame is composed into a character grid, compared cell by cell with the frame on
+// screen, and only the changed runs are sent (ANSI cursor move + UTF-8 text), in one
+// write per frame. Nothing is allocated once the grid and output buffer have warmed up.
+class TerminalRenderer
+{
+public:
+    enum class Align { Left, Right };
+
+    // Sized to the terminal on stdout; frames are written there
+    TerminalRenderer();
+
+    // Fixed size, frames are only built in memory (see lastFrame); used by the benchmark
+    TerminalRenderer(int columns, int rows);
+
+    // Re-reads the terminal size; on a change the next frame is redrawn in full
+    bool updateSize();
+
+    int columns() const;
+    int rows() const;
+
+    // Starts a new frame with every cell blank
+    void beginFrame();
+
+    // Writes text at (row, column) into a field of width cells, padded with spaces and cut
+    // to fit; anything outside the grid is clipped
+    void text(int row, int column, const wchar_t* text, size_t length, int width, Align align = Align::Left);
+    void text(int row, int column, const std::wstring& text, int width, Align align = Align::Left);
+
+    // Fills width cells with the same character
+    void fill(int row, int column, int width, wchar_t ch);
+
+    // Diffs the frame against the screen and writes the changes
+    void present();
+
+    // Bytes produced by the last present (for the benchmark)
+    const std::string& lastFrame() const;
+
+    // Forces the next frame to be redrawn in full
+    void invalidate();
+
+private:
+    // Sets the grid size and forces a full redraw
+    void resize(int columns, int rows);
+
+    // Appends one cell as UTF-8
+    void appendCell(wchar_t ch);
+
+    // Appends ESC [ row ; column H (1-based)
+    void appendMove(int row, int column);
+
+    // Sends out to stdout
+    void writeOut() const;
+
+    int width = 0;
+    int height = 0;
+    bool toTerminal;
+    bool fullRedraw = true;
+    std::vector<wchar_t> back;     // Frame being composed
+    std::vector<wchar_t> front;    // Frame on screen
+    std::string out;               // Escape sequences and text of one frame
+};
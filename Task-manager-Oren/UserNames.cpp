@@ -0,0 +1,60 @@
+#include "UserNames.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <pwd.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::mutex cacheMutex;
+    std::unordered_map<uint32_t, std::wstring> cache;
+}
+
+void rememberUserName(uint32_t userId, const std::wstring& name)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache[userId] = name;
+}
+
+bool knowsUserName(uint32_t userId)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return cache.count(userId) != 0;
+}
+
+std::wstring userName(uint32_t userId)
+{
+    if (userId == NoUser)
+        return std::wstring();
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cache.find(userId);
+        if (it != cache.end())
+            return it->second;
+    }
+
+    // Resolved outside the lock: the account database can be slow (e.g. NSS over the network)
+    std::wstring name;
+#ifndef _WIN32
+    passwd entry;
+    passwd* result = nullptr;
+    std::vector<char> buffer(16384);
+    if (getpwuid_r(static_cast<uid_t>(userId), &entry, buffer.data(), buffer.size(), &result) == 0 && result)
+    {
+        // Account names are ASCII in practice
+        for (const char* p = result->pw_name; *p; ++p)
+            name.push_back(static_cast<wchar_t>(static_cast<unsigned char>(*p)));
+    }
+#endif
+    if (name.empty())
+        name = std::to_wstring(userId);
+
+    rememberUserName(userId, name);
+    return name;
+}
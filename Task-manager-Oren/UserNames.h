@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Process owners are kept as a 32-bit user ID per process: the uid on Linux, the relative
+// ID (last part of the account SID) on Windows. These map them to account names; lookups
+// are cached, so each account is resolved once.
+
+// ID of processes whose owner could not be read
+const uint32_t NoUser = 0xFFFFFFFFu;
+
+// Account name of a user ID (the number itself if it has no name, empty for NoUser)
+std::wstring userName(uint32_t userId);
+
+// Records the name of an account a snapshot source has just resolved (used on Windows,
+// where the name comes from the process token rather than a lookup by ID)
+void rememberUserName(uint32_t userId, const std::wstring& name);
+
+// Is the name of this user ID already cached?
+bool knowsUserName(uint32_t userId);
@@ -1,25 +1,184 @@
 #include "Utils.h"
-#include <sstream>
-#include <iomanip>
+#include "Format.h"
 
-// Convert memory size in bytes to a human-readable string (MB or GB)
-// Shows memory usage with 2 decimal places, appends appropriate unit
+#include <algorithm>
+#include <cmath>
+#include <cwchar>
+#include <cwctype>
+
+// Owning-string wrappers over the buffer formatters in Format.h, for call sites that
+// are not on a hot path
 std::wstring formatMemory(size_t memoryUsage)
 {
-    std::wstringstream stream;
-    // Convert bytes to megabytes
-    double memoryMB = static_cast<double>(memoryUsage) / (1024.0 * 1024.0);
+    wchar_t buffer[40];
+    return std::wstring(buffer, formatMemory(buffer, 40, memoryUsage));
+}
+
+std::wstring formatCpu(long long hundredthsOfPercent)
+{
+    wchar_t buffer[32];
+    return std::wstring(buffer, formatCpu(buffer, 32, hundredthsOfPercent));
+}
 
-    if (memoryMB >= 1024.0) 
+// Encode each wide character as UTF-8
+std::string toNarrow(const std::wstring& text)
+{
+    std::string result;
+    result.reserve(text.size());
+    for (wchar_t wc : text)
     {
-        // If larger than 1 GB, convert to GB and format output
-        stream << std::fixed << std::setprecision(2) << (memoryMB / 1024.0) << L" GB";
+        unsigned long c = static_cast<unsigned long>(wc);
+        if (c < 0x80)
+        {
+            result.push_back(static_cast<char>(c));
+        }
+        else if (c < 0x800)
+        {
+            result.push_back(static_cast<char>(0xC0 | (c >> 6)));
+            result.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            result.push_back(static_cast<char>(0xE0 | (c >> 12)));
+            result.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            result.push_back(static_cast<char>(0xF0 | (c >> 18)));
+            result.push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (c & 0x3F)));
+        }
     }
-    else 
+    return result;
+}
+
+std::wstring toWide(const std::string& text)
+{
+    std::wstring result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size();)
     {
-        // Otherwise, format output in MB
-        stream << std::fixed << std::setprecision(2) << memoryMB << L" MB";
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        unsigned long c = length == 1 ? lead : length == 2 ? (lead & 0x1F) : length == 3 ? (lead & 0x0F) : (lead & 0x07);
+        bool valid = length != 0 && i + length <= text.size();
+        for (size_t k = 1; valid && k < length; ++k)
+        {
+            unsigned char next = static_cast<unsigned char>(text[i + k]);
+            valid = (next & 0xC0) == 0x80;
+            c = (c << 6) | (next & 0x3F);
+        }
+        if (!valid)
+        {
+            result.push_back(static_cast<wchar_t>(0xFFFD));
+            ++i;
+            continue;
+        }
+        result.push_back(static_cast<wchar_t>(c));    // Beyond U+FFFF this needs wchar_t of 32 bits (not Windows)
+        i += length;
     }
+    return result;
+}
+
+// Everything from ".exe" on is dropped, matching how Windows lists executables
+std::wstring cleanProcessName(const std::wstring& name)
+{
+    size_t pos = name.find(L".exe");
+    if (pos != std::wstring::npos)
+    {
+        return name.substr(0, pos);
+    }
+    return name;
+}
 
-    return stream.str();
+// Whole-string match with * (any run) and ? (any one character)
+bool globMatch(const std::wstring& pattern, const std::wstring& text)
+{
+    size_t p = 0, t = 0;
+    size_t starPattern = std::wstring::npos, starText = 0;
+    while (t < text.size())
+    {
+        if (p < pattern.size() && (pattern[p] == L'?' || pattern[p] == text[t]))
+        {
+            ++p;
+            ++t;
+        }
+        else if (p < pattern.size() && pattern[p] == L'*')
+        {
+            starPattern = p++;
+            starText = t;
+        }
+        else if (starPattern != std::wstring::npos)
+        {
+            // Let the last * swallow one more character and retry
+            p = starPattern + 1;
+            t = ++starText;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == L'*')
+        ++p;
+    return p == pattern.size();
+}
+
+// Number with an optional lowercase suffix; false if there is no number
+static bool splitNumber(const std::wstring& text, double& number, std::wstring& suffix)
+{
+    wchar_t* end = nullptr;
+    number = std::wcstod(text.c_str(), &end);
+    if (end == text.c_str() || !(number >= 0.0) || std::isinf(number))
+        return false;
+    suffix = end;
+    std::transform(suffix.begin(), suffix.end(), suffix.begin(), ::towlower);
+    return true;
+}
+
+bool parseMemorySize(const std::wstring& text, double& bytes)
+{
+    static const struct { const wchar_t* suffix; double scale; } units[] = {
+        { L"", 1.0 }, { L"b", 1.0 },
+        { L"k", 1024.0 }, { L"kb", 1024.0 }, { L"kib", 1024.0 },
+        { L"m", 1048576.0 }, { L"mb", 1048576.0 }, { L"mib", 1048576.0 },
+        { L"g", 1073741824.0 }, { L"gb", 1073741824.0 }, { L"gib", 1073741824.0 },
+        { L"t", 1099511627776.0 }, { L"tb", 1099511627776.0 }, { L"tib", 1099511627776.0 },
+    };
+
+    std::wstring suffix;
+    if (!splitNumber(text, bytes, suffix))
+        return false;
+    for (const auto& unit : units)
+    {
+        if (suffix == unit.suffix)
+        {
+            bytes *= unit.scale;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseDuration(const std::wstring& text, std::chrono::milliseconds& duration)
+{
+    static const struct { const wchar_t* suffix; double scale; } units[] = {
+        { L"ms", 1.0 }, { L"", 1000.0 }, { L"s", 1000.0 }, { L"m", 60000.0 }, { L"h", 3600000.0 },
+    };
+
+    double number = 0.0;
+    std::wstring suffix;
+    if (!splitNumber(text, number, suffix))
+        return false;
+    for (const auto& unit : units)
+    {
+        if (suffix == unit.suffix)
+        {
+            duration = std::chrono::milliseconds(static_cast<long long>(number * unit.scale + 0.5));
+            return true;
+        }
+    }
+    return false;
 }
@@ -1,6 +1,29 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 
-// Formats a memory size (in bytes) into a readable string with units (KB, MB, GB, etc.)
+// Formats a memory size (in bytes) in the display unit (see Format.h for the buffer versions)
 std::wstring formatMemory(size_t memoryUsage);
+
+// Formats a CPU usage given in hundredths of a percent (e.g. 1234 -> "12.34%")
+std::wstring formatCpu(long long hundredthsOfPercent);
+
+// Converts a wide string to UTF-8 (used for paths and command lines outside Windows)
+std::string toNarrow(const std::wstring& text);
+
+// Converts UTF-8 to a wide string (used for program arguments); bad bytes become U+FFFD
+std::wstring toWide(const std::string& text);
+
+// Removes the ".exe" extension from a process name
+std::wstring cleanProcessName(const std::wstring& name);
+
+// Whole-string match of text against pattern, where * matches any run and ? any one character
+bool globMatch(const std::wstring& pattern, const std::wstring& text);
+
+// Parses a size such as "512MB" or "2.5g" (B, KB, MB, GB, TB, with or without the B, and
+// their KiB forms; no unit = bytes) into bytes. False if it is not one.
+bool parseMemorySize(const std::wstring& text, double& bytes);
+
+// Parses a duration such as "500ms", "30s", "5m" or "1h" (no unit = seconds)
+bool parseDuration(const std::wstring& text, std::chrono::milliseconds& duration);
@@ -0,0 +1,205 @@
+#ifdef _WIN32
+
+#include "WindowsSnapshotSource.h"
+#include "UserNames.h"
+#include <psapi.h>
+#include <cwchar>
+
+// Link against the Psapi library (used for memory info)
+#pragma comment(lib, "psapi.lib")
+
+// Owner of the process as the relative ID of its account SID; the account name is looked
+// up the first time each ID is seen. NoUser if the token cannot be opened.
+static uint32_t readProcessUser(HANDLE hProcess)
+{
+    HANDLE token = NULL;
+    if (!OpenProcessToken(hProcess, TOKEN_QUERY, &token))
+        return NoUser;
+
+    uint32_t userId = NoUser;
+    DWORD length = 0;
+    union
+    {
+        TOKEN_USER user;
+        char bytes[sizeof(TOKEN_USER) + SECURITY_MAX_SID_SIZE];
+    } tokenUser;
+    if (GetTokenInformation(token, TokenUser, &tokenUser, sizeof(tokenUser), &length)
+        && IsValidSid(tokenUser.user.User.Sid))
+    {
+        PSID sid = tokenUser.user.User.Sid;
+        UCHAR parts = *GetSidSubAuthorityCount(sid);
+        if (parts > 0)
+        {
+            userId = static_cast<uint32_t>(*GetSidSubAuthority(sid, parts - 1));
+            if (!knowsUserName(userId))
+            {
+                wchar_t account[256], domain[256];
+                DWORD accountLength = 256, domainLength = 256;
+                SID_NAME_USE use;
+                if (LookupAccountSidW(NULL, sid, account, &accountLength, domain, &domainLength, &use))
+                    rememberUserName(userId, account);
+            }
+        }
+    }
+    CloseHandle(token);
+    return userId;
+}
+
+bool WindowsSnapshotSource::beginWalk(size_t& count)
+{
+    entries.clear();
+
+    // Take a snapshot of all running processes
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    PROCESSENTRY32W entry;
+    entry.dwSize = sizeof(PROCESSENTRY32W);
+
+    // Get the first process from the snapshot
+    if (!Process32FirstW(snapshot, &entry))
+    {
+        CloseHandle(snapshot);
+        return false;
+    }
+
+    do
+    {
+        entries.push_back(entry);
+    } while (Process32NextW(snapshot, &entry)); // Continue through the snapshot
+
+    CloseHandle(snapshot);
+    count = entries.size();
+    return true;
+}
+
+bool WindowsSnapshotSource::sampleAt(size_t index, ProcessSample& sample, SampleScratch&)
+{
+    const PROCESSENTRY32W& entry = entries[index];
+    sample.pid = entry.th32ProcessID;
+    sample.parentPid = entry.th32ParentProcessID;
+    sample.startTime = 0;
+    sample.cpuTime = 0;
+    sample.memoryUsage = 0;
+    sample.isAccessible = false;
+    sample.userId = NoUser;
+    sample.state = '?';    // Windows has no single per-process scheduler state
+    sample.pageFaults = 0;
+    sample.majorFaults = 0;    // Not told apart from soft faults
+    sample.peakMemory = 0;
+    sample.threadCount = entry.cntThreads;    // Comes with the toolhelp entry
+    sample.handleCount = 0;
+    sample.readBytes = 0;
+    sample.writeBytes = 0;
+    sample.readOps = 0;
+    sample.writeOps = 0;
+    sample.contextSwitches = 0;    // Only kept per thread, by NtQuerySystemInformation
+    sample.wideName = entry.szExeFile; // Process executable name, copied only for new PIDs
+    sample.utf8Name = nullptr;
+    sample.nameLength = wcslen(entry.szExeFile);
+
+    // Try to open the process for querying its times and memory info
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, sample.pid);
+    if (hProcess)
+    {
+        sample.isAccessible = true;
+
+        FILETIME creation, exitTime, kernel, user;
+        if (GetProcessTimes(hProcess, &creation, &exitTime, &kernel, &user))
+        {
+            sample.startTime = (static_cast<unsigned long long>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+
+            // Kernel and user times count 100 ns units
+            unsigned long long kernelTime = (static_cast<unsigned long long>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+            unsigned long long userTime = (static_cast<unsigned long long>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+            sample.cpuTime = (kernelTime + userTime) * 100;
+        }
+
+        // The extended counters come with the same call, so peak and faults cost nothing extra
+        PROCESS_MEMORY_COUNTERS_EX pmc;
+        if (GetProcessMemoryInfo(hProcess, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc)))
+        {
+            sample.memoryUsage = pmc.WorkingSetSize;  // Store current memory usage
+            sample.peakMemory = pmc.PeakWorkingSetSize;
+            sample.pageFaults = pmc.PageFaultCount;
+        }
+
+        // Counts all I/O the process issued (files, network, devices), not just storage
+        IO_COUNTERS io;
+        if (GetProcessIoCounters(hProcess, &io))
+        {
+            sample.readBytes = io.ReadTransferCount;
+            sample.writeBytes = io.WriteTransferCount;
+            sample.readOps = io.ReadOperationCount;
+            sample.writeOps = io.WriteOperationCount;
+        }
+        DWORD handles = 0;
+        if (GetProcessHandleCount(hProcess, &handles))
+            sample.handleCount = handles;
+        sample.userId = readProcessUser(hProcess);
+        CloseHandle(hProcess);
+    }
+
+    // Inaccessible processes are still listed, just without counters
+    return true;
+}
+
+bool WindowsSnapshotSource::readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch&)
+{
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+    if (!hProcess)
+        return false;
+
+    // The working set can grow between asking for its size and reading it, so leave room
+    // and retry; the buffer stays with the thread for the next process
+    thread_local std::vector<ULONG_PTR> buffer(4096);
+    bool read = false;
+    for (int attempt = 0; attempt < 4 && !read; ++attempt)
+    {
+        read = QueryWorkingSet(hProcess, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(ULONG_PTR))) != 0;
+        if (!read)
+        {
+            if (GetLastError() != ERROR_BAD_LENGTH)
+                break;
+            ULONG_PTR entries = reinterpret_cast<PSAPI_WORKING_SET_INFORMATION*>(buffer.data())->NumberOfEntries;
+            buffer.resize(static_cast<size_t>(entries + entries / 8 + 1024));
+        }
+    }
+
+    PROCESS_MEMORY_COUNTERS_EX pmc;
+    bool counters = GetProcessMemoryInfo(hProcess, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc)) != 0;
+    CloseHandle(hProcess);
+    if (!read)
+        return false;
+
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+    unsigned long long pageSize = system.dwPageSize;
+
+    // ShareCount saturates at 7, so pages shared more widely than that are overweighted
+    // in the proportional share
+    detail = MemoryDetail();
+    const PSAPI_WORKING_SET_INFORMATION* info = reinterpret_cast<const PSAPI_WORKING_SET_INFORMATION*>(buffer.data());
+    for (ULONG_PTR i = 0; i < info->NumberOfEntries; ++i)
+    {
+        const PSAPI_WORKING_SET_BLOCK& block = info->WorkingSetInfo[i];
+        if (block.Shared && block.ShareCount > 1)
+        {
+            detail.shared += pageSize;
+            detail.proportional += pageSize / block.ShareCount;
+        }
+        else
+        {
+            detail.unique += pageSize;
+            detail.proportional += pageSize;
+        }
+    }
+    if (counters && pmc.PrivateUsage > detail.unique)
+        detail.swap = pmc.PrivateUsage - detail.unique;
+    return true;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ProcessSnapshotSource.h"
+
+#ifdef _WIN32
+#include <tlhelp32.h>
+#include <vector>
+
+// Walks the toolhelp snapshot and asks each process for its times, working set, I/O and handles
+class WindowsSnapshotSource : public ProcessSnapshotSource
+{
+public:
+    bool beginWalk(size_t& count) override;
+    bool sampleAt(size_t index, ProcessSample& sample, SampleScratch& scratch) override;
+
+    // Walks the working set with QueryWorkingSet and splits it by share count; one entry
+    // per resident page, so far dearer than the counters sampleAt reads
+    bool readMemoryDetail(DWORD pid, MemoryDetail& detail, SampleScratch& scratch) override;
+
+private:
+    // Toolhelp entries of the current walk (PID and executable name)
+    std::vector<PROCESSENTRY32W> entries;
+};
+#endif
@@ -0,0 +1,98 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned threadCount)
+    : workerCount(std::max(1u, threadCount)), slices(new Slice[std::max(1u, threadCount)])
+{
+    for (unsigned worker = 1; worker < workerCount; ++worker)
+    {
+        threads.emplace_back(&WorkerPool::workerLoop, this, worker);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+unsigned WorkerPool::size() const
+{
+    return workerCount;
+}
+
+void WorkerPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, unsigned)>& body)
+{
+    if (count == 0)
+        return;
+
+    // Hand every worker an equal slice up front
+    size_t share = (count + workerCount - 1) / workerCount;
+    for (unsigned worker = 0; worker < workerCount; ++worker)
+    {
+        size_t begin = std::min(count, share * worker);
+        slices[worker].next.store(begin);
+        slices[worker].end = std::min(count, begin + share);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &body;
+        jobGrain = std::max<size_t>(1, grain);
+        pending = workerCount - 1;
+        ++generation;
+    }
+    jobReady.notify_all();
+
+    runSlices(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [this]() { return pending == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::workerLoop(unsigned worker)
+{
+    unsigned long long seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this, seen]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        runSlices(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending;
+        }
+        jobDone.notify_one();
+    }
+}
+
+void WorkerPool::runSlices(unsigned worker)
+{
+    for (unsigned step = 0; step < workerCount; ++step)
+    {
+        Slice& slice = slices[(worker + step) % workerCount];
+        while (true)
+        {
+            size_t begin = slice.next.fetch_add(jobGrain);
+            if (begin >= slice.end)
+                break;
+            (*job)(begin, std::min(slice.end, begin + jobGrain), worker);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads for splitting index ranges. Each worker starts on its own slice
+// of the range and, once that is done, steals chunks from the slices of slower workers.
+class WorkerPool
+{
+public:
+    // threadCount includes the calling thread, which takes part as worker 0
+    explicit WorkerPool(unsigned threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Number of workers, calling thread included
+    unsigned size() const;
+
+    // Calls body(begin, end, worker) for chunks of at most grain indices until [0, count)
+    // is covered, and returns once every chunk has finished
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, unsigned)>& body);
+
+private:
+    // One worker's share of the range; others take chunks from it with the same fetch_add
+    struct alignas(64) Slice
+    {
+        std::atomic<size_t> next{ 0 };
+        size_t end = 0;
+    };
+
+    // Body of the extra threads
+    void workerLoop(unsigned worker);
+
+    // Works through our own slice, then through everyone else's
+    void runSlices(unsigned worker);
+
+    unsigned workerCount;
+    std::unique_ptr<Slice[]> slices;
+    std::vector<std::thread> threads;
+
+    // Current job, published under mutex
+    const std::function<void(size_t, size_t, unsigned)>* job = nullptr;
+    size_t jobGrain = 1;
+    unsigned long long generation = 0;
+    unsigned pending = 0;
+    bool stopping = false;
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+};
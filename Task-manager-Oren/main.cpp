@@ -1,10 +1,40 @@
+#include "CommandLine.h"
 #include "ProcessManager.h"
 #include "Menu.h"
+#include "ProcessFilter.h"
+#include "ProcessSampler.h"
 #include <iostream>
+#include <clocale>
+#include <thread>
 
 // Entry point of the program
-int main()
+int main(int argc, char* argv[])
 {
+    // Use the user's locale so wide process names print correctly
+    std::setlocale(LC_ALL, "");
+
+    // Any argument selects the non-interactive mode, which streams snapshots to stdout
+    CommandLineOptions options;
+    std::string error;
+    if (!parseCommandLine(argc, argv, options, error))
+    {
+        std::cerr << "Task-manager-Oren: " << error << "\n\n" << commandLineUsage();
+        return 2;
+    }
+    if (options.help)
+    {
+        std::cout << commandLineUsage() << "\n" << ProcessFilter::syntax() << "\n" << ResourceGuard::syntax();
+        return 0;
+    }
+    if (options.serve)
+        return runMetricsServer(options);
+    if (!options.batchPath.empty())
+        return runBatchCommands(options);
+    if (!options.guardPath.empty())
+        return runGuard(options);
+    if (options.headless)
+        return runHeadless(options);
+
     // Create an instance of ProcessManager to handle process data
     ProcessManager pm;
 
@@ -16,8 +46,19 @@ int main()
         return 1;
     }
 
-    // Create a menu interface and pass the ProcessManager instance to it
-    Menu menu(pm);
+    // Keep collecting in the background so the views never wait for a refresh
+    ProcessSampler sampler(std::chrono::seconds(2));
+    sampler.setCollectionThreads(std::thread::hardware_concurrency());
+
+    // Memory breakdown for the 20 largest processes each tick, for everyone once a minute
+    MemoryDetailPolicy detailPolicy;
+    detailPolicy.topCount = 20;
+    detailPolicy.every = 30;
+    sampler.setMemoryDetailPolicy(detailPolicy);
+    sampler.start();
+
+    // Create a menu interface and pass the ProcessManager and sampler to it
+    Menu menu(pm, sampler);
 
     // Start the menu loop to interact with the user
     menu.runMenu();